@@ -0,0 +1,87 @@
+/**
+ * Measure how long a follower takes to catch up from a snapshot depending
+ * on the size of the cache, going through the logical snapshot objects of
+ * the state machine as NuRaft does, without the network.
+ *
+ * usage: bench_catch_up [max_items] [value_size] [block_size]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "raft/cache_state_machine.hxx"
+#include "helpers/utilities.hxx"
+
+int main(int argc, char** argv)
+{
+    size_t max_items = argc > 1 ? std::atol(argv[1]) : 1000000;
+    size_t value_size = argc > 2 ? std::atol(argv[2]) : 100;
+    size_t block_size = argc > 3 ? std::atol(argv[3]) : 4 * 1024 * 1024;
+
+    std::printf("catch up: %zu bytes values, %zu bytes blocks\n",
+                value_size, block_size);
+    std::printf("%10s  %8s  %10s  %10s  %10s  %10s\n", "items", "blocks",
+                "read (s)", "save (s)", "apply (s)", "Mitems/s");
+
+    using clock = std::chrono::steady_clock;
+    auto seconds = [](clock::time_point begin) {
+        return std::chrono::duration<double>(clock::now() - begin).count();
+    };
+
+    for (size_t items = 1000; items <= max_items; items *= 10) {
+        lrucache::cache_config config = build_default_cache_config();
+        config.cache_size = 2 * items * item_size(value_size) + (64 << 20);
+        config.max_item_size = value_size;
+        config.max_key_size = 64;
+        config.shard_count = 16;
+        config.snapshot_block_size = block_size;
+        lrucache::cache_state_machine leader(config);
+        lrucache::cache_state_machine follower(config);
+
+        std::time_t now = std::time(nullptr);
+        auto item = create_item(value_size, now + 3600);
+        for (size_t i = 0; i < items; i++) {
+            leader.state().commit_write("key" + std::to_string(i), item, now);
+        }
+
+        auto cluster = nuraft::cs_new<nuraft::cluster_config>();
+        nuraft::snapshot s(items, 1, cluster);
+        nuraft::async_result<bool>::handler_type when_done =
+            [](bool&, nuraft::ptr<std::exception>&) {};
+        leader.create_snapshot(s, when_done);
+
+        double read_time = 0;
+        double save_time = 0;
+        size_t blocks = 0;
+        void* ctx = nullptr;
+        ulong obj_id = 0;
+        bool is_last_obj = false;
+        while (!is_last_obj) {
+            nuraft::ptr<nuraft::buffer> data;
+            auto begin = clock::now();
+            if (leader.read_logical_snp_obj(s, ctx, obj_id, data,
+                                            is_last_obj) < 0) {
+                std::fprintf(stderr, "failed to read object %lu\n", obj_id);
+                return 1;
+            }
+            read_time += seconds(begin);
+
+            begin = clock::now();
+            follower.save_logical_snp_obj(s, obj_id, *data, obj_id == 0,
+                                          is_last_obj);
+            save_time += seconds(begin);
+            blocks++;
+        }
+        leader.free_user_snp_ctx(ctx);
+
+        auto begin = clock::now();
+        follower.apply_snapshot(s);
+        double apply_time = seconds(begin);
+
+        std::printf("%10zu  %8zu  %10.3f  %10.3f  %10.3f  %10.2f\n", items,
+                    blocks - 1, read_time, save_time, apply_time,
+                    items / (read_time + save_time + apply_time) / 1e6);
+    }
+    return 0;
+}
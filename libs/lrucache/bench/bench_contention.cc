@@ -0,0 +1,102 @@
+/**
+ * Measure how cache_state throughput scales with the number of threads
+ * hammering it, for different shard counts.
+ *
+ * usage: bench_contention [duration_ms] [read_percent]
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cache/cache_state.hxx"
+#include "helpers/utilities.hxx"
+
+constexpr size_t KEY_COUNT = 100000;
+constexpr size_t VALUE_SIZE = 64;
+
+static double run(size_t shard_count, size_t thread_count,
+                  int duration_ms, int read_percent)
+{
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 1024 * 1024 * 1024;
+    config.max_item_size = 1024;
+    config.max_key_size = 64;
+    config.shard_count = shard_count;
+    lrucache::cache_state state(config);
+
+    std::time_t now = std::time(nullptr);
+    std::vector<std::string> keys;
+    keys.reserve(KEY_COUNT);
+    for (size_t i = 0; i < KEY_COUNT; i++) {
+        keys.push_back("key" + std::to_string(i));
+        state.commit_write(keys.back(), create_item(VALUE_SIZE, now + 3600),
+                           now);
+    }
+
+    std::atomic<bool> start(false);
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> total_ops(0);
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < thread_count; t++) {
+        threads.emplace_back([&, t]() {
+            auto item = create_item(VALUE_SIZE, now + 3600);
+            uint64_t seed = 0x9e3779b97f4a7c15ULL * (t + 1);
+            uint64_t ops = 0;
+            while (!start) {}
+            while (!stop) {
+                seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+                const auto& key = keys[seed % KEY_COUNT];
+                if ((int)(seed >> 32) % 100 < read_percent) {
+                    state.read_then(key, [](unsigned char*, size_t) {});
+                } else {
+                    state.commit_write(key, item, now);
+                }
+                ops++;
+            }
+            total_ops += ops;
+        });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    start = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    auto elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - begin).count();
+    return total_ops / elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    int duration_ms = argc > 1 ? std::atoi(argv[1]) : 500;
+    int read_percent = argc > 2 ? std::atoi(argv[2]) : 90;
+    const size_t shard_counts[] = { 1, 4, 16, 64 };
+    const size_t thread_counts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+    std::printf("cache_state contention: %d%% reads, %zu keys, %zu bytes\n",
+                read_percent, KEY_COUNT, VALUE_SIZE);
+    std::printf("%8s", "threads");
+    for (auto shards : shard_counts) {
+        std::printf("  %9zu shards", shards);
+    }
+    std::printf("   (Mops/s)\n");
+
+    for (auto threads : thread_counts) {
+        std::printf("%8zu", threads);
+        for (auto shards : shard_counts) {
+            double ops = run(shards, threads, duration_ms, read_percent);
+            std::printf("  %16.2f", ops / 1e6);
+            std::fflush(stdout);
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
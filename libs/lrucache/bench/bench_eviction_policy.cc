@@ -0,0 +1,97 @@
+/**
+ * Measure the hit ratio of each eviction policy on a skewed workload
+ * interrupted by scans of keys read only once, like a nightly batch job.
+ *
+ * usage: bench_eviction_policy [operations] [scan_length]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "cache/cache_storage.hxx"
+#include "helpers/utilities.hxx"
+
+constexpr size_t KEY_COUNT = 100000;
+constexpr size_t CACHE_ITEMS = 10000;
+constexpr size_t VALUE_SIZE = 100;
+constexpr size_t SCAN_EVERY = 100000;
+
+struct result {
+    double hit_ratio;
+    double ops_per_second;
+};
+
+static result run(const std::string& policy, size_t operations,
+                  size_t scan_length)
+{
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = CACHE_ITEMS * item_size(VALUE_SIZE);
+    config.max_item_size = 1024;
+    config.max_key_size = 64;
+    config.eviction_policy = policy;
+    lrucache::cache_storage storage(config);
+
+    std::time_t now = std::time(nullptr);
+    auto item = create_item(VALUE_SIZE, now + 3600);
+
+    // zipf distribution of the keys, s = 0.9
+    std::vector<double> cumulative(KEY_COUNT);
+    double sum = 0;
+    for (size_t i = 0; i < KEY_COUNT; i++) {
+        sum += 1.0 / std::pow(i + 1, 0.9);
+        cumulative[i] = sum;
+    }
+
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    size_t hits = 0;
+    size_t lookups = 0;
+    size_t scanned = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t op = 0; op < operations; op++) {
+        if (op % SCAN_EVERY == 0) {
+            for (size_t i = 0; i < scan_length; i++, scanned++) {
+                storage.commit_write("scan" + std::to_string(scanned), item,
+                                     now);
+            }
+        }
+
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        double target = (seed >> 11) * (1.0 / 9007199254740992.0) * sum;
+        size_t rank = std::lower_bound(cumulative.begin(), cumulative.end(),
+                                       target) - cumulative.begin();
+        auto key = "key" + std::to_string(rank);
+
+        lookups++;
+        if (storage.commit_read(key, now)) {
+            hits++;
+        } else {
+            storage.commit_write(key, item, now);
+        }
+    }
+    auto elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - begin).count();
+    return { double(hits) / lookups, operations / elapsed };
+}
+
+int main(int argc, char** argv)
+{
+    size_t operations = argc > 1 ? std::atol(argv[1]) : 1000000;
+    size_t scan_length = argc > 2 ? std::atol(argv[2]) : 2 * CACHE_ITEMS;
+    const char* policies[] = { "lru", "slru", "arc", "clock", "wtinylfu" };
+
+    std::printf("eviction policies: %zu keys, %zu cached, "
+                "scan of %zu keys every %zu operations\n",
+                KEY_COUNT, CACHE_ITEMS, scan_length, SCAN_EVERY);
+    std::printf("%10s  %10s  %10s\n", "policy", "hit ratio", "Mops/s");
+    for (auto policy : policies) {
+        auto r = run(policy, operations, scan_length);
+        std::printf("%10s  %9.2f%%  %10.2f\n",
+                    policy, 100 * r.hit_ratio, r.ops_per_second / 1e6);
+        std::fflush(stdout);
+    }
+    return 0;
+}
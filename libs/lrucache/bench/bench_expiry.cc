@@ -0,0 +1,109 @@
+/**
+ * Measure the cost of scheduling, updating and purging item expiries with
+ * the timing wheel against the sorted map of buckets it replaced.
+ *
+ * usage: bench_expiry [items] [max_ttl]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "cache/timing_wheel.hxx"
+
+using lrucache::cache_entry;
+using lrucache::expiry_list;
+
+// the previous implementation, one bucket per purge interval
+struct bucket_map {
+    bucket_map(int interval) : interval(interval) {}
+
+    void schedule(cache_entry* entry) {
+        auto bucket = entry->item.expires_at / interval * interval + interval;
+        buckets[bucket].push_back(entry);
+        // the entry used to remember its bucket, borrow an unused field
+        entry->hash = bucket;
+    }
+
+    void cancel(cache_entry* entry) {
+        auto iter = buckets.find(entry->hash);
+        iter->second.remove(entry);
+        if (iter->second.empty())
+            buckets.erase(iter);
+    }
+
+    template <typename F>
+    size_t advance(std::time_t now, size_t, F expire) {
+        size_t expired = 0;
+        while (!buckets.empty() && buckets.begin()->first <= now) {
+            expire(buckets.begin()->second.front());
+            expired++;
+        }
+        return expired;
+    }
+
+    int interval;
+    std::map<std::time_t, expiry_list> buckets;
+};
+
+template <typename Wheel>
+static double run(Wheel& wheel, std::deque<cache_entry>& entries,
+                  std::time_t now, int max_ttl)
+{
+    std::mt19937_64 rng(42);
+    auto begin = std::chrono::steady_clock::now();
+
+    for (auto& entry : entries) {
+        entry.item.expires_at = now + 1 + rng() % max_ttl;
+        wheel.schedule(&entry);
+    }
+    // every item gets its TTL refreshed once
+    for (auto& entry : entries) {
+        wheel.cancel(&entry);
+        entry.item.expires_at = now + 1 + rng() % max_ttl;
+        wheel.schedule(&entry);
+    }
+    size_t expired = 0;
+    for (std::time_t t = now; t <= now + max_ttl + 30; t += 30) {
+        expired += wheel.advance(t, SIZE_MAX, [&](cache_entry* entry) {
+            wheel.cancel(entry);
+        });
+    }
+
+    auto elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - begin).count();
+    if (expired != entries.size())
+        std::printf("only %zu items expired\n", expired);
+    return elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    size_t items = argc > 1 ? std::atol(argv[1]) : 1000000;
+    int max_ttl = argc > 2 ? std::atoi(argv[2]) : 3600;
+    std::time_t now = 1700000000;
+
+    std::printf("expiry: %zu items, TTL up to %d s, 1 refresh each\n",
+                items, max_ttl);
+    std::printf("%12s  %10s  %12s\n", "bucket (s)", "time (s)", "Mops/s");
+    {
+        std::deque<cache_entry> entries(items);
+        lrucache::timing_wheel wheel;
+        wheel.reset(now);
+        double elapsed = run(wheel, entries, now, max_ttl);
+        std::printf("%12s  %10.3f  %12.2f\n", "wheel  1", elapsed,
+                    3 * items / elapsed / 1e6);
+    }
+    // the wheel expires items to the second, the map to the purge interval
+    for (int interval : { 30, 1 }) {
+        std::deque<cache_entry> entries(items);
+        bucket_map map(interval);
+        double elapsed = run(map, entries, now, max_ttl);
+        std::printf("%9s %2d  %10.3f  %12.2f\n", "map", interval, elapsed,
+                    3 * items / elapsed / 1e6);
+    }
+    return 0;
+}
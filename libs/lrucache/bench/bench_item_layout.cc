@@ -0,0 +1,139 @@
+/**
+ * Compare the memory footprint and write throughput of cache_item, which
+ * stores small values inline, against the previous layout where every
+ * value lived in a shared heap vector.
+ *
+ * usage: bench_item_layout [item_count]
+ */
+#include <malloc.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "cache/cache_storage.hxx"
+#include "helpers/utilities.hxx"
+
+// layout of cache_item before small values were stored inline
+struct legacy_item {
+    legacy_item(unsigned char* bytes, size_t len, std::time_t exp)
+        : key(nullptr), data_size(len), expires_at(exp)
+    {
+        data = std::make_shared<item_data>(len);
+        std::memcpy(data.get()->data(), bytes, len);
+    }
+
+    const std::string* key;
+    std::shared_ptr<item_data> data;
+    size_t data_size;
+    std::time_t expires_at;
+};
+
+// bytes handed out by operator new, including malloc bookkeeping
+static std::atomic<size_t> heap_bytes(0);
+
+void* operator new(size_t size)
+{
+    void* ptr = std::malloc(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    heap_bytes += malloc_usable_size(ptr) + sizeof(size_t);
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (ptr)
+        heap_bytes -= malloc_usable_size(ptr) + sizeof(size_t);
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+static size_t heap_in_use()
+{
+    return heap_bytes;
+}
+
+template <typename T>
+static void measure(const char* name, size_t count, size_t value_size)
+{
+    std::vector<unsigned char> value(value_size, 'x');
+    std::vector<T> items;
+    items.reserve(count);
+
+    size_t before = heap_in_use();
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++) {
+        items.emplace_back(value.data(), value_size, 0);
+    }
+    auto elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - begin).count();
+    size_t after = heap_in_use();
+
+    // the vector was reserved up front, add the size of the item itself
+    std::printf("%-8s %8zu %14.1f %14.2f\n", name, value_size,
+                sizeof(T) + (double)(after - before) / count,
+                count / elapsed / 1e6);
+}
+
+static void measure_storage(size_t count, size_t value_size)
+{
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 1024 * 1024 * 1024;
+    config.purge_interval = 30;
+    lrucache::cache_storage storage(config);
+
+    std::vector<std::string> keys;
+    keys.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        keys.push_back("key" + std::to_string(i));
+    }
+    std::vector<unsigned char> value(value_size, 'x');
+    std::time_t expires_at = std::time(nullptr) + 3600;
+
+    // build the item for every write like the state machine does
+    size_t before = heap_in_use();
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++) {
+        lrucache::cache_item item(value.data(), value_size, expires_at);
+        storage.commit_write(keys[i], item, 0);
+    }
+    auto elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - begin).count();
+    size_t after = heap_in_use();
+
+    std::printf("%-8s %8zu %14.1f %14.2f %18zu\n", "storage", value_size,
+                (double)(after - before) / count, count / elapsed / 1e6,
+                lrucache::cache_storage::get_item_size(keys[0], value_size));
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = argc > 1 ? std::atoll(argv[1]) : 1000000;
+    const size_t value_sizes[] = { 8, 32, 64, 128, 512 };
+
+    std::printf("inline value size: %zu bytes, %zu items\n\n",
+                lrucache::cache_item::INLINE_SIZE, count);
+    std::printf("%-8s %8s %14s %14s\n",
+                "layout", "value", "heap B/item", "Mitems/s");
+    for (auto size : value_sizes) {
+        measure<legacy_item>("legacy", count, size);
+        measure<lrucache::cache_item>("inline", count, size);
+    }
+
+    std::printf("\n%-8s %8s %14s %14s %18s\n",
+                "", "value", "heap B/item", "Mwrites/s", "get_item_size()");
+    for (auto size : value_sizes) {
+        measure_storage(count, size);
+    }
+    return 0;
+}
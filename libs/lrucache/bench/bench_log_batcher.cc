@@ -0,0 +1,196 @@
+/**
+ * Measure the throughput and latency of operations replicated through the
+ * log batcher for different batch windows, with clients proposing a 90/10
+ * mix of reads and writes and waiting for each to be committed.
+ *
+ * The leader's append path is modeled by a single thread spending a fixed
+ * cost on each log entry, for its serialization, log write and replication
+ * messages, before committing it to the state machine. Batching shares
+ * that cost between the operations of an entry, at the price of the time
+ * they wait for the window to end.
+ *
+ * usage: bench_log_batcher [duration_ms] [entry_cost_us]
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "helpers/utilities.hxx"
+#include "raft/log_batcher.hxx"
+
+using lrucache::cache_state_machine;
+using lrucache::log_batcher;
+
+constexpr size_t KEY_COUNT = 10000;
+constexpr size_t VALUE_SIZE = 100;
+constexpr int WRITE_PERCENT = 10;
+
+using bench_clock = std::chrono::steady_clock;
+
+struct result {
+    double throughput;
+    double entries;
+    double p50_us;
+    double p99_us;
+};
+
+/**
+ * Single thread appending and committing the log entries one at a time.
+ */
+class leader {
+public:
+    leader(cache_state_machine& machine, int entry_cost_us)
+        : machine_(machine)
+        , entry_cost_(entry_cost_us)
+        , thread_(&leader::run, this)
+    {
+    }
+
+    ~leader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    nuraft::ptr<log_batcher::result> append(
+            nuraft::ptr<nuraft::buffer> entry)
+    {
+        auto ret = nuraft::cs_new<log_batcher::result>();
+        ret->accept();
+        std::lock_guard<std::mutex> lock(lock_);
+        queue_.emplace_back(entry, ret);
+        cv_.notify_all();
+        return ret;
+    }
+
+    size_t committed() const { return index_; }
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+        while (true) {
+            cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;
+            }
+            auto next = std::move(queue_.front());
+            queue_.pop_front();
+            lock.unlock();
+
+            auto until = bench_clock::now() + entry_cost_;
+            while (bench_clock::now() < until) {
+            }
+            auto ret = machine_.commit(++index_, *next.first);
+            nuraft::ptr<std::exception> err;
+            next.second->set_result(ret, err);
+            lock.lock();
+        }
+    }
+
+    cache_state_machine& machine_;
+    std::chrono::microseconds entry_cost_;
+    std::atomic<size_t> index_{0};
+
+    std::mutex lock_;
+    std::condition_variable cv_;
+    std::deque<std::pair<nuraft::ptr<nuraft::buffer>,
+                         nuraft::ptr<log_batcher::result>>> queue_;
+    bool stopping_ = false;
+
+    std::thread thread_;
+};
+
+static result run(int window, size_t client_count, int duration_ms,
+                  int entry_cost_us)
+{
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 256 * 1024 * 1024;
+    config.max_item_size = 1024;
+    config.max_key_size = 64;
+    config.shard_count = 16;
+    cache_state_machine machine(config);
+
+    leader raft(machine, entry_cost_us);
+    log_batcher batcher(window, 1024 * 1024,
+                        [&raft](nuraft::ptr<nuraft::buffer> entry) {
+                            return raft.append(entry);
+                        });
+
+    std::atomic<bool> stop(false);
+    std::vector<std::vector<double>> latencies(client_count);
+    std::vector<std::thread> clients;
+    for (size_t i = 0; i < client_count; i++) {
+        clients.emplace_back([&, i]() {
+            std::mt19937_64 rng(i);
+            std::vector<unsigned char> value(VALUE_SIZE, 'v');
+            while (!stop) {
+                cache_state_machine::op_payload op;
+                op.timestamp = std::time(nullptr);
+                op.key = "key" + std::to_string(rng() % KEY_COUNT);
+                op.type = rng() % 100 < WRITE_PERCENT
+                          ? cache_state_machine::WRITE
+                          : cache_state_machine::READ;
+                op.data = value.data();
+                op.data_len = value.size();
+                op.expires_at = op.timestamp + 3600;
+
+                auto begin = bench_clock::now();
+                batcher.propose(op)->get();
+                latencies[i].push_back(std::chrono::duration<double,
+                        std::micro>(bench_clock::now() - begin).count());
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+    stop = true;
+    for (auto& client : clients) {
+        client.join();
+    }
+
+    std::vector<double> all;
+    for (auto& client : latencies) {
+        all.insert(all.end(), client.begin(), client.end());
+    }
+    std::sort(all.begin(), all.end());
+    if (all.empty()) {
+        return { 0, 0, 0, 0 };
+    }
+    return { all.size() * 1000.0 / duration_ms,
+             raft.committed() * 1000.0 / duration_ms,
+             all[all.size() / 2], all[all.size() * 99 / 100] };
+}
+
+int main(int argc, char** argv)
+{
+    int duration_ms = argc > 1 ? std::atoi(argv[1]) : 2000;
+    int entry_cost_us = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    std::printf("batched operations: %d us per log entry, %d%% writes\n",
+                entry_cost_us, WRITE_PERCENT);
+    std::printf("%10s  %8s  %12s  %12s  %10s  %10s\n", "window us",
+                "clients", "ops/s", "entries/s", "p50 (us)", "p99 (us)");
+    for (int window : { 0, 50, 200, 1000 }) {
+        for (size_t clients : { 1, 16, 128 }) {
+            result r = run(window, clients, duration_ms, entry_cost_us);
+            std::printf("%10d  %8zu  %12.0f  %12.0f  %10.1f  %10.1f\n",
+                        window, clients, r.throughput, r.entries, r.p50_us,
+                        r.p99_us);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,197 @@
+/**
+ * Measure the cost of encoding and decoding log entries with the
+ * FlatBuffers schema of schema/LogEntry.fbs, against the previous format
+ * written field by field with nuraft::buffer_serializer, for each type of
+ * operation.
+ *
+ * Verifying an entry is all a commit does before reading it in place,
+ * decoding it also copies its keys out like the previous format did.
+ *
+ * usage: bench_log_codec [iterations]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "raft/cache_state_machine.hxx"
+
+using lrucache::cache_state_machine;
+using op_payload = cache_state_machine::op_payload;
+
+using bench_clock = std::chrono::steady_clock;
+
+// entries written field by field, as before the schema
+static size_t legacy_size(const op_payload& payload)
+{
+    size_t size = sizeof(payload.type) + sizeof(payload.timestamp);
+    if (payload.type == cache_state_machine::BATCH) {
+        size += sizeof(uint64_t);
+        for (auto& op : payload.ops) {
+            size += legacy_size(op);
+        }
+    } else if (payload.type == cache_state_machine::TOUCH) {
+        size += sizeof(uint64_t) * (payload.hashes.size() + 1);
+    } else if (payload.type != cache_state_machine::PURGE) {
+        size += sizeof(size_t) + payload.key.size();
+    }
+    if (payload.type == cache_state_machine::WRITE) {
+        size += sizeof(size_t) + payload.data_len + sizeof(time_t);
+    }
+    return size;
+}
+
+static void legacy_put(nuraft::buffer_serializer& bs,
+                       const op_payload& payload)
+{
+    bs.put_raw(&payload.type, sizeof(payload.type));
+    bs.put_raw(&payload.timestamp, sizeof(payload.timestamp));
+    if (payload.type == cache_state_machine::BATCH) {
+        bs.put_u64(payload.ops.size());
+        for (auto& op : payload.ops) {
+            legacy_put(bs, op);
+        }
+    } else if (payload.type == cache_state_machine::TOUCH) {
+        bs.put_u64(payload.hashes.size());
+        for (auto hash : payload.hashes) {
+            bs.put_u64(hash);
+        }
+    } else if (payload.type != cache_state_machine::PURGE) {
+        bs.put_str(payload.key);
+    }
+    if (payload.type == cache_state_machine::WRITE) {
+        bs.put_bytes(payload.data, payload.data_len);
+        bs.put_raw(&payload.expires_at, sizeof(payload.expires_at));
+    }
+}
+
+static void legacy_get(nuraft::buffer_serializer& bs, op_payload& payload)
+{
+    std::memcpy(&payload.type, bs.get_raw(sizeof(payload.type)),
+                sizeof(payload.type));
+    std::memcpy(&payload.timestamp, bs.get_raw(sizeof(payload.timestamp)),
+                sizeof(payload.timestamp));
+    if (payload.type == cache_state_machine::BATCH) {
+        payload.ops.resize(bs.get_u64());
+        for (auto& op : payload.ops) {
+            legacy_get(bs, op);
+        }
+    } else if (payload.type == cache_state_machine::TOUCH) {
+        payload.hashes.resize(bs.get_u64());
+        for (auto& hash : payload.hashes) {
+            hash = bs.get_u64();
+        }
+    } else if (payload.type != cache_state_machine::PURGE) {
+        payload.key = bs.get_str();
+    }
+    if (payload.type == cache_state_machine::WRITE) {
+        payload.data = static_cast<unsigned char*>(
+                bs.get_bytes(payload.data_len));
+        std::memcpy(&payload.expires_at,
+                    bs.get_raw(sizeof(payload.expires_at)),
+                    sizeof(payload.expires_at));
+    }
+}
+
+static nuraft::ptr<nuraft::buffer> legacy_encode(const op_payload& payload)
+{
+    auto log = nuraft::buffer::alloc(legacy_size(payload));
+    nuraft::buffer_serializer bs(log);
+    legacy_put(bs, payload);
+    return log;
+}
+
+static op_payload create_op(cache_state_machine::op_type type,
+                            const std::string& key, size_t value_size)
+{
+    static std::vector<unsigned char> value(64 * 1024, 'v');
+    op_payload op;
+    op.type = type;
+    op.timestamp = 1700000000;
+    op.key = key;
+    op.data_len = type == cache_state_machine::WRITE ? value_size : 0;
+    op.data = value.data();
+    op.expires_at = op.timestamp + 3600;
+    return op;
+}
+
+// ns per call of `fn`
+static double time_ns(size_t iterations, const std::function<void()>& fn)
+{
+    auto begin = bench_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        fn();
+    }
+    return std::chrono::duration<double, std::nano>(
+            bench_clock::now() - begin).count() / iterations;
+}
+
+static void run(const char* name, const op_payload& op, size_t iterations)
+{
+    volatile size_t sink = 0;
+    auto entry = cache_state_machine::encode_log(op);
+    auto legacy = legacy_encode(op);
+
+    double encode = time_ns(iterations, [&]() {
+        sink += cache_state_machine::encode_log(op)->size();
+    });
+    double legacy_encode_ns = time_ns(iterations, [&]() {
+        sink += legacy_encode(op)->size();
+    });
+    double verify = time_ns(iterations, [&]() {
+        sink += cache_state_machine::read_log(*entry) != nullptr;
+    });
+    double decode = time_ns(iterations, [&]() {
+        op_payload payload;
+        cache_state_machine::decode_log(*entry, payload);
+        sink += payload.key.size() + payload.ops.size();
+    });
+    double legacy_decode = time_ns(iterations, [&]() {
+        op_payload payload;
+        legacy->pos(0);
+        nuraft::buffer_serializer bs(*legacy);
+        legacy_get(bs, payload);
+        sink += payload.key.size() + payload.ops.size();
+    });
+
+    std::printf("%-16s  %8zu  %8zu  %10.1f  %10.1f  %10.1f  %10.1f  %10.1f\n",
+                name, entry->size(), legacy->size(), encode,
+                legacy_encode_ns, verify, decode, legacy_decode);
+}
+
+int main(int argc, char** argv)
+{
+    size_t iterations = argc > 1 ? std::atoll(argv[1]) : 200000;
+
+    auto touch = create_op(cache_state_machine::TOUCH, "", 0);
+    for (uint64_t i = 0; i < 64; i++) {
+        touch.hashes.push_back(i * 0x9e3779b97f4a7c15ULL);
+    }
+    // what the batcher appends under load, 90% reads
+    auto batch = create_op(cache_state_machine::BATCH, "", 0);
+    for (int i = 0; i < 64; i++) {
+        batch.ops.push_back(create_op(i % 10 ? cache_state_machine::READ
+                                             : cache_state_machine::WRITE,
+                                      "key" + std::to_string(i), 100));
+    }
+
+    std::printf("log entry codec, ns per entry\n");
+    std::printf("%-16s  %8s  %8s  %10s  %10s  %10s  %10s  %10s\n", "operation",
+                "bytes", "(legacy)", "encode", "(legacy)", "verify",
+                "decode", "(legacy)");
+    run("read", create_op(cache_state_machine::READ, "key:12345", 0),
+        iterations);
+    run("write 100 B", create_op(cache_state_machine::WRITE, "key:12345",
+                                 100), iterations);
+    run("write 4 KiB", create_op(cache_state_machine::WRITE, "key:12345",
+                                 4096), iterations);
+    run("write 64 KiB", create_op(cache_state_machine::WRITE, "key:12345",
+                                  64 * 1024), iterations / 10);
+    run("purge", create_op(cache_state_machine::PURGE, "", 0), iterations);
+    run("touch 64", touch, iterations);
+    run("batch 64", batch, iterations / 10);
+    return 0;
+}
@@ -0,0 +1,111 @@
+/**
+ * Measure the commit latency and throughput of the file log store for
+ * different group commit windows, with clients appending one entry each
+ * and waiting for it to be durable like raft waits before committing it.
+ * Run it once on tmpfs and once on a real disk to see the cost of fsync.
+ *
+ * usage: bench_log_store [directory] [duration_ms] [value_size]
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "raft/file_log_store.hxx"
+
+using lrucache::file_log_store;
+
+struct result {
+    double throughput;
+    double p50_us;
+    double p99_us;
+};
+
+static result run(const std::string& dir, int window, size_t client_count,
+                  int duration_ms, size_t value_size)
+{
+    std::filesystem::remove_all(dir);
+    file_log_store store(dir, 64 * 1024 * 1024, window);
+
+    // raft appends a batch at a time, then waits for the flush callback
+    std::mutex append_lock;
+    std::mutex durable_lock;
+    std::condition_variable durable_cv;
+    store.set_flush_callback([&](bool) {
+        std::lock_guard<std::mutex> lock(durable_lock);
+        durable_cv.notify_all();
+    });
+
+    using clock = std::chrono::steady_clock;
+    std::atomic<bool> stop(false);
+    std::vector<std::vector<double>> latencies(client_count);
+    std::vector<std::thread> clients;
+    for (size_t i = 0; i < client_count; i++) {
+        clients.emplace_back([&, i]() {
+            auto buf = nuraft::buffer::alloc(value_size);
+            std::memset(buf->data_begin(), 'v', value_size);
+            while (!stop) {
+                auto begin = clock::now();
+                auto entry = nuraft::cs_new<nuraft::log_entry>(1, buf);
+                nuraft::ulong index;
+                {
+                    std::lock_guard<std::mutex> lock(append_lock);
+                    index = store.append(entry);
+                    store.end_of_append_batch(index, 1);
+                }
+                std::unique_lock<std::mutex> lock(durable_lock);
+                durable_cv.wait(lock, [&] {
+                    return store.last_durable_index() >= index;
+                });
+                latencies[i].push_back(std::chrono::duration<double,
+                        std::micro>(clock::now() - begin).count());
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+    stop = true;
+    for (auto& client : clients) {
+        client.join();
+    }
+
+    std::vector<double> all;
+    for (auto& client : latencies) {
+        all.insert(all.end(), client.begin(), client.end());
+    }
+    std::sort(all.begin(), all.end());
+    std::filesystem::remove_all(dir);
+    if (all.empty()) {
+        return { 0, 0, 0 };
+    }
+    return { all.size() * 1000.0 / duration_ms, all[all.size() / 2],
+             all[all.size() * 99 / 100] };
+}
+
+int main(int argc, char** argv)
+{
+    std::string dir = std::string(argc > 1 ? argv[1] : ".")
+                      + "/bench_log_store";
+    int duration_ms = argc > 2 ? std::atoi(argv[2]) : 2000;
+    size_t value_size = argc > 3 ? std::atol(argv[3]) : 100;
+
+    std::printf("log store commits: %zu bytes entries in %s\n", value_size,
+                dir.c_str());
+    std::printf("%10s  %8s  %12s  %10s  %10s\n", "window us", "clients",
+                "commits/s", "p50 (us)", "p99 (us)");
+    for (int window : { 0, 100, 500, 2000 }) {
+        for (size_t clients : { 1, 8, 64 }) {
+            result r = run(dir, window, clients, duration_ms, value_size);
+            std::printf("%10d  %8zu  %12.0f  %10.1f  %10.1f\n", window,
+                        clients, r.throughput, r.p50_us, r.p99_us);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+/**
+ * Measure read latency on a 95/5 read/write mix, with reads going through
+ * cache_state::read_then() without a lock, against reads serialized with
+ * the commits by a single lock like the cache used to do.
+ *
+ * usage: bench_read_latency [duration_ms] [threads]
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cache/cache_state.hxx"
+#include "helpers/utilities.hxx"
+
+constexpr size_t KEY_COUNT = 100000;
+constexpr size_t VALUE_SIZE = 256;
+constexpr int WRITE_PERCENT = 5;
+
+struct latencies {
+    std::vector<uint64_t> reads;
+    std::vector<uint64_t> writes;
+};
+
+static uint64_t percentile(std::vector<uint64_t>& values, double p)
+{
+    if (values.empty())
+        return 0;
+    size_t i = std::min(values.size() - 1,
+                        static_cast<size_t>(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + i, values.end());
+    return values[i];
+}
+
+static latencies run(bool locked, size_t thread_count, int duration_ms)
+{
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 1024 * 1024 * 1024;
+    config.max_item_size = 1024;
+    config.max_key_size = 64;
+    config.shard_count = 16;
+    lrucache::cache_state state(config);
+
+    std::time_t now = std::time(nullptr);
+    std::vector<std::string> keys;
+    keys.reserve(KEY_COUNT);
+    for (size_t i = 0; i < KEY_COUNT; i++) {
+        keys.push_back("key" + std::to_string(i));
+        state.commit_write(keys.back(), create_item(VALUE_SIZE, now + 3600),
+                           now);
+    }
+
+    // commits are applied one at a time, like the raft apply thread does
+    std::mutex apply_lock;
+    // the lock readers used to share with commits
+    std::mutex cache_lock;
+
+    std::atomic<bool> start(false);
+    std::atomic<bool> stop(false);
+    std::vector<latencies> results(thread_count);
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < thread_count; t++) {
+        threads.emplace_back([&, t]() {
+            auto item = create_item(VALUE_SIZE, now + 3600);
+            auto& result = results[t];
+            uint64_t seed = 0x9e3779b97f4a7c15ULL * (t + 1);
+            uint64_t checksum = 0;
+            while (!start) {}
+            while (!stop) {
+                seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+                const auto& key = keys[seed % KEY_COUNT];
+                bool write = (seed >> 40) % 100 < WRITE_PERCENT;
+
+                auto begin = std::chrono::steady_clock::now();
+                if (write) {
+                    std::lock_guard<std::mutex> apply(apply_lock);
+                    std::unique_lock<std::mutex> lock(cache_lock,
+                                                      std::defer_lock);
+                    if (locked)
+                        lock.lock();
+                    state.commit_write(key, item, now);
+                } else {
+                    std::unique_lock<std::mutex> lock(cache_lock,
+                                                      std::defer_lock);
+                    if (locked)
+                        lock.lock();
+                    state.read_then(key, [&](unsigned char* data, size_t n) {
+                        for (size_t i = 0; data && i < n; i++)
+                            checksum += data[i];
+                    });
+                }
+                auto elapsed = std::chrono::duration_cast<
+                    std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - begin).count();
+                (write ? result.writes : result.reads).push_back(elapsed);
+            }
+            if (checksum == 42)
+                std::printf(" ");
+        });
+    }
+
+    start = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    latencies total;
+    for (auto& result : results) {
+        total.reads.insert(total.reads.end(), result.reads.begin(),
+                           result.reads.end());
+        total.writes.insert(total.writes.end(), result.writes.begin(),
+                            result.writes.end());
+    }
+    return total;
+}
+
+int main(int argc, char** argv)
+{
+    int duration_ms = argc > 1 ? std::atoi(argv[1]) : 1000;
+    size_t threads = argc > 2 ? std::atol(argv[2])
+                              : std::max(2u, std::thread::hardware_concurrency());
+
+    std::printf("read latency: %d%% writes, %zu threads, %zu keys, "
+                "%zu bytes\n", WRITE_PERCENT, threads, KEY_COUNT, VALUE_SIZE);
+    std::printf("%10s  %10s  %10s  %10s  %10s  %10s\n", "reads",
+                "p50 (ns)", "p99 (ns)", "p999 (ns)", "write p99", "Mreads/s");
+    for (bool locked : { true, false }) {
+        auto result = run(locked, threads, duration_ms);
+        double reads = result.reads.size() / (duration_ms / 1000.0);
+        std::printf("%10s  %10lu  %10lu  %10lu  %10lu  %10.2f\n",
+                    locked ? "locked" : "lock-free",
+                    percentile(result.reads, 0.5),
+                    percentile(result.reads, 0.99),
+                    percentile(result.reads, 0.999),
+                    percentile(result.writes, 0.99),
+                    reads / 1e6);
+        std::fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+/**
+ * Measure the throughput of streaming a snapshot to /dev/null, copying
+ * each chunk with read_snapshot_chunk() against writing the buffers of
+ * the snapshot cursor with writev().
+ *
+ * usage: bench_snapshot [items] [value_size] [chunk_size]
+ */
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "cache/cache_state.hxx"
+#include "helpers/utilities.hxx"
+
+static void write_all(int fd, const std::vector<iovec>& iov)
+{
+    for (size_t i = 0; i < iov.size(); i += IOV_MAX) {
+        int count = static_cast<int>(std::min<size_t>(IOV_MAX, iov.size() - i));
+        if (writev(fd, iov.data() + i, count) < 0) {
+            std::perror("writev");
+            std::exit(1);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    size_t items = argc > 1 ? std::atol(argv[1]) : 1000000;
+    size_t value_size = argc > 2 ? std::atol(argv[2]) : 100;
+    size_t chunk_size = argc > 3 ? std::atol(argv[3]) : 4 * 1024 * 1024;
+
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 2 * items * item_size(value_size) + (64 << 20);
+    config.max_item_size = value_size;
+    config.max_key_size = 64;
+    config.shard_count = 16;
+    lrucache::cache_state state(config);
+
+    std::time_t now = std::time(nullptr);
+    auto item = create_item(value_size, now + 3600);
+    for (size_t i = 0; i < items; i++) {
+        state.commit_write("key" + std::to_string(i), item, now);
+    }
+
+    int fd = open("/dev/null", O_WRONLY);
+    if (fd < 0) {
+        std::perror("open");
+        return 1;
+    }
+
+    std::printf("snapshot: %zu items, %zu bytes values, %zu bytes chunks\n",
+                items, value_size, chunk_size);
+    std::printf("%10s  %10s  %10s  %10s\n", "reader", "time (s)", "MB/s",
+                "Mitems/s");
+    auto report = [&](const char* name, double seconds, size_t bytes) {
+        std::printf("%10s  %10.3f  %10.1f  %10.2f\n", name, seconds,
+                    bytes / seconds / 1e6, items / seconds / 1e6);
+    };
+
+    state.begin_snapshot();
+    {
+        auto begin = std::chrono::steady_clock::now();
+        size_t bytes = 0;
+        int item_index = 0;
+        size_t read = 0;
+        while (item_index >= 0) {
+            auto data = state.read_snapshot_chunk(chunk_size, item_index, read);
+            write_all(fd, { { data.get(), read } });
+            bytes += read;
+        }
+        report("copy", std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - begin).count(), bytes);
+    }
+    {
+        auto begin = std::chrono::steady_clock::now();
+        size_t bytes = 0;
+        auto cursor = state.open_snapshot();
+        std::vector<iovec> iov;
+        while (!cursor.done()) {
+            bytes += cursor.next(chunk_size, iov);
+            write_all(fd, iov);
+        }
+        report("iovec", std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - begin).count(), bytes);
+    }
+    state.end_snapshot();
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,145 @@
+/**
+ * Measure the compression ratio and throughput of the snapshot frames for
+ * each compression built in, on a cache holding JSON-like documents.
+ * Chunks are encoded by several threads at once, their frames being
+ * independent, and decoded one after the other like a follower does.
+ *
+ * usage: bench_snapshot_codec [items] [threads] [chunk_size]
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cache/cache_state.hxx"
+#include "cache/snapshot_codec.hxx"
+#include "helpers/utilities.hxx"
+
+using lrucache::snapshot_codec;
+using lrucache::snapshot_compression;
+
+/**
+ * Document looking like a typical API response: same field names, small
+ * numbers, and words from a limited vocabulary.
+ */
+static std::string make_document(std::mt19937& random)
+{
+    static const char* words[] = {
+        "active", "pending", "shipped", "paris", "london", "tokyo", "red",
+        "blue", "green", "premium", "basic", "admin", "user", "guest"
+    };
+    auto word = [&]() { return words[random() % 14]; };
+    std::string doc = "{\"id\":" + std::to_string(random() % 1000000)
+        + ",\"status\":\"" + word() + "\",\"city\":\"" + word()
+        + "\",\"score\":" + std::to_string(random() % 100) + "."
+        + std::to_string(random() % 10) + ",\"tags\":[";
+    for (int i = 0, n = random() % 5; i < n; i++) {
+        doc += std::string(i ? "," : "") + "\"" + word() + "\"";
+    }
+    doc += "],\"owner\":{\"role\":\"" + std::string(word())
+        + "\",\"since\":" + std::to_string(1600000000 + random() % 100000000)
+        + "}}";
+    return doc;
+}
+
+int main(int argc, char** argv)
+{
+    size_t items = argc > 1 ? std::atol(argv[1]) : 500000;
+    size_t threads = argc > 2 ? std::atol(argv[2]) : 4;
+    size_t chunk_size = argc > 3 ? std::atol(argv[3]) : 4 * 1024 * 1024;
+
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = items * item_size(512) + (64 << 20);
+    config.max_item_size = 512;
+    config.max_key_size = 64;
+    config.shard_count = 16;
+    lrucache::cache_state state(config);
+
+    std::mt19937 random(42);
+    std::time_t now = std::time(nullptr);
+    for (size_t i = 0; i < items; i++) {
+        auto doc = make_document(random);
+        lrucache::cache_item item(
+            reinterpret_cast<unsigned char*>(&doc[0]), doc.size(),
+            now + 3600);
+        state.commit_write("user:" + std::to_string(i), item, now);
+    }
+
+    // describe every chunk up front so that threads can pick any of them
+    state.begin_snapshot();
+    auto cursor = state.open_snapshot();
+    std::vector<std::vector<iovec>> chunks;
+    size_t bytes = 0;
+    while (!cursor.done()) {
+        chunks.emplace_back();
+        bytes += cursor.next(chunk_size, chunks.back());
+    }
+    // the cursor reuses its key size storage on each call, copy them
+    std::vector<std::vector<unsigned char>> raw(chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++) {
+        for (auto& buffer : chunks[i]) {
+            auto base = static_cast<unsigned char*>(buffer.iov_base);
+            raw[i].insert(raw[i].end(), base, base + buffer.iov_len);
+        }
+    }
+
+    std::printf("snapshot codec: %zu items, %zu chunks, %.1f MB, %zu threads\n",
+                items, raw.size(), bytes / 1e6, threads);
+    std::printf("%6s  %8s  %14s  %14s\n", "codec", "ratio", "encode (MB/s)",
+                "decode (MB/s)");
+
+    using clock = std::chrono::steady_clock;
+    auto seconds = [](clock::time_point begin) {
+        return std::chrono::duration<double>(clock::now() - begin).count();
+    };
+
+    const char* names[] = { "none", "lz4", "zstd" };
+    for (auto name : names) {
+        auto compression = name[0] == 'n' ? snapshot_compression::NONE
+                         : name[0] == 'l' ? snapshot_compression::LZ4
+                                          : snapshot_compression::ZSTD;
+        if (!snapshot_codec::is_available(compression)) {
+            std::printf("%6s  %8s\n", name, "n/a");
+            continue;
+        }
+        snapshot_codec codec(compression);
+
+        std::vector<std::vector<unsigned char>> frames(raw.size());
+        std::atomic<size_t> next(0);
+        auto begin = clock::now();
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back([&]() {
+                for (size_t i; (i = next++) < raw.size();) {
+                    codec.encode(raw[i].data(), raw[i].size(), frames[i]);
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        double encode_time = seconds(begin);
+
+        size_t framed = 0;
+        std::vector<unsigned char> chunk;
+        begin = clock::now();
+        for (auto& frame : frames) {
+            framed += frame.size();
+            if (!snapshot_codec::decode(frame.data(), frame.size(), chunk)) {
+                std::fprintf(stderr, "corrupt frame\n");
+                return 1;
+            }
+        }
+        double decode_time = seconds(begin);
+
+        std::printf("%6s  %8.2f  %14.1f  %14.1f\n", name,
+                    static_cast<double>(bytes) / framed,
+                    bytes / encode_time / 1e6, bytes / decode_time / 1e6);
+    }
+    state.end_snapshot();
+    return 0;
+}
@@ -0,0 +1,93 @@
+/**
+ * Measure how snapshot creation, serialization and install scale with the
+ * number of snapshot threads, going through the logical snapshot objects
+ * of the state machine as NuRaft does, without the network.
+ *
+ * usage: bench_snapshot_parallel [items] [max_threads] [value_size]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "raft/cache_state_machine.hxx"
+#include "helpers/utilities.hxx"
+
+int main(int argc, char** argv)
+{
+    size_t items = argc > 1 ? std::atol(argv[1]) : 2000000;
+    size_t max_threads = argc > 2
+        ? std::atol(argv[2])
+        : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    size_t value_size = argc > 3 ? std::atol(argv[3]) : 100;
+
+    std::printf("parallel snapshot: %zu items, %zu bytes values\n",
+                items, value_size);
+    std::printf("%8s  %10s  %10s  %10s  %10s\n", "threads", "create (s)",
+                "read (s)", "install (s)", "speedup");
+
+    using clock = std::chrono::steady_clock;
+    auto seconds = [](clock::time_point begin) {
+        return std::chrono::duration<double>(clock::now() - begin).count();
+    };
+
+    double baseline = 0;
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        lrucache::cache_config config = build_default_cache_config();
+        config.cache_size = 2 * items * item_size(value_size) + (64 << 20);
+        config.max_item_size = value_size;
+        config.max_key_size = 64;
+        config.shard_count = 64;
+        config.snapshot_threads = threads;
+        lrucache::cache_state_machine leader(config);
+        lrucache::cache_state_machine follower(config);
+
+        std::time_t now = std::time(nullptr);
+        auto item = create_item(value_size, now + 3600);
+        for (size_t i = 0; i < items; i++) {
+            leader.state().commit_write("key" + std::to_string(i), item, now);
+        }
+
+        auto cluster = nuraft::cs_new<nuraft::cluster_config>();
+        nuraft::snapshot s(items, 1, cluster);
+        nuraft::async_result<bool>::handler_type when_done =
+            [](bool&, nuraft::ptr<std::exception>&) {};
+        auto begin = clock::now();
+        leader.create_snapshot(s, when_done);
+        double create_time = seconds(begin);
+
+        double read_time = 0;
+        double install_time = 0;
+        void* ctx = nullptr;
+        ulong obj_id = 0;
+        bool is_last_obj = false;
+        while (!is_last_obj) {
+            nuraft::ptr<nuraft::buffer> data;
+            begin = clock::now();
+            if (leader.read_logical_snp_obj(s, ctx, obj_id, data,
+                                            is_last_obj) < 0) {
+                std::fprintf(stderr, "failed to read object %lu\n", obj_id);
+                return 1;
+            }
+            read_time += seconds(begin);
+
+            begin = clock::now();
+            follower.save_logical_snp_obj(s, obj_id, *data, obj_id == 0,
+                                          is_last_obj);
+            install_time += seconds(begin);
+        }
+        leader.free_user_snp_ctx(ctx);
+        begin = clock::now();
+        follower.apply_snapshot(s);
+        install_time += seconds(begin);
+
+        double total = create_time + read_time + install_time;
+        if (threads == 1) {
+            baseline = total;
+        }
+        std::printf("%8zu  %10.3f  %10.3f  %10.3f  %10.2f\n", threads,
+                    create_time, read_time, install_time, baseline / total);
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+/**
+ * Measure how long a restarted node takes to serve reads from a snapshot
+ * file, by restoring its items first or by attaching its mapping, for
+ * growing cache sizes. The time to fold the attached file into the shards
+ * in the background is shown as well.
+ *
+ * usage: bench_warm_restart [max_items] [value_size] [directory]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include "cache/cache_state.hxx"
+#include "cache/snapshot_file.hxx"
+#include "helpers/utilities.hxx"
+
+using lrucache::snapshot_file;
+
+int main(int argc, char** argv)
+{
+    size_t max_items = argc > 1 ? std::atol(argv[1]) : 4000000;
+    size_t value_size = argc > 2 ? std::atol(argv[2]) : 100;
+    std::string path = std::string(argc > 3 ? argv[3] : ".")
+                       + "/bench_warm_restart.lrcs";
+
+    std::printf("warm restart: %zu bytes values\n", value_size);
+    std::printf("%10s  %12s  %12s  %12s\n", "items", "restore (s)",
+                "attach (s)", "fold (s)");
+
+    using clock = std::chrono::steady_clock;
+    auto seconds = [](clock::time_point begin) {
+        return std::chrono::duration<double>(clock::now() - begin).count();
+    };
+
+    for (size_t items = max_items / 16; items <= max_items; items *= 2) {
+        lrucache::cache_config config = build_default_cache_config();
+        config.cache_size = items * item_size(value_size) + (64 << 20);
+        config.max_item_size = value_size;
+        config.max_key_size = 64;
+        config.shard_count = 64;
+        std::time_t now = std::time(nullptr);
+        {
+            lrucache::cache_state state(config);
+            auto item = create_item(value_size, now + 3600);
+            for (size_t i = 0; i < items; i++) {
+                state.commit_write("key" + std::to_string(i), item, now);
+            }
+            state.begin_snapshot();
+            if (!snapshot_file::write(state, path, now, {})) {
+                std::perror("failed to write the snapshot");
+                return 1;
+            }
+        }
+
+        double restore_time;
+        {
+            lrucache::cache_state state(config);
+            auto begin = clock::now();
+            auto file = snapshot_file::open(path);
+            if (!file || !file->restore(state)) {
+                std::fprintf(stderr, "invalid snapshot\n");
+                return 1;
+            }
+            restore_time = seconds(begin);
+        }
+
+        lrucache::cache_state state(config);
+        auto begin = clock::now();
+        std::shared_ptr<const snapshot_file> file = snapshot_file::open(path);
+        if (!file || !state.attach_snapshot(file)) {
+            std::fprintf(stderr, "invalid snapshot\n");
+            return 1;
+        }
+        double attach_time = seconds(begin);
+        size_t len = 0;
+        if (!state.read("key0", len)) {
+            std::fprintf(stderr, "item missing from the snapshot\n");
+            return 1;
+        }
+
+        begin = clock::now();
+        state.fold_snapshot();
+        double fold_time = seconds(begin);
+
+        std::printf("%10zu  %12.3f  %12.3f  %12.3f\n", items, restore_time,
+                    attach_time, fold_time);
+    }
+    std::remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,33 @@
+# Checks that the headers of src/schema are what flatc generates from their
+# schema, the leading comments aside.
+#
+#   cmake -DFLATC=<flatc> -DSCHEMA_DIR=<src/schema> -DOUTPUT_DIR=<temp dir>
+#         -P check_schema.cmake
+
+file(GLOB schema_files ${SCHEMA_DIR}/*.fbs)
+file(REMOVE_RECURSE ${OUTPUT_DIR})
+file(MAKE_DIRECTORY ${OUTPUT_DIR})
+execute_process(
+    COMMAND ${FLATC} --cpp -I ${SCHEMA_DIR} -o ${OUTPUT_DIR} ${schema_files}
+    RESULT_VARIABLE flatc_result)
+if (NOT flatc_result EQUAL 0)
+    message(FATAL_ERROR "flatc failed on the schemas of ${SCHEMA_DIR}")
+endif()
+
+set(stale_headers "")
+foreach(schema_file ${schema_files})
+    get_filename_component(schema_name ${schema_file} NAME_WE)
+    set(header ${schema_name}_generated.h)
+    file(READ ${SCHEMA_DIR}/${header} checked_in)
+    file(READ ${OUTPUT_DIR}/${header} generated)
+    string(REGEX REPLACE "^(//[^\n]*\n)+" "" checked_in "${checked_in}")
+    string(REGEX REPLACE "^(//[^\n]*\n)+" "" generated "${generated}")
+    if (NOT checked_in STREQUAL generated)
+        list(APPEND stale_headers ${header})
+    endif()
+endforeach()
+
+if (stale_headers)
+    message(FATAL_ERROR "Not what flatc generates: ${stale_headers}, "
+                        "regenerate them with the schema target")
+endif()
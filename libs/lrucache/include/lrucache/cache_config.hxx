@@ -8,8 +8,19 @@ namespace lrucache {
 
 class cache_config {
 public:
+    /**
+     * Read a configuration from an INI file.
+     *
+     * @throw std::invalid_argument if max_item_size exceeds the share of
+     *        cache_size of a shard, or if read_lease is too long for the
+     *        election timeout
+     */
     static cache_config from_file(std::string path);
 
+    // drift allowed between the clocks of the nodes over an election
+    // timeout, in percent, see `read_lease`
+    static constexpr int CLOCK_DRIFT_PERCENT = 10;
+
     std::string endpoint() {
         return host + ":" + std::to_string(port);
     }
@@ -38,12 +49,35 @@ public:
 
     // amount in bytes that the cache will keep until eviction.
     size_t cache_size;
-    // max size for an individual object in bytes.
+    // max size for an individual object in bytes, key included.
     size_t max_item_size;
     // max key size.
     size_t max_key_size;
-    // time in seconds before each cache purge of expired items.
+    // time in seconds between two purges of the expired items, run by
+    // each node on its own in the background. 0 to only remove them when
+    // their memory is needed.
     int purge_interval;
+    // max number of expired items removed by each purge, 0 for no limit.
+    // Items left over are removed by the next purges, or when their memory
+    // is needed. Split evenly between shards, background purges releasing
+    // the lock of a shard after each of its share.
+    size_t purge_batch_size = 0;
+    // number of independently locked partitions the keys are hashed into.
+    // cache_size is split evenly between shards, and max_item_size must
+    // not exceed the share of a shard, cache_size / shard_count.
+    size_t shard_count = 1;
+    // amount in bytes kept free once eviction is needed, so that the next
+    // writes do not have to evict. Split evenly between shards.
+    size_t eviction_headroom = 0;
+    // how items to evict are chosen: lru, slru, arc, clock or wtinylfu.
+    std::string eviction_policy = "lru";
+    // when true, reads only set a reference bit that is replicated in
+    // batches and evictions use a CLOCK sweep, whatever eviction_policy is.
+    bool approximate_recency = false;
+    // time in ms between two batches of reads replicated, the ones of
+    // approximate_recency and the ones served without going through the
+    // log.
+    int touch_interval = 100;
 
     // [raft]
 
@@ -62,6 +96,45 @@ public:
     int reserved_log_items;
     // number of logs required before creating a new snapshot.
     int snapshot_distance;
+    // max size in bytes of each block of items sent to a follower catching
+    // up from a snapshot. Must be able to hold the biggest item, its key
+    // and 24 bytes of sizes and expiry.
+    size_t snapshot_block_size = 4 * 1024 * 1024;
+    // compression of the blocks sent to a follower: none, lz4 or zstd if
+    // built with LRUCACHE_WITH_LZ4 or LRUCACHE_WITH_ZSTD.
+    std::string snapshot_compression = "none";
+    // number of threads snapshots are taken, sent and restored with, one
+    // shard at a time. 0 for one per core.
+    size_t snapshot_threads = 0;
+    // directory the snapshots are persisted to, so that a restarting node
+    // only pulls what it missed since its last one, and sent from. empty to
+    // disable, the items of the last snapshot and whatever replaces them
+    // being then kept in memory until the next one.
+    std::string snapshot_dir;
+    // directory the raft log is written to, so that a restarting node
+    // keeps its log, term and vote. empty to keep them in memory.
+    std::string log_dir;
+    // size in bytes from which the log starts a new segment file.
+    size_t log_segment_size = 64 * 1024 * 1024;
+    // time in µs the log waits for more appends to fsync along, so that
+    // concurrent requests share an fsync. 0 to fsync each batch of appends
+    // right away.
+    int log_flush_window = 0;
+    // time in µs the operations proposed wait for more to be replicated
+    // along in the same log entry. 0 for one entry per operation.
+    int batch_window = 0;
+    // size in bytes from which a batch of operations is replicated without
+    // waiting for the end of its window.
+    size_t batch_max_bytes = 1024 * 1024;
+    // time in ms the leader serves reads locally after a quorum of voters
+    // last answered it. Must stay below election_timeout_lower_bound minus
+    // a round trip, taken as heart_beat_interval, and the clock drift
+    // between nodes, see CLOCK_DRIFT_PERCENT. 0 to wait for a quorum to
+    // answer after each read.
+    int read_lease = 0;
+    // level up to which NuRaft, the state machine and the log report to
+    // stderr: 1 fatal, 2 error, 3 warning, 4 info, 5 debug, 6 trace.
+    int log_level = 3;
     // client timeout in ms
     int client_req_timeout;
 };
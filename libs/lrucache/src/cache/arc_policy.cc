@@ -0,0 +1,130 @@
+#include "arc_policy.hxx"
+
+#include <algorithm>
+
+namespace lrucache {
+
+void arc_policy::inserted(cache_entry* entry)
+{
+    if (b1_.contains(entry->hash)) {
+        size_t delta = std::max<size_t>(b2_.size() / b1_.size(), 1);
+        target_ = std::min(target_ + delta, capacity_);
+        b1_.erase(entry->hash);
+    } else if (b2_.contains(entry->hash)) {
+        size_t delta = std::max<size_t>(b1_.size() / b2_.size(), 1);
+        target_ = target_ > delta ? target_ - delta : 0;
+        b2_.erase(entry->hash);
+    } else {
+        entry->policy_segment = T1;
+        t1_.push_front(entry);
+        capacity_ = std::max(capacity_, t1_.size() + t2_.size());
+        return;
+    }
+    // the key was evicted recently, it is not seen for the first time
+    entry->policy_segment = T2;
+    t2_.push_front(entry);
+    capacity_ = std::max(capacity_, t1_.size() + t2_.size());
+}
+
+void arc_policy::accessed(cache_entry* entry)
+{
+    if (entry->policy_segment == T1) {
+        t1_.remove(entry);
+        entry->policy_segment = T2;
+        t2_.push_front(entry);
+    } else {
+        t2_.move_to_front(entry);
+    }
+}
+
+void arc_policy::removed(cache_entry* entry, bool evicted)
+{
+    if (entry->policy_segment == T1) {
+        t1_.remove(entry);
+        if (evicted) {
+            b1_.push_front(entry->hash);
+        }
+    } else {
+        t2_.remove(entry);
+        if (evicted) {
+            b2_.push_front(entry->hash);
+        }
+    }
+    trim_ghosts();
+}
+
+void arc_policy::replaced(cache_entry* entry, cache_entry* replacement)
+{
+    replacement->policy_segment = entry->policy_segment;
+    if (entry->policy_segment == T1) {
+        t1_.replace(entry, replacement);
+    } else {
+        t2_.replace(entry, replacement);
+    }
+}
+
+cache_entry* arc_policy::victim(const cache_entry* pinned)
+{
+    cache_entry* entry = nullptr;
+    if (t1_.size() > target_ || t2_.empty()) {
+        entry = back_except(t1_, pinned);
+    }
+    if (!entry) {
+        entry = back_except(t2_, pinned);
+    }
+    if (!entry) {
+        entry = back_except(t1_, pinned);
+    }
+    return entry;
+}
+
+void arc_policy::clear()
+{
+    t1_.clear();
+    t2_.clear();
+    b1_ = ghost_list();
+    b2_ = ghost_list();
+    target_ = 0;
+    capacity_ = 0;
+}
+
+void arc_policy::trim_ghosts()
+{
+    // T1 and B1 together hold at most `capacity_` keys, and so do both
+    // ghost lists together
+    while (t1_.size() + b1_.size() > capacity_ && b1_.size() > 0) {
+        b1_.pop_back();
+    }
+    while (b1_.size() + b2_.size() > capacity_ && b2_.size() > 0) {
+        b2_.pop_back();
+    }
+}
+
+bool arc_policy::ghost_list::contains(uint64_t hash) const
+{
+    return lookup.count(hash) > 0;
+}
+
+void arc_policy::ghost_list::push_front(uint64_t hash)
+{
+    erase(hash);
+    order.push_front(hash);
+    lookup[hash] = order.begin();
+}
+
+void arc_policy::ghost_list::erase(uint64_t hash)
+{
+    auto iter = lookup.find(hash);
+    if (iter != lookup.end()) {
+        order.erase(iter->second);
+        lookup.erase(iter);
+    }
+}
+
+void arc_policy::ghost_list::pop_back()
+{
+    lookup.erase(order.back());
+    order.pop_back();
+}
+
+} // namespace lrucache
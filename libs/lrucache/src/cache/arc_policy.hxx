@@ -0,0 +1,83 @@
+#ifndef LRUCACHE_ARC_POLICY_
+#define LRUCACHE_ARC_POLICY_
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+#include "eviction_policy.hxx"
+
+namespace lrucache {
+
+/**
+ * Adaptive Replacement Cache. Entries seen once and entries seen more than
+ * once are kept in two LRU lists, T1 and T2. The keys recently evicted
+ * from each list are remembered in two ghost lists, B1 and B2. Hitting a
+ * ghost of B1 means T1 was too small and grows its target size, hitting a
+ * ghost of B2 shrinks it.
+ *
+ * The cache is bounded in bytes, so sizes here are numbers of entries and
+ * the capacity is the highest number of entries stored at once. Ghosts
+ * are remembered by key hash.
+ */
+class arc_policy : public eviction_policy {
+public:
+    arc_policy() : target_(0), capacity_(0) {}
+
+    virtual void inserted(cache_entry* entry);
+
+    virtual void accessed(cache_entry* entry);
+
+    virtual void removed(cache_entry* entry, bool evicted);
+
+    virtual void replaced(cache_entry* entry, cache_entry* replacement);
+
+    virtual cache_entry* victim(const cache_entry* pinned);
+
+    virtual void clear();
+
+    /**
+     * Target number of entries in T1.
+     */
+    size_t target() const { return target_; }
+
+    enum segment : uint8_t {
+        T1 = 1,
+        T2 = 2
+    };
+
+private:
+    struct ghost_list {
+        bool contains(uint64_t hash) const;
+        void push_front(uint64_t hash);
+        void erase(uint64_t hash);
+        void pop_back();
+        size_t size() const { return order.size(); }
+
+        // most recently evicted first
+        std::list<uint64_t> order;
+        std::unordered_map<uint64_t, std::list<uint64_t>::iterator> lookup;
+    };
+
+    void trim_ghosts();
+
+    // target size of t1_
+    size_t target_;
+
+    // highest number of entries stored at once
+    size_t capacity_;
+
+    // entries seen once, most recently used first
+    policy_list t1_;
+
+    // entries seen more than once, most recently used first
+    policy_list t2_;
+
+    // keys evicted from t1_ and t2_
+    ghost_list b1_;
+    ghost_list b2_;
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_ARC_POLICY_
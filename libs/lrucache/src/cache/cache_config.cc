@@ -1,4 +1,7 @@
 #include "lrucache/cache_config.hxx"
+
+#include <stdexcept>
+
 #include "ini/ini.h"
 
 namespace lrucache {
@@ -24,6 +27,15 @@ cache_config cache_config::from_file(std::string path)
     config.max_item_size = r.Get<size_t>("cache", "max_item_size");
     config.max_key_size = r.Get<size_t>("cache", "max_key_size");
     config.purge_interval = r.Get<unsigned short int>("cache", "purge_interval");
+    config.purge_batch_size = r.Get<size_t>("cache", "purge_batch_size", 0);
+    config.shard_count = r.Get<size_t>("cache", "shard_count", 1);
+    config.eviction_headroom =
+            r.Get<size_t>("cache", "eviction_headroom", 0);
+    config.eviction_policy =
+            r.Get<std::string>("cache", "eviction_policy", "lru");
+    config.approximate_recency =
+            r.Get<bool>("cache", "approximate_recency", false);
+    config.touch_interval = r.Get<int>("cache", "touch_interval", 100);
 
     config.raft_host = r.Get<std::string>("raft", "raft_host");
     config.raft_port = r.Get<unsigned short int>("raft", "raft_port");
@@ -37,9 +49,44 @@ cache_config cache_config::from_file(std::string path)
             r.Get<size_t>("raft", "reserved_log_items");
     config.snapshot_distance =
             r.Get<size_t>("raft", "snapshot_distance");
+    config.snapshot_block_size =
+            r.Get<size_t>("raft", "snapshot_block_size", 4 * 1024 * 1024);
+    config.snapshot_compression =
+            r.Get<std::string>("raft", "snapshot_compression", "none");
+    config.snapshot_threads =
+            r.Get<size_t>("raft", "snapshot_threads", 0);
+    config.snapshot_dir =
+            r.Get<std::string>("raft", "snapshot_dir", "");
+    config.log_dir = r.Get<std::string>("raft", "log_dir", "");
+    config.log_segment_size =
+            r.Get<size_t>("raft", "log_segment_size", 64 * 1024 * 1024);
+    config.log_flush_window = r.Get<int>("raft", "log_flush_window", 0);
+    config.batch_window = r.Get<int>("raft", "batch_window", 0);
+    config.batch_max_bytes =
+            r.Get<size_t>("raft", "batch_max_bytes", 1024 * 1024);
+    config.read_lease = r.Get<int>("raft", "read_lease", 0);
+    config.log_level = r.Get<int>("raft", "log_level", 3);
     config.client_req_timeout =
             r.Get<size_t>("raft", "client_req_timeout");
 
+    // an item is stored whole in the shard of its key
+    if (config.shard_count == 0
+        || config.max_item_size > config.cache_size / config.shard_count) {
+        throw std::invalid_argument(
+            "max_item_size must not exceed cache_size / shard_count");
+    }
+    // the lease ends before the voters that answered the leader can vote
+    // for another, whatever the round trip and the drift of their clocks
+    int lease_limit = config.election_timeout_lower_bound
+                      * (100 - CLOCK_DRIFT_PERCENT) / 100
+                      - config.heart_beat_interval;
+    if (config.read_lease < 0
+        || (config.read_lease > 0 && config.read_lease >= lease_limit)) {
+        throw std::invalid_argument(
+            "read_lease must stay below election_timeout_lower_bound minus "
+            "heart_beat_interval and "
+            + std::to_string(CLOCK_DRIFT_PERCENT) + "% of clock drift");
+    }
     return config;
 }
 
@@ -0,0 +1,64 @@
+#ifndef LRUCACHE_CACHE_ENTRY_
+#define LRUCACHE_CACHE_ENTRY_
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <string_view>
+
+#include "cache_item.hxx"
+#include "intrusive_list.hxx"
+
+namespace lrucache {
+
+/**
+ * Record holding one cache_item inside cache_storage. Every link the
+ * storage needs to find, order and expire an item lives in the record
+ * itself so that a single record is all that is required per item.
+ */
+struct cache_entry {
+    std::string_view key() const { return item.key; }
+
+    // slab chunk holding the key, followed by the data when it is too big
+    // to be inlined in `item`. `item.key` points into it.
+    unsigned char* chunk = nullptr;
+
+    // `key_hash(key)`, computed once at insertion
+    uint64_t hash = 0;
+
+    // position in the LRU order
+    list_hook<cache_entry> lru_hook;
+
+    // position in the LRU order of the entries sharing its slab class
+    list_hook<cache_entry> class_hook;
+
+    // position in its timing wheel slot
+    list_hook<cache_entry> expiry_hook;
+
+    // position in the lists of the eviction policy
+    list_hook<cache_entry> policy_hook;
+
+    // eviction policy list the entry belongs to
+    uint8_t policy_segment = 0;
+
+    // set when the entry is accessed, for policies using reference bits
+    bool referenced = false;
+
+    // timing wheel slot the entry belongs to
+    uint16_t expiry_slot = 0;
+
+    // set once the entry is removed and its chunk given back, which
+    // readers check after copying out of the chunk
+    std::atomic<bool> retired{false};
+
+    cache_item item;
+};
+
+using lru_list = intrusive_list<cache_entry, &cache_entry::lru_hook>;
+using class_list = intrusive_list<cache_entry, &cache_entry::class_hook>;
+using expiry_list = intrusive_list<cache_entry, &cache_entry::expiry_hook>;
+using policy_list = intrusive_list<cache_entry, &cache_entry::policy_hook>;
+
+} // namespace lrucache
+
+#endif // LRUCACHE_CACHE_ENTRY_
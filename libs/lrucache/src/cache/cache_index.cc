@@ -0,0 +1,164 @@
+#include "cache_index.hxx"
+
+namespace lrucache {
+
+constexpr size_t INITIAL_CAPACITY = 16;
+
+cache_index::table::table(size_t capacity)
+    : mask(capacity - 1)
+    , slots(new slot[capacity])
+{
+    for (size_t i = 0; i < capacity; i++) {
+        slots[i].hash.store(0, std::memory_order_relaxed);
+        slots[i].entry.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+cache_index::cache_index(epoch_manager* epoch)
+    : table_(new table(INITIAL_CAPACITY))
+    , size_(0)
+    , used_(0)
+    , epoch_(epoch)
+{
+}
+
+cache_index::~cache_index()
+{
+    delete table_.load();
+    for (auto& retired : retired_) {
+        delete retired.second;
+    }
+}
+
+cache_entry* cache_index::find(std::string_view key, uint64_t hash) const
+{
+    auto t = table_.load(std::memory_order_acquire);
+    size_t i = hash & t->mask;
+    while (true) {
+        const auto& s = t->slots[i];
+        auto entry = s.entry.load(std::memory_order_acquire);
+        if (!entry) {
+            return nullptr;
+        }
+        if (entry != tombstone()
+                && s.hash.load(std::memory_order_relaxed) == hash
+                && entry->key() == key) {
+            return entry;
+        }
+        i = (i + 1) & t->mask;
+    }
+}
+
+void cache_index::insert(cache_entry* entry)
+{
+    auto t = table_.load(std::memory_order_relaxed);
+    size_t capacity = t->mask + 1;
+    if ((used_ + 1) * MAX_LOAD_DEN > capacity * MAX_LOAD_NUM) {
+        // grow only if tombstones are not what fills the table
+        if ((size_ + 1) * 2 * MAX_LOAD_DEN > capacity * MAX_LOAD_NUM) {
+            capacity *= 2;
+        }
+        rebuild(capacity);
+        t = table_.load(std::memory_order_relaxed);
+    }
+
+    size_t i = entry->hash & t->mask;
+    while (true) {
+        auto current = t->slots[i].entry.load(std::memory_order_relaxed);
+        if (!current || current == tombstone()) {
+            if (!current) {
+                used_++;
+            }
+            break;
+        }
+        i = (i + 1) & t->mask;
+    }
+    t->slots[i].hash.store(entry->hash, std::memory_order_relaxed);
+    t->slots[i].entry.store(entry, std::memory_order_release);
+    size_++;
+}
+
+void cache_index::erase(cache_entry* entry)
+{
+    auto s = find_slot(entry);
+    if (!s) {
+        return;
+    }
+    s->entry.store(tombstone(), std::memory_order_release);
+    size_--;
+}
+
+void cache_index::replace(cache_entry* entry, cache_entry* replacement)
+{
+    auto s = find_slot(entry);
+    if (s) {
+        s->entry.store(replacement, std::memory_order_release);
+    }
+}
+
+void cache_index::clear()
+{
+    size_ = 0;
+    rebuild(INITIAL_CAPACITY);
+}
+
+void cache_index::reclaim(uint64_t safe_epoch)
+{
+    while (!retired_.empty() && retired_.front().first < safe_epoch) {
+        delete retired_.front().second;
+        retired_.pop_front();
+    }
+}
+
+cache_entry* cache_index::tombstone()
+{
+    static cache_entry marker;
+    return &marker;
+}
+
+void cache_index::rebuild(size_t capacity)
+{
+    auto old = table_.load(std::memory_order_relaxed);
+    auto t = new table(capacity);
+    used_ = 0;
+    if (size_ > 0) {
+        for (size_t j = 0; j <= old->mask; j++) {
+            auto entry = old->slots[j].entry.load(std::memory_order_relaxed);
+            if (!entry || entry == tombstone()) {
+                continue;
+            }
+            size_t i = entry->hash & t->mask;
+            while (t->slots[i].entry.load(std::memory_order_relaxed)) {
+                i = (i + 1) & t->mask;
+            }
+            t->slots[i].hash.store(entry->hash, std::memory_order_relaxed);
+            t->slots[i].entry.store(entry, std::memory_order_relaxed);
+            used_++;
+        }
+    }
+    table_.store(t, std::memory_order_release);
+
+    if (epoch_) {
+        retired_.emplace_back(epoch_->retire_epoch(), old);
+    } else {
+        delete old;
+    }
+}
+
+cache_index::slot* cache_index::find_slot(const cache_entry* entry) const
+{
+    auto t = table_.load(std::memory_order_relaxed);
+    size_t i = entry->hash & t->mask;
+    while (true) {
+        auto current = t->slots[i].entry.load(std::memory_order_relaxed);
+        if (!current) {
+            return nullptr;
+        }
+        if (current == entry) {
+            return &t->slots[i];
+        }
+        i = (i + 1) & t->mask;
+    }
+}
+
+} // namespace lrucache
@@ -0,0 +1,145 @@
+#ifndef LRUCACHE_CACHE_INDEX_
+#define LRUCACHE_CACHE_INDEX_
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string_view>
+#include <utility>
+
+#include "cache_entry.hxx"
+#include "epoch_manager.hxx"
+
+namespace lrucache {
+
+/**
+ * Open addressing hash table mapping keys to their cache_entry.
+ *
+ * Each slot stores the precomputed hash next to the entry pointer so that
+ * probing only dereferences an entry when the hashes match. Collisions are
+ * resolved with linear probing.
+ *
+ * A single writer may modify the index while readers pinned in the
+ * `epoch_manager` given at construction call `find()`. Entries are never
+ * moved between slots: removals leave a tombstone, and tombstones are
+ * dropped by rebuilding the table into a new one that replaces the old one
+ * atomically. Old tables are retired instead of freed.
+ */
+class cache_index {
+public:
+    /**
+     * @param epoch epoch manager pinned by concurrent readers, or nullptr
+     *              if the index is never read concurrently.
+     */
+    cache_index(epoch_manager* epoch = nullptr);
+
+    cache_index(const cache_index&) = delete;
+    cache_index& operator=(const cache_index&) = delete;
+
+    ~cache_index();
+
+    /**
+     * Find the entry for `key`. Safe to call concurrently with the writer
+     * if the epoch is pinned.
+     *
+     * @param key key to look up
+     * @param hash `key_hash(key)`
+     * @return entry or nullptr if the key is not indexed
+     */
+    cache_entry* find(std::string_view key, uint64_t hash) const;
+
+    /**
+     * Call `fn` with every entry whose key hash is `hash`. Not safe to call
+     * concurrently with the writer.
+     */
+    template <typename F>
+    void for_each(uint64_t hash, F fn) const {
+        auto t = table_.load(std::memory_order_relaxed);
+        size_t i = hash & t->mask;
+        while (auto entry = t->slots[i].entry.load(std::memory_order_relaxed)) {
+            if (entry != tombstone() && entry->hash == hash) {
+                fn(entry);
+            }
+            i = (i + 1) & t->mask;
+        }
+    }
+
+    /**
+     * Index an entry whose key is not already present. `entry->hash`
+     * must be set.
+     */
+    void insert(cache_entry* entry);
+
+    /**
+     * Remove an indexed entry.
+     */
+    void erase(cache_entry* entry);
+
+    /**
+     * Make the slot of an indexed entry point to another entry with the
+     * same key, atomically for readers.
+     */
+    void replace(cache_entry* entry, cache_entry* replacement);
+
+    void clear();
+
+    /**
+     * Free the tables retired before `safe_epoch`.
+     */
+    void reclaim(uint64_t safe_epoch);
+
+    size_t size() const { return size_; }
+
+    /**
+     * Amount of index memory used per entry, counting the empty slots
+     * kept around by the load factor.
+     */
+    static constexpr size_t entry_overhead() {
+        return sizeof(slot) * MAX_LOAD_DEN / MAX_LOAD_NUM;
+    }
+
+private:
+    struct slot {
+        std::atomic<uint64_t> hash;
+        std::atomic<cache_entry*> entry;
+    };
+
+    struct table {
+        table(size_t capacity);
+
+        // capacity - 1, the capacity is always a power of 2
+        size_t mask;
+        std::unique_ptr<slot[]> slots;
+    };
+
+    // the table is rebuilt when it is more than 3/4 full, tombstones
+    // included
+    static constexpr size_t MAX_LOAD_NUM = 3;
+    static constexpr size_t MAX_LOAD_DEN = 4;
+
+    // marks the slot of a removed entry, never dereferenced
+    static cache_entry* tombstone();
+
+    void rebuild(size_t capacity);
+
+    slot* find_slot(const cache_entry* entry) const;
+
+    // only the writer reads it without atomics
+    std::atomic<table*> table_;
+
+    // number of indexed entries
+    size_t size_;
+
+    // number of slots holding an entry or a tombstone
+    size_t used_;
+
+    epoch_manager* epoch_;
+
+    // replaced tables and the epoch they were retired at
+    std::deque<std::pair<uint64_t, table*>> retired_;
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_CACHE_INDEX_
@@ -1,43 +1,218 @@
 #ifndef LRUCACHE_CACHE_ITEM_
 #define LRUCACHE_CACHE_ITEM_
 
+#include <cstdint>
 #include <ctime>
 #include <cstring>
 #include <memory>
+#include <new>
 #include <string>
+#include <string_view>
 #include <vector>
 
+// values up to this size are stored inside the item itself instead of
+// a separate heap buffer.
+#ifndef LRUCACHE_INLINE_VALUE_SIZE
+#define LRUCACHE_INLINE_VALUE_SIZE 64
+#endif
+
 typedef std::vector<unsigned char> item_data;
 
 namespace lrucache {
 
 struct cache_item {
-    cache_item(unsigned char* bytes, size_t len, std::time_t exp)
-        : data_size(len), expires_at(exp), key(nullptr)
+    static constexpr size_t INLINE_SIZE = LRUCACHE_INLINE_VALUE_SIZE;
+
+    static_assert(INLINE_SIZE >= sizeof(std::shared_ptr<item_data>),
+                  "inline value size too small to hold a heap pointer");
+
+    cache_item()
+        : data_size(0), expires_at(0), version(0)
+        , storage_(storage_type::INLINE) {}
+
+    cache_item(unsigned char* bytes, size_t len, std::time_t exp,
+               uint64_t ver = 0)
+        : data_size(len), expires_at(exp), version(ver)
+        , storage_(storage_type::INLINE)
+    {
+        if (len <= INLINE_SIZE) {
+            std::memcpy(inline_data_, bytes, len);
+        } else {
+            storage_ = storage_type::HEAP;
+            new (&heap_data_) std::shared_ptr<item_data>(
+                std::make_shared<item_data>(bytes, bytes + len));
+        }
+    }
+
+    cache_item(const cache_item& other)
+        : key(other.key), data_size(0), expires_at(other.expires_at)
+        , version(other.version), storage_(storage_type::INLINE)
+    {
+        copy_data(other);
+    }
+
+    cache_item(cache_item&& other)
+        : key(other.key), data_size(0), expires_at(other.expires_at)
+        , version(other.version), storage_(storage_type::INLINE)
     {
-        data = std::make_shared<item_data>(len);
-        std::memcpy(data.get()->data(), bytes, len);
+        move_data(std::move(other));
+    }
+
+    ~cache_item() {
+        release_data();
+    }
+
+    cache_item& operator=(const cache_item& other) {
+        if (this != &other) {
+            release_data();
+            key = other.key;
+            expires_at = other.expires_at;
+            version = other.version;
+            copy_data(other);
+        }
+        return *this;
+    }
+
+    cache_item& operator=(cache_item&& other) {
+        if (this != &other) {
+            release_data();
+            key = other.key;
+            expires_at = other.expires_at;
+            version = other.version;
+            move_data(std::move(other));
+        }
+        return *this;
     }
 
     bool is_expired(std::time_t checked_at) const {
         return expires_at <= checked_at;
     }
 
-    size_t size() {
+    /**
+     * True when the data is small enough to be stored within the item.
+     */
+    bool is_inline() const {
+        return storage_ == storage_type::INLINE;
+    }
+
+    /**
+     * Pointer to the first byte of the item data.
+     */
+    unsigned char* bytes() {
+        switch (storage_) {
+            case storage_type::INLINE:   return inline_data_;
+            case storage_type::HEAP:     return heap_data_->data();
+            case storage_type::BORROWED: return borrowed_data_;
+        }
+        return nullptr;
+    }
+
+    const unsigned char* bytes() const {
+        return const_cast<cache_item*>(this)->bytes();
+    }
+
+    /**
+     * Point the item at `len` bytes it does not own, such as a slab chunk
+     * owned by cache_storage. Data small enough to be inlined is copied
+     * instead. The bytes must outlive the item and all of its copies.
+     *
+     * @param bytes data the item points to
+     * @param len size of the data
+     */
+    void borrow_data(unsigned char* bytes, size_t len) {
+        release_data();
+        data_size = len;
+        if (len <= INLINE_SIZE) {
+            std::memcpy(inline_data_, bytes, len);
+        } else {
+            storage_ = storage_type::BORROWED;
+            borrowed_data_ = bytes;
+        }
+    }
+
+    /**
+     * Memory used by the item data outside of the item itself when it
+     * owns its data.
+     *
+     * @param data_size size of the data
+     * @return size in bytes
+     */
+    static size_t external_size(size_t data_size) {
+        if (data_size <= INLINE_SIZE)
+            return 0;
+        // make_shared puts the control block and the vector in one block
+        return data_size + sizeof(item_data) + 2 * sizeof(void*);
+    }
+
+    size_t size() const {
         size_t result = 0;
-        result += sizeof(key->size());
-        if (key)
-            result += key->size();
+        result += sizeof(size_t);
+        result += key.size();
         result += sizeof(data_size);
         result += data_size;
         result += sizeof(expires_at);
+        result += sizeof(version);
         return result;
     }
 
-    const std::string* key;
-    std::shared_ptr<item_data> data;
+    std::string_view key;
     size_t data_size;
     std::time_t expires_at;
+    // set by the commit that last wrote the data, compared by
+    // `cache_storage::commit_cas()`
+    uint64_t version;
+
+private:
+    enum class storage_type : uint8_t {
+        INLINE,
+        HEAP,
+        BORROWED
+    };
+
+    void copy_data(const cache_item& other) {
+        data_size = other.data_size;
+        storage_ = other.storage_;
+        switch (storage_) {
+            case storage_type::INLINE:
+                std::memcpy(inline_data_, other.inline_data_, data_size);
+                break;
+            case storage_type::HEAP:
+                // large data is shared between copies, like before
+                new (&heap_data_) std::shared_ptr<item_data>(
+                    other.heap_data_);
+                break;
+            case storage_type::BORROWED:
+                borrowed_data_ = other.borrowed_data_;
+                break;
+        }
+    }
+
+    void move_data(cache_item&& other) {
+        if (other.storage_ != storage_type::HEAP) {
+            copy_data(other);
+            return;
+        }
+        data_size = other.data_size;
+        storage_ = storage_type::HEAP;
+        new (&heap_data_) std::shared_ptr<item_data>(
+            std::move(other.heap_data_));
+    }
+
+    void release_data() {
+        if (storage_ == storage_type::HEAP) {
+            heap_data_.~shared_ptr<item_data>();
+        }
+        storage_ = storage_type::INLINE;
+        data_size = 0;
+    }
+
+    storage_type storage_;
+
+    union {
+        unsigned char inline_data_[INLINE_SIZE];
+        std::shared_ptr<item_data> heap_data_;
+        unsigned char* borrowed_data_;
+    };
 };
 
 }
@@ -0,0 +1,63 @@
+#ifndef LRUCACHE_CACHE_SHARD_
+#define LRUCACHE_CACHE_SHARD_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "lrucache/cache_config.hxx"
+#include "cache_storage.hxx"
+
+namespace lrucache {
+
+/**
+ * One hash partition of the cache state. Each shard owns its own storage,
+ * LRU order, expiry buckets and memory budget so that operations on keys
+ * living in different shards never contend on the same lock.
+ */
+struct cache_shard {
+    /**
+     * @param config cache settings for this shard
+     * @param epoch epoch pinned by the readers not taking `lock`
+     */
+    cache_shard(cache_config config, epoch_manager* epoch)
+        : owned_(std::make_unique<cache_storage>(config, epoch))
+        , storage_(owned_.get()) {}
+
+    /**
+     * Current storage of the shard. Readable without `lock` as long as the
+     * epoch is pinned before calling this, frozen while a snapshot is in
+     * progress.
+     */
+    cache_storage& storage() {
+        return *storage_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Swap in another storage, atomically for readers. `lock` must be
+     * held.
+     *
+     * @return the previous storage, to be destroyed only once the readers
+     *         pinned before the swap are done
+     */
+    std::unique_ptr<cache_storage> replace(
+            std::unique_ptr<cache_storage> storage) {
+        storage_.store(storage.get(), std::memory_order_release);
+        std::swap(owned_, storage);
+        return storage;
+    }
+
+    // mutex for operations on this shard
+    std::mutex lock;
+
+private:
+    std::unique_ptr<cache_storage> owned_;
+
+    // `owned_`, loaded by the readers not taking `lock`
+    std::atomic<cache_storage*> storage_;
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_CACHE_SHARD_
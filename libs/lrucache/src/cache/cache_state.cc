@@ -1,11 +1,69 @@
 #include "cache_state.hxx"
 
-#include <iostream>
+#include <cstdint>
 #include <cstring>
 #include <mutex>
+#include <thread>
+
+#include "key_hash.hxx"
+#include "parallel_for.hxx"
 
 namespace lrucache {
 
+namespace {
+
+/**
+ * Buffer the values held in slab chunks are copied into by a reader, kept
+ * by each thread from one read to the next. A callback reading again gets
+ * a buffer of its own.
+ */
+class read_buffer {
+public:
+    read_buffer() { buffer_.swap(spare()); }
+    ~read_buffer() { buffer_.swap(spare()); }
+
+    std::vector<unsigned char>& get() { return buffer_; }
+
+private:
+    static std::vector<unsigned char>& spare() {
+        thread_local std::vector<unsigned char> buffer;
+        return buffer;
+    }
+
+    std::vector<unsigned char> buffer_;
+};
+
+} // namespace
+
+cache_state::cache_state(cache_config config)
+    : config_(config)
+    , shard_config_(config)
+    , restored_at_(0)
+    , mapped_(nullptr)
+    , commit_code_(cache_storage::commit_result::DONE_OK)
+    , clock_(0)
+{
+    size_t count = std::max<size_t>(config.shard_count, 1);
+    shard_config_.cache_size = config.cache_size / count;
+    shard_config_.eviction_headroom = config.eviction_headroom / count;
+    shard_config_.purge_batch_size = (config.purge_batch_size + count - 1)
+                                     / count;
+
+    shards_.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        shards_.push_back(
+            std::make_unique<cache_shard>(shard_config_, &epoch_));
+    }
+
+    size_t threads = config.snapshot_threads
+        ? config.snapshot_threads
+        : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    if (threads > 1) {
+        snapshot_pool_ = std::make_unique<ctpl::thread_pool>(
+            static_cast<int>(threads - 1));
+    }
+}
+
 std::unique_ptr<unsigned char[]> cache_state::read(const std::string& key,
                                                    size_t& len)
 {
@@ -21,81 +79,590 @@ std::unique_ptr<unsigned char[]> cache_state::read(const std::string& key,
 }
 
 void cache_state::read_then(const std::string& key,
-                            std::function<void(unsigned char*, size_t)> then)
+                            std::function<void(unsigned char*, size_t)> then,
+                            bool touch)
 {
-    std::lock_guard<std::mutex> lock(cache_lock_);
+    size_t len = 0;
+    uint64_t version = 0;
+    read_buffer buffer;
+    auto guard = epoch_.pin();
+    unsigned char* data = find_data(key, len, version, buffer.get(), touch);
+    then(data, len);
+}
 
+void cache_state::read_versioned(
+        const std::string& key,
+        std::function<void(unsigned char*, size_t, uint64_t)> then,
+        bool touch)
+{
     size_t len = 0;
-    unsigned char* data = nullptr;
-    cache_storage* storage = &storage_;
+    uint64_t version = 0;
+    read_buffer buffer;
+    auto guard = epoch_.pin();
+    unsigned char* data = find_data(key, len, version, buffer.get(), touch);
+    then(data, len, version);
+}
 
-    if (snapshot_in_progress_) {
-        storage = &snapshot_storage_;
-    }
+unsigned char* cache_state::find_data(const std::string& key, size_t& len,
+                                      uint64_t& version,
+                                      std::vector<unsigned char>& buffer,
+                                      bool touch)
+{
+    uint64_t hash = key_hash(key);
+    auto& shard = this->shard(hash);
 
-    data = storage->read(key, len);
-    then(data, len);
+    std::time_t now = clock();
+    unsigned char* data = shard.storage().read(key, now, len, buffer,
+                                               &version);
+    auto mapped = mapped_.load(std::memory_order_acquire);
+    snapshot_file::record record;
+    // an item taken over while looked up is briefly missed
+    if (!data && mapped
+            && mapped->find(hash % shards_.size(), key, hash, record)
+            && record.expires_at > now) {
+        data = const_cast<unsigned char*>(record.data);
+        len = record.data_size;
+        version = record.version;
+    }
+    if (data && (touch || config_.approximate_recency)) {
+        touches_.record(hash);
+    }
+    return data;
 }
 
 bool cache_state::commit_read(const std::string& key, std::time_t read_at)
 {
-    std::lock_guard<std::mutex> lock(cache_lock_);
+    advance_clock(read_at);
+    uint64_t hash = key_hash(key);
+    size_t index = hash % shards_.size();
+    auto& shard = *shards_[index];
+    std::lock_guard<std::mutex> lock(shard.lock);
+    take_mapped(index, hash, &key, read_at);
 
-    bool result = storage()->commit_read(key, read_at);
-    commit_code_ = storage()->get_commit_code();
+    bool result = shard.storage().commit_read(key, read_at);
+    commit_code_ = shard.storage().get_commit_code();
     return result;
 }
 
+std::vector<uint64_t> cache_state::collect_touches()
+{
+    std::vector<uint64_t> hashes;
+    touches_.drain([&hashes](uint64_t hash) {
+        hashes.push_back(hash);
+    });
+    return hashes;
+}
+
+void cache_state::commit_touch(const std::vector<uint64_t>& hashes)
+{
+    for (auto hash : hashes) {
+        size_t index = hash % shards_.size();
+        auto& shard = *shards_[index];
+        std::lock_guard<std::mutex> lock(shard.lock);
+        take_mapped(index, hash, nullptr, 0);
+        shard.storage().commit_touch(hash);
+    }
+    commit_code_ = cache_storage::commit_result::DONE_OK;
+}
+
 bool cache_state::commit_write(const std::string& key,
                                const cache_item& item,
                                std::time_t written_at)
 {
-    std::lock_guard<std::mutex> lock(cache_lock_);
+    advance_clock(written_at);
+    uint64_t hash = key_hash(key);
+    size_t index = hash % shards_.size();
+    auto& shard = *shards_[index];
+    std::lock_guard<std::mutex> lock(shard.lock);
+    take_mapped(index, hash, &key, written_at);
 
-    bool result = storage()->commit_write(key, std::move(item), written_at);
-    commit_code_ = storage()->get_commit_code();
+    bool result = shard.storage().commit_write(key, item, written_at);
+    commit_code_ = shard.storage().get_commit_code();
     return result;
 }
 
+bool cache_state::commit_delete(const std::string& key,
+                                std::time_t deleted_at)
+{
+    advance_clock(deleted_at);
+    uint64_t hash = key_hash(key);
+    size_t index = hash % shards_.size();
+    auto& shard = *shards_[index];
+    std::lock_guard<std::mutex> lock(shard.lock);
+    take_mapped(index, hash, &key, deleted_at);
+
+    bool result = shard.storage().commit_delete(key, deleted_at);
+    commit_code_ = shard.storage().get_commit_code();
+    return result;
+}
+
+bool cache_state::commit_expire(const std::string& key,
+                                std::time_t expires_at,
+                                std::time_t touched_at)
+{
+    advance_clock(touched_at);
+    uint64_t hash = key_hash(key);
+    size_t index = hash % shards_.size();
+    auto& shard = *shards_[index];
+    std::lock_guard<std::mutex> lock(shard.lock);
+    take_mapped(index, hash, &key, touched_at);
+
+    bool result = shard.storage().commit_expire(key, expires_at, touched_at);
+    commit_code_ = shard.storage().get_commit_code();
+    return result;
+}
+
+bool cache_state::commit_cas(const std::string& key,
+                             const cache_item& item,
+                             uint64_t expected,
+                             std::time_t written_at)
+{
+    advance_clock(written_at);
+    uint64_t hash = key_hash(key);
+    size_t index = hash % shards_.size();
+    auto& shard = *shards_[index];
+    std::lock_guard<std::mutex> lock(shard.lock);
+    take_mapped(index, hash, &key, written_at);
+
+    bool result = shard.storage().commit_cas(key, item, expected, written_at);
+    commit_code_ = shard.storage().get_commit_code();
+    return result;
+}
+
+bool cache_state::commit_incr(const std::string& key,
+                              int64_t delta,
+                              uint64_t version,
+                              std::time_t incremented_at,
+                              int64_t& value)
+{
+    advance_clock(incremented_at);
+    uint64_t hash = key_hash(key);
+    size_t index = hash % shards_.size();
+    auto& shard = *shards_[index];
+    std::lock_guard<std::mutex> lock(shard.lock);
+    take_mapped(index, hash, &key, incremented_at);
+
+    bool result = shard.storage().commit_incr(key, delta, version,
+                                              incremented_at, value);
+    commit_code_ = shard.storage().get_commit_code();
+    return result;
+}
+
+void cache_state::commit_batch(std::vector<batch_op>& ops)
+{
+    std::vector<std::vector<std::pair<batch_op*, uint64_t>>> by_shard(
+            shards_.size());
+    for (auto& op : ops) {
+        advance_clock(op.at);
+        if (op.kind == batch_op::PURGE) {
+            for (auto& shard_ops : by_shard) {
+                shard_ops.emplace_back(&op, 0);
+            }
+            continue;
+        }
+        uint64_t hash = op.kind == batch_op::TOUCH ? op.hash
+                                                   : key_hash(op.key);
+        by_shard[hash % shards_.size()].emplace_back(&op, hash);
+    }
+
+    for (size_t index = 0; index < shards_.size(); index++) {
+        if (by_shard[index].empty()) {
+            continue;
+        }
+        auto& shard = *shards_[index];
+        std::lock_guard<std::mutex> lock(shard.lock);
+        auto& storage = shard.storage();
+        for (auto& entry : by_shard[index]) {
+            batch_op& op = *entry.first;
+            uint64_t hash = entry.second;
+            if (op.kind == batch_op::TOUCH) {
+                take_mapped(index, hash, nullptr, 0);
+            } else if (op.kind != batch_op::PURGE) {
+                take_mapped(index, hash, &op.key, op.at);
+            }
+
+            // copied once, from the log entry into the shard
+            cache_item item;
+            if (op.kind == batch_op::WRITE || op.kind == batch_op::CAS) {
+                item.expires_at = op.expires_at;
+                item.version = op.version;
+                item.borrow_data(const_cast<unsigned char*>(op.data),
+                                 op.data_len);
+            }
+
+            switch (op.kind) {
+                case batch_op::READ:
+                    storage.commit_read(op.key, op.at);
+                    break;
+                case batch_op::WRITE:
+                    storage.commit_write(op.key, item, op.at);
+                    break;
+                case batch_op::TOUCH:
+                    storage.commit_touch(hash);
+                    break;
+                case batch_op::PURGE:
+                    storage.commit_purge(op.at);
+                    break;
+                case batch_op::DELETE:
+                    storage.commit_delete(op.key, op.at);
+                    break;
+                case batch_op::EXPIRE:
+                    storage.commit_expire(op.key, op.expires_at, op.at);
+                    break;
+                case batch_op::CAS:
+                    storage.commit_cas(op.key, item, op.expected, op.at);
+                    break;
+                case batch_op::INCR:
+                    storage.commit_incr(op.key, op.delta, op.version, op.at,
+                                        op.value);
+                    break;
+            }
+            // a PURGE is applied to every shard and never fails
+            if (op.kind != batch_op::PURGE) {
+                op.code = storage.get_commit_code();
+            }
+        }
+    }
+    commit_code_ = cache_storage::commit_result::DONE_OK;
+}
+
 void cache_state::commit_purge_expired(std::time_t purge_at)
 {
-    storage()->commit_purge(purge_at);
+    advance_clock(purge_at);
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->lock);
+        shard->storage().commit_purge(purge_at);
+    }
+}
+
+size_t cache_state::purge_expired()
+{
+    std::time_t now = clock();
+    size_t limit = shard_config_.purge_batch_size
+                   ? shard_config_.purge_batch_size : SIZE_MAX;
+    size_t purged = 0;
+    for (auto& shard : shards_) {
+        size_t removed;
+        do {
+            std::lock_guard<std::mutex> lock(shard->lock);
+            removed = shard->storage().purge_expired(now, limit);
+            purged += removed;
+        } while (removed == limit);
+    }
+    return purged;
+}
+
+size_t cache_state::purge_debt()
+{
+    size_t result = 0;
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->lock);
+        result += shard->storage().purge_debt();
+    }
+    return result;
+}
+
+void cache_state::advance_clock(std::time_t now)
+{
+    std::time_t last = clock_.load(std::memory_order_relaxed);
+    while (last < now
+           && !clock_.compare_exchange_weak(last, now,
+                                            std::memory_order_release)) {
+    }
 }
 
 void cache_state::begin_snapshot()
 {
-    std::lock_guard<std::mutex> lock(cache_lock_);
-    snapshot_in_progress_ = true;
+    fold_snapshot();
+    frozen_file_.reset();
+    parallel_for(snapshot_pool(), shards_.size(), [this](size_t i) {
+        std::lock_guard<std::mutex> lock(shards_[i]->lock);
+        shards_[i]->storage().freeze();
+    });
+    chunk_cursor_ = open_snapshot();
+}
+
+snapshot_cursor cache_state::open_snapshot(bool oldest_first)
+{
+    if (frozen_file_) {
+        std::vector<std::pair<const unsigned char*, size_t>> segments;
+        for (size_t i = 0; i < frozen_file_->segment_count(); i++) {
+            segments.emplace_back(frozen_file_->segment_data(i),
+                                  frozen_file_->segment_size(i));
+        }
+        return snapshot_cursor(std::move(segments));
+    }
+
+    std::vector<const std::vector<const cache_entry*>*> parts;
+    for (auto& shard : shards_) {
+        parts.push_back(&shard->storage().frozen_entries());
+    }
+    return snapshot_cursor(std::move(parts), oldest_first);
+}
+
+snapshot_cursor cache_state::open_snapshot_segment(size_t segment,
+                                                   bool oldest_first)
+{
+    if (frozen_file_) {
+        return snapshot_cursor({ { frozen_file_->segment_data(segment),
+                                   frozen_file_->segment_size(segment) } });
+    }
+    return snapshot_cursor({ &shards_[segment]->storage().frozen_entries() },
+                           oldest_first);
 }
 
 std::unique_ptr<unsigned char[]> cache_state::read_snapshot_chunk(
         size_t chunk_size, int& item_index, size_t& read)
 {
-    return storage_.read_snapshot_chunk(chunk_size, item_index, read);
+    auto result = std::make_unique<unsigned char[]>(chunk_size);
+    read = 0;
+    if (item_index < 0) {
+        return result;
+    }
+
+    // frozen items are not modified until `end_snapshot()`, no need to
+    // lock the shards while reading them.
+    std::lock_guard<std::mutex> lock(chunk_lock_);
+    if (chunk_cursor_.position() != static_cast<size_t>(item_index)) {
+        chunk_cursor_.seek(item_index);
+    }
+    std::vector<iovec> iov;
+    chunk_cursor_.next(chunk_size, iov);
+    for (auto& buffer : iov) {
+        std::memcpy(result.get() + read, buffer.iov_base, buffer.iov_len);
+        read += buffer.iov_len;
+    }
+
+    item_index = chunk_cursor_.done()
+        ? -1 // done!
+        : static_cast<int>(chunk_cursor_.position());
+    return result;
 }
 
 void cache_state::end_snapshot()
 {
-    std::lock_guard<std::mutex> lock(cache_lock_);
+    parallel_for(snapshot_pool(), shards_.size(), [this](size_t i) {
+        std::lock_guard<std::mutex> lock(shards_[i]->lock);
+        shards_[i]->storage().thaw();
+    });
+    chunk_cursor_ = snapshot_cursor();
+    frozen_file_.reset();
+}
 
-    size_t len = 0;
-    const auto& events = snapshot_storage_.events();
-    for (const auto& event : events) {
-        switch (event.type) {
-            case snapshot_event::type::READ:
-                storage_.commit_read(*event.key, event.created_at);
-                break;
-            case snapshot_event::type::WRITE:
-                storage_.commit_write(*event.key, *event.item, event.created_at);
-                break;
-            case snapshot_event::type::PURGE:
-                storage_.commit_purge(event.created_at);
-                break;
-        };
+void cache_state::serve_snapshot(std::shared_ptr<const snapshot_file> file)
+{
+    {
+        std::lock_guard<std::mutex> lock(chunk_lock_);
+        frozen_file_ = std::move(file);
+        chunk_cursor_ = open_snapshot();
     }
+    parallel_for(snapshot_pool(), shards_.size(), [this](size_t i) {
+        std::lock_guard<std::mutex> lock(shards_[i]->lock);
+        shards_[i]->storage().thaw();
+    });
+}
 
-    snapshot_storage_.clear();
-    snapshot_in_progress_ = false;
+void cache_state::begin_restore(std::time_t taken_at)
+{
+    restored_.clear();
+    restored_.reserve(shards_.size());
+    for (size_t i = 0; i < shards_.size(); i++) {
+        restored_.push_back(
+            std::make_unique<cache_shard>(shard_config_, &epoch_));
+    }
+    restored_at_ = taken_at;
+}
+
+bool cache_state::restore_chunk(const unsigned char* data, size_t size)
+{
+    if (restored_.empty()) {
+        return false;
+    }
+
+    const unsigned char* end = data + size;
+    auto take = [&data, end](void* out, size_t len) {
+        if (static_cast<size_t>(end - data) < len) {
+            return false;
+        }
+        std::memcpy(out, data, len);
+        data += len;
+        return true;
+    };
+
+    // consecutive items usually belong to the same shard, keep it locked
+    std::unique_lock<std::mutex> lock;
+    while (data < end) {
+        size_t key_size = 0;
+        if (!take(&key_size, sizeof(key_size))
+                || static_cast<size_t>(end - data) < key_size) {
+            return false;
+        }
+        std::string key(reinterpret_cast<const char*>(data), key_size);
+        data += key_size;
+
+        cache_item item;
+        if (!take(&item.data_size, sizeof(item.data_size))
+                || static_cast<size_t>(end - data) < item.data_size) {
+            return false;
+        }
+        // copied straight into the slab chunk of the entry
+        item.borrow_data(const_cast<unsigned char*>(data), item.data_size);
+        data += item.data_size;
+        if (!take(&item.expires_at, sizeof(item.expires_at))
+                || !take(&item.version, sizeof(item.version))) {
+            return false;
+        }
+
+        auto& shard = *restored_[key_hash(key) % restored_.size()];
+        if (lock.mutex() != &shard.lock) {
+            // never wait for a shard while holding another one
+            if (lock) {
+                lock.unlock();
+            }
+            lock = std::unique_lock<std::mutex>(shard.lock);
+        }
+        shard.storage().restore_item(key, item, restored_at_);
+    }
+    return true;
+}
+
+bool cache_state::end_restore()
+{
+    if (restored_.empty()) {
+        return false;
+    }
+
+    // the items restored replace the ones of the snapshot file attached
+    std::lock_guard<std::mutex> fold_lock(fold_lock_);
+    mapped_.store(nullptr, std::memory_order_release);
+    auto detached = std::move(owned_mapped_);
+    {
+        // the cursor reads the frozen items of the storages replaced
+        std::lock_guard<std::mutex> lock(chunk_lock_);
+        chunk_cursor_ = snapshot_cursor();
+        frozen_file_.reset();
+    }
+
+    std::vector<std::unique_ptr<cache_storage>> replaced;
+    for (size_t i = 0; i < shards_.size(); i++) {
+        // the restored shard is not readable, no need to swap atomically
+        auto storage = restored_[i]->replace(nullptr);
+        std::lock_guard<std::mutex> lock(shards_[i]->lock);
+        replaced.push_back(shards_[i]->replace(std::move(storage)));
+    }
+    restored_.clear();
+    advance_clock(restored_at_);
+
+    // readers may still be reading the entries of the replaced storages
+    epoch_.synchronize();
+    parallel_for(snapshot_pool(), replaced.size(), [&replaced](size_t i) {
+        replaced[i].reset();
+    });
+    return true;
+}
+
+void cache_state::abort_restore()
+{
+    // the restored shards were never readable
+    parallel_for(snapshot_pool(), restored_.size(), [this](size_t i) {
+        restored_[i].reset();
+    });
+    restored_.clear();
+}
+
+bool cache_state::attach_snapshot(std::shared_ptr<const snapshot_file> file)
+{
+    if (file->segment_count() != shards_.size()) {
+        return false;
+    }
+    // reads are served from the segments until folded, none may be corrupt
+    std::atomic<bool> intact(true);
+    parallel_for(snapshot_pool(), shards_.size(), [&](size_t i) {
+        if (!file->check_segment(i)) {
+            intact = false;
+        }
+    });
+    if (!intact) {
+        return false;
+    }
+
+    // start from empty shards
+    begin_restore(file->taken_at());
+    end_restore();
+
+    std::lock_guard<std::mutex> fold_lock(fold_lock_);
+    owned_mapped_ = std::make_unique<mapped_snapshot>(file);
+    mapped_.store(owned_mapped_.get(), std::memory_order_release);
+    std::lock_guard<std::mutex> lock(chunk_lock_);
+    frozen_file_ = std::move(file);
+    chunk_cursor_ = open_snapshot();
+    return true;
+}
+
+void cache_state::fold_snapshot()
+{
+    std::lock_guard<std::mutex> fold_lock(fold_lock_);
+    auto mapped = owned_mapped_.get();
+    if (!mapped) {
+        return;
+    }
+
+    std::time_t taken_at = mapped->file()->taken_at();
+    std::vector<std::unique_ptr<cache_storage>> replaced(shards_.size());
+    parallel_for(snapshot_pool(), shards_.size(), [&](size_t i) {
+        auto fold = [&]() {
+            auto storage = std::make_unique<cache_storage>(shard_config_,
+                                                           &epoch_);
+            mapped->for_each(i, [&](const std::string& key,
+                                    const cache_item& item) {
+                storage->restore_item(key, item, taken_at);
+            });
+            return storage;
+        };
+
+        size_t taken;
+        {
+            std::lock_guard<std::mutex> lock(shards_[i]->lock);
+            taken = mapped->taken(i);
+        }
+        // copied without the lock, over again in the rare case commits
+        // took items over meanwhile
+        auto storage = fold();
+        std::lock_guard<std::mutex> lock(shards_[i]->lock);
+        if (mapped->taken(i) != taken) {
+            storage = fold();
+        }
+        shards_[i]->storage().restore_into(*storage);
+        mapped->set_folded(i);
+        replaced[i] = shards_[i]->replace(std::move(storage));
+    });
+
+    mapped_.store(nullptr, std::memory_order_release);
+    // readers may still be reading the storages replaced or the mapping
+    epoch_.synchronize();
+    parallel_for(snapshot_pool(), replaced.size(), [&replaced](size_t i) {
+        replaced[i].reset();
+    });
+    owned_mapped_.reset();
+}
+
+void cache_state::take_mapped(size_t index, uint64_t hash,
+                              const std::string* key, std::time_t taken_at)
+{
+    // the mapped snapshot is freed once folded, right after the epoch
+    auto guard = epoch_.pin();
+    auto mapped = mapped_.load(std::memory_order_acquire);
+    if (!mapped) {
+        return;
+    }
+    if (!taken_at) {
+        taken_at = mapped->file()->taken_at();
+    }
+    auto& storage = shards_[index]->storage();
+    mapped->take(index, hash, key, [&](const std::string& key,
+                                       const cache_item& item) {
+        storage.restore_item(key, item, taken_at);
+    });
 }
 
 cache_storage::commit_result cache_state::get_commit_code()
@@ -103,11 +670,19 @@ cache_storage::commit_result cache_state::get_commit_code()
     return commit_code_;
 }
 
-cache_storage* cache_state::storage()
+size_t cache_state::shard_count() const
+{
+    return shards_.size();
+}
+
+cache_shard& cache_state::shard(const std::string& key)
+{
+    return shard(key_hash(key));
+}
+
+cache_shard& cache_state::shard(uint64_t hash)
 {
-    if (snapshot_in_progress_)
-        return &snapshot_storage_;
-    return &storage_;
+    return *shards_[hash % shards_.size()];
 }
 
 } // namespace lrucache
@@ -2,22 +2,28 @@
 #define LRUCACHE_CACHE_STATE_H_
 
 #include <atomic>
+#include <ctime>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "ctpl/ctpl_stl.h"
 #include "lrucache/cache_config.hxx"
+#include "cache_shard.hxx"
 #include "cache_storage.hxx"
-#include "snapshot_storage.hxx"
+#include "epoch_manager.hxx"
+#include "mapped_snapshot.hxx"
+#include "snapshot_cursor.hxx"
+#include "touch_buffer.hxx"
 
 namespace lrucache {
 
 class cache_state {
 public:
-    cache_state(cache_config config)
-        : snapshot_in_progress_(false)
-        , storage_(config)
-        , snapshot_storage_(config, &storage_)
-        , config_(config) {}
+    cache_state(cache_config config);
 
     /**
      * Read data in cache at the given key.
@@ -33,34 +39,71 @@ public:
      * with returned data as is without an extra copy.
      * 
      * This is useful to avoid the cost incurred by `read()` copy of data.
-     * With this method, no copying is necessary and the data read is
-     * thread-safe until the end of the callback.
+     * Inline data and the data of the snapshot file attached are given in
+     * place, other data is copied once into a buffer kept by the thread,
+     * since the slab chunk of an item is reused as soon as it is removed.
+     * The data read is thread-safe until the end of the callback.
+     *
+     * Items expiring by `clock()` are not found, whatever the time on
+     * this node, so that every node reads the same items.
+     *
+     * No lock is taken: the entry read is kept alive by pinning the
+     * current epoch, so a slow callback never delays commits.
      * 
      * @param key key used to retrieve the data.
      * @param then callback function taking the read data and the
      *             length of the data. If no data is found, the callback
      *             will receive a nullptr instead.
+     * @param touch record the item read for `collect_touches()` even when
+     *              approximate recency is disabled, for reads that do not
+     *              go through the log.
      */
     void read_then(const std::string& key,
-                   std::function<void(unsigned char*, size_t)> then);
+                   std::function<void(unsigned char*, size_t)> then,
+                   bool touch = false);
+
+    /**
+     * Like `read_then()`, also giving `then` the version of the item read,
+     * to be expected by a later `commit_cas()`.
+     */
+    void read_versioned(
+            const std::string& key,
+            std::function<void(unsigned char*, size_t, uint64_t)> then,
+            bool touch = false);
 
     /**
      * Update the cache state so that the data pointed by the key is put at
      * the back of the eviction queue.
      * 
      * @param key key for the data to read.
-     * @param read_at POSIX time of when the read is committed.
+     * @param read_at time in ms of when the read is committed.
      * @return true if read succeeds. If false, `get_error_code()` will
      *         indicate why.
      */
     bool commit_read(const std::string& key, std::time_t read_at);
 
+    /**
+     * Take the key hashes recorded by `read_then()` since the last call.
+     * They are meant to be replicated and given back to `commit_touch()`
+     * on every node.
+     *
+     * @return key hashes of the items read
+     */
+    std::vector<uint64_t> collect_touches();
+
+    /**
+     * Mark the items with the given key hashes as recently used.
+     *
+     * @param hashes key hashes returned by `collect_touches()`
+     */
+    void commit_touch(const std::vector<uint64_t>& hashes);
+
     /**
      * Write data in cache that can be retrieved with the given key.
      *
      * @param key key used to retrieve the data written.
      * @param cache_item item to write into cache
-     * @param written_at POSIX time of when the write is committed.
+     * @param written_at time in ms of when the write is committed.
      * @return true if write succeeds. If false, `get_error_code()` will
      *         indicate why.
      */
@@ -68,38 +111,181 @@ public:
                       const cache_item& item,
                       std::time_t written_at);
 
+    /**
+     * Remove the item pointed by `key`, see `cache_storage::commit_delete()`.
+     */
+    bool commit_delete(const std::string& key, std::time_t deleted_at);
+
+    /**
+     * Change when the item pointed by `key` expires, see
+     * `cache_storage::commit_expire()`.
+     */
+    bool commit_expire(const std::string& key,
+                       std::time_t expires_at,
+                       std::time_t touched_at);
+
+    /**
+     * Write `item` over a live item whose version is `expected`, see
+     * `cache_storage::commit_cas()`.
+     */
+    bool commit_cas(const std::string& key,
+                    const cache_item& item,
+                    uint64_t expected,
+                    std::time_t written_at);
+
+    /**
+     * Add `delta` to the integer pointed by `key`, see
+     * `cache_storage::commit_incr()`.
+     */
+    bool commit_incr(const std::string& key,
+                     int64_t delta,
+                     uint64_t version,
+                     std::time_t incremented_at,
+                     int64_t& value);
+
+    /**
+     * Operation committed as part of a batch, see `commit_batch()`.
+     */
+    struct batch_op {
+        enum kind_type {
+            READ, WRITE, TOUCH, PURGE, DELETE, EXPIRE, CAS, INCR
+        };
+
+        kind_type kind;
+        // time in ms of when the operation is committed.
+        std::time_t at;
+        // key of the operations other than TOUCH and PURGE.
+        std::string key;
+        // key hash of a TOUCH.
+        uint64_t hash = 0;
+        // data of a WRITE or a CAS, only used during the commit.
+        const unsigned char* data = nullptr;
+        size_t data_len = 0;
+        // expiry of a WRITE, a CAS or an EXPIRE.
+        std::time_t expires_at = 0;
+        // version given to the item by a WRITE, a CAS or an INCR.
+        uint64_t version = 0;
+        // version a CAS expects the item to have.
+        uint64_t expected = 0;
+        // amount added by an INCR.
+        int64_t delta = 0;
+
+        // outcome of the operation, set by the commit
+        cache_storage::commit_result code = cache_storage::DONE_OK;
+        // value of the item once incremented by an INCR
+        int64_t value = 0;
+    };
+
+    /**
+     * Commit a batch of operations as if one after the other, taking the
+     * lock of each shard involved once only.
+     *
+     * Operations on different shards commute, so each shard applies its
+     * own in order. A PURGE is applied to every shard at its place in the
+     * batch. `get_error_code()` does not tell about single operations,
+     * their own outcome is set in `batch_op::code`.
+     *
+     * @param ops[in,out] operations in the order they were proposed
+     */
+    void commit_batch(std::vector<batch_op>& ops);
+
     /**
      * Purge all expired items from the cache.
      * 
-     * @param purge_at POSIX time of when the data is purged.
+     * @param purge_at time in ms of when the data is purged.
      */
     void commit_purge_expired(std::time_t purge_at);
 
+    /**
+     * Remove the items expired by `clock()` from every shard, see
+     * `cache_storage::purge_expired()`. Expiry only depends on the time
+     * committed, so each node calls this on its own rather than through
+     * a PURGE log entry. Shard locks are released every
+     * `cache_config::purge_batch_size` items, so that commits are not
+     * stalled by a mass expiry.
+     *
+     * @return number of items removed
+     */
+    size_t purge_expired();
+
+    /**
+     * Number of items that expired before the last purge but are still
+     * waiting to be purged, see `cache_config::purge_batch_size`.
+     */
+    size_t purge_debt();
+
+    /**
+     * Move the clock reads filter expired items against up to `now`, the
+     * time of the last commit. Every commit moves it, and it never goes
+     * backwards.
+     *
+     * @param now time in ms of the log clock
+     */
+    void advance_clock(std::time_t now);
+
+    /**
+     * Time in ms of the last commit, see `advance_clock()`.
+     */
+    std::time_t clock() const {
+        return clock_.load(std::memory_order_acquire);
+    }
+
     /**
      * Instruct the cache state that a snapshot of its data is in progress.
      * 
-     * When a snapshot is in progress, the cache data is frozen in time
-     * until `end_snapshot()` is called. Reads and writes are still possible
-     * but will go to a temporary data storage instead. Evictions are
-     * disabled during the snapshot process for performance reasons. Once
-     * the snapshot is terminated, evictions will be applied in the right
-     * order as expected if no snapshot happened.
-     * 
-     * For consumers, this entire process should be transparent except that
-     * reads could return stale data until evictions are enabled again.
+     * The items in cache are frozen as they are until `end_snapshot()` is
+     * called, and only those are returned by `read_snapshot_chunk()`. All
+     * commits, evictions and purges keep being applied to the live cache
+     * in the meantime: frozen items are copied when updated, and the ones
+     * removed are only released at the end of the snapshot.
      * 
+     * For consumers, this entire process is transparent. A snapshot still
+     * in progress is ended first. Shards are frozen in parallel on the
+     * snapshot threads.
      */
     void begin_snapshot();
 
+    /**
+     * Get a cursor over the items frozen by `begin_snapshot()`, which can
+     * be used without any lock until `end_snapshot()` or `end_restore()`.
+     * Items are listed in order from most recently used to least recently
+     * used within each shard, shards being read one after the other.
+     *
+     * @param oldest_first list the items of each shard from least recently
+     *                     used to most recently used instead, the order in
+     *                     which `restore_chunk()` rebuilds the same LRU
+     *                     order. Always the case for the snapshot file
+     *                     attached by `attach_snapshot()`.
+     * @return cursor on the first item
+     */
+    snapshot_cursor open_snapshot(bool oldest_first = false);
+
+    /**
+     * Get a cursor over the items frozen in one shard only, like
+     * `open_snapshot()` does for all of them. Each shard is a segment of
+     * the snapshot that can be read and restored independently of the
+     * others, in parallel.
+     *
+     * @param segment index of the shard, below `shard_count()`
+     * @param oldest_first see `open_snapshot()`
+     * @return cursor on the first item of the shard
+     */
+    snapshot_cursor open_snapshot_segment(size_t segment,
+                                          bool oldest_first = false);
+
     /**
      * Read up to `chunk_size` of data from the frozen cache data during
      * snapshot process. Each cache item will be written in this format:
      * 
-     *  <key size>   <key data>    <data size>     <data>       <expiry>
-     *   8 bytes   key_size bytes    8 bytes    data_size bytes  8 bytes
+     *  <key size>  <key data>  <data size>    <data>     <expiry>  <version>
+     *   8 bytes    key_size     8 bytes    data_size   8 bytes   8 bytes
      * 
      * The data will also be listed in order from most recently used to
-     * least recently used.
+     * least recently used within each shard, shards being read one after
+     * the other.
+     *
+     * Chunks read one after the other resume in O(1). Unlike the cursor
+     * from `open_snapshot()`, the data is copied into the buffer returned.
      * 
      * @param chunk_size max size of data returned. Must be big enough
      *                   to contain the biggest object the cache can
@@ -122,44 +308,193 @@ public:
      */
     void end_snapshot();
 
+    /**
+     * Terminate the snapshot process once its items are written to a file,
+     * which stands for the snapshot in progress from then on, read by
+     * `open_snapshot()` until the next `begin_snapshot()`. The items
+     * removed since `begin_snapshot()` are released.
+     *
+     * Cursors opened before read the frozen items, which are gone: open
+     * them again and seek where they were, the items being in the same
+     * order.
+     *
+     * @param file snapshot file written by `snapshot_file::write()`
+     */
+    void serve_snapshot(std::shared_ptr<const snapshot_file> file);
+
+    /**
+     * Start restoring a snapshot taken by another node into empty shadow
+     * shards. The live cache is left untouched and readable until
+     * `end_restore()`.
+     *
+     * @param taken_at time in ms of the last commit in the snapshot
+     */
+    void begin_restore(std::time_t taken_at);
+
+    /**
+     * Add the items of a snapshot chunk to the shadow shards. Chunks are
+     * laid out like those of `read_snapshot_chunk()`, and hold whole items.
+     * Each item becomes the most recently used one of its shard, so they
+     * must come from least recently used to most recently used to restore
+     * the LRU order of the snapshot.
+     *
+     * Can be called from several threads at once, typically with chunks of
+     * different segments. The chunks of a segment must still be restored
+     * in order.
+     *
+     * @param data chunk of items
+     * @param size size of the chunk in bytes
+     * @return false if the chunk is truncated or there is no restore in
+     *         progress, the items before the faulty one being kept
+     */
+    bool restore_chunk(const unsigned char* data, size_t size);
+
+    /**
+     * Replace the items of each shard by the ones restored since
+     * `begin_restore()`. Readers see each shard switch atomically, and
+     * commits must not be applied concurrently. Cursors from
+     * `open_snapshot()` are invalidated. The items replaced are freed in
+     * parallel on the snapshot threads.
+     *
+     * @return false if there is no restore in progress, the live cache
+     *         being left as is
+     */
+    bool end_restore();
+
+    /**
+     * Drop the items restored since `begin_restore()`, the live cache
+     * being kept as is.
+     */
+    void abort_restore();
+
+    /**
+     * Replace the items of the cache by the ones of a snapshot file, served
+     * straight from its mapping: the cache is readable right away, whatever
+     * its size. Commits take over the items they touch into their shard,
+     * and `fold_snapshot()` moves the others there.
+     *
+     * The file also stands for the snapshot in progress, read by
+     * `open_snapshot()` until the next `begin_snapshot()`.
+     *
+     * Items left in the file do not count toward the memory of their shard
+     * until folded, where they become its least recently used items.
+     *
+     * Every segment is checked first, in parallel on the snapshot threads.
+     *
+     * @param file snapshot to serve
+     * @return false if the file does not have one segment per shard or if
+     *         a segment is corrupt, the cache being left untouched
+     */
+    bool attach_snapshot(std::shared_ptr<const snapshot_file> file);
+
+    /**
+     * Move the items left in the snapshot file attached into the shards,
+     * below their own items, in parallel on the snapshot threads. Each
+     * shard is only locked while its own items are copied. Done first by
+     * `begin_snapshot()` if not done before.
+     */
+    void fold_snapshot();
+
     /**
      * Return a code indicating why the previous commit operation failed.
      * 
      * @return DONE_OK: operation successfully completed.
      *         NOT_FOUND: when key isn't found in cache
      *         KEY_TOO_BIG: when size of key is bigger than config.max_key_size
-     *         DATA_TOO_BIG: when item data is bigger than config.max_item_size
+     *         DATA_TOO_BIG: when item data and key are bigger than
+     *                       config.max_item_size
      *         WRONG_EXPIRY: expiry date is before commit time
+     *         WRONG_VERSION: the item changed since the version expected
+     *         NOT_A_NUMBER: the item incremented is not an integer
      */
     cache_storage::commit_result get_commit_code();
 
 
+    /**
+     * Number of shards the keys are partitioned into.
+     */
+    size_t shard_count() const;
+
+    /**
+     * Threads the snapshots are taken and restored with, the caller thread
+     * not included, or nullptr if `cache_config::snapshot_threads` is 1.
+     * Meant to be used with `parallel_for()`.
+     */
+    ctpl::thread_pool* snapshot_pool() { return snapshot_pool_.get(); }
+
 private:
     /**
-     * Get current cache_storage strategy.
-     * 
-     * @return either `cache_storage` or `snapshot_storage` based
-     *         `snapshot_in_progress_` value.
+     * Get the shard responsible for the given key.
+     *
+     * @param key key to look up
+     * @return shard owning the key
      */
-    cache_storage* storage();
+    cache_shard& shard(const std::string& key);
 
-    // true if snapshot is in progress
-    std::atomic<bool> snapshot_in_progress_;
+    cache_shard& shard(uint64_t hash);
 
-    // storage used during normal operations
-    cache_storage storage_;
+    /**
+     * Find the data at `key` in its shard, or in the snapshot file attached
+     * if not taken over yet. The epoch must be pinned by the caller.
+     *
+     * @param len[out] size of the data found
+     * @param version[out] version of the item found
+     * @param buffer[out] copy of the data, see `cache_storage::read()`
+     * @param touch see `read_then()`
+     * @return pointer to the data, or nullptr if no data found
+     */
+    unsigned char* find_data(const std::string& key, size_t& len,
+                             uint64_t& version,
+                             std::vector<unsigned char>& buffer, bool touch);
 
-    // storage used while snapshot is in progress
-    snapshot_storage snapshot_storage_;
+    /**
+     * Take over the items of the snapshot file attached with that key hash,
+     * and that key unless nullptr, into the shard `index`. Its lock must
+     * be held.
+     */
+    void take_mapped(size_t index, uint64_t hash, const std::string* key,
+                     std::time_t taken_at);
 
     // cache settings
     cache_config config_;
 
+    // settings of each shard
+    cache_config shard_config_;
+
+    // pinned by lock-free readers, must outlive the shards
+    epoch_manager epoch_;
+
+    // hash partitions of the cache, each with its own lock
+    std::vector<std::unique_ptr<cache_shard>> shards_;
+
+    // used by `read_snapshot_chunk()`
+    snapshot_cursor chunk_cursor_;
+    std::mutex chunk_lock_;
+
+    // shards filled by `restore_chunk()` and time they are restored at
+    std::vector<std::unique_ptr<cache_shard>> restored_;
+    std::time_t restored_at_;
+
+    // items of the snapshot file attached and not folded yet, loaded by
+    // the readers, and lock of the folds
+    std::atomic<mapped_snapshot*> mapped_;
+    std::unique_ptr<mapped_snapshot> owned_mapped_;
+    std::mutex fold_lock_;
+
+    // snapshot file read instead of the frozen items
+    std::shared_ptr<const snapshot_file> frozen_file_;
+
+    // helps the caller thread take and restore snapshots
+    std::unique_ptr<ctpl::thread_pool> snapshot_pool_;
+
+    // items read since the last `collect_touches()`
+    touch_buffer touches_;
+
     // reason for last commit result
-    cache_storage::commit_result commit_code_;
+    std::atomic<cache_storage::commit_result> commit_code_;
 
-    // Mutex for cache operations.
-    std::mutex cache_lock_;
+    // time of the last commit, reads filter expired items against it
+    std::atomic<std::time_t> clock_;
 };
 
 } // namespace lrucache
@@ -1,23 +1,74 @@
 #include "cache_storage.hxx"
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
 #include <iostream>
+#include <limits>
+
+#include "key_hash.hxx"
 
 namespace lrucache {
 
-unsigned char* cache_storage::read(const std::string& key, size_t& len)
+// retired entries are released in batches
+constexpr size_t RECLAIM_THRESHOLD = 64;
+
+cache_storage::cache_storage(cache_config config, epoch_manager* epoch)
+    : config_(config)
+    , slab_(config.cache_size)
+    , class_lru_(slab_allocator::class_count())
+    , index_(epoch)
+    , policy_(eviction_policy::create(
+          config.approximate_recency ? "clock" : config.eviction_policy))
+    , epoch_(epoch)
+    , frozen_(false)
+    , used_memory_(0)
+    , last_commit_time_(0)
+    , last_purge_time_(0)
 {
-    auto item = get_item(key, std::time(nullptr));
-    if (!item) {
-        return nullptr;
+}
+
+cache_storage::~cache_storage()
+{
+    cache_storage::clear();
+}
+
+unsigned char* cache_storage::read(const std::string& key,
+                                   std::time_t read_at, size_t& len,
+                                   std::vector<unsigned char>& buffer,
+                                   uint64_t* version)
+{
+    while (true) {
+        auto entry = find_entry(key);
+        if (!entry || entry->item.is_expired(read_at)) {
+            return nullptr;
+        }
+        const cache_item& item = entry->item;
+        len = item.data_size;
+        if (version) {
+            *version = item.version;
+        }
+        if (item.is_inline()) {
+            // in the record, which outlives the readers
+            return const_cast<unsigned char*>(item.bytes());
+        }
+
+        // the chunk may be reused by a commit while copied, in which case
+        // the entry was retired before: look it up again
+        buffer.assign(item.bytes(), item.bytes() + len);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (!entry->retired.load(std::memory_order_relaxed)) {
+            return buffer.data();
+        }
     }
-    len = item->data_size;
-    return item->data.get()->data();
 }
 
 bool cache_storage::commit_read(const std::string& key, std::time_t read_at)
 {
-    auto item = get_item(key, read_at);
-    if (!item) {
+    last_commit_time_ = read_at;
+    auto entry = live_entry(key, read_at);
+    if (!entry) {
         commit_code_ = commit_result::NOT_FOUND;
         return false;
     }
@@ -35,7 +86,7 @@ bool cache_storage::commit_write(const std::string& key,
         return false;
     }
 
-    if (item.data_size < 0) {
+    if (item.data_size + key.size() > config_.max_item_size) {
         commit_code_ = commit_result::DATA_TOO_BIG;
         return false;
     }
@@ -45,137 +96,350 @@ bool cache_storage::commit_write(const std::string& key,
         return false;
     }
 
-    int required_memory = get_required_memory(key, item, written_at);
-    evict_lru_data(key, required_memory);
+    write_item(key, item, written_at);
+    commit_code_ = commit_result::DONE_OK;
+    return true;
+}
 
-    auto old_item = get_item(key, written_at);
-    if (old_item) {
-        update_item(key, item, written_at);
+bool cache_storage::commit_delete(const std::string& key,
+                                  std::time_t deleted_at)
+{
+    last_commit_time_ = deleted_at;
+    auto entry = live_entry(key, deleted_at);
+    if (!entry) {
+        commit_code_ = commit_result::NOT_FOUND;
+        return false;
+    }
+    remove_entry(entry);
+    commit_code_ = commit_result::DONE_OK;
+    return true;
+}
+
+bool cache_storage::commit_expire(const std::string& key,
+                                  std::time_t expires_at,
+                                  std::time_t touched_at)
+{
+    last_commit_time_ = touched_at;
+    if (expires_at <= touched_at) {
+        commit_code_ = commit_result::WRONG_EXPIRY;
+        return false;
+    }
+    auto entry = live_entry(key, touched_at);
+    if (!entry) {
+        commit_code_ = commit_result::NOT_FOUND;
+        return false;
+    }
+
+    cache_item item = entry->item;
+    item.expires_at = expires_at;
+    entry = own_entry(entry, item);
+    expiry_wheel_.cancel(entry);
+    expiry_wheel_.schedule(entry);
+    touch_entry(entry);
+    commit_code_ = commit_result::DONE_OK;
+    return true;
+}
+
+bool cache_storage::commit_cas(const std::string& key,
+                               const cache_item& item,
+                               uint64_t expected,
+                               std::time_t written_at)
+{
+    last_commit_time_ = written_at;
+    auto entry = live_entry(key, written_at);
+    if (!entry) {
+        commit_code_ = commit_result::NOT_FOUND;
+        return false;
+    }
+    if (entry->item.version != expected) {
+        commit_code_ = commit_result::WRONG_VERSION;
+        return false;
+    }
+    return commit_write(key, item, written_at);
+}
+
+bool cache_storage::commit_incr(const std::string& key,
+                                int64_t delta,
+                                uint64_t version,
+                                std::time_t incremented_at,
+                                int64_t& value)
+{
+    last_commit_time_ = incremented_at;
+    auto entry = live_entry(key, incremented_at);
+    if (!entry) {
+        commit_code_ = commit_result::NOT_FOUND;
+        return false;
+    }
+
+    int64_t current = 0;
+    auto first = reinterpret_cast<const char*>(entry->item.bytes());
+    auto last = first + entry->item.data_size;
+    auto parsed = std::from_chars(first, last, current);
+    constexpr auto max = std::numeric_limits<int64_t>::max();
+    constexpr auto min = std::numeric_limits<int64_t>::min();
+    if (parsed.ec != std::errc() || parsed.ptr != last
+            || (delta > 0 && current > max - delta)
+            || (delta < 0 && current < min - delta)) {
+        commit_code_ = commit_result::NOT_A_NUMBER;
+        return false;
+    }
+    value = current + delta;
+
+    // sign and 19 digits
+    unsigned char text[20];
+    auto end = std::to_chars(reinterpret_cast<char*>(text),
+                             reinterpret_cast<char*>(text) + sizeof(text),
+                             value).ptr;
+    size_t len = end - reinterpret_cast<char*>(text);
+    if (len + key.size() > config_.max_item_size) {
+        commit_code_ = commit_result::DATA_TOO_BIG;
+        return false;
+    }
+    if (entry->item.is_inline() && len <= cache_item::INLINE_SIZE) {
+        // the chunk only holds the key, the digits go in the record
+        cache_item item = entry->item;
+        item.borrow_data(text, len);
+        item.version = version;
+        entry = own_entry(entry, item);
+        touch_entry(entry);
     } else {
-        insert_item(key, item, written_at);
+        cache_item item;
+        item.expires_at = entry->item.expires_at;
+        item.version = version;
+        item.borrow_data(text, len);
+        write_item(key, item, incremented_at);
     }
     commit_code_ = commit_result::DONE_OK;
     return true;
 }
 
-void cache_storage::commit_purge(std::time_t purged_at)
+void cache_storage::restore_item(const std::string& key,
+                                 const cache_item& item,
+                                 std::time_t restored_at)
 {
-    std::time_t next = next_purge_time(purged_at, config_.purge_interval);
-    std::time_t prev = next - config_.purge_interval;
+    // already validated by the node that took the snapshot, and kept even
+    // if expired until purged or reclaimed, like on that node
+    write_item(key, item, restored_at);
+}
 
-    auto i = expiry_buckets_.begin();
-    while (i != expiry_buckets_.end()) {
-        auto current = i++;
-        if (current->first > prev) {
-            return;
-        }
-        auto j = current->second.begin();
-        while (j != current->second.end()) {
-            auto iter = j++;
-            remove_item(**iter);
-        }
+void cache_storage::restore_into(cache_storage& target) const
+{
+    for (auto entry = lru_.back(); entry; entry = lru_list::prev(entry)) {
+        target.restore_item(std::string(entry->item.key), entry->item,
+                            last_commit_time_);
     }
 }
 
-void cache_storage::mark_as_recently_used(const std::string& key,
-                                          std::time_t when)
+void cache_storage::write_item(const std::string& key,
+                               const cache_item& item,
+                               std::time_t written_at)
 {
-    auto iter = item_map_.find(key);
-    if (iter != item_map_.end()) {
-        items_.splice(items_.begin(), items_, iter->second.item_iter);
+    last_commit_time_ = written_at;
+    // an expired item may be purged already on other nodes, count on it
+    // being gone on this one too
+    live_entry(key, written_at);
+    size_t required_memory = get_required_memory(key, item, written_at);
+    evict_lru_data(key, required_memory);
+
+    // nothing to expire, skip the ticks elapsed since the last purge
+    if (expiry_wheel_.empty()) {
+        expiry_wheel_.reset(written_at);
+    }
+
+    if (find_entry(key)) {
+        update_item(key, item, written_at);
+    } else {
+        insert_item(key, item, written_at);
     }
 }
 
-std::unique_ptr<unsigned char[]> cache_storage::read_snapshot_chunk(
-        size_t chunk_size, int& item_index, size_t& read)
+void cache_storage::commit_purge(std::time_t purged_at)
 {
-    auto result = std::make_unique<unsigned char[]>(chunk_size);
-    auto ptr = result.get();
-    read = 0;
+    last_commit_time_ = purged_at;
+    last_purge_time_ = std::max(last_purge_time_, purged_at);
+
+    // bounded so that a mass expiry does not stall the commits, the rest
+    // is left for the next purges
+    size_t limit = config_.purge_batch_size ? config_.purge_batch_size
+                                            : SIZE_MAX;
+    expiry_wheel_.advance(purged_at, limit, [this](cache_entry* entry) {
+        remove_entry(entry);
+    });
+
+    // purges are committed on a regular basis, use them to restore the
+    // headroom so that writes seldom need to evict.
+    if (available_memory() < config_.eviction_headroom) {
+        reclaim_expired(last_commit_time_);
+        evict_until(nullptr, config_.eviction_headroom);
+    }
+}
 
-    auto it = items_.begin();
-    std::advance(it, std::min(items_.size(), (size_t)item_index));
-    while (it != items_.end()) {
-        size_t size = it->size();
-        if (read + size > chunk_size) {
-            return result;
-        }
+size_t cache_storage::purge_expired(std::time_t now, size_t limit)
+{
+    last_purge_time_ = std::max(last_purge_time_, now);
+    return expiry_wheel_.advance(now, limit, [this](cache_entry* entry) {
+        remove_entry(entry);
+    });
+}
 
-        // key
-        auto key_size = it->key->size();
-        memcpy(ptr, &key_size, sizeof(key_size));
-        ptr += sizeof(key_size);
-        memcpy(ptr, it->key->data(), key_size);
-        ptr += it->key->size();
+void cache_storage::commit_touch(uint64_t hash)
+{
+    index_.for_each(hash, [this](cache_entry* entry) {
+        touch_entry(entry);
+    });
+    commit_code_ = commit_result::DONE_OK;
+}
 
-        // data
-        memcpy(ptr, &it->data_size, sizeof(it->data_size));
-        ptr += sizeof(it->data_size);
-        memcpy(ptr, it->data.get()->data(), it->data_size);
-        ptr += it->data_size;
+void cache_storage::mark_as_recently_used(const std::string& key,
+                                          std::time_t when)
+{
+    auto entry = find_entry(key);
+    if (entry) {
+        touch_entry(entry);
+    }
+}
 
-        // expiry
-        memcpy(ptr, &it->expires_at, sizeof(it->expires_at));
-        ptr += sizeof(it->expires_at);
+void cache_storage::touch_entry(cache_entry* entry)
+{
+    policy_->accessed(entry);
+    if (config_.approximate_recency) {
+        // the reference bit set by the policy is all the sweep needs
+        return;
+    }
+    lru_.move_to_front(entry);
+    auto bytes = chunk_bytes(entry->item.key.size(), entry->item.data_size);
+    if (auto list = class_lru(bytes)) {
+        list->move_to_front(entry);
+    }
+}
 
-        read += size;
-        item_index++;
-        it++;
+void cache_storage::freeze()
+{
+    if (frozen_) {
+        thaw();
     }
+    frozen_ = true;
+    frozen_entries_.clear();
+    frozen_entries_.reserve(lru_.size());
+    for (auto entry = lru_.front(); entry; entry = lru_list::next(entry)) {
+        frozen_entries_.push_back(entry);
+    }
+    // removed entries keep their chunks until thawed, let the slab go over
+    // the cache size rather than evict to make up for them
+    slab_.set_memory_limit(SIZE_MAX);
+}
 
-    item_index = -1; // done!
-    return result;
+void cache_storage::thaw()
+{
+    frozen_ = false;
+    frozen_entries_.clear();
+    frozen_entries_.shrink_to_fit();
+    for (auto entry : frozen_released_) {
+        release_entry(entry);
+    }
+    frozen_released_.clear();
+    slab_.set_memory_limit(config_.cache_size);
+}
+
+size_t cache_storage::item_count() const
+{
+    return index_.size();
+}
+
+size_t cache_storage::purge_debt() const
+{
+    return expiry_wheel_.due(last_purge_time_);
 }
 
-void cache_storage::evict_lru_data(const std::string& key, int memory_required)
+void cache_storage::evict_lru_data(const std::string& key,
+                                   size_t memory_required)
 {
-    int available_memory = config_.cache_size - used_memory_;
-    if (available_memory >= memory_required) {
+    if (available_memory() >= memory_required) {
+        return;
+    }
+    // nodes may have purged more or less of the expired items, make sure
+    // none is left so that the same live items are evicted on every node
+    reclaim_expired(last_commit_time_);
+    if (available_memory() >= memory_required) {
         return;
     }
 
-    size_t removed_memory = 0;
-    auto it = items_.rbegin();
-    while (it != items_.rend()) {
-        if (*it->key == key) {
-            it++;
-            continue;
-        }
-        size_t item_size = get_item_size(*it->key, it->data_size);
-        it = std::make_reverse_iterator(remove_item(*it->key));
-        available_memory += item_size;
-        if (available_memory >= memory_required) {
+    // evict down to the low watermark
+    size_t target = std::min(memory_required + config_.eviction_headroom,
+                             config_.cache_size);
+    evict_until(find_entry(key), target);
+}
+
+void cache_storage::evict_until(const cache_entry* pinned, size_t target)
+{
+    while (available_memory() < target) {
+        auto victim = policy_->victim(pinned);
+        if (!victim) {
             return;
         }
+        remove_entry(victim, true);
+    }
+}
+
+void cache_storage::reclaim_expired(std::time_t now)
+{
+    expiry_wheel_.advance(now, SIZE_MAX, [this](cache_entry* entry) {
+        remove_entry(entry);
+    });
+}
+
+size_t cache_storage::available_memory() const
+{
+    if (used_memory_ >= config_.cache_size) {
+        return 0;
     }
+    return config_.cache_size - used_memory_;
 }
 
 void cache_storage::clear()
 {
-    items_.clear();
-    item_map_.clear();
-    expiry_buckets_.clear();
+    if (frozen_) {
+        thaw();
+    }
+
+    // unreachable from now on, wait for the readers that found entries
+    index_.clear();
+    if (epoch_) {
+        epoch_->synchronize();
+        index_.reclaim(epoch_->safe_epoch());
+        for (auto& retired : retired_) {
+            free_retired(retired.second);
+        }
+        retired_.clear();
+    }
+
+    while (auto entry = lru_.pop_back()) {
+        free_entry(entry);
+    }
+    for (auto& list : class_lru_) {
+        list.clear();
+    }
+    policy_->clear();
+    slab_.clear();
+    expiry_wheel_.clear();
     used_memory_ = 0;
 }
 
 cache_item* cache_storage::get_item(const std::string& key, std::time_t when)
-{    
-    auto iter = item_map_.find(key);
-    if (iter != item_map_.end()) {
-        if (!iter->second.item_iter->is_expired(when)) {
-            return &(*iter->second.item_iter);
-        }
+{
+    auto entry = find_entry(key);
+    if (entry && !entry->item.is_expired(when)) {
+        return &entry->item;
     }
     return nullptr;
 }
 
-size_t cache_storage::get_item_size(const std::string& key, size_t data_size)
+size_t cache_storage::get_item_size(std::string_view key, size_t data_size)
 {
     size_t result = 0;
-    result += sizeof(cache_item);
-    result += sizeof(std::list<cache_item>::iterator);
-    result += data_size;
-    result += key.size();
+    result += sizeof(cache_entry);
+    result += cache_index::entry_overhead();
+    result += slab_allocator::chunk_size(chunk_bytes(key.size(), data_size));
     return result;
 }
 
@@ -188,143 +452,327 @@ cache_item* cache_storage::insert_item(const std::string& key,
                                        const cache_item& item,
                                        std::time_t written_at)
 {
-    // insert into items_
-    auto item_iter = items_.insert(items_.begin(), item);
-
-    // make sure expiry bucket already exist
-    auto purge_at = next_purge_time(item.expires_at, config_.purge_interval);
-    auto expiry_map_iter = expiry_buckets_.emplace_hint(
-        expiry_buckets_.end(),
-        purge_at,
-        std::move(std::list<const std::string*>()));
-    
-    // insert temporary key into expiry_buckets_
-    auto* expiry_bucket = &expiry_map_iter->second;
-    auto expiry_item_iter = expiry_bucket->insert(
-        expiry_bucket->end(), nullptr);
-
-    // insert into item_map_
-    internal_iterators iters;
-    iters.item_iter = item_iter;
-    iters.expiry_map_iter = expiry_map_iter;
-    iters.expiry_bucket_iter = expiry_item_iter;
-    auto item_map_iter = item_map_.insert({key, iters});
-
-    // update keys
-    (*expiry_item_iter) = &item_map_iter.first->first;
-    item_iter->key = &item_map_iter.first->first;
+    auto bytes = chunk_bytes(key.size(), item.data_size);
+    auto chunk = allocate_chunk(key, bytes);
+
+    auto entry = entries_.allocate();
+    entry->chunk = chunk;
+    entry->hash = key_hash(key);
+    store_item(entry, key, item);
+
+    lru_.push_front(entry);
+    if (auto list = class_lru(bytes)) {
+        list->push_front(entry);
+    }
+    expiry_wheel_.schedule(entry);
+    index_.insert(entry);
+    policy_->inserted(entry);
 
     // update used_memory_
-    size_t item_size = get_item_size(key, item_iter->data_size);
-    used_memory_ += item_size;
+    used_memory_ += get_item_size(key, item.data_size);
 
-    return &(*item_iter);
+    return &entry->item;
 }
 
 cache_item* cache_storage::update_item(const std::string& key,
                                        const cache_item& item,
                                        std::time_t written_at)
 {
-    auto item_iter = item_map_.find(key)->second.item_iter;
-    const std::string* old_key = item_iter->key;
-    std::time_t old_expiry = item_iter->expires_at;
+    auto entry = find_entry(key);
 
     // update memory used
     auto new_item_size = get_item_size(key, item.data_size);
-    auto old_item_size = get_item_size(key, item_iter->data_size);
+    auto old_item_size = get_item_size(key, entry->item.data_size);
     used_memory_ += new_item_size - old_item_size;
 
-    // update item
-    (*item_iter) = item;
-    (*item_iter).key = old_key;
-    items_.splice(items_.begin(), items_, item_iter);
-    update_item_expiry_bucket(key, old_expiry, item.expires_at);
+    auto old_bytes = chunk_bytes(key.size(), entry->item.data_size);
+    auto new_bytes = chunk_bytes(key.size(), item.data_size);
+    if (epoch_ || frozen_) {
+        // readers or the snapshot may be using the entry, swap in an
+        // updated copy
+        entry = copy_entry(entry, key, item);
+    } else {
+        // move to a chunk of the right class if the size class changed
+        auto old_class = slab_allocator::class_for(old_bytes);
+        auto new_class = slab_allocator::class_for(new_bytes);
+        if (old_class != new_class
+                || old_class == slab_allocator::HUGE_CLASS) {
+            if (auto list = class_lru(old_bytes)) {
+                list->remove(entry);
+            }
+            auto chunk = allocate_chunk(key, new_bytes);
+            slab_.release(entry->chunk, old_bytes);
+            entry->chunk = chunk;
+            if (auto list = class_lru(new_bytes)) {
+                list->push_front(entry);
+            }
+        }
+        store_item(entry, key, item);
+    }
 
-    return &(*item_iter);
+    lru_.move_to_front(entry);
+    policy_->accessed(entry);
+    if (auto list = class_lru(new_bytes)) {
+        list->move_to_front(entry);
+    }
+    expiry_wheel_.cancel(entry);
+    expiry_wheel_.schedule(entry);
+
+    return &entry->item;
 }
 
-std::list<cache_item>::iterator cache_storage::remove_item(
-        const std::string &key)
+bool cache_storage::remove_item(const std::string& key)
 {
-    auto item_map_iter = item_map_.find(key);
-    if (item_map_iter != item_map_.end()) {
-        auto iters = item_map_iter->second;
-        auto item_iter = iters.item_iter;
-        auto expiry_map_iter = iters.expiry_map_iter;
-        auto expiry_bucket_iter = iters.expiry_bucket_iter;
-        size_t size = get_item_size(*item_iter->key, item_iter->data_size);
+    auto entry = find_entry(key);
+    if (!entry) {
+        return false;
+    }
+    remove_entry(entry);
+    return true;
+}
 
-        item_iter = items_.erase(item_iter);
-        item_map_.erase(item_map_iter);
-        expiry_map_iter->second.erase(expiry_bucket_iter);
-        if (expiry_map_iter->second.size() == 0) {
-            expiry_buckets_.erase(expiry_map_iter);
-        }
+void cache_storage::remove_entry(cache_entry* entry, bool evicted)
+{
+    auto bytes = chunk_bytes(entry->item.key.size(), entry->item.data_size);
+
+    used_memory_ -= get_item_size(entry->key(), entry->item.data_size);
+    lru_.remove(entry);
+    policy_->removed(entry, evicted);
+    if (auto list = class_lru(bytes)) {
+        list->remove(entry);
+    }
+    expiry_wheel_.cancel(entry);
+    index_.erase(entry);
+    release_entry(entry);
+}
+
+cache_entry* cache_storage::copy_entry(cache_entry* entry,
+                                       const std::string& key,
+                                       const cache_item& item)
+{
+    auto old_bytes = chunk_bytes(key.size(), entry->item.data_size);
+    auto new_bytes = chunk_bytes(key.size(), item.data_size);
+
+    auto old_class = slab_allocator::class_for(old_bytes);
+    if (!frozen_ && old_class == slab_allocator::class_for(new_bytes)
+            && old_class != slab_allocator::HUGE_CLASS) {
+        // give the chunk back before taking one of the same class, as when
+        // it is written over in place without readers, so that nothing is
+        // evicted for it; readers copying out of it see the flag
+        entry->retired.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slab_.release(entry->chunk, old_bytes);
+        entry->chunk = nullptr;
+    }
+
+    auto copy = entries_.allocate();
+    copy->chunk = allocate_chunk(key, new_bytes);
+    copy->hash = entry->hash;
+    store_item(copy, key, item);
+
+    lru_.replace(entry, copy);
+    policy_->replaced(entry, copy);
+    if (auto list = class_lru(old_bytes)) {
+        list->remove(entry);
+    }
+    if (auto list = class_lru(new_bytes)) {
+        list->push_front(copy);
+    }
+    expiry_wheel_.replace(entry, copy);
+
+    // readers find the copy from now on
+    index_.replace(entry, copy);
+    release_entry(entry);
+    return copy;
+}
+
+cache_entry* cache_storage::own_entry(cache_entry* entry,
+                                      const cache_item& item)
+{
+    if (!epoch_ && !frozen_) {
+        entry->item = item;
+        return entry;
+    }
+
+    // readers or the snapshot may be using the record, swap in a copy of
+    // it taking over the chunk, which neither is changed nor freed; the
+    // copy is complete before readers can find it
+    auto bytes = chunk_bytes(entry->item.key.size(), entry->item.data_size);
+    auto copy = entries_.allocate();
+    copy->chunk = entry->chunk;
+    copy->hash = entry->hash;
+    copy->item = item;
+    entry->chunk = nullptr;
+
+    lru_.replace(entry, copy);
+    policy_->replaced(entry, copy);
+    if (auto list = class_lru(bytes)) {
+        list->replace(entry, copy);
+    }
+    expiry_wheel_.replace(entry, copy);
+
+    // readers find the copy from now on
+    index_.replace(entry, copy);
+    release_entry(entry);
+    return copy;
+}
+
+void cache_storage::release_entry(cache_entry* entry)
+{
+    if (frozen_) {
+        frozen_released_.push_back(entry);
+        return;
+    }
+    if (!epoch_) {
+        free_entry(entry);
+        return;
+    }
+
+    // readers copying out of the chunk see the flag if they may have
+    // copied what the next owner of the chunk wrote
+    entry->retired.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    // no chunk once taken over by `own_entry()`
+    if (entry->chunk
+            && !slab_.retire(entry->chunk,
+                             chunk_bytes(entry->item.key.size(),
+                                         entry->item.data_size))) {
+        entry->chunk = nullptr;
+    }
+    retired_.emplace_back(epoch_->retire_epoch(), entry);
+    if (retired_.size() >= RECLAIM_THRESHOLD) {
+        reclaim();
+    }
+}
 
-        used_memory_ -= size;
-        return item_iter;
+void cache_storage::free_entry(cache_entry* entry)
+{
+    // no chunk once taken over by `own_entry()`
+    if (entry->chunk) {
+        slab_.release(entry->chunk, chunk_bytes(entry->item.key.size(),
+                                                entry->item.data_size));
     }
-    return items_.end();
+    entries_.release(entry);
 }
 
-void cache_storage::update_item_expiry_bucket(const std::string& key,
-                                              std::time_t old_expiry,
-                                              std::time_t new_expiry)
+void cache_storage::free_retired(cache_entry* entry)
 {
-    std::time_t expiry1 = next_purge_time(old_expiry, config_.purge_interval);
-    std::time_t expiry2 = next_purge_time(new_expiry, config_.purge_interval);
+    if (entry->chunk) {
+        slab_allocator::free_huge(entry->chunk);
+        entry->chunk = nullptr;
+    }
+    entries_.release(entry);
+}
 
-    if (expiry1 == expiry2) {
+void cache_storage::reclaim()
+{
+    if (!epoch_) {
         return;
     }
+    auto safe_epoch = epoch_->safe_epoch();
+    while (!retired_.empty() && retired_.front().first < safe_epoch) {
+        auto entry = retired_.front().second;
+        retired_.pop_front();
+        free_retired(entry);
+    }
+    index_.reclaim(safe_epoch);
+}
 
-    auto item_map_iter = item_map_.find(key);
-    auto iters = item_map_iter->second;
-    auto old_expiry_map_iter = iters.expiry_map_iter;
-    auto old_expiry_bucket_iter = iters.expiry_bucket_iter;
-    auto* old_bucket = &old_expiry_map_iter->second;
+void cache_storage::store_item(cache_entry* entry,
+                               const std::string& key,
+                               const cache_item& item)
+{
+    auto chunk = entry->chunk;
+    std::memcpy(chunk, key.data(), key.size());
 
-    // make sure destination expirty bucket already exist
-    auto new_expiry_map_iter = expiry_buckets_.emplace_hint(
-        expiry_buckets_.end(),
-        expiry2,
-        std::list<const std::string*>());
-    
-    // insert into new expiry bucket and update iterators
-    auto* new_bucket = &new_expiry_map_iter->second;
-    auto new_expiry_bucket_iter = new_bucket->insert(
-        new_bucket->end(),
-        iters.item_iter->key);
-    iters.expiry_bucket_iter = new_expiry_bucket_iter;
-    iters.expiry_map_iter = new_expiry_map_iter;
-    item_map_iter->second = iters;
+    auto data = const_cast<unsigned char*>(item.bytes());
+    if (item.data_size > cache_item::INLINE_SIZE) {
+        std::memcpy(chunk + key.size(), data, item.data_size);
+        data = chunk + key.size();
+    }
+    entry->item.borrow_data(data, item.data_size);
+    entry->item.key = std::string_view(reinterpret_cast<char*>(chunk),
+                                       key.size());
+    entry->item.expires_at = item.expires_at;
+    entry->item.version = item.version;
+}
 
-    // delete previous iterators
-    old_expiry_map_iter->second.erase(old_expiry_bucket_iter);
-    if (old_expiry_map_iter->second.size() == 0) {
-        expiry_buckets_.erase(old_expiry_map_iter);
+unsigned char* cache_storage::allocate_chunk(const std::string& key,
+                                             size_t size)
+{
+    auto chunk = slab_.allocate(size, false);
+    if (!chunk) {
+        // reserve a page or evict only once the chunks of expired items are
+        // free, whether this node purged them yet or not, so that the slab
+        // classes grow alike on every node
+        reclaim_expired(last_commit_time_);
+        chunk = slab_.allocate(size);
     }
+    while (!chunk) {
+        // the class has pages, so it has entries to evict, each giving its
+        // chunk back right away whatever the readers
+        auto list = class_lru(size);
+        auto victim = list->back();
+        if (victim && victim->key() == key) {
+            victim = class_list::prev(victim);
+        }
+        if (!victim) {
+            throw std::bad_alloc();
+        }
+        remove_entry(victim, true);
+        chunk = slab_.allocate(size);
+    }
+    return chunk;
 }
 
-int cache_storage::get_required_memory(const std::string& key,
-                                       const cache_item& item,
-                                       std::time_t written_at)
+size_t cache_storage::chunk_bytes(size_t key_size, size_t data_size)
 {
-    size_t item_size = get_item_size(key, item.data_size);
-    size_t old_size = 0;
+    if (data_size > cache_item::INLINE_SIZE) {
+        return key_size + data_size;
+    }
+    return key_size;
+}
 
-    auto old_item = get_item(key, written_at);
-    if (old_item) {
-        old_size = get_item_size(key, old_item->data_size);
+class_list* cache_storage::class_lru(size_t chunk_size)
+{
+    auto slab_class = slab_allocator::class_for(chunk_size);
+    if (slab_class == slab_allocator::HUGE_CLASS) {
+        return nullptr;
     }
-    return item_size - old_size;
+    return &class_lru_[slab_class];
 }
 
-std::time_t cache_storage::next_purge_time(std::time_t current, int interval)
+cache_entry* cache_storage::find_entry(const std::string& key) const
 {
-    int remainder = current % interval;
-    int difference = interval - remainder;
-    return current + difference;
+    return index_.find(key, key_hash(key));
+}
+
+cache_entry* cache_storage::live_entry(const std::string& key,
+                                       std::time_t when)
+{
+    auto entry = find_entry(key);
+    if (entry && entry->item.is_expired(when)) {
+        remove_entry(entry);
+        entry = nullptr;
+    }
+    return entry;
+}
+
+size_t cache_storage::get_required_memory(const std::string& key,
+                                          const cache_item& item,
+                                          std::time_t written_at)
+{
+    size_t item_size = get_item_size(key, item.data_size);
+    size_t old_size = 0;
+
+    auto old_entry = find_entry(key);
+    if (old_entry) {
+        old_size = get_item_size(key, old_entry->item.data_size);
+    }
+    if (old_size >= item_size) {
+        return 0;
+    }
+    return item_size - old_size;
 }
 
 }
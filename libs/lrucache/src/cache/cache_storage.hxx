@@ -2,51 +2,76 @@
 #define LRUCACHE_CACHE_STORAGE_
 
 #include <ctime>
-#include <list>
-#include <map>
-#include <optional>
+#include <deque>
+#include <memory>
 #include <string>
-#include <unordered_map>
-#include <utility>
+#include <string_view>
 #include <vector>
 
 #include "lrucache/cache_config.hxx"
+#include "cache_entry.hxx"
+#include "cache_index.hxx"
 #include "cache_item.hxx"
+#include "entry_pool.hxx"
+#include "epoch_manager.hxx"
+#include "eviction_policy.hxx"
+#include "slab_allocator.hxx"
+#include "timing_wheel.hxx"
 
 namespace lrucache {
 
 class cache_storage {
 public:
-    cache_storage(cache_config config)
-        : config_(config)
-        , used_memory_(0) {}
+    /**
+     * @param config cache settings
+     * @param epoch when given, `read()` can be called without holding the
+     *              lock of the writer as long as the epoch is pinned.
+     *              Entries are then copied on write and released once no
+     *              reader can see them anymore.
+     */
+    cache_storage(cache_config config, epoch_manager* epoch = nullptr);
 
-    virtual ~cache_storage() {}
+    virtual ~cache_storage();
 
     enum commit_result {
         DONE_OK      = 0x0,
         NOT_FOUND    = 0x1,
         KEY_TOO_BIG  = 0x3,
         DATA_TOO_BIG = 0x4,
-        WRONG_EXPIRY = 0x5
+        WRONG_EXPIRY = 0x5,
+        WRONG_VERSION = 0x6,
+        NOT_A_NUMBER = 0x7
     };
 
     /**
      * Read cache data without changing the cache state. Reading data with
      * this method won't mark the data as most recently used.
+     *
+     * Safe to call concurrently with commits if the storage was created
+     * with an epoch_manager and the caller pinned it. The chunk of an item
+     * removed is reused right away, so data held in a chunk is copied into
+     * `buffer` and only returned if the item was still there once copied.
+     * Inline data is returned in place. Either stays valid until the epoch
+     * is unpinned, or `buffer` changes.
      * 
      * @param key key pointing to the data
+     * @param read_at time in ms the item must not have expired by, that
+     *                of the last commit rather than of this node's clock
      * @param len[out] number of bytes returned
+     * @param buffer[out] copy of the data when not inline
+     * @param version[out] version of the item read, if not nullptr
      * @result pointer to data read
      */
-    unsigned char* read(const std::string& key, size_t& len);
+    unsigned char* read(const std::string& key, std::time_t read_at,
+                        size_t& len, std::vector<unsigned char>& buffer,
+                        uint64_t* version = nullptr);
 
     /**
      * Mark data pointed by `key` as most recently used, pushing all other
      * items further down and closer to eviction.
      * 
      * @param key key pointing to the data
-     * @param read_at POSIX time at which the read commit is applied. Must be
+     * @param read_at time in ms at which the read commit is applied. Must be
      *                later than `last_commit_time_`.
      */
     virtual bool commit_read(const std::string& key, std::time_t read_at);
@@ -56,7 +81,7 @@ public:
      *
      * @param key key used to retrieve the data written.
      * @param cache_item item to write into cache
-     * @param written_at POSIX time of when the write is committed.
+     * @param written_at time in ms of when the write is committed.
      * @return true if write succeeds. If false, `get_error_code()` will
      *         indicate why.
      */
@@ -65,36 +90,180 @@ public:
                               std::time_t written_at);
 
     /**
-     * Purge all expired items from the cache.
+     * Remove the item pointed by `key`.
+     *
+     * @param key key of the item to remove
+     * @param deleted_at time in ms of when the delete is committed.
+     * @return false if there was no item, or only an expired one.
+     */
+    virtual bool commit_delete(const std::string& key, std::time_t deleted_at);
+
+    /**
+     * Change when the item pointed by `key` expires and mark it as most
+     * recently used. Its data is left where it is, and so is its version.
+     *
+     * @param key key of the item
+     * @param expires_at new expiry of the item
+     * @param touched_at time in ms of when the change is committed.
+     * @return true if the item was found. If false, `get_commit_code()`
+     *         will indicate why.
+     */
+    virtual bool commit_expire(const std::string& key,
+                               std::time_t expires_at,
+                               std::time_t touched_at);
+
+    /**
+     * Write `item` like `commit_write()`, but only over a live item whose
+     * version is `expected`.
+     *
+     * @param key key of the item
+     * @param item item to write into cache
+     * @param expected version the item must have
+     * @param written_at time in ms of when the write is committed.
+     * @return true if write succeeds. If false, `get_commit_code()` will
+     *         indicate why, WRONG_VERSION if the item changed since.
+     */
+    virtual bool commit_cas(const std::string& key,
+                            const cache_item& item,
+                            uint64_t expected,
+                            std::time_t written_at);
+
+    /**
+     * Add `delta` to the item pointed by `key`, whose data must be a
+     * signed 64 bits integer in decimal. The result is written back in
+     * decimal in place when it fits in the item, keeping its expiry.
+     *
+     * @param key key of the item
+     * @param delta amount added, negative to decrement
+     * @param version version of the item once incremented
+     * @param incremented_at time in ms of when the increment is committed.
+     * @param value[out] value of the item once incremented
+     * @return true if the item was incremented. If false,
+     *         `get_commit_code()` will indicate why, NOT_A_NUMBER if its
+     *         data is not an integer or the result overflows.
+     */
+    virtual bool commit_incr(const std::string& key,
+                             int64_t delta,
+                             uint64_t version,
+                             std::time_t incremented_at,
+                             int64_t& value);
+
+    /**
+     * Write an item read from a snapshot as the most recently used one.
+     *
+     * Unlike `commit_write()` the item is not validated, and is kept even
+     * if it already expired: it is purged like on the node that took the
+     * snapshot.
+     *
+     * @param key key of the item
+     * @param item item to write into cache
+     * @param restored_at time in ms of the last commit in the snapshot
+     */
+    void restore_item(const std::string& key,
+                      const cache_item& item,
+                      std::time_t restored_at);
+
+    /**
+     * Write the items of this storage into `target` with `restore_item()`,
+     * from the least recently used to the most recently used, so that they
+     * keep their LRU order above the items already there.
+     *
+     * @param target storage to write into
+     */
+    void restore_into(cache_storage& target) const;
+
+    /**
+     * Mark the items whose key hash is `hash` as recently used. In
+     * approximate recency mode this only sets their reference bit.
+     *
+     * @param hash key hash of the items read
+     */
+    virtual void commit_touch(uint64_t hash);
+
+    /**
+     * Purge expired items from the cache, at most `config.purge_batch_size`
+     * of them. The items left are purged first by the next purges, and are
+     * already invisible to reads.
      * 
-     * @param purge_at POSIX time of when the data is purged.
+     * @param purge_at time in ms of when the data is purged.
      */
     virtual void commit_purge(std::time_t purged_at);
 
     /**
-     * See `cache_state::read_snapshot_chunk()` for more information.
-     * 
-     * @param chunk_size max size of data returned. Must be big enough
-     *                   to contain the biggest object the cache can
-     *                   store at minimum.
-     * @param item_index[in,out]
-     *      item index from where to start reading. At the end of the
-     *      call, item_index will hold the index of the next item to
-     *      read, or -1 if all items were read.
-     * @param read[out] amount of bytes returned
-     * @return pointer to data read 
-     */
-    std::unique_ptr<unsigned char[]> read_snapshot_chunk(size_t chunk_size,
-                                                         int& item_index,
-                                                         size_t& read);
+     * Remove up to `limit` items expired by `now`, and nothing else: live
+     * items are not evicted to restore the headroom, unlike
+     * `commit_purge()`. Items expired by the last commit are neither read
+     * nor kept by the next ones, so each node may call this at its own
+     * pace, outside of the log.
+     *
+     * @param now time in ms no later than the next commit
+     * @param limit max number of items removed
+     * @return number of items removed
+     */
+    size_t purge_expired(std::time_t now, size_t limit);
+
+    /**
+     * Freeze the items currently in storage for a snapshot, in LRU order,
+     * thawing the previous ones first if still frozen.
+     *
+     * Commits, evictions and purges keep being applied while frozen, but
+     * never change nor free the entries frozen: updated entries are copied
+     * and removed entries are only released by `thaw()`. The frozen items
+     * can therefore be read by `read_snapshot_chunk()` without the lock of
+     * the writer.
+     */
+    void freeze();
+
+    /**
+     * Forget the items frozen by `freeze()` and release the ones removed
+     * since.
+     */
+    void thaw();
+
+    bool is_frozen() const { return frozen_; }
+
+    /**
+     * Number of items frozen by `freeze()`.
+     */
+    size_t frozen_count() const { return frozen_entries_.size(); }
+
+    /**
+     * Entries frozen by `freeze()`, in LRU order. Readable without the lock
+     * of the writer until `thaw()`.
+     */
+    const std::vector<const cache_entry*>& frozen_entries() const {
+        return frozen_entries_;
+    }
+
+    /**
+     * Number of items currently held in storage, expired or not.
+     */
+    size_t item_count() const;
+
+    /**
+     * Number of items that expired before the last purge but are still
+     * waiting to be purged.
+     */
+    size_t purge_debt() const;
     
     /**
      * Delete least recently used items from cache until there is at least
-     * `memory_required` amount of space available.
+     * `memory_required` amount of space available. When anything has to be
+     * evicted, `config.eviction_headroom` more bytes are freed so that the
+     * following writes fit without evicting.
+     *
+     * Only the tail of the LRU list is looked at, and the item pointed by
+     * `key` is skipped in place, so each eviction is O(1).
      * 
+     * @param key key of the item being written, never evicted
      * @param memory_required  amount of memory in bytes to make available.
      */
-    virtual void evict_lru_data(const std::string& key, int required_memory);
+    virtual void evict_lru_data(const std::string& key, size_t memory_required);
+
+    /**
+     * Amount of memory left before reaching `config.cache_size`.
+     */
+    size_t available_memory() const;
     
     /**
      * Reset the cache data. Use with caution.
@@ -111,13 +280,14 @@ public:
     virtual cache_item* get_item(const std::string& key, std::time_t when);
 
     /**
-     * Return an approximation of the memory required to store an item.
+     * Return the memory required to store an item: its cache_entry record,
+     * its share of the index and the slab chunk holding its key and data.
      * 
      * @param key key pointing to the data
      * @param data_size size of the data pointed by the key
      * @return size in bytes
      */
-    size_t get_item_size(const std::string& key, size_t data_size);
+    static size_t get_item_size(std::string_view key, size_t data_size);
 
     /**
      * Return a code indicating why the previous commit operation failed.
@@ -125,12 +295,22 @@ public:
      * @return DONE_OK: operation successfully completed.
      *         NOT_FOUND: when key isn't found in cache
      *         KEY_TOO_BIG: when size of key is bigger than config.max_key_size
-     *         DATA_TOO_BIG: when item data is bigger than config.max_item_size
+     *         DATA_TOO_BIG: when item data and key are bigger than
+     *                       config.max_item_size
      *         WRONG_EXPIRY: expiry date is before commit time
+     *         WRONG_VERSION: the item changed since the version expected
+     *         NOT_A_NUMBER: the item incremented is not an integer
      */
     commit_result get_commit_code();
 
 protected:
+    /**
+     * Write a valid item, evicting what is needed to make room for it.
+     */
+    void write_item(const std::string& key,
+                    const cache_item& item,
+                    std::time_t written_at);
+
     virtual cache_item* insert_item(const std::string& key,
                                     const cache_item& item,
                                     std::time_t written_at);
@@ -139,41 +319,168 @@ protected:
                                     const cache_item& item,
                                     std::time_t written_at);
 
-    virtual std::list<cache_item>::iterator remove_item(
-        const std::string& key);
+    virtual bool remove_item(const std::string& key);
 
-    void mark_as_recently_used(const std::string& key, std::time_t when);
+    /**
+     * Unlink an entry from every structure and give it back to the pool.
+     *
+     * @param evicted true if the entry is removed to free memory
+     */
+    void remove_entry(cache_entry* entry, bool evicted = false);
 
-    void update_item_expiry_bucket(const std::string& key,
-                                   std::time_t old_expiry,
-                                   std::time_t new_expiry);
+    /**
+     * Replace an entry by a copy holding `item`, so that concurrent
+     * readers of the entry never see it change. Unless frozen, a chunk
+     * of the same class is given back before the copy takes one, so that
+     * the copy evicts exactly what an update in place would.
+     *
+     * @return the copy
+     */
+    cache_entry* copy_entry(cache_entry* entry,
+                            const std::string& key,
+                            const cache_item& item);
 
-    int get_required_memory(const std::string& key,
-                            const cache_item& item,
-                            std::time_t written_at);
+    /**
+     * Give an entry a new record keeping its chunk: in place, or when
+     * readers or the frozen snapshot may be using it, through a copy of
+     * the record sharing its chunk that takes its place everywhere once
+     * it holds `item`, so that readers never see the record half changed.
+     *
+     * @param entry entry to change
+     * @param item new record, with the key and the data of the chunk or
+     *        inline data
+     * @return the entry holding `item`
+     */
+    cache_entry* own_entry(cache_entry* entry, const cache_item& item);
 
-    std::time_t next_purge_time(std::time_t current, int interval);
+    /**
+     * Give the chunk and the record of an unlinked entry back. While
+     * frozen, both are kept for the snapshot until thawed. Concurrent
+     * readers only delay the record: the chunk is given back right away,
+     * so that the memory available does not depend on them.
+     */
+    void release_entry(cache_entry* entry);
 
-    struct internal_iterators {
-        std::list<cache_item>::iterator
-            item_iter;
-        std::map<std::time_t, std::list<const std::string*>>::iterator
-            expiry_map_iter;
-        std::list<const std::string*>::iterator
-            expiry_bucket_iter;
-    };
+    /**
+     * Give the chunk and the record of an entry back right away.
+     */
+    void free_entry(cache_entry* entry);
+
+    /**
+     * Give back the record of an entry retired by `release_entry()`, and
+     * its huge chunk if it had one.
+     */
+    void free_retired(cache_entry* entry);
+
+    /**
+     * Release the retired entries no reader can see anymore.
+     */
+    void reclaim();
+
+    /**
+     * Copy the key and data of `item` into the slab chunk of `entry` and
+     * point `entry->item` at them.
+     */
+    void store_item(cache_entry* entry,
+                    const std::string& key,
+                    const cache_item& item);
+
+    /**
+     * Get a slab chunk of `size` bytes, evicting the least recently used
+     * entries of the matching slab class if that class is out of memory.
+     *
+     * @param key key of the item being written, never evicted
+     * @param size amount of bytes needed
+     */
+    unsigned char* allocate_chunk(const std::string& key, size_t size);
+
+    /**
+     * Number of chunk bytes needed to store an item. Data small enough to be
+     * inlined in the cache_item does not need any.
+     */
+    static size_t chunk_bytes(size_t key_size, size_t data_size);
+
+    class_list* class_lru(size_t chunk_size);
+
+    cache_entry* find_entry(const std::string& key) const;
+
+    /**
+     * Find the entry of `key` if its item has not expired at `when`. An
+     * expired one is removed on the way rather than waiting for the purge
+     * to reach it.
+     */
+    cache_entry* live_entry(const std::string& key, std::time_t when);
+
+    /**
+     * Evict least recently used entries until `target` bytes are available.
+     * Expired items must be reclaimed first, so that only live items are
+     * left to pick from.
+     *
+     * @param pinned entry never evicted, may be nullptr
+     * @param target amount of memory in bytes to make available
+     */
+    void evict_until(const cache_entry* pinned, size_t target);
+
+    /**
+     * Remove every item expired by `now`. Nodes purge expired items at
+     * their own pace, so this is done before any eviction: it leaves the
+     * live items only, the same on every node, and memory is only short
+     * when it is short on every node. The purges keep what is left to
+     * remove small.
+     *
+     * @param now time in ms of the current commit
+     */
+    void reclaim_expired(std::time_t now);
+
+    void mark_as_recently_used(const std::string& key, std::time_t when);
+
+    void touch_entry(cache_entry* entry);
+
+    size_t get_required_memory(const std::string& key,
+                               const cache_item& item,
+                               std::time_t written_at);
 
     // cache settings
     cache_config config_;
 
+    // recycled cache_entry records
+    entry_pool entries_;
+
+    // memory for keys and data that are not inlined
+    slab_allocator slab_;
+
+    // LRU order of the entries of each slab class, for evictions within a
+    // class when it runs out of chunks.
+    std::vector<class_list> class_lru_;
+
     // source of truth for keys
-    std::unordered_map<std::string, internal_iterators> item_map_;
+    cache_index index_;
 
-    // source of truth for cache_item
-    std::list<cache_item> items_;
+    // entries from most recently used to least recently used, the order
+    // in which snapshots are taken
+    lru_list lru_;
 
-    // group items by expiry date for a fast purge
-    std::map<std::time_t, std::list<const std::string*>> expiry_buckets_;
+    // chooses the entries evicted when the cache is full
+    std::unique_ptr<eviction_policy> policy_;
+
+    // pinned by readers not holding the writer lock, nullptr if none
+    epoch_manager* epoch_;
+
+    // records removed while readers may still use them, and the epoch
+    // they were retired at
+    std::deque<std::pair<uint64_t, cache_entry*>> retired_;
+
+    // true between `freeze()` and `thaw()`
+    bool frozen_;
+
+    // entries in LRU order when frozen, never modified until thawed
+    std::vector<const cache_entry*> frozen_entries_;
+
+    // entries removed while frozen, released once thawed
+    std::vector<cache_entry*> frozen_released_;
+
+    // schedules the expiry of every entry for the purges
+    timing_wheel expiry_wheel_;
 
     // amount of memory used by items in cache
     size_t used_memory_;
@@ -183,6 +490,9 @@ protected:
 
     // posix time of last commit
     std::time_t last_commit_time_;
+
+    // posix time of last purge
+    std::time_t last_purge_time_;
 };
 
 }
@@ -0,0 +1,74 @@
+#include "clock_policy.hxx"
+
+namespace lrucache {
+
+void clock_policy::inserted(cache_entry* entry)
+{
+    entry->referenced = false;
+    // right behind the hand, so that it is looked at last
+    auto behind = hand_ ? policy_list::prev(hand_) : ring_.back();
+    if (behind) {
+        ring_.insert_after(behind, entry);
+    } else {
+        ring_.push_front(entry);
+    }
+}
+
+void clock_policy::accessed(cache_entry* entry)
+{
+    entry->referenced = true;
+}
+
+void clock_policy::removed(cache_entry* entry, bool evicted)
+{
+    if (hand_ == entry) {
+        hand_ = advance(entry);
+        if (hand_ == entry) {
+            hand_ = nullptr;
+        }
+    }
+    ring_.remove(entry);
+}
+
+void clock_policy::replaced(cache_entry* entry, cache_entry* replacement)
+{
+    replacement->referenced = entry->referenced;
+    ring_.replace(entry, replacement);
+    if (hand_ == entry) {
+        hand_ = replacement;
+    }
+}
+
+cache_entry* clock_policy::victim(const cache_entry* pinned)
+{
+    if (!hand_) {
+        hand_ = ring_.front();
+    }
+    // two turns at most: the first one clears every reference bit
+    for (size_t i = 0; hand_ && i <= 2 * ring_.size(); i++) {
+        auto entry = hand_;
+        hand_ = advance(entry);
+        if (entry == pinned) {
+            continue;
+        }
+        if (!entry->referenced) {
+            return entry;
+        }
+        entry->referenced = false;
+    }
+    return nullptr;
+}
+
+void clock_policy::clear()
+{
+    ring_.clear();
+    hand_ = nullptr;
+}
+
+cache_entry* clock_policy::advance(cache_entry* entry) const
+{
+    auto next = policy_list::next(entry);
+    return next ? next : ring_.front();
+}
+
+} // namespace lrucache
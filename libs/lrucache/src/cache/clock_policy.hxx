@@ -0,0 +1,42 @@
+#ifndef LRUCACHE_CLOCK_POLICY_
+#define LRUCACHE_CLOCK_POLICY_
+
+#include "eviction_policy.hxx"
+
+namespace lrucache {
+
+/**
+ * CLOCK, an approximation of LRU where an access only sets the reference
+ * bit of the entry instead of moving it. To find a victim a hand sweeps
+ * the entries in insertion order, clearing reference bits, and stops at
+ * the first entry whose bit is already clear.
+ */
+class clock_policy : public eviction_policy {
+public:
+    clock_policy() : hand_(nullptr) {}
+
+    virtual void inserted(cache_entry* entry);
+
+    virtual void accessed(cache_entry* entry);
+
+    virtual void removed(cache_entry* entry, bool evicted);
+
+    virtual void replaced(cache_entry* entry, cache_entry* replacement);
+
+    virtual cache_entry* victim(const cache_entry* pinned);
+
+    virtual void clear();
+
+private:
+    cache_entry* advance(cache_entry* entry) const;
+
+    // entries in insertion order, the sweep wraps around at the end
+    policy_list ring_;
+
+    // next entry looked at by the sweep
+    cache_entry* hand_;
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_CLOCK_POLICY_
@@ -0,0 +1,61 @@
+#include "crc32c.hxx"
+
+#include <array>
+#include <cstring>
+
+namespace lrucache {
+
+// reflected Castagnoli polynomial
+constexpr uint32_t POLYNOMIAL = 0x82F63B78;
+
+using crc_tables = std::array<std::array<uint32_t, 256>, 8>;
+
+static crc_tables make_tables()
+{
+    crc_tables tables;
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (POLYNOMIAL & (0 - (crc & 1)));
+        }
+        tables[0][i] = crc;
+    }
+    // tables[k][i] is the crc of byte i followed by k zero bytes
+    for (size_t k = 1; k < tables.size(); k++) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = tables[k - 1][i];
+            tables[k][i] = (crc >> 8) ^ tables[0][crc & 0xFF];
+        }
+    }
+    return tables;
+}
+
+uint32_t crc32c(const void* data, size_t size, uint32_t crc)
+{
+    static const crc_tables tables = make_tables();
+    auto bytes = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes, sizeof(word));
+        // assumes a little-endian host, like the snapshot format
+        word ^= crc;
+        crc = tables[7][word & 0xFF]
+            ^ tables[6][(word >> 8) & 0xFF]
+            ^ tables[5][(word >> 16) & 0xFF]
+            ^ tables[4][(word >> 24) & 0xFF]
+            ^ tables[3][(word >> 32) & 0xFF]
+            ^ tables[2][(word >> 40) & 0xFF]
+            ^ tables[1][(word >> 48) & 0xFF]
+            ^ tables[0][word >> 56];
+        bytes += 8;
+        size -= 8;
+    }
+    while (size--) {
+        crc = (crc >> 8) ^ tables[0][(crc ^ *bytes++) & 0xFF];
+    }
+    return ~crc;
+}
+
+} // namespace lrucache
@@ -0,0 +1,23 @@
+#ifndef LRUCACHE_CRC32C_
+#define LRUCACHE_CRC32C_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace lrucache {
+
+/**
+ * CRC-32C (Castagnoli) checksum of `size` bytes, computed 8 bytes at a time
+ * with slicing tables.
+ *
+ * @param data bytes to checksum
+ * @param size number of bytes
+ * @param crc checksum of the bytes before `data`, to checksum a sequence
+ *            of buffers one after the other
+ * @return checksum of all the bytes so far
+ */
+uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0);
+
+} // namespace lrucache
+
+#endif // LRUCACHE_CRC32C_
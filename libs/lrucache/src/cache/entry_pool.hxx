@@ -0,0 +1,77 @@
+#ifndef LRUCACHE_ENTRY_POOL_
+#define LRUCACHE_ENTRY_POOL_
+
+#include <memory>
+#include <vector>
+
+#include "cache_entry.hxx"
+
+namespace lrucache {
+
+/**
+ * Recycles cache_entry records so that inserting and removing items does
+ * not hit the allocator. Records are allocated in blocks and never moved,
+ * so pointers to them stay valid until they are released.
+ *
+ */
+class entry_pool {
+public:
+    entry_pool(size_t block_size = 1024)
+        : free_(nullptr)
+        , block_size_(block_size) {}
+
+    /**
+     * Get a record from the pool, growing the pool if it is empty.
+     */
+    cache_entry* allocate() {
+        if (!free_) {
+            grow();
+        }
+        cache_entry* entry = free_;
+        free_ = entry->lru_hook.next;
+        entry->lru_hook.next = nullptr;
+        return entry;
+    }
+
+    /**
+     * Return a record to the pool. The item it holds is released.
+     */
+    void release(cache_entry* entry) {
+        entry->item = cache_item();
+        entry->chunk = nullptr;
+        entry->hash = 0;
+        entry->class_hook = list_hook<cache_entry>();
+        entry->expiry_slot = 0;
+        entry->expiry_hook = list_hook<cache_entry>();
+        entry->policy_hook = list_hook<cache_entry>();
+        entry->policy_segment = 0;
+        entry->referenced = false;
+        entry->retired.store(false, std::memory_order_relaxed);
+        entry->lru_hook.prev = nullptr;
+        entry->lru_hook.next = free_;
+        free_ = entry;
+    }
+
+private:
+    void grow() {
+        blocks_.push_back(std::make_unique<cache_entry[]>(block_size_));
+        auto block = blocks_.back().get();
+        for (size_t i = block_size_; i > 0; i--) {
+            block[i - 1].lru_hook.next = free_;
+            free_ = &block[i - 1];
+        }
+    }
+
+    // every block ever allocated
+    std::vector<std::unique_ptr<cache_entry[]>> blocks_;
+
+    // records ready to be handed out, chained through `lru_hook.next`
+    cache_entry* free_;
+
+    // number of records per block
+    size_t block_size_;
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_ENTRY_POOL_
@@ -0,0 +1,94 @@
+#include "epoch_manager.hxx"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+namespace lrucache {
+
+epoch_manager::guard::guard(epoch_manager* manager)
+    : manager_(manager)
+    , slot_(manager->acquire_slot())
+{
+}
+
+epoch_manager::guard::guard(guard&& other)
+    : manager_(other.manager_)
+    , slot_(other.slot_)
+{
+    other.manager_ = nullptr;
+}
+
+epoch_manager::guard::~guard()
+{
+    if (manager_) {
+        manager_->release_slot(slot_);
+    }
+}
+
+epoch_manager::epoch_manager()
+    : epoch_(0)
+{
+}
+
+epoch_manager::guard epoch_manager::pin()
+{
+    return guard(this);
+}
+
+uint64_t epoch_manager::retire_epoch()
+{
+    // pairs with the fence in acquire_slot(): either the reader sees the
+    // memory unlinked, or the writer sees the reader pinned
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return epoch_.load(std::memory_order_relaxed);
+}
+
+uint64_t epoch_manager::safe_epoch()
+{
+    uint64_t result = epoch_.fetch_add(1) + 1;
+    for (auto& reader : readers_) {
+        result = std::min(result, reader.epoch.load(std::memory_order_acquire));
+    }
+    return result;
+}
+
+void epoch_manager::synchronize()
+{
+    uint64_t target = epoch_.fetch_add(1) + 1;
+    while (safe_epoch() < target) {
+        std::this_thread::yield();
+    }
+}
+
+size_t epoch_manager::acquire_slot()
+{
+    // start where this thread is likely to find a free slot
+    static thread_local size_t hint =
+        std::hash<std::thread::id>()(std::this_thread::get_id());
+
+    while (true) {
+        for (size_t i = 0; i < MAX_READERS; i++) {
+            size_t slot = (hint + i) % MAX_READERS;
+            auto& reader = readers_[slot];
+            bool expected = false;
+            if (!reader.used.load(std::memory_order_relaxed)
+                    && reader.used.compare_exchange_strong(expected, true)) {
+                reader.epoch.store(epoch_.load(), std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                hint = slot;
+                return slot;
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+void epoch_manager::release_slot(size_t slot)
+{
+    auto& reader = readers_[slot];
+    reader.epoch.store(IDLE, std::memory_order_release);
+    reader.used.store(false, std::memory_order_release);
+}
+
+} // namespace lrucache
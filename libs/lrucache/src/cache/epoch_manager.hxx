@@ -0,0 +1,86 @@
+#ifndef LRUCACHE_EPOCH_MANAGER_
+#define LRUCACHE_EPOCH_MANAGER_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace lrucache {
+
+/**
+ * Epoch based reclamation, letting readers use cache entries without
+ * taking the lock of the writer that may remove them.
+ *
+ * A reader pins the current epoch for as long as it uses the memory it
+ * found. A writer that unlinks memory retires it with `retire_epoch()`
+ * instead of freeing it, and only frees it once `safe_epoch()` goes past
+ * the epoch it was retired at, meaning no reader can still see it. Writers
+ * never wait for readers, memory is just freed a bit later.
+ */
+class epoch_manager {
+public:
+    // max number of threads pinned at the same time
+    static constexpr size_t MAX_READERS = 128;
+
+    /**
+     * Keeps an epoch pinned until destroyed.
+     */
+    class guard {
+    public:
+        guard(epoch_manager* manager);
+        guard(guard&& other);
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+        ~guard();
+
+    private:
+        epoch_manager* manager_;
+        size_t slot_;
+    };
+
+    epoch_manager();
+
+    /**
+     * Pin the current epoch. Memory reachable after this call stays
+     * valid until the guard is destroyed.
+     */
+    guard pin();
+
+    /**
+     * Epoch to retire memory at. Must be called after the memory is
+     * unlinked from every structure a reader could find it through.
+     */
+    uint64_t retire_epoch();
+
+    /**
+     * Advance the epoch and get the oldest epoch still pinned. Memory
+     * retired at an epoch strictly before the result can be freed.
+     */
+    uint64_t safe_epoch();
+
+    /**
+     * Wait until every reader pinned before the call is done. Only meant
+     * for rare operations such as clearing the whole cache.
+     */
+    void synchronize();
+
+private:
+    static constexpr uint64_t IDLE = UINT64_MAX;
+
+    struct alignas(64) reader_slot {
+        std::atomic<bool> used{false};
+        std::atomic<uint64_t> epoch{IDLE};
+    };
+
+    size_t acquire_slot();
+
+    void release_slot(size_t slot);
+
+    std::atomic<uint64_t> epoch_;
+
+    reader_slot readers_[MAX_READERS];
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_EPOCH_MANAGER_
@@ -0,0 +1,34 @@
+#include "eviction_policy.hxx"
+
+#include <stdexcept>
+
+#include "arc_policy.hxx"
+#include "clock_policy.hxx"
+#include "lru_policy.hxx"
+#include "slru_policy.hxx"
+#include "tinylfu_policy.hxx"
+
+namespace lrucache {
+
+std::unique_ptr<eviction_policy> eviction_policy::create(
+        const std::string& name)
+{
+    if (name == "lru") {
+        return std::make_unique<lru_policy>();
+    }
+    if (name == "slru") {
+        return std::make_unique<slru_policy>();
+    }
+    if (name == "arc") {
+        return std::make_unique<arc_policy>();
+    }
+    if (name == "clock") {
+        return std::make_unique<clock_policy>();
+    }
+    if (name == "wtinylfu") {
+        return std::make_unique<tinylfu_policy>();
+    }
+    throw std::invalid_argument("unknown eviction policy: " + name);
+}
+
+} // namespace lrucache
@@ -0,0 +1,86 @@
+#ifndef LRUCACHE_EVICTION_POLICY_
+#define LRUCACHE_EVICTION_POLICY_
+
+#include <memory>
+#include <string>
+
+#include "cache_entry.hxx"
+
+namespace lrucache {
+
+/**
+ * Decides which entry cache_storage evicts when it runs out of memory.
+ *
+ * A policy is only told about committed operations, and must not depend
+ * on anything else such as wall clock time or addresses, so that every
+ * replica applying the same log evicts the same keys. Policies keep their
+ * state in the `policy_hook`, `policy_segment` and `referenced` fields of
+ * the entries.
+ */
+class eviction_policy {
+public:
+    virtual ~eviction_policy() {}
+
+    /**
+     * Create a policy from its name in the [cache] section of the
+     * configuration: lru, slru, arc, clock or wtinylfu.
+     *
+     * @throw std::invalid_argument if the name is unknown
+     */
+    static std::unique_ptr<eviction_policy> create(const std::string& name);
+
+    /**
+     * Called once `entry` is stored.
+     */
+    virtual void inserted(cache_entry* entry) = 0;
+
+    /**
+     * Called when `entry` is read or overwritten by a committed operation.
+     */
+    virtual void accessed(cache_entry* entry) = 0;
+
+    /**
+     * Called before `entry` is released.
+     *
+     * @param evicted true if the entry is removed to free memory, false if
+     *                it expired or was deleted.
+     */
+    virtual void removed(cache_entry* entry, bool evicted) = 0;
+
+    /**
+     * Called when `replacement`, a copy of `entry` holding new data, takes
+     * its place. `entry` is released afterwards.
+     */
+    virtual void replaced(cache_entry* entry, cache_entry* replacement) = 0;
+
+    /**
+     * Pick the next entry to evict. The policy may reorganize its lists
+     * while choosing but the entry returned must still be tracked.
+     *
+     * @param pinned entry that must not be returned, may be nullptr
+     * @return entry to evict or nullptr if there is none but `pinned`
+     */
+    virtual cache_entry* victim(const cache_entry* pinned) = 0;
+
+    /**
+     * Forget every entry.
+     */
+    virtual void clear() = 0;
+
+protected:
+    /**
+     * Least recently used entry of `list` that is not `pinned`.
+     */
+    static cache_entry* back_except(const policy_list& list,
+                                    const cache_entry* pinned) {
+        auto entry = list.back();
+        if (entry && entry == pinned) {
+            entry = policy_list::prev(entry);
+        }
+        return entry;
+    }
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_EVICTION_POLICY_
@@ -0,0 +1,78 @@
+#include "frequency_sketch.hxx"
+
+#include <algorithm>
+
+namespace lrucache {
+
+constexpr size_t MIN_WIDTH = 64;
+
+// odd constants mixing the key hash differently for each row
+constexpr uint64_t ROW_SEEDS[frequency_sketch::DEPTH] = {
+    0x9e3779b97f4a7c15ULL,
+    0xc2b2ae3d27d4eb4fULL,
+    0x165667b19e3779f9ULL,
+    0xd6e8feb86659fd93ULL
+};
+
+frequency_sketch::frequency_sketch()
+    : width_(MIN_WIDTH)
+    , additions_(0)
+    , counters_(DEPTH * MIN_WIDTH, 0)
+{
+}
+
+void frequency_sketch::ensure_capacity(size_t expected)
+{
+    if (expected <= width_) {
+        return;
+    }
+    while (width_ < expected) {
+        width_ *= 2;
+    }
+    counters_.assign(DEPTH * width_, 0);
+    additions_ = 0;
+}
+
+void frequency_sketch::increment(uint64_t hash)
+{
+    for (size_t row = 0; row < DEPTH; row++) {
+        auto& counter = counters_[index(hash, row)];
+        if (counter < MAX_COUNT) {
+            counter++;
+        }
+    }
+    if (++additions_ >= 10 * width_) {
+        halve();
+    }
+}
+
+uint8_t frequency_sketch::frequency(uint64_t hash) const
+{
+    uint8_t result = MAX_COUNT;
+    for (size_t row = 0; row < DEPTH; row++) {
+        result = std::min(result, counters_[index(hash, row)]);
+    }
+    return result;
+}
+
+void frequency_sketch::clear()
+{
+    std::fill(counters_.begin(), counters_.end(), 0);
+    additions_ = 0;
+}
+
+size_t frequency_sketch::index(uint64_t hash, size_t row) const
+{
+    uint64_t mixed = (hash ^ (hash >> 32)) * ROW_SEEDS[row];
+    return row * width_ + ((mixed >> 32) & (width_ - 1));
+}
+
+void frequency_sketch::halve()
+{
+    for (auto& counter : counters_) {
+        counter /= 2;
+    }
+    additions_ /= 2;
+}
+
+} // namespace lrucache
@@ -0,0 +1,58 @@
+#ifndef LRUCACHE_FREQUENCY_SKETCH_
+#define LRUCACHE_FREQUENCY_SKETCH_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lrucache {
+
+/**
+ * Count-min sketch estimating how often a key was seen, with 4 rows of
+ * counters saturating at 15. Once the number of increments reaches 10
+ * times the width of the sketch every counter is halved, so that old
+ * popularity fades away.
+ */
+class frequency_sketch {
+public:
+    static constexpr size_t DEPTH = 4;
+    static constexpr uint8_t MAX_COUNT = 15;
+
+    frequency_sketch();
+
+    /**
+     * Make room for about `expected` distinct keys. Counters are reset if
+     * the sketch has to grow.
+     */
+    void ensure_capacity(size_t expected);
+
+    void increment(uint64_t hash);
+
+    /**
+     * Estimated number of times `hash` was incremented since it was last
+     * halved, at most `MAX_COUNT`.
+     */
+    uint8_t frequency(uint64_t hash) const;
+
+    void clear();
+
+    size_t width() const { return width_; }
+
+private:
+    size_t index(uint64_t hash, size_t row) const;
+
+    void halve();
+
+    // number of counters per row, a power of two
+    size_t width_;
+
+    // increments since the last halving
+    size_t additions_;
+
+    // DEPTH rows of width_ counters
+    std::vector<uint8_t> counters_;
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_FREQUENCY_SKETCH_
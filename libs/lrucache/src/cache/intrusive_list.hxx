@@ -0,0 +1,151 @@
+#ifndef LRUCACHE_INTRUSIVE_LIST_
+#define LRUCACHE_INTRUSIVE_LIST_
+
+#include <cstddef>
+
+namespace lrucache {
+
+/**
+ * Links embedded in an object so that it can be part of an
+ * `intrusive_list` without any extra allocation.
+ */
+template <typename T>
+struct list_hook {
+    T* prev = nullptr;
+    T* next = nullptr;
+};
+
+/**
+ * Doubly linked list whose links live inside the elements themselves.
+ * The list never owns nor allocates its elements, an element can be part
+ * of as many lists as it has hooks.
+ *
+ * @tparam T type of the elements
+ * @tparam Hook pointer to the `list_hook` member used by this list
+ */
+template <typename T, list_hook<T> T::*Hook>
+class intrusive_list {
+public:
+    intrusive_list() : head_(nullptr), tail_(nullptr), size_(0) {}
+
+    T* front() const { return head_; }
+
+    T* back() const { return tail_; }
+
+    bool empty() const { return size_ == 0; }
+
+    size_t size() const { return size_; }
+
+    static T* next(const T* element) { return (element->*Hook).next; }
+
+    static T* prev(const T* element) { return (element->*Hook).prev; }
+
+    void push_front(T* element) {
+        auto& hook = element->*Hook;
+        hook.prev = nullptr;
+        hook.next = head_;
+        if (head_)
+            (head_->*Hook).prev = element;
+        else
+            tail_ = element;
+        head_ = element;
+        size_++;
+    }
+
+    void push_back(T* element) {
+        auto& hook = element->*Hook;
+        hook.prev = tail_;
+        hook.next = nullptr;
+        if (tail_)
+            (tail_->*Hook).next = element;
+        else
+            head_ = element;
+        tail_ = element;
+        size_++;
+    }
+
+    /**
+     * Insert `element` right after `position`, which must be in the list.
+     */
+    void insert_after(T* position, T* element) {
+        auto& hook = element->*Hook;
+        auto& position_hook = position->*Hook;
+        hook.prev = position;
+        hook.next = position_hook.next;
+        if (position_hook.next)
+            (position_hook.next->*Hook).prev = element;
+        else
+            tail_ = element;
+        position_hook.next = element;
+        size_++;
+    }
+
+    /**
+     * Unlink `element` from the list. `element` must be in the list.
+     */
+    void remove(T* element) {
+        auto& hook = element->*Hook;
+        if (hook.prev)
+            (hook.prev->*Hook).next = hook.next;
+        else
+            head_ = hook.next;
+        if (hook.next)
+            (hook.next->*Hook).prev = hook.prev;
+        else
+            tail_ = hook.prev;
+        hook.prev = nullptr;
+        hook.next = nullptr;
+        size_--;
+    }
+
+    /**
+     * Put `replacement` at the position of `element`, which must be in the
+     * list, and unlink `element`.
+     */
+    void replace(T* element, T* replacement) {
+        auto& hook = element->*Hook;
+        replacement->*Hook = hook;
+        if (hook.prev)
+            (hook.prev->*Hook).next = replacement;
+        else
+            head_ = replacement;
+        if (hook.next)
+            (hook.next->*Hook).prev = replacement;
+        else
+            tail_ = replacement;
+        hook.prev = nullptr;
+        hook.next = nullptr;
+    }
+
+    void move_to_front(T* element) {
+        if (head_ == element)
+            return;
+        remove(element);
+        push_front(element);
+    }
+
+    T* pop_back() {
+        T* element = tail_;
+        if (element)
+            remove(element);
+        return element;
+    }
+
+    /**
+     * Forget every element without touching their hooks.
+     */
+    void clear() {
+        head_ = nullptr;
+        tail_ = nullptr;
+        size_ = 0;
+    }
+
+private:
+    T* head_;
+    T* tail_;
+    size_t size_;
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_INTRUSIVE_LIST_
@@ -0,0 +1,40 @@
+#ifndef LRUCACHE_KEY_HASH_
+#define LRUCACHE_KEY_HASH_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace lrucache {
+
+/**
+ * 64 bits FNV-1a hash of a key.
+ *
+ * std::hash is not guaranteed to give the same result across builds or
+ * standard libraries, and every replica must route a key to the same
+ * shard, so the cache uses its own hash function.
+ *
+ * @param data pointer to the key bytes
+ * @param len size of the key
+ * @param hash hash of the previous bytes of the key, to hash it piece by
+ *             piece
+ * @return hash of the key
+ */
+inline uint64_t key_hash(const char* data, size_t len,
+                         uint64_t hash = 0xcbf29ce484222325ULL)
+{
+    for (size_t i = 0; i < len; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+inline uint64_t key_hash(const std::string& key)
+{
+    return key_hash(key.data(), key.size());
+}
+
+} // namespace lrucache
+
+#endif // LRUCACHE_KEY_HASH_
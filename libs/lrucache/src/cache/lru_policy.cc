@@ -0,0 +1,35 @@
+#include "lru_policy.hxx"
+
+namespace lrucache {
+
+void lru_policy::inserted(cache_entry* entry)
+{
+    entries_.push_front(entry);
+}
+
+void lru_policy::accessed(cache_entry* entry)
+{
+    entries_.move_to_front(entry);
+}
+
+void lru_policy::removed(cache_entry* entry, bool evicted)
+{
+    entries_.remove(entry);
+}
+
+void lru_policy::replaced(cache_entry* entry, cache_entry* replacement)
+{
+    entries_.replace(entry, replacement);
+}
+
+cache_entry* lru_policy::victim(const cache_entry* pinned)
+{
+    return back_except(entries_, pinned);
+}
+
+void lru_policy::clear()
+{
+    entries_.clear();
+}
+
+} // namespace lrucache
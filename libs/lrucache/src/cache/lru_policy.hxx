@@ -0,0 +1,32 @@
+#ifndef LRUCACHE_LRU_POLICY_
+#define LRUCACHE_LRU_POLICY_
+
+#include "eviction_policy.hxx"
+
+namespace lrucache {
+
+/**
+ * Strict LRU: evict the entry accessed the longest time ago.
+ */
+class lru_policy : public eviction_policy {
+public:
+    virtual void inserted(cache_entry* entry);
+
+    virtual void accessed(cache_entry* entry);
+
+    virtual void removed(cache_entry* entry, bool evicted);
+
+    virtual void replaced(cache_entry* entry, cache_entry* replacement);
+
+    virtual cache_entry* victim(const cache_entry* pinned);
+
+    virtual void clear();
+
+private:
+    // entries from most recently used to least recently used
+    policy_list entries_;
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_LRU_POLICY_
@@ -0,0 +1,51 @@
+#include "mapped_snapshot.hxx"
+
+#include <utility>
+
+namespace lrucache {
+
+mapped_snapshot::mapped_snapshot(std::shared_ptr<const snapshot_file> file)
+    : file_(std::move(file))
+    , taken_count_(file_->segment_count(), 0)
+    , folded_(new std::atomic<bool>[file_->segment_count()])
+{
+    for (size_t i = 0; i < file_->segment_count(); i++) {
+        size_t slots = file_->index_slots(i);
+        taken_.emplace_back(new std::atomic<bool>[slots]);
+        for (size_t j = 0; j < slots; j++) {
+            taken_.back()[j].store(false, std::memory_order_relaxed);
+        }
+        folded_[i].store(false, std::memory_order_relaxed);
+    }
+}
+
+bool mapped_snapshot::find(size_t segment, const std::string& key,
+                           uint64_t hash, snapshot_file::record& out) const
+{
+    if (is_folded(segment)) {
+        return false;
+    }
+    bool found = false;
+    auto& taken = taken_[segment];
+    file_->find(segment, hash, [&](size_t slot,
+                                   const snapshot_file::record& record) {
+        if (!found && record.key == key
+                && !taken[slot].load(std::memory_order_acquire)) {
+            out = record;
+            found = true;
+        }
+    });
+    return found;
+}
+
+cache_item mapped_snapshot::to_item(const snapshot_file::record& record)
+{
+    cache_item item;
+    // copied into the storage when written there
+    item.borrow_data(const_cast<unsigned char*>(record.data), record.data_size);
+    item.expires_at = record.expires_at;
+    item.version = record.version;
+    return item;
+}
+
+} // namespace lrucache
@@ -0,0 +1,141 @@
+#ifndef LRUCACHE_MAPPED_SNAPSHOT_
+#define LRUCACHE_MAPPED_SNAPSHOT_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cache_item.hxx"
+#include "key_hash.hxx"
+#include "snapshot_file.hxx"
+
+namespace lrucache {
+
+/**
+ * Items of a snapshot file served straight from its mapping, under the
+ * items of the shards, until they are folded into the shards.
+ *
+ * Each segment of the file backs the shard of the same index. An item is
+ * taken over by its shard as soon as a commit touches it, and is no longer
+ * read from the file from then on.
+ */
+class mapped_snapshot {
+public:
+    /**
+     * @param file snapshot to serve, with one segment per shard
+     */
+    explicit mapped_snapshot(std::shared_ptr<const snapshot_file> file);
+
+    const std::shared_ptr<const snapshot_file>& file() const { return file_; }
+
+    /**
+     * Look up an item that is neither taken over nor folded. Safe to call
+     * concurrently with everything else as long as the mapped snapshot is
+     * alive.
+     *
+     * @param segment segment of the key, which is the index of its shard
+     * @param key key to look up
+     * @param hash key hash of `key`
+     * @param out[out] item found
+     * @return false if there is none
+     */
+    bool find(size_t segment, const std::string& key, uint64_t hash,
+              snapshot_file::record& out) const;
+
+    /**
+     * Take over the items of `segment` that are neither taken over nor
+     * folded, whose key hash is `hash` and key is `key` unless nullptr.
+     * The lock of the shard must be held.
+     *
+     * @param fn called as `fn(key, item)` for each item taken over, the
+     *           item pointing into the mapping
+     */
+    template <typename F>
+    void take(size_t segment, uint64_t hash, const std::string* key, F fn);
+
+    /**
+     * Call `fn(key, item)` for the items of `segment` not taken over yet,
+     * least recently used first.
+     */
+    template <typename F>
+    void for_each(size_t segment, F fn) const;
+
+    /**
+     * Number of items of `segment` taken over so far. The lock of the
+     * shard must be held.
+     */
+    size_t taken(size_t segment) const { return taken_count_[segment]; }
+
+    bool is_folded(size_t segment) const {
+        return folded_[segment].load(std::memory_order_acquire);
+    }
+
+    /**
+     * Stop serving the items of `segment`, its shard holding them all.
+     * The lock of the shard must be held.
+     */
+    void set_folded(size_t segment) {
+        folded_[segment].store(true, std::memory_order_release);
+    }
+
+private:
+    static cache_item to_item(const snapshot_file::record& record);
+
+    std::shared_ptr<const snapshot_file> file_;
+
+    // per slot of the index of each segment, true once taken over
+    std::vector<std::unique_ptr<std::atomic<bool>[]>> taken_;
+    std::vector<size_t> taken_count_;
+
+    // per segment, true once folded into its shard
+    std::unique_ptr<std::atomic<bool>[]> folded_;
+};
+
+template <typename F>
+void mapped_snapshot::take(size_t segment, uint64_t hash,
+                           const std::string* key, F fn)
+{
+    if (is_folded(segment)) {
+        return;
+    }
+    auto& taken = taken_[segment];
+    file_->find(segment, hash, [&](size_t slot,
+                                   const snapshot_file::record& record) {
+        if ((key && record.key != *key)
+                || taken[slot].load(std::memory_order_relaxed)) {
+            return;
+        }
+        taken[slot].store(true, std::memory_order_release);
+        taken_count_[segment]++;
+        fn(std::string(record.key), to_item(record));
+    });
+}
+
+template <typename F>
+void mapped_snapshot::for_each(size_t segment, F fn) const
+{
+    auto& taken = taken_[segment];
+    auto data = file_->segment_data(segment);
+    auto end = data + file_->segment_size(segment);
+    snapshot_file::record record;
+    while (data < end) {
+        auto next = snapshot_file::read_record(data, end, record);
+        if (!next) {
+            return;
+        }
+        uint64_t hash = key_hash(record.key.data(), record.key.size());
+        size_t slot = file_->slot_of(segment, hash, data);
+        if (slot == file_->index_slots(segment)
+                || !taken[slot].load(std::memory_order_acquire)) {
+            fn(std::string(record.key), to_item(record));
+        }
+        data = next;
+    }
+}
+
+} // namespace lrucache
+
+#endif // LRUCACHE_MAPPED_SNAPSHOT_
@@ -0,0 +1,69 @@
+#ifndef LRUCACHE_PARALLEL_FOR_
+#define LRUCACHE_PARALLEL_FOR_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <vector>
+
+#include "ctpl/ctpl_stl.h"
+
+namespace lrucache {
+
+/**
+ * Call `fn(i)` for every `i` in [0, count) on the threads of `pool` and the
+ * calling thread, and wait until all calls return. Calls are made one after
+ * the other on the calling thread when `pool` is nullptr.
+ *
+ * The calling thread takes part, so the calls always make progress even if
+ * the pool is busy. Must not be nested on the same pool.
+ */
+template <typename F>
+void parallel_for(ctpl::thread_pool* pool, size_t count, F fn)
+{
+    if (!pool || count < 2) {
+        for (size_t i = 0; i < count; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    auto work = [&next, &fn, count]() {
+        for (size_t i; (i = next++) < count;) {
+            fn(i);
+        }
+    };
+    size_t helpers = std::min<size_t>(pool->size(), count - 1);
+    std::vector<std::future<void>> helping;
+    helping.reserve(helpers);
+    for (size_t i = 0; i < helpers; i++) {
+        helping.push_back(pool->push([&work](int) { work(); }));
+    }
+    // the helpers use this frame, wait for them whatever happens
+    std::exception_ptr error;
+    try {
+        work();
+    } catch (...) {
+        error = std::current_exception();
+        next = count;
+    }
+    for (auto& done : helping) {
+        try {
+            done.get();
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace lrucache
+
+#endif // LRUCACHE_PARALLEL_FOR_
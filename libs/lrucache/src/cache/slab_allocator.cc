@@ -0,0 +1,137 @@
+#include "slab_allocator.hxx"
+
+#include <algorithm>
+#include <cstring>
+
+namespace lrucache {
+
+constexpr size_t CHUNK_ALIGNMENT = 8;
+
+slab_allocator::slab_allocator(size_t memory_limit)
+    : memory_limit_(memory_limit)
+    , reserved_(0)
+    , classes_(class_count())
+{
+}
+
+slab_allocator::~slab_allocator()
+{
+    clear();
+}
+
+const std::vector<size_t>& slab_allocator::class_sizes()
+{
+    static const std::vector<size_t> sizes = [] {
+        std::vector<size_t> result;
+        double size = MIN_CHUNK_SIZE;
+        while (size < PAGE_SIZE / 2) {
+            size_t aligned = (static_cast<size_t>(size) + CHUNK_ALIGNMENT - 1)
+                           & ~(CHUNK_ALIGNMENT - 1);
+            if (result.empty() || aligned > result.back()) {
+                result.push_back(aligned);
+            }
+            size *= GROWTH_FACTOR;
+        }
+        result.push_back(PAGE_SIZE);
+        return result;
+    }();
+    return sizes;
+}
+
+uint8_t slab_allocator::class_for(size_t size)
+{
+    const auto& sizes = class_sizes();
+    auto iter = std::lower_bound(sizes.begin(), sizes.end(), size);
+    if (iter == sizes.end()) {
+        return HUGE_CLASS;
+    }
+    return static_cast<uint8_t>(iter - sizes.begin());
+}
+
+size_t slab_allocator::chunk_size(size_t size)
+{
+    auto slab_class = class_for(size);
+    if (slab_class == HUGE_CLASS) {
+        return size;
+    }
+    return class_sizes()[slab_class];
+}
+
+size_t slab_allocator::class_count()
+{
+    return class_sizes().size();
+}
+
+unsigned char* slab_allocator::allocate(size_t size, bool reserve)
+{
+    auto slab_class = class_for(size);
+    if (slab_class == HUGE_CLASS) {
+        reserved_ += size;
+        return new unsigned char[size];
+    }
+
+    auto& cls = classes_[slab_class];
+    if (cls.free_list) {
+        auto chunk = cls.free_list;
+        std::memcpy(&cls.free_list, chunk, sizeof(cls.free_list));
+        return chunk;
+    }
+
+    if (cls.unused_chunks == 0
+            && (!reserve || !reserve_page(slab_class))) {
+        return nullptr;
+    }
+    auto chunk = cls.unused;
+    cls.unused += class_sizes()[slab_class];
+    cls.unused_chunks--;
+    return chunk;
+}
+
+void slab_allocator::release(unsigned char* chunk, size_t size)
+{
+    auto slab_class = class_for(size);
+    if (slab_class == HUGE_CLASS) {
+        reserved_ -= size;
+        delete[] chunk;
+        return;
+    }
+
+    auto& cls = classes_[slab_class];
+    std::memcpy(chunk, &cls.free_list, sizeof(cls.free_list));
+    cls.free_list = chunk;
+}
+
+bool slab_allocator::retire(unsigned char* chunk, size_t size)
+{
+    if (class_for(size) == HUGE_CLASS) {
+        reserved_ -= size;
+        return true;
+    }
+    release(chunk, size);
+    return false;
+}
+
+void slab_allocator::clear()
+{
+    pages_.clear();
+    classes_.assign(class_count(), size_class());
+    reserved_ = 0;
+}
+
+bool slab_allocator::reserve_page(uint8_t slab_class)
+{
+    auto& cls = classes_[slab_class];
+    if (cls.pages > 0 && reserved_ + PAGE_SIZE > memory_limit_) {
+        return false;
+    }
+
+    pages_.push_back(std::unique_ptr<unsigned char[]>(
+        new unsigned char[PAGE_SIZE]));
+    reserved_ += PAGE_SIZE;
+    cls.pages++;
+    cls.unused = pages_.back().get();
+    cls.unused_chunks = PAGE_SIZE / class_sizes()[slab_class];
+    return true;
+}
+
+} // namespace lrucache
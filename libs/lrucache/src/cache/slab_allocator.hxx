@@ -0,0 +1,142 @@
+#ifndef LRUCACHE_SLAB_ALLOCATOR_
+#define LRUCACHE_SLAB_ALLOCATOR_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace lrucache {
+
+/**
+ * Memcached style slab allocator used for the keys and values stored in
+ * cache_storage.
+ *
+ * Memory is reserved from the system in pages of `PAGE_SIZE` bytes. Each
+ * page is given to one size class and cut into chunks of that class size.
+ * Class sizes start at `MIN_CHUNK_SIZE` and grow by `GROWTH_FACTOR`, so a
+ * chunk wastes at most 20% of its size. Released chunks go back to the free
+ * list of their class and pages are never given back until `clear()`, which
+ * keeps the process footprint at the amount of memory reserved instead of
+ * whatever fragmentation the system allocator ends up with.
+ *
+ * Requests bigger than the biggest class are served by the system allocator
+ * and use the `HUGE_CLASS` class.
+ */
+class slab_allocator {
+public:
+    static constexpr size_t PAGE_SIZE = 1024 * 1024;
+    static constexpr size_t MIN_CHUNK_SIZE = 32;
+    static constexpr double GROWTH_FACTOR = 1.25;
+    static constexpr uint8_t HUGE_CLASS = 0xff;
+
+    /**
+     * @param memory_limit max amount of memory reserved for pages. Like
+     *                     memcached, a class can always get its first page
+     *                     even if it goes over the limit.
+     */
+    slab_allocator(size_t memory_limit);
+
+    slab_allocator(const slab_allocator&) = delete;
+    slab_allocator& operator=(const slab_allocator&) = delete;
+
+    ~slab_allocator();
+
+    /**
+     * Get the smallest class able to hold `size` bytes.
+     */
+    static uint8_t class_for(size_t size);
+
+    /**
+     * Get the memory actually used to store `size` bytes, that is the size
+     * of the chunks of the matching class.
+     */
+    static size_t chunk_size(size_t size);
+
+    /**
+     * Number of size classes, `HUGE_CLASS` excluded.
+     */
+    static size_t class_count();
+
+    /**
+     * Get a chunk able to hold `size` bytes.
+     *
+     * @param size amount of bytes needed
+     * @param reserve reserve a page when the class has no free chunk left
+     * @return chunk of memory, or nullptr if the class has no free chunk
+     *         left and no page can be reserved without going over the
+     *         memory limit. Freeing a chunk of the same class is then the
+     *         only way to get one.
+     */
+    unsigned char* allocate(size_t size, bool reserve = true);
+
+    /**
+     * Give a chunk back to its class.
+     *
+     * @param chunk chunk returned by `allocate()`
+     * @param size size given to `allocate()`
+     */
+    void release(unsigned char* chunk, size_t size);
+
+    /**
+     * Give a chunk back like `release()` while readers may still look at
+     * it. Chunks of the size classes can be handed out again right away,
+     * their pages staying reserved. The memory of a `HUGE_CLASS` chunk is
+     * no longer counted as reserved, but is only freed by `free_huge()`.
+     *
+     * @param chunk chunk returned by `allocate()`
+     * @param size size given to `allocate()`
+     * @return true if the chunk is a huge one, to give to `free_huge()`
+     *         once no reader can look at it anymore
+     */
+    bool retire(unsigned char* chunk, size_t size);
+
+    /**
+     * Free the memory of a huge chunk given to `retire()`.
+     */
+    static void free_huge(unsigned char* chunk) { delete[] chunk; }
+
+    /**
+     * Release every page. All chunks become invalid.
+     */
+    void clear();
+
+    /**
+     * Change the max amount of memory reserved for pages. Pages already
+     * reserved are kept.
+     */
+    void set_memory_limit(size_t memory_limit) { memory_limit_ = memory_limit; }
+
+    /**
+     * Amount of memory reserved from the system.
+     */
+    size_t reserved_memory() const { return reserved_; }
+
+private:
+    struct size_class {
+        // released chunks, chained through their first bytes
+        unsigned char* free_list = nullptr;
+        // part of the last page never handed out yet
+        unsigned char* unused = nullptr;
+        size_t unused_chunks = 0;
+        size_t pages = 0;
+    };
+
+    static const std::vector<size_t>& class_sizes();
+
+    bool reserve_page(uint8_t slab_class);
+
+    // max amount of memory reserved for pages
+    size_t memory_limit_;
+
+    // memory currently reserved, pages and huge chunks
+    size_t reserved_;
+
+    std::vector<size_class> classes_;
+
+    std::vector<std::unique_ptr<unsigned char[]>> pages_;
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_SLAB_ALLOCATOR_
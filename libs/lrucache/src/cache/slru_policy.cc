@@ -0,0 +1,79 @@
+#include "slru_policy.hxx"
+
+namespace lrucache {
+
+slru_policy::slru_policy(size_t protected_percent)
+    : protected_percent_(protected_percent)
+{
+}
+
+void slru_policy::inserted(cache_entry* entry)
+{
+    entry->policy_segment = PROBATION;
+    probation_.push_front(entry);
+}
+
+void slru_policy::inserted_protected(cache_entry* entry)
+{
+    entry->policy_segment = PROTECTED;
+    protected_.push_front(entry);
+}
+
+void slru_policy::accessed(cache_entry* entry)
+{
+    if (entry->policy_segment == PROTECTED) {
+        protected_.move_to_front(entry);
+        return;
+    }
+    probation_.remove(entry);
+    inserted_protected(entry);
+}
+
+void slru_policy::removed(cache_entry* entry, bool evicted)
+{
+    if (entry->policy_segment == PROTECTED) {
+        protected_.remove(entry);
+    } else {
+        probation_.remove(entry);
+    }
+}
+
+void slru_policy::replaced(cache_entry* entry, cache_entry* replacement)
+{
+    replacement->policy_segment = entry->policy_segment;
+    if (entry->policy_segment == PROTECTED) {
+        protected_.replace(entry, replacement);
+    } else {
+        probation_.replace(entry, replacement);
+    }
+}
+
+cache_entry* slru_policy::victim(const cache_entry* pinned)
+{
+    // the cache is full, the protected segment is limited to its share
+    demote_overflow();
+
+    auto entry = back_except(probation_, pinned);
+    if (!entry) {
+        entry = back_except(protected_, pinned);
+    }
+    return entry;
+}
+
+void slru_policy::clear()
+{
+    probation_.clear();
+    protected_.clear();
+}
+
+void slru_policy::demote_overflow()
+{
+    size_t capacity = size() * protected_percent_ / 100;
+    while (protected_.size() > capacity && protected_.size() > 1) {
+        auto entry = protected_.pop_back();
+        entry->policy_segment = PROBATION;
+        probation_.push_front(entry);
+    }
+}
+
+} // namespace lrucache
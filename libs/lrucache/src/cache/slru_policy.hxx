@@ -0,0 +1,63 @@
+#ifndef LRUCACHE_SLRU_POLICY_
+#define LRUCACHE_SLRU_POLICY_
+
+#include "eviction_policy.hxx"
+
+namespace lrucache {
+
+/**
+ * Segmented LRU. New entries start in a probation segment and move to a
+ * protected segment when accessed again, so a scan of keys read only once
+ * cannot flush the entries that are used repeatedly. Victims are taken
+ * from probation first. When a victim is needed and the protected segment
+ * is over its share of the entries, its least recently used entries go
+ * back to probation first.
+ */
+class slru_policy : public eviction_policy {
+public:
+    /**
+     * @param protected_percent share of the entries the protected segment
+     *                          can hold
+     */
+    slru_policy(size_t protected_percent = 80);
+
+    virtual void inserted(cache_entry* entry);
+
+    virtual void accessed(cache_entry* entry);
+
+    virtual void removed(cache_entry* entry, bool evicted);
+
+    virtual void replaced(cache_entry* entry, cache_entry* replacement);
+
+    virtual cache_entry* victim(const cache_entry* pinned);
+
+    virtual void clear();
+
+    /**
+     * Same as `inserted()` but into the protected segment, for entries
+     * known to be popular.
+     */
+    void inserted_protected(cache_entry* entry);
+
+    size_t size() const { return probation_.size() + protected_.size(); }
+
+    enum segment : uint8_t {
+        PROBATION = 1,
+        PROTECTED = 2
+    };
+
+private:
+    void demote_overflow();
+
+    size_t protected_percent_;
+
+    // entries seen once, most recently used first
+    policy_list probation_;
+
+    // entries seen more than once, most recently used first
+    policy_list protected_;
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_SLRU_POLICY_
@@ -0,0 +1,234 @@
+#include "snapshot_codec.hxx"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifdef LRUCACHE_WITH_LZ4
+#include <lz4.h>
+#endif
+#ifdef LRUCACHE_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "crc32c.hxx"
+
+namespace lrucache {
+
+// offsets of the header fields
+constexpr size_t MAGIC_OFFSET = 0;
+constexpr size_t VERSION_OFFSET = 4;
+constexpr size_t COMPRESSION_OFFSET = 5;
+constexpr size_t CHUNK_SIZE_OFFSET = 8;
+constexpr size_t PAYLOAD_SIZE_OFFSET = 12;
+constexpr size_t CRC_OFFSET = 16;
+
+snapshot_codec::snapshot_codec(snapshot_compression compression, int level)
+    : compression_(compression)
+    , level_(level)
+{
+}
+
+snapshot_compression snapshot_codec::parse(const std::string& name)
+{
+    snapshot_compression compression;
+    if (name == "none") {
+        compression = snapshot_compression::NONE;
+    } else if (name == "lz4") {
+        compression = snapshot_compression::LZ4;
+    } else if (name == "zstd") {
+        compression = snapshot_compression::ZSTD;
+    } else {
+        throw std::invalid_argument("unknown snapshot compression: " + name);
+    }
+    if (!is_available(compression)) {
+        throw std::invalid_argument("snapshot compression not built in: "
+                                    + name);
+    }
+    return compression;
+}
+
+bool snapshot_codec::is_available(snapshot_compression compression)
+{
+    switch (compression) {
+        case snapshot_compression::NONE:
+            return true;
+        case snapshot_compression::LZ4:
+#ifdef LRUCACHE_WITH_LZ4
+            return true;
+#else
+            return false;
+#endif
+        case snapshot_compression::ZSTD:
+#ifdef LRUCACHE_WITH_ZSTD
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+void snapshot_codec::encode(const std::vector<iovec>& iov,
+                            std::vector<unsigned char>& frame) const
+{
+    if (compression_ != snapshot_compression::NONE) {
+        // compressors need the chunk in one piece
+        thread_local std::vector<unsigned char> chunk;
+        chunk.clear();
+        for (auto& buffer : iov) {
+            auto base = static_cast<const unsigned char*>(buffer.iov_base);
+            chunk.insert(chunk.end(), base, base + buffer.iov_len);
+        }
+        encode(chunk.data(), chunk.size(), frame);
+        return;
+    }
+
+    size_t size = 0;
+    for (auto& buffer : iov) {
+        size += buffer.iov_len;
+    }
+    write_header(frame, snapshot_compression::NONE, size);
+    frame.reserve(HEADER_SIZE + size);
+    for (auto& buffer : iov) {
+        auto base = static_cast<const unsigned char*>(buffer.iov_base);
+        frame.insert(frame.end(), base, base + buffer.iov_len);
+    }
+    seal(frame);
+}
+
+void snapshot_codec::encode(const unsigned char* data,
+                            size_t size,
+                            std::vector<unsigned char>& frame) const
+{
+    write_header(frame, compression_, size);
+    if (compress(data, size, frame) == snapshot_compression::NONE) {
+        frame[COMPRESSION_OFFSET] =
+            static_cast<uint8_t>(snapshot_compression::NONE);
+        frame.insert(frame.end(), data, data + size);
+    }
+    seal(frame);
+}
+
+snapshot_compression snapshot_codec::compress(
+        const unsigned char* data,
+        size_t size,
+        std::vector<unsigned char>& frame) const
+{
+    switch (compression_) {
+#ifdef LRUCACHE_WITH_LZ4
+        case snapshot_compression::LZ4: {
+            int bound = LZ4_compressBound(static_cast<int>(size));
+            frame.resize(HEADER_SIZE + bound);
+            int compressed = LZ4_compress_fast(
+                reinterpret_cast<const char*>(data),
+                reinterpret_cast<char*>(frame.data() + HEADER_SIZE),
+                static_cast<int>(size), bound, level_ > 0 ? level_ : 1);
+            if (compressed > 0 && static_cast<size_t>(compressed) < size) {
+                frame.resize(HEADER_SIZE + compressed);
+                return snapshot_compression::LZ4;
+            }
+            break;
+        }
+#endif
+#ifdef LRUCACHE_WITH_ZSTD
+        case snapshot_compression::ZSTD: {
+            size_t bound = ZSTD_compressBound(size);
+            frame.resize(HEADER_SIZE + bound);
+            size_t compressed = ZSTD_compress(
+                frame.data() + HEADER_SIZE, bound, data, size,
+                level_ ? level_ : ZSTD_CLEVEL_DEFAULT);
+            if (!ZSTD_isError(compressed) && compressed < size) {
+                frame.resize(HEADER_SIZE + compressed);
+                return snapshot_compression::ZSTD;
+            }
+            break;
+        }
+#endif
+        default:
+            break;
+    }
+    frame.resize(HEADER_SIZE);
+    return snapshot_compression::NONE;
+}
+
+bool snapshot_codec::decode(const unsigned char* frame,
+                            size_t size,
+                            std::vector<unsigned char>& chunk)
+{
+    if (size < HEADER_SIZE) {
+        return false;
+    }
+
+    uint32_t magic, chunk_size, payload_size, crc;
+    std::memcpy(&magic, frame + MAGIC_OFFSET, sizeof(magic));
+    std::memcpy(&chunk_size, frame + CHUNK_SIZE_OFFSET, sizeof(chunk_size));
+    std::memcpy(&payload_size, frame + PAYLOAD_SIZE_OFFSET,
+                sizeof(payload_size));
+    std::memcpy(&crc, frame + CRC_OFFSET, sizeof(crc));
+    if (magic != MAGIC
+            || frame[VERSION_OFFSET] != VERSION
+            || payload_size != size - HEADER_SIZE) {
+        return false;
+    }
+
+    const unsigned char* payload = frame + HEADER_SIZE;
+    if (crc32c(payload, payload_size, crc32c(frame, CRC_OFFSET)) != crc) {
+        return false;
+    }
+
+    switch (static_cast<snapshot_compression>(frame[COMPRESSION_OFFSET])) {
+        case snapshot_compression::NONE:
+            if (payload_size != chunk_size) {
+                return false;
+            }
+            chunk.assign(payload, payload + payload_size);
+            return true;
+#ifdef LRUCACHE_WITH_LZ4
+        case snapshot_compression::LZ4: {
+            chunk.resize(chunk_size);
+            int decompressed = LZ4_decompress_safe(
+                reinterpret_cast<const char*>(payload),
+                reinterpret_cast<char*>(chunk.data()),
+                static_cast<int>(payload_size),
+                static_cast<int>(chunk_size));
+            return decompressed >= 0
+                && static_cast<uint32_t>(decompressed) == chunk_size;
+        }
+#endif
+#ifdef LRUCACHE_WITH_ZSTD
+        case snapshot_compression::ZSTD: {
+            chunk.resize(chunk_size);
+            size_t decompressed = ZSTD_decompress(chunk.data(), chunk_size,
+                                                  payload, payload_size);
+            return !ZSTD_isError(decompressed) && decompressed == chunk_size;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+void snapshot_codec::write_header(std::vector<unsigned char>& frame,
+                                  snapshot_compression compression,
+                                  size_t chunk_size)
+{
+    frame.assign(HEADER_SIZE, 0);
+    uint32_t magic = MAGIC;
+    uint32_t size = static_cast<uint32_t>(chunk_size);
+    std::memcpy(frame.data() + MAGIC_OFFSET, &magic, sizeof(magic));
+    frame[VERSION_OFFSET] = VERSION;
+    frame[COMPRESSION_OFFSET] = static_cast<uint8_t>(compression);
+    std::memcpy(frame.data() + CHUNK_SIZE_OFFSET, &size, sizeof(size));
+}
+
+void snapshot_codec::seal(std::vector<unsigned char>& frame)
+{
+    uint32_t payload_size = static_cast<uint32_t>(frame.size() - HEADER_SIZE);
+    std::memcpy(frame.data() + PAYLOAD_SIZE_OFFSET, &payload_size,
+                sizeof(payload_size));
+    uint32_t crc = crc32c(frame.data() + HEADER_SIZE, payload_size,
+                          crc32c(frame.data(), CRC_OFFSET));
+    std::memcpy(frame.data() + CRC_OFFSET, &crc, sizeof(crc));
+}
+
+} // namespace lrucache
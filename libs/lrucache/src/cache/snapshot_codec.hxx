@@ -0,0 +1,108 @@
+#ifndef LRUCACHE_SNAPSHOT_CODEC_
+#define LRUCACHE_SNAPSHOT_CODEC_
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lrucache {
+
+enum class snapshot_compression : uint8_t {
+    NONE = 0x0,
+    LZ4  = 0x1,
+    ZSTD = 0x2
+};
+
+/**
+ * Encodes snapshot chunks into independent, checksummed frames, optionally
+ * compressed, and decodes them back.
+ *
+ * Each frame only depends on its own chunk, so frames can be encoded in
+ * parallel and decoded as they arrive. A frame is laid out as:
+ *
+ *  <magic>  <version>  <compression>  <reserved>  <chunk size>  <payload size>  <crc32c>  <payload>
+ *  4 bytes   1 byte       1 byte       2 bytes      4 bytes        4 bytes      4 bytes
+ *
+ * The checksum covers the first 16 bytes of the header and the payload,
+ * which is the chunk compressed as told by <compression>. LZ4 and Zstd are
+ * only available when built with LRUCACHE_WITH_LZ4 and LRUCACHE_WITH_ZSTD.
+ */
+class snapshot_codec {
+public:
+    static constexpr uint32_t MAGIC = 0x5343524C; // "LRCS"
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 20;
+
+    /**
+     * @param compression compression of the frames encoded, must be
+     *                    available
+     * @param level compression level, 0 for the default of the codec
+     */
+    snapshot_codec(snapshot_compression compression = snapshot_compression::NONE,
+                   int level = 0);
+
+    /**
+     * Get a compression from its name in the [raft] section of the
+     * configuration: none, lz4 or zstd.
+     *
+     * @throw std::invalid_argument if the name is unknown or the
+     *        compression was not built in
+     */
+    static snapshot_compression parse(const std::string& name);
+
+    static bool is_available(snapshot_compression compression);
+
+    snapshot_compression compression() const { return compression_; }
+
+    /**
+     * Encode a chunk into a frame. Chunks left bigger by compression are
+     * stored as is. Safe to call from several threads at once.
+     *
+     * @param iov buffers of the chunk, such as the ones returned by
+     *            `snapshot_cursor::next()`. Must add up to less than 4 GB.
+     * @param frame[out] replaced by the frame
+     */
+    void encode(const std::vector<iovec>& iov,
+                std::vector<unsigned char>& frame) const;
+
+    void encode(const unsigned char* data,
+                size_t size,
+                std::vector<unsigned char>& frame) const;
+
+    /**
+     * Check a frame and decode its chunk, whatever its compression.
+     *
+     * @param frame frame to decode
+     * @param size size of the frame
+     * @param chunk[out] replaced by the chunk
+     * @return false if the frame is truncated, corrupt, of another version
+     *         or compressed with a codec that was not built in
+     */
+    static bool decode(const unsigned char* frame,
+                       size_t size,
+                       std::vector<unsigned char>& chunk);
+
+private:
+    // compress `size` bytes after the header of `frame`, and return the
+    // compression actually used
+    snapshot_compression compress(const unsigned char* data,
+                                  size_t size,
+                                  std::vector<unsigned char>& frame) const;
+
+    static void write_header(std::vector<unsigned char>& frame,
+                             snapshot_compression compression,
+                             size_t chunk_size);
+
+    // fill in the payload size and the checksum once the payload is written
+    static void seal(std::vector<unsigned char>& frame);
+
+    snapshot_compression compression_;
+    int level_;
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_SNAPSHOT_CODEC_
@@ -0,0 +1,164 @@
+#include "snapshot_cursor.hxx"
+
+#include <cstring>
+#include <utility>
+
+namespace lrucache {
+
+snapshot_cursor::snapshot_cursor(
+        std::vector<const std::vector<const cache_entry*>*> parts,
+        bool oldest_first)
+    : parts_(std::move(parts))
+    , oldest_first_(oldest_first)
+    , part_(0)
+    , index_(0)
+    , position_(0)
+{
+    settle();
+}
+
+snapshot_cursor::snapshot_cursor(
+        std::vector<std::pair<const unsigned char*, size_t>> segments)
+    : segments_(std::move(segments))
+    , oldest_first_(true)
+    , part_(0)
+    , index_(0)
+    , position_(0)
+{
+    settle();
+}
+
+/**
+ * Size of the laid out item at `data`, or 0 if it is truncated.
+ */
+static size_t laid_out_size(const unsigned char* data, size_t left)
+{
+    size_t key_size = 0;
+    size_t data_size = 0;
+    size_t fixed = 4 * sizeof(size_t);
+    if (left < fixed) {
+        return 0;
+    }
+    std::memcpy(&key_size, data, sizeof(size_t));
+    if (key_size > left - fixed) {
+        return 0;
+    }
+    std::memcpy(&data_size, data + sizeof(size_t) + key_size, sizeof(size_t));
+    if (data_size > left - fixed - key_size) {
+        return 0;
+    }
+    return fixed + key_size + data_size;
+}
+
+size_t snapshot_cursor::next(size_t max_bytes, std::vector<iovec>& iov)
+{
+    if (!segments_.empty()) {
+        return next_laid_out(max_bytes, iov);
+    }
+
+    iov.clear();
+    key_sizes_.clear();
+    size_t read = 0;
+
+    while (!done()) {
+        auto& part = *parts_[part_];
+        auto& item = part[oldest_first_ ? part.size() - 1 - index_ : index_]
+                         ->item;
+        size_t size = item.size();
+        if (read + size > max_bytes) {
+            break;
+        }
+
+        key_sizes_.push_back(item.key.size());
+        auto add = [&iov](const void* base, size_t len) {
+            iov.push_back({ const_cast<void*>(base), len });
+        };
+        add(&key_sizes_.back(), sizeof(size_t));
+        add(item.key.data(), item.key.size());
+        add(&item.data_size, sizeof(item.data_size));
+        if (item.data_size) {
+            add(item.bytes(), item.data_size);
+        }
+        add(&item.expires_at, sizeof(item.expires_at));
+        add(&item.version, sizeof(item.version));
+
+        read += size;
+        position_++;
+        index_++;
+        settle();
+    }
+    return read;
+}
+
+size_t snapshot_cursor::next_laid_out(size_t max_bytes,
+                                      std::vector<iovec>& iov)
+{
+    iov.clear();
+    size_t read = 0;
+
+    while (!done() && read < max_bytes) {
+        auto& segment = segments_[part_];
+        size_t begin = index_;
+        // whole items only, a truncated one ends the segment
+        while (index_ < segment.second) {
+            size_t size = laid_out_size(segment.first + index_,
+                                        segment.second - index_);
+            if (size == 0) {
+                index_ = segment.second;
+                break;
+            }
+            if (read + size > max_bytes) {
+                break;
+            }
+            read += size;
+            index_ += size;
+            position_++;
+        }
+        if (index_ > begin) {
+            iov.push_back({ const_cast<unsigned char*>(segment.first + begin),
+                            index_ - begin });
+        }
+        if (index_ < segment.second) {
+            break;
+        }
+        settle();
+    }
+    return read;
+}
+
+void snapshot_cursor::seek(size_t index)
+{
+    part_ = 0;
+    index_ = index;
+    position_ = index;
+    if (!segments_.empty()) {
+        // items have different sizes, walk to the one asked for
+        index_ = 0;
+        position_ = 0;
+        settle();
+        while (!done() && position_ < index) {
+            auto& segment = segments_[part_];
+            size_t size = laid_out_size(segment.first + index_,
+                                        segment.second - index_);
+            index_ = size ? index_ + size : segment.second;
+            position_ += size ? 1 : 0;
+            settle();
+        }
+        return;
+    }
+    settle();
+}
+
+void snapshot_cursor::settle()
+{
+    while (part_ < parts_.size() && index_ >= parts_[part_]->size()) {
+        index_ -= parts_[part_]->size();
+        part_++;
+    }
+    while (part_ < segments_.size() && index_ >= segments_[part_].second) {
+        index_ = 0;
+        part_++;
+    }
+}
+
+} // namespace lrucache
@@ -0,0 +1,103 @@
+#ifndef LRUCACHE_SNAPSHOT_CURSOR_
+#define LRUCACHE_SNAPSHOT_CURSOR_
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "cache_entry.hxx"
+
+namespace lrucache {
+
+/**
+ * Position in the items frozen for a snapshot, read chunk after chunk.
+ *
+ * Each chunk is returned as scatter-gather buffers pointing straight at
+ * the keys, data, expiries and versions of the frozen entries, ready for
+ * `writev()`, so nothing is copied. Each item is laid out as:
+ *
+ *  <key size>  <key data>  <data size>    <data>     <expiry>  <version>
+ *   8 bytes    key_size     8 bytes    data_size   8 bytes   8 bytes
+ *
+ * Every call resumes where the previous one stopped in O(1).
+ */
+class snapshot_cursor {
+public:
+    snapshot_cursor()
+        : oldest_first_(false), part_(0), index_(0), position_(0) {}
+
+    /**
+     * @param parts frozen entries of each shard, read one after the other.
+     *              They must outlive the cursor.
+     * @param oldest_first read the entries of each part from the last one
+     *                     to the first one
+     */
+    snapshot_cursor(std::vector<const std::vector<const cache_entry*>*> parts,
+                    bool oldest_first = false);
+
+    /**
+     * @param segments items already laid out as above, such as the
+     *                 segments of a snapshot file, read one after the
+     *                 other. They must outlive the cursor.
+     */
+    explicit snapshot_cursor(
+        std::vector<std::pair<const unsigned char*, size_t>> segments);
+
+    /**
+     * Describe the next items that fit in `max_bytes`.
+     *
+     * The buffers stay valid until the next call or until the snapshot
+     * ends, whichever comes first.
+     *
+     * @param max_bytes max size of the chunk. Must be big enough to contain
+     *                  the biggest item the cache can store.
+     * @param iov[out] buffers to send in order, replaced on each call
+     * @return number of bytes described by `iov`
+     */
+    size_t next(size_t max_bytes, std::vector<iovec>& iov);
+
+    /**
+     * Move the cursor to the `index`th item, in O(number of shards), or
+     * O(index) when reading laid out segments.
+     */
+    void seek(size_t index);
+
+    bool done() const { return part_ >= parts_.size() + segments_.size(); }
+
+    /**
+     * Number of items already read.
+     */
+    size_t position() const { return position_; }
+
+private:
+    // skip the exhausted parts
+    void settle();
+
+    // `next()` over `segments_`, describing whole items of them
+    size_t next_laid_out(size_t max_bytes, std::vector<iovec>& iov);
+
+    std::vector<const std::vector<const cache_entry*>*> parts_;
+
+    // laid out items read instead of `parts_`
+    std::vector<std::pair<const unsigned char*, size_t>> segments_;
+
+    bool oldest_first_;
+
+    // current part, and index of the next item in it, or offset of the
+    // next item in the current segment
+    size_t part_;
+    size_t index_;
+
+    size_t position_;
+
+    // key sizes pointed at by the last chunk, whose addresses must not
+    // change while it grows
+    std::deque<size_t> key_sizes_;
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_SNAPSHOT_CURSOR_
@@ -0,0 +1,436 @@
+#include "snapshot_file.hxx"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#include "cache_state.hxx"
+#include "crc32c.hxx"
+#include "key_hash.hxx"
+#include "parallel_for.hxx"
+
+namespace lrucache {
+
+constexpr char MAGIC[8] = { 'L', 'R', 'C', 'S', 'N', 'A', 'P', '1' };
+constexpr size_t HEADER_SIZE = 64;
+
+// offsets of the header fields
+constexpr size_t VERSION_OFFSET = 8;
+constexpr size_t SEGMENT_COUNT_OFFSET = 12;
+constexpr size_t TAKEN_AT_OFFSET = 16;
+constexpr size_t META_SIZE_OFFSET = 24;
+constexpr size_t ITEM_COUNT_OFFSET = 32;
+constexpr size_t FILE_SIZE_OFFSET = 40;
+constexpr size_t CRC_OFFSET = 48;
+
+// amount of items described by each call to the cursors
+constexpr size_t WRITE_CHUNK_SIZE = 1024 * 1024;
+
+static size_t align8(size_t offset)
+{
+    return (offset + 7) & ~size_t(7);
+}
+
+// index slots of a segment, at most half full
+static size_t slots_for(size_t items)
+{
+    size_t slots = items ? 2 : 0;
+    while (slots < 2 * items) {
+        slots *= 2;
+    }
+    return slots;
+}
+
+template <typename T>
+static void put(std::vector<unsigned char>& buffer, size_t offset, T value)
+{
+    std::memcpy(buffer.data() + offset, &value, sizeof(value));
+}
+
+template <typename T>
+static T get(const unsigned char* buffer, size_t offset)
+{
+    T value;
+    std::memcpy(&value, buffer + offset, sizeof(value));
+    return value;
+}
+
+/**
+ * Write every buffer of `iov` at `offset`, retrying partial writes. The
+ * buffers are modified.
+ */
+static bool pwrite_all(int fd, iovec* iov, size_t count, off_t offset)
+{
+    while (count > 0) {
+        int batch = static_cast<int>(std::min<size_t>(count, IOV_MAX));
+        ssize_t written = pwritev(fd, iov, batch, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        offset += written;
+        while (count > 0 && static_cast<size_t>(written) >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+            iov->iov_len -= written;
+        }
+    }
+    return true;
+}
+
+/**
+ * Call `fn(hash, offset)` with the key hash and file offset of each item
+ * described by `iov`, whatever the way they are split into buffers.
+ *
+ * @param iov whole items, as returned by a snapshot_cursor
+ * @param offset file offset the first buffer is written at
+ */
+template <typename F>
+static void index_items(const std::vector<iovec>& iov, off_t offset, F fn)
+{
+    size_t buffer = 0;
+    size_t at = 0;
+    // feed the next `len` bytes to `sink(data, len)`, piece by piece
+    auto consume = [&](size_t len, auto sink) {
+        while (len > 0) {
+            size_t piece = std::min(len, iov[buffer].iov_len - at);
+            sink(static_cast<const char*>(iov[buffer].iov_base) + at, piece);
+            at += piece;
+            len -= piece;
+            if (at == iov[buffer].iov_len) {
+                buffer++;
+                at = 0;
+            }
+        }
+    };
+    auto read_size = [&]() {
+        size_t value = 0;
+        auto out = reinterpret_cast<char*>(&value);
+        consume(sizeof(size_t), [&out](const char* data, size_t len) {
+            out = std::copy(data, data + len, out);
+        });
+        return value;
+    };
+    auto skip = [](const char*, size_t) {};
+
+    while (buffer < iov.size()) {
+        off_t item_offset = offset;
+        size_t key_size = read_size();
+        uint64_t hash = key_hash(nullptr, 0);
+        consume(key_size, [&hash](const char* data, size_t len) {
+            hash = key_hash(data, len, hash);
+        });
+        size_t data_size = read_size();
+        consume(data_size + sizeof(std::time_t) + sizeof(uint64_t), skip);
+        offset += 4 * sizeof(size_t) + key_size + data_size;
+        fn(hash, item_offset);
+    }
+}
+
+snapshot_file::snapshot_file(const unsigned char* base, size_t size)
+    : base_(base)
+    , size_(size)
+    , taken_at_(0)
+    , meta_offset_(0)
+    , meta_size_(0)
+    , item_count_(0)
+{
+}
+
+snapshot_file::~snapshot_file()
+{
+    munmap(const_cast<unsigned char*>(base_), size_);
+}
+
+bool snapshot_file::write(cache_state& state,
+                          const std::string& path,
+                          std::time_t taken_at,
+                          const std::vector<unsigned char>& meta)
+{
+    size_t count = state.shard_count();
+    std::vector<segment> segments(count, segment { 0, 0, 0, 0, 0, 0, 0 });
+    auto pool = state.snapshot_pool();
+
+    // sizes first, so that every segment is written at its offset at once
+    parallel_for(pool, count, [&](size_t i) {
+        auto cursor = state.open_snapshot_segment(i, true);
+        std::vector<iovec> iov;
+        while (!cursor.done()) {
+            segments[i].size += cursor.next(WRITE_CHUNK_SIZE, iov);
+        }
+        segments[i].items = cursor.position();
+    });
+
+    size_t meta_offset = HEADER_SIZE + count * sizeof(segment);
+    size_t offset = align8(meta_offset + meta.size());
+    size_t items = 0;
+    for (auto& segment : segments) {
+        segment.offset = offset;
+        offset = align8(offset + segment.size);
+        items += segment.items;
+    }
+    for (auto& segment : segments) {
+        segment.index_offset = offset;
+        segment.index_slots = slots_for(segment.items);
+        offset += segment.index_slots * sizeof(slot);
+    }
+    size_t file_size = offset;
+
+    std::string temp_path = path + ".tmp";
+    int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                    0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    std::atomic<int> error(0);
+    parallel_for(pool, count, [&](size_t i) {
+        auto cursor = state.open_snapshot_segment(i, true);
+        std::vector<iovec> iov;
+        size_t mask = segments[i].index_slots - 1;
+        std::vector<slot> table(segments[i].index_slots, slot { 0, 0 });
+        off_t position = segments[i].offset;
+        uint32_t crc = 0;
+        while (!cursor.done() && !error) {
+            size_t bytes = cursor.next(WRITE_CHUNK_SIZE, iov);
+            index_items(iov, position, [&](uint64_t hash, off_t at) {
+                size_t index = hash & mask;
+                while (table[index].offset) {
+                    index = (index + 1) & mask;
+                }
+                table[index] = { hash, static_cast<uint64_t>(at) };
+            });
+            for (auto& buffer : iov) {
+                crc = crc32c(buffer.iov_base, buffer.iov_len, crc);
+            }
+            if (!pwrite_all(fd, iov.data(), iov.size(), position)) {
+                error = errno;
+            }
+            position += bytes;
+        }
+        segments[i].crc = crc;
+
+        size_t table_size = table.size() * sizeof(slot);
+        segments[i].index_crc = crc32c(table.data(), table_size);
+        iovec buffer = { table.data(), table_size };
+        if (!error && !pwrite_all(fd, &buffer, 1, segments[i].index_offset)) {
+            error = errno;
+        }
+    });
+
+    // header, segment table and meta, padded up to the first segment
+    std::vector<unsigned char> head(align8(meta_offset + meta.size()), 0);
+    std::memcpy(head.data(), MAGIC, sizeof(MAGIC));
+    put<uint32_t>(head, VERSION_OFFSET, VERSION);
+    put<uint32_t>(head, SEGMENT_COUNT_OFFSET, static_cast<uint32_t>(count));
+    put<int64_t>(head, TAKEN_AT_OFFSET, taken_at);
+    put<uint64_t>(head, META_SIZE_OFFSET, meta.size());
+    put<uint64_t>(head, ITEM_COUNT_OFFSET, items);
+    put<uint64_t>(head, FILE_SIZE_OFFSET, file_size);
+    std::memcpy(head.data() + HEADER_SIZE, segments.data(),
+                count * sizeof(segment));
+    std::memcpy(head.data() + meta_offset, meta.data(), meta.size());
+    uint32_t crc = crc32c(head.data(), CRC_OFFSET);
+    crc = crc32c(head.data() + HEADER_SIZE, meta_offset + meta.size()
+                                            - HEADER_SIZE, crc);
+    put<uint32_t>(head, CRC_OFFSET, crc);
+
+    iovec iov = { head.data(), head.size() };
+    if (!error && !pwrite_all(fd, &iov, 1, 0)) {
+        error = errno;
+    }
+    // the padding of the last segment, if no index follows
+    if (!error && ftruncate(fd, file_size) < 0) {
+        error = errno;
+    }
+    if (!error && fsync(fd) < 0) {
+        error = errno;
+    }
+    close(fd);
+    if (!error && rename(temp_path.c_str(), path.c_str()) < 0) {
+        error = errno;
+    }
+    if (error) {
+        unlink(temp_path.c_str());
+        errno = error;
+        return false;
+    }
+
+    // make the rename durable
+    auto slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+    int dir_fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+    return true;
+}
+
+std::unique_ptr<snapshot_file> snapshot_file::open(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < HEADER_SIZE) {
+        close(fd);
+        return nullptr;
+    }
+    size_t size = st.st_size;
+    void* base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return nullptr;
+    }
+    madvise(base, size, MADV_SEQUENTIAL);
+
+    std::unique_ptr<snapshot_file> file(
+        new snapshot_file(static_cast<const unsigned char*>(base), size));
+    if (!file->parse()) {
+        return nullptr;
+    }
+    return file;
+}
+
+bool snapshot_file::parse()
+{
+    if (std::memcmp(base_, MAGIC, sizeof(MAGIC)) != 0
+            || get<uint32_t>(base_, VERSION_OFFSET) != VERSION
+            || get<uint64_t>(base_, FILE_SIZE_OFFSET) != size_) {
+        return false;
+    }
+
+    size_t count = get<uint32_t>(base_, SEGMENT_COUNT_OFFSET);
+    meta_offset_ = HEADER_SIZE + count * sizeof(segment);
+    meta_size_ = get<uint64_t>(base_, META_SIZE_OFFSET);
+    if (meta_offset_ > size_ || meta_size_ > size_ - meta_offset_) {
+        return false;
+    }
+    uint32_t crc = crc32c(base_, CRC_OFFSET);
+    crc = crc32c(base_ + HEADER_SIZE, meta_offset_ + meta_size_ - HEADER_SIZE,
+                 crc);
+    if (crc != get<uint32_t>(base_, CRC_OFFSET)) {
+        return false;
+    }
+
+    segments_.resize(count);
+    std::memcpy(segments_.data(), base_ + HEADER_SIZE,
+                count * sizeof(segment));
+    for (auto& segment : segments_) {
+        size_t slots = segment.index_slots;
+        if (segment.offset > size_ || segment.size > size_ - segment.offset
+                || segment.index_offset % 8 != 0
+                || segment.index_offset > size_
+                || (slots & (slots - 1)) != 0
+                || slots > (size_ - segment.index_offset) / sizeof(slot)) {
+            return false;
+        }
+    }
+    taken_at_ = static_cast<std::time_t>(
+        get<int64_t>(base_, TAKEN_AT_OFFSET));
+    item_count_ = get<uint64_t>(base_, ITEM_COUNT_OFFSET);
+    return true;
+}
+
+bool snapshot_file::check_segment(size_t segment) const
+{
+    auto& s = segments_[segment];
+    return crc32c(base_ + s.offset, s.size) == s.crc
+        && crc32c(base_ + s.index_offset, s.index_slots * sizeof(slot))
+           == s.index_crc;
+}
+
+size_t snapshot_file::slot_of(size_t segment, uint64_t hash,
+                              const unsigned char* data) const
+{
+    size_t slots = index_slots(segment);
+    auto table = index(segment);
+    uint64_t offset = data - base_;
+    for (size_t i = hash & (slots - 1), probes = 0; probes < slots;
+            i = (i + 1) & (slots - 1), probes++) {
+        if (table[i].offset == offset) {
+            return i;
+        }
+        if (table[i].offset == 0) {
+            break;
+        }
+    }
+    return slots;
+}
+
+const unsigned char* snapshot_file::read_record(const unsigned char* data,
+                                                const unsigned char* end,
+                                                record& out)
+{
+    size_t left = end - data;
+    size_t key_size = 0;
+    if (left < 4 * sizeof(size_t)) {
+        return nullptr;
+    }
+    std::memcpy(&key_size, data, sizeof(size_t));
+    left -= 4 * sizeof(size_t);
+    if (key_size > left) {
+        return nullptr;
+    }
+    out.key = std::string_view(
+        reinterpret_cast<const char*>(data + sizeof(size_t)), key_size);
+    data += sizeof(size_t) + key_size;
+    std::memcpy(&out.data_size, data, sizeof(size_t));
+    if (out.data_size > left - key_size) {
+        return nullptr;
+    }
+    out.data = data + sizeof(size_t);
+    data = out.data + out.data_size;
+    std::memcpy(&out.expires_at, data, sizeof(std::time_t));
+    data += sizeof(std::time_t);
+    std::memcpy(&out.version, data, sizeof(uint64_t));
+    return data + sizeof(uint64_t);
+}
+
+bool snapshot_file::restore(cache_state& state) const
+{
+    auto pool = state.snapshot_pool();
+    std::atomic<bool> valid(true);
+    parallel_for(pool, segments_.size(), [&](size_t i) {
+        auto& segment = segments_[i];
+        if (crc32c(base_ + segment.offset, segment.size) != segment.crc) {
+            valid = false;
+        }
+    });
+    if (!valid) {
+        return false;
+    }
+
+    // segments of the same shard count only touch their own shard
+    state.begin_restore(taken_at_);
+    parallel_for(pool, segments_.size(), [&](size_t i) {
+        auto& segment = segments_[i];
+        if (!state.restore_chunk(base_ + segment.offset, segment.size)) {
+            valid = false;
+        }
+    });
+    if (!valid) {
+        state.abort_restore();
+        return false;
+    }
+    state.end_restore();
+    return true;
+}
+
+} // namespace lrucache
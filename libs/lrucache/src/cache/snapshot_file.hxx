@@ -0,0 +1,220 @@
+#ifndef LRUCACHE_SNAPSHOT_FILE_
+#define LRUCACHE_SNAPSHOT_FILE_
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace lrucache {
+
+class cache_state;
+
+/**
+ * Snapshot of the cache persisted to a local file, so that a restarted
+ * node only has to catch up on what happened since.
+ *
+ * The file is memory-mapped when read, and can be served as is without
+ * restoring its items first, see `cache_state::attach_snapshot()`. It is
+ * laid out as:
+ *
+ *  <header>  <segment table>  <meta>  <segment 0>  ...  <index 0>  ...
+ *  64 bytes  48 bytes/segment
+ *
+ * Each segment holds the items of a shard, least recently used first, in
+ * the layout of `cache_state::read_snapshot_chunk()`. Each index is an
+ * open addressing hash table of the items of its segment, with a power of
+ * two number of 16 bytes slots holding the key hash and file offset of an
+ * item, or 0 for empty slots, probed linearly.
+ *
+ * Segments and indexes start at 8 bytes aligned offsets. The header is
+ * checksummed along with the segment table and the meta, and each segment
+ * and index has its own checksum. Integers are written in host byte order.
+ */
+class snapshot_file {
+public:
+    // files of another version are not loaded: version 4 counts times
+    // in ms instead of seconds
+    static constexpr uint32_t VERSION = 4;
+
+    /**
+     * Item of a segment, pointing into the mapping.
+     */
+    struct record {
+        std::string_view key;
+        const unsigned char* data;
+        size_t data_size;
+        std::time_t expires_at;
+        uint64_t version;
+    };
+
+    ~snapshot_file();
+
+    snapshot_file(const snapshot_file&) = delete;
+    snapshot_file& operator=(const snapshot_file&) = delete;
+
+    /**
+     * Write the items frozen by `cache_state::begin_snapshot()` to `path`,
+     * one segment per shard written in parallel on the snapshot threads.
+     *
+     * The file is written next to `path` then renamed, so `path` always
+     * holds a whole snapshot.
+     *
+     * @param state cache whose snapshot is in progress
+     * @param path file to write
+     * @param taken_at time in ms of the last commit in the snapshot
+     * @param meta opaque bytes stored along, such as the Raft snapshot
+     * @return false if the file could not be written, with `errno` set
+     */
+    static bool write(cache_state& state,
+                      const std::string& path,
+                      std::time_t taken_at,
+                      const std::vector<unsigned char>& meta);
+
+    /**
+     * Map a snapshot file and check its header, without reading the
+     * items.
+     *
+     * @return the snapshot, or nullptr if the file cannot be read or is
+     *         not a valid snapshot
+     */
+    static std::unique_ptr<snapshot_file> open(const std::string& path);
+
+    /**
+     * Replace the items of `state` by the ones of the snapshot, see
+     * `cache_state::begin_restore()`. Every segment is checked first, and
+     * segments are restored in parallel on the snapshot threads.
+     *
+     * @return false if a segment is corrupt, `state` being left untouched
+     */
+    bool restore(cache_state& state) const;
+
+    std::time_t taken_at() const { return taken_at_; }
+
+    const unsigned char* meta() const { return base_ + meta_offset_; }
+
+    size_t meta_size() const { return meta_size_; }
+
+    size_t item_count() const { return item_count_; }
+
+    size_t segment_count() const { return segments_.size(); }
+
+    /**
+     * Items of a segment, laid out like the chunks of
+     * `cache_state::read_snapshot_chunk()`.
+     */
+    const unsigned char* segment_data(size_t segment) const {
+        return base_ + segments_[segment].offset;
+    }
+
+    size_t segment_size(size_t segment) const {
+        return segments_[segment].size;
+    }
+
+    /**
+     * Number of slots of the index of a segment, a power of two or 0.
+     */
+    size_t index_slots(size_t segment) const {
+        return segments_[segment].index_slots;
+    }
+
+    /**
+     * Check the checksums of a segment and its index.
+     */
+    bool check_segment(size_t segment) const;
+
+    /**
+     * Call `fn(slot, record)` for each item of `segment` whose key hash is
+     * `hash`, in O(1) on average. Items whose record is corrupt are
+     * skipped.
+     */
+    template <typename F>
+    void find(size_t segment, uint64_t hash, F fn) const;
+
+    /**
+     * Slot of the index of `segment` pointing at the item at `data`, or
+     * `index_slots(segment)` if none does.
+     */
+    size_t slot_of(size_t segment, uint64_t hash,
+                   const unsigned char* data) const;
+
+    /**
+     * Read the item at `data`.
+     *
+     * @param data item to read
+     * @param end end of its segment
+     * @param out[out] item read, pointing into `data`
+     * @return the next item, or nullptr if the item is truncated
+     */
+    static const unsigned char* read_record(const unsigned char* data,
+                                            const unsigned char* end,
+                                            record& out);
+
+private:
+    struct segment {
+        uint64_t offset;
+        uint64_t size;
+        uint64_t items;
+        uint64_t index_offset;
+        uint64_t index_slots;
+        uint32_t crc;
+        uint32_t index_crc;
+    };
+
+    struct slot {
+        uint64_t hash;
+        uint64_t offset;
+    };
+
+    const slot* index(size_t segment) const {
+        return reinterpret_cast<const slot*>(
+            base_ + segments_[segment].index_offset);
+    }
+
+    snapshot_file(const unsigned char* base, size_t size);
+
+    // read the header and segment table, false if invalid
+    bool parse();
+
+    const unsigned char* base_;
+    size_t size_;
+
+    std::time_t taken_at_;
+    size_t meta_offset_;
+    size_t meta_size_;
+    size_t item_count_;
+    std::vector<segment> segments_;
+};
+
+template <typename F>
+void snapshot_file::find(size_t segment, uint64_t hash, F fn) const
+{
+    size_t slots = index_slots(segment);
+    if (slots == 0) {
+        return;
+    }
+    auto table = index(segment);
+    auto end = segment_data(segment) + segment_size(segment);
+    for (size_t i = hash & (slots - 1), probes = 0; probes < slots;
+            i = (i + 1) & (slots - 1), probes++) {
+        if (table[i].offset == 0) {
+            return;
+        }
+        if (table[i].hash != hash) {
+            continue;
+        }
+        auto data = base_ + table[i].offset;
+        record item;
+        if (data >= segment_data(segment) && data < end
+                && read_record(data, end, item)) {
+            fn(i, item);
+        }
+    }
+}
+
+} // namespace lrucache
+
+#endif // LRUCACHE_SNAPSHOT_FILE_
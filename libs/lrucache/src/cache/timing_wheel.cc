@@ -0,0 +1,143 @@
+#include "timing_wheel.hxx"
+
+namespace lrucache {
+
+timing_wheel::timing_wheel()
+    : now_(0)
+    , size_(0)
+{
+    level_sizes_.fill(0);
+}
+
+void timing_wheel::schedule(cache_entry* entry)
+{
+    auto index = slot_for(entry->item.expires_at);
+    slots_[index].push_back(entry);
+    entry->expiry_slot = static_cast<uint16_t>(index);
+    size_++;
+    level_sizes_[index / SLOTS]++;
+}
+
+void timing_wheel::cancel(cache_entry* entry)
+{
+    slots_[entry->expiry_slot].remove(entry);
+    size_--;
+    level_sizes_[entry->expiry_slot / SLOTS]--;
+}
+
+void timing_wheel::replace(cache_entry* entry, cache_entry* replacement)
+{
+    slots_[entry->expiry_slot].replace(entry, replacement);
+    replacement->expiry_slot = entry->expiry_slot;
+}
+
+void timing_wheel::reset(std::time_t now)
+{
+    if (size_ == 0) {
+        now_ = now;
+    }
+}
+
+void timing_wheel::clear()
+{
+    for (auto& slot : slots_) {
+        slot.clear();
+    }
+    size_ = 0;
+    level_sizes_.fill(0);
+}
+
+size_t timing_wheel::due(std::time_t now) const
+{
+    size_t result = 0;
+    for (size_t level = 0; level < LEVELS; level++) {
+        size_t shift = level * SLOT_BITS;
+        uint64_t turn = static_cast<uint64_t>(now_) >> (shift + SLOT_BITS);
+        for (size_t i = 0; i < SLOTS; i++) {
+            auto& slot = slots_[level * SLOTS + i];
+            if (slot.empty()) {
+                continue;
+            }
+            // slots only hold ticks from the current turn of their level
+            uint64_t first = ((turn << SLOT_BITS) | i) << shift;
+            uint64_t last = first + (uint64_t(1) << shift) - 1;
+            if (level == 0 && i == (now_ & (SLOTS - 1))) {
+                // also holds the entries that were already due
+                first = 0;
+            }
+            if (static_cast<uint64_t>(now) >= last) {
+                result += slot.size();
+            } else if (static_cast<uint64_t>(now) >= first) {
+                result += count_due(slot, now);
+            }
+        }
+    }
+    return result + count_due(slots_[OVERFLOW_SLOT], now);
+}
+
+size_t timing_wheel::count_due(const expiry_list& slot, std::time_t now)
+{
+    size_t result = 0;
+    for (auto entry = slot.front(); entry; entry = expiry_list::next(entry)) {
+        if (entry->item.expires_at <= now) {
+            result++;
+        }
+    }
+    return result;
+}
+
+size_t timing_wheel::idle_levels() const
+{
+    size_t level = 0;
+    while (level < LEVELS && level_sizes_[level] == 0) {
+        level++;
+    }
+    return level;
+}
+
+size_t timing_wheel::slot_for(std::time_t when) const
+{
+    if (when <= now_) {
+        return now_ & (SLOTS - 1);
+    }
+    // the highest bit differing from the current tick gives the level
+    uint64_t differing = static_cast<uint64_t>(when) ^ now_;
+    for (size_t level = 0; level < LEVELS; level++) {
+        size_t shift = level * SLOT_BITS;
+        if (differing >> (shift + SLOT_BITS) == 0) {
+            return level * SLOTS + ((when >> shift) & (SLOTS - 1));
+        }
+    }
+    return OVERFLOW_SLOT;
+}
+
+void timing_wheel::tick()
+{
+    now_++;
+    for (size_t level = 1; level < LEVELS; level++) {
+        size_t shift = level * SLOT_BITS;
+        if (now_ & ((size_t(1) << shift) - 1)) {
+            return;
+        }
+        // the level below completed a turn
+        reschedule(level * SLOTS + ((now_ >> shift) & (SLOTS - 1)));
+    }
+    if ((now_ & ((size_t(1) << (LEVELS * SLOT_BITS)) - 1)) == 0) {
+        reschedule(OVERFLOW_SLOT);
+    }
+}
+
+void timing_wheel::reschedule(size_t index)
+{
+    // entries always land in a lower level, or back in the overflow slot
+    expiry_list pending = slots_[index];
+    slots_[index].clear();
+    size_ -= pending.size();
+    level_sizes_[index / SLOTS] -= pending.size();
+    while (auto entry = pending.front()) {
+        pending.remove(entry);
+        schedule(entry);
+    }
+}
+
+} // namespace lrucache
@@ -0,0 +1,150 @@
+#ifndef LRUCACHE_TIMING_WHEEL_
+#define LRUCACHE_TIMING_WHEEL_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+#include "cache_entry.hxx"
+
+namespace lrucache {
+
+/**
+ * Hierarchical timing wheel scheduling the expiry of cache entries, one
+ * tick per ms of `cache_item::expires_at`.
+ *
+ * Level 0 has one slot per tick, and each slot of level N covers a whole
+ * turn of level N-1. An entry goes to the lowest level where its expiry
+ * shares the same higher bits as the current tick, and moves down a level
+ * each time the wheel below it completes a turn, until it reaches level 0
+ * and expires. Entries further away than the top level wait in an overflow
+ * slot. Scheduling and cancelling only link or unlink the entry from a
+ * slot through its `expiry_hook`.
+ */
+class timing_wheel {
+public:
+    static constexpr size_t SLOT_BITS = 6;
+    static constexpr size_t SLOTS = size_t(1) << SLOT_BITS;
+    // 5 levels of 64 slots cover about 12 days of ticks
+    static constexpr size_t LEVELS = 5;
+
+    timing_wheel();
+
+    /**
+     * Schedule the expiry of an entry at `entry->item.expires_at`. Entries
+     * already due expire on the next tick processed.
+     */
+    void schedule(cache_entry* entry);
+
+    /**
+     * Unschedule a scheduled entry.
+     */
+    void cancel(cache_entry* entry);
+
+    /**
+     * Give the schedule of a scheduled entry to another entry.
+     */
+    void replace(cache_entry* entry, cache_entry* replacement);
+
+    /**
+     * Process every tick up to `now`, calling `expire` with each entry due,
+     * which must cancel it.
+     *
+     * Stops after `limit` entries and resumes from the same entry on the
+     * next call, so that a burst of expiries is spread over several calls.
+     *
+     * @param now time in ms of the last tick to process
+     * @param limit max number of entries to expire
+     * @param expire function expiring an entry
+     * @return number of entries expired
+     */
+    template <typename F>
+    size_t advance(std::time_t now, size_t limit, F expire) {
+        size_t expired = 0;
+        while (now_ <= now) {
+            if (size_ == 0) {
+                now_ = now + 1;
+                break;
+            }
+            if (size_t idle = idle_levels()) {
+                // nothing can be due before the next slot of the first
+                // level holding entries starts, go straight to its tick
+                std::time_t last = now_ | ((std::time_t(1)
+                                            << (idle * SLOT_BITS)) - 1);
+                now_ = std::min(last, now);
+                tick();
+                continue;
+            }
+            auto& due = slots_[now_ & (SLOTS - 1)];
+            while (!due.empty()) {
+                if (expired == limit) {
+                    return expired;
+                }
+                expire(due.front());
+                expired++;
+            }
+            tick();
+        }
+        return expired;
+    }
+
+    /**
+     * Number of scheduled entries expiring at or before `now`.
+     */
+    size_t due(std::time_t now) const;
+
+    /**
+     * Move the wheel to `now` if no entry is scheduled, so that it does not
+     * have to go through every tick since the last one processed.
+     */
+    void reset(std::time_t now);
+
+    void clear();
+
+    bool empty() const { return size_ == 0; }
+
+    size_t size() const { return size_; }
+
+    /**
+     * Next tick to process.
+     */
+    std::time_t now() const { return now_; }
+
+private:
+    static constexpr size_t OVERFLOW_SLOT = LEVELS * SLOTS;
+
+    size_t slot_for(std::time_t when) const;
+
+    static size_t count_due(const expiry_list& slot, std::time_t now);
+
+    /**
+     * Number of empty levels below the first one holding entries, the
+     * overflow slot counting as the level above the top one.
+     */
+    size_t idle_levels() const;
+
+    /**
+     * Go to the next tick, moving down the entries of the higher level
+     * slots it starts.
+     */
+    void tick();
+
+    void reschedule(size_t index);
+
+    std::time_t now_;
+
+    // LEVELS * SLOTS slots, level after level, then the overflow slot
+    std::array<expiry_list, LEVELS * SLOTS + 1> slots_;
+
+    // number of scheduled entries
+    size_t size_;
+
+    // number of scheduled entries in each level, then in the overflow slot
+    std::array<size_t, LEVELS + 1> level_sizes_;
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_TIMING_WHEEL_
@@ -0,0 +1,102 @@
+#include "tinylfu_policy.hxx"
+
+#include <algorithm>
+
+namespace lrucache {
+
+tinylfu_policy::tinylfu_policy(size_t window_percent)
+    : window_percent_(window_percent)
+{
+}
+
+void tinylfu_policy::inserted(cache_entry* entry)
+{
+    sketch_.ensure_capacity(window_.size() + main_.size() + 1);
+    sketch_.increment(entry->hash);
+    entry->policy_segment = WINDOW;
+    window_.push_front(entry);
+}
+
+void tinylfu_policy::accessed(cache_entry* entry)
+{
+    sketch_.increment(entry->hash);
+    if (entry->policy_segment == WINDOW) {
+        window_.move_to_front(entry);
+    } else {
+        main_.accessed(entry);
+    }
+}
+
+void tinylfu_policy::removed(cache_entry* entry, bool evicted)
+{
+    if (entry->policy_segment == WINDOW) {
+        window_.remove(entry);
+    } else {
+        main_.removed(entry, evicted);
+    }
+}
+
+void tinylfu_policy::replaced(cache_entry* entry, cache_entry* replacement)
+{
+    if (entry->policy_segment == WINDOW) {
+        replacement->policy_segment = WINDOW;
+        window_.replace(entry, replacement);
+    } else {
+        main_.replaced(entry, replacement);
+    }
+}
+
+cache_entry* tinylfu_policy::victim(const cache_entry* pinned)
+{
+    size_t total = window_.size() + main_.size();
+    size_t window_capacity =
+        std::max<size_t>(total * window_percent_ / 100, 1);
+
+    // entries piled up in the window while the cache was filling up, they
+    // join the main segment without competing
+    while (window_.size() > window_capacity + 1) {
+        auto entry = back_except(window_, pinned);
+        if (!entry) {
+            break;
+        }
+        window_.remove(entry);
+        main_.inserted(entry);
+    }
+
+    if (window_.size() > window_capacity) {
+        auto candidate = back_except(window_, pinned);
+        if (candidate) {
+            auto main_victim = main_.victim(pinned);
+
+            // the candidate joins the main segment on probation
+            window_.remove(candidate);
+            main_.inserted(candidate);
+            if (!main_victim) {
+                return candidate;
+            }
+
+            // admit the candidate only if it is more popular
+            auto candidate_frequency = sketch_.frequency(candidate->hash);
+            auto victim_frequency = sketch_.frequency(main_victim->hash);
+            if (candidate_frequency > victim_frequency) {
+                return main_victim;
+            }
+            return candidate;
+        }
+    }
+
+    auto entry = main_.victim(pinned);
+    if (!entry) {
+        entry = back_except(window_, pinned);
+    }
+    return entry;
+}
+
+void tinylfu_policy::clear()
+{
+    window_.clear();
+    main_.clear();
+    sketch_.clear();
+}
+
+} // namespace lrucache
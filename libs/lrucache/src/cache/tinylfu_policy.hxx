@@ -0,0 +1,59 @@
+#ifndef LRUCACHE_TINYLFU_POLICY_
+#define LRUCACHE_TINYLFU_POLICY_
+
+#include "eviction_policy.hxx"
+#include "frequency_sketch.hxx"
+#include "slru_policy.hxx"
+
+namespace lrucache {
+
+/**
+ * W-TinyLFU. New entries go to a small LRU window. Once the window is over
+ * its share of the entries, its least recently used entry becomes a
+ * candidate for the main segmented LRU and competes with the probation
+ * victim of the main segment. A count-min sketch of the key hashes decides
+ * the competition: the entry accessed less often is the one evicted. One
+ * time keys of a scan thus go through the window without flushing the
+ * keys used frequently.
+ */
+class tinylfu_policy : public eviction_policy {
+public:
+    /**
+     * @param window_percent share of the entries held by the window
+     */
+    tinylfu_policy(size_t window_percent = 1);
+
+    virtual void inserted(cache_entry* entry);
+
+    virtual void accessed(cache_entry* entry);
+
+    virtual void removed(cache_entry* entry, bool evicted);
+
+    virtual void replaced(cache_entry* entry, cache_entry* replacement);
+
+    virtual cache_entry* victim(const cache_entry* pinned);
+
+    virtual void clear();
+
+    const frequency_sketch& sketch() const { return sketch_; }
+
+    // segment of the entries in the window, the main segment uses
+    // slru_policy::segment values
+    static constexpr uint8_t WINDOW = 3;
+
+private:
+    size_t window_percent_;
+
+    // popularity of the keys, including keys no longer stored
+    frequency_sketch sketch_;
+
+    // new entries, most recently used first
+    policy_list window_;
+
+    // entries admitted out of the window
+    slru_policy main_;
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_TINYLFU_POLICY_
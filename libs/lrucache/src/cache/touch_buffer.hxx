@@ -0,0 +1,75 @@
+#ifndef LRUCACHE_TOUCH_BUFFER_
+#define LRUCACHE_TOUCH_BUFFER_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace lrucache {
+
+/**
+ * Lossy set of the key hashes read since it was last drained, filled by
+ * readers with a single relaxed store and no lock.
+ *
+ * Each hash goes to the slot its low bits point to, so reading the same
+ * key again costs nothing and two keys sharing a slot keep only the last
+ * one read. Losing a few reads is fine: they only feed an approximation
+ * of the recency order.
+ */
+class touch_buffer {
+public:
+    /**
+     * @param capacity number of slots, rounded up to a power of 2
+     */
+    touch_buffer(size_t capacity = 16384)
+        : mask_(round_up(capacity) - 1)
+        , slots_(new std::atomic<uint64_t>[mask_ + 1])
+    {
+        for (size_t i = 0; i <= mask_; i++) {
+            slots_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void record(uint64_t hash) {
+        auto& slot = slots_[hash & mask_];
+        // avoid dirtying the cache line when the key is already recorded
+        if (slot.load(std::memory_order_relaxed) != hash) {
+            slot.store(hash, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Empty the buffer, calling `fn` with every hash recorded.
+     */
+    template <typename F>
+    void drain(F fn) {
+        for (size_t i = 0; i <= mask_; i++) {
+            if (slots_[i].load(std::memory_order_relaxed) == 0) {
+                continue;
+            }
+            uint64_t hash = slots_[i].exchange(0, std::memory_order_relaxed);
+            if (hash) {
+                fn(hash);
+            }
+        }
+    }
+
+private:
+    static size_t round_up(size_t capacity) {
+        size_t result = 1;
+        while (result < capacity) {
+            result *= 2;
+        }
+        return result;
+    }
+
+    size_t mask_;
+
+    // recorded hashes, 0 when empty
+    std::unique_ptr<std::atomic<uint64_t>[]> slots_;
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_TOUCH_BUFFER_
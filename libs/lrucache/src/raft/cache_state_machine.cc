@@ -1,35 +1,599 @@
 #include "raft/cache_state_machine.hxx"
 
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "cache/parallel_for.hxx"
+#include "cache/snapshot_file.hxx"
+#include "raft/raft_logger.hxx"
+#include "schema/LogEntry_generated.h"
+
 namespace lrucache {
 
-nuraft::ptr<nuraft::buffer> cache_state_machine::commit(const ulong log_idx,
-                                                        nuraft::buffer& data)
+namespace {
+
+using op_payload = cache_state_machine::op_payload;
+using op_result = cache_state_machine::op_result;
+
+// size of the root, the tables of an operation and their vtables, padded
+constexpr size_t OP_OVERHEAD = 96;
+// size of the length, terminator and padding of a string or vector
+constexpr size_t VECTOR_OVERHEAD = 12;
+
+// size of the log index and operation count heading a commit result, and
+// of the code, version and value of each operation
+constexpr size_t RESULT_HEADER = sizeof(uint64_t) + sizeof(uint32_t);
+constexpr size_t RESULT_SIZE = sizeof(uint8_t) + 2 * sizeof(uint64_t);
+
+// first LogEntry version stamped with a hybrid_clock, the earlier ones
+// holding times in seconds
+constexpr uint8_t CLOCK_VERSION = 3;
+
+/**
+ * Time in ms of an expiry read from an entry of version `format`.
+ */
+std::time_t entry_time(int64_t value, uint8_t format)
+{
+    return format < CLOCK_VERSION ? value * 1000 : value;
+}
+
+/**
+ * hybrid_clock value of an operation read from an entry of version
+ * `format`.
+ */
+uint64_t entry_stamp(const schema::Operation& op, uint8_t format)
+{
+    return format < CLOCK_VERSION
+           ? hybrid_clock::from_millis(op.timestamp() * 1000)
+           : static_cast<uint64_t>(op.timestamp());
+}
+
+/**
+ * Item pointing at the value of a WriteOp or a CasOp in its log entry.
+ */
+template <typename T>
+cache_item entry_item(const T& op, uint8_t format, uint64_t version)
+{
+    cache_item item;
+    item.expires_at = entry_time(op.expires_at(), format);
+    item.version = version;
+    if (auto value = op.value()) {
+        item.borrow_data(const_cast<unsigned char*>(value->data()),
+                         value->size());
+    }
+    return item;
+}
+
+flatbuffers::Offset<schema::Operation> build_op(
+        flatbuffers::FlatBufferBuilder& builder, const op_payload& payload)
 {
-    op_payload payload;
-    decode_log(data, payload);
-    
+    // children are built before their parent, flatbuffers being written
+    // back to front
+    schema::Op type = schema::Op_NONE;
+    flatbuffers::Offset<void> op;
     switch (payload.type) {
-        case READ:
-            state_.commit_read(payload.key, payload.timestamp);
+        case cache_state_machine::READ:
+            type = schema::Op_ReadOp;
+            op = schema::CreateReadOp(
+                builder, builder.CreateString(payload.key)).Union();
+            break;
+        case cache_state_machine::WRITE: {
+            type = schema::Op_WriteOp;
+            auto key = builder.CreateString(payload.key);
+            auto value = builder.CreateVector(payload.data,
+                                              payload.data_len);
+            op = schema::CreateWriteOp(builder, key, value,
+                                       payload.expires_at).Union();
+            break;
+        }
+        case cache_state_machine::PURGE:
+            type = schema::Op_PurgeOp;
+            op = schema::CreatePurgeOp(builder).Union();
+            break;
+        case cache_state_machine::TOUCH:
+            type = schema::Op_TouchOp;
+            op = schema::CreateTouchOp(
+                builder, builder.CreateVector(payload.hashes)).Union();
+            break;
+        case cache_state_machine::BATCH: {
+            type = schema::Op_BatchOp;
+            std::vector<flatbuffers::Offset<schema::Operation>> ops;
+            ops.reserve(payload.ops.size());
+            for (auto& each : payload.ops) {
+                ops.push_back(build_op(builder, each));
+            }
+            op = schema::CreateBatchOp(
+                builder, builder.CreateVector(ops)).Union();
+            break;
+        }
+        case cache_state_machine::DELETE:
+            type = schema::Op_DeleteOp;
+            op = schema::CreateDeleteOp(
+                builder, builder.CreateString(payload.key)).Union();
+            break;
+        case cache_state_machine::EXPIRE:
+            type = schema::Op_ExpireOp;
+            op = schema::CreateExpireOp(
+                builder, builder.CreateString(payload.key),
+                payload.expires_at).Union();
+            break;
+        case cache_state_machine::CAS: {
+            type = schema::Op_CasOp;
+            auto key = builder.CreateString(payload.key);
+            auto value = builder.CreateVector(payload.data,
+                                              payload.data_len);
+            op = schema::CreateCasOp(builder, key, value, payload.expires_at,
+                                     payload.expected).Union();
+            break;
+        }
+        case cache_state_machine::INCR:
+            type = schema::Op_IncrOp;
+            op = schema::CreateIncrOp(
+                builder, builder.CreateString(payload.key),
+                payload.delta).Union();
+            break;
+    }
+    return schema::CreateOperation(builder, payload.timestamp, type, op);
+}
+
+/**
+ * Whether this version knows the operation, and the ones of a BATCH.
+ * FlatBuffers verifies the unions of unknown types as valid, for later
+ * versions to add operations.
+ */
+bool known_op(const schema::Operation& op)
+{
+    if (op.op_type() <= schema::Op_NONE || op.op_type() > schema::Op_MAX) {
+        return false;
+    }
+    if (auto batch = op.op_as_BatchOp()) {
+        if (auto ops = batch->ops()) {
+            for (auto each : *ops) {
+                if (!known_op(*each)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void read_op(const schema::Operation& op, uint8_t format,
+             op_payload& payload)
+{
+    payload.timestamp = entry_stamp(op, format);
+    payload.data = nullptr;
+    payload.data_len = 0;
+    payload.expires_at = 0;
+    payload.expected = 0;
+    payload.delta = 0;
+    switch (op.op_type()) {
+        case schema::Op_ReadOp:
+            payload.type = cache_state_machine::READ;
+            payload.key = op.op_as_ReadOp()->key()->str();
+            break;
+        case schema::Op_WriteOp: {
+            auto write = op.op_as_WriteOp();
+            payload.type = cache_state_machine::WRITE;
+            payload.key = write->key()->str();
+            if (auto value = write->value()) {
+                payload.data = const_cast<unsigned char*>(value->data());
+                payload.data_len = value->size();
+            }
+            payload.expires_at = entry_time(write->expires_at(), format);
+            break;
+        }
+        case schema::Op_TouchOp: {
+            payload.type = cache_state_machine::TOUCH;
+            auto hashes = op.op_as_TouchOp()->hashes();
+            if (hashes) {
+                payload.hashes.assign(hashes->begin(), hashes->end());
+            }
+            break;
+        }
+        case schema::Op_BatchOp: {
+            payload.type = cache_state_machine::BATCH;
+            auto ops = op.op_as_BatchOp()->ops();
+            payload.ops.resize(ops ? ops->size() : 0);
+            for (size_t i = 0; i < payload.ops.size(); i++) {
+                read_op(*ops->Get(i), format, payload.ops[i]);
+            }
+            break;
+        }
+        case schema::Op_DeleteOp:
+            payload.type = cache_state_machine::DELETE;
+            payload.key = op.op_as_DeleteOp()->key()->str();
+            break;
+        case schema::Op_ExpireOp: {
+            auto expire = op.op_as_ExpireOp();
+            payload.type = cache_state_machine::EXPIRE;
+            payload.key = expire->key()->str();
+            payload.expires_at = entry_time(expire->expires_at(), format);
+            break;
+        }
+        case schema::Op_CasOp: {
+            auto cas = op.op_as_CasOp();
+            payload.type = cache_state_machine::CAS;
+            payload.key = cas->key()->str();
+            if (auto value = cas->value()) {
+                payload.data = const_cast<unsigned char*>(value->data());
+                payload.data_len = value->size();
+            }
+            payload.expires_at = entry_time(cas->expires_at(), format);
+            payload.expected = cas->expected();
+            break;
+        }
+        case schema::Op_IncrOp: {
+            auto incr = op.op_as_IncrOp();
+            payload.type = cache_state_machine::INCR;
+            payload.key = incr->key()->str();
+            payload.delta = incr->delta();
+            break;
+        }
+        case schema::Op_PurgeOp:
+            payload.type = cache_state_machine::PURGE;
             break;
+        default:
+            // never read, see `known_op()`
+            break;
+    }
+}
+
+} // namespace
+
+nuraft::ptr<nuraft::buffer> cache_state_machine::encode_log(
+        const op_payload& payload)
+{
+    flatbuffers::FlatBufferBuilder builder(encoded_size(payload));
+    auto operation = build_op(builder, payload);
+    schema::FinishLogEntryBuffer(
+        builder, schema::CreateLogEntry(builder, LOG_VERSION, operation));
+
+    nuraft::ptr<nuraft::buffer> log = nuraft::buffer::alloc(builder.GetSize());
+    std::memcpy(log->data_begin(), builder.GetBufferPointer(),
+                builder.GetSize());
+    return log;
+}
+
+const schema::LogEntry* cache_state_machine::read_log(
+        const nuraft::buffer& log)
+{
+    // the data of nuraft buffers is only 4 bytes aligned, which unaligned
+    // loads of the 8 bytes fields cope with
+    flatbuffers::Verifier::Options options;
+    options.check_alignment = false;
+    flatbuffers::Verifier verifier(log.data_begin(), log.size(), options);
+    if (!schema::VerifyLogEntryBuffer(verifier)) {
+        return nullptr;
+    }
+    return schema::GetLogEntry(log.data_begin());
+}
+
+bool cache_state_machine::decode_log(nuraft::buffer& log,
+                                     op_payload& payload)
+{
+    auto entry = read_log(log);
+    if (!entry || entry->version() > LOG_VERSION
+            || !known_op(*entry->operation())) {
+        return false;
+    }
+    read_op(*entry->operation(), entry->version(), payload);
+    return true;
+}
+
+size_t cache_state_machine::encoded_size(const op_payload& payload)
+{
+    // an over estimate, so that the builder never has to grow
+    size_t size = OP_OVERHEAD;
+    switch (payload.type) {
+        case BATCH:
+            size += VECTOR_OVERHEAD;
+            for (auto& op : payload.ops) {
+                size += sizeof(uint32_t) + encoded_size(op);
+            }
+            break;
+        case TOUCH:
+            size += VECTOR_OVERHEAD + sizeof(uint64_t) * payload.hashes.size();
+            break;
+        case CAS:
+            size += 2 * sizeof(uint64_t);
+            // fall through
         case WRITE:
-            state_.commit_write(
-                payload.key,
-                {payload.data, payload.data_len, payload.expires_at},
-                payload.timestamp);
+            size += VECTOR_OVERHEAD + payload.data_len;
+            // fall through
+        case READ:
+        case DELETE:
+        case EXPIRE:
+        case INCR:
+            size += VECTOR_OVERHEAD + payload.key.size();
             break;
         case PURGE:
-            state_.commit_purge_expired(payload.timestamp);
             break;
     }
+    return size;
+}
+
+bool cache_state_machine::read_result(nuraft::buffer& ret, size_t position,
+                                      op_result& result)
+{
+    if (ret.size() < RESULT_HEADER) {
+        return false;
+    }
+    nuraft::buffer_serializer bs(ret);
+    bs.pos(sizeof(uint64_t));
+    size_t count = bs.get_u32();
+    if (position >= count
+            || ret.size() < RESULT_HEADER + (position + 1) * RESULT_SIZE) {
+        return false;
+    }
+    bs.pos(RESULT_HEADER + position * RESULT_SIZE);
+    result.code = static_cast<cache_storage::commit_result>(bs.get_u8());
+    result.version = bs.get_u64();
+    result.value = bs.get_i64();
+    return true;
+}
+
+bool cache_state_machine::read_log_idx(nuraft::buffer& ret, ulong& log_idx)
+{
+    if (ret.size() < RESULT_HEADER) {
+        return false;
+    }
+    nuraft::buffer_serializer bs(ret);
+    log_idx = bs.get_u64();
+    return true;
+}
+
+nuraft::ptr<nuraft::buffer> cache_state_machine::slice_result(
+        const nuraft::ptr<nuraft::buffer>& ret, size_t position)
+{
+    if (!ret || ret->size() < RESULT_HEADER) {
+        return ret;
+    }
+    nuraft::buffer_serializer in(*ret);
+    uint64_t log_idx = in.get_u64();
+    size_t count = in.get_u32();
+    bool found = position < count
+            && ret->size() >= RESULT_HEADER + (position + 1) * RESULT_SIZE;
+
+    auto slice = nuraft::buffer::alloc(RESULT_HEADER
+                                       + (found ? RESULT_SIZE : 0));
+    nuraft::buffer_serializer out(slice);
+    out.put_u64(log_idx);
+    out.put_u32(found ? 1 : 0);
+    if (found) {
+        out.put_raw(ret->data_begin() + RESULT_HEADER
+                    + position * RESULT_SIZE, RESULT_SIZE);
+    }
+    return slice;
+}
+
+nuraft::ptr<nuraft::buffer> cache_state_machine::commit(const ulong log_idx,
+                                                        nuraft::buffer& data)
+{
+    std::vector<op_result> results;
+    // every node reads the same entry, and skips it alike if corrupt. The
+    // nodes already upgraded apply an entry of a later version, or holding
+    // an operation it added, so this one stops rather than diverge from
+    // them.
+    auto entry = read_log(data);
+    if (entry && (entry->version() > LOG_VERSION
+                  || !known_op(*entry->operation()))) {
+        throw std::runtime_error(
+            "Log entry " + std::to_string(log_idx)
+            + " written by a later version, upgrade this node");
+    }
+    if (entry) {
+        uint8_t format = entry->version();
+        uint64_t stamp = entry_stamp(*entry->operation(), format);
+        clock_.observe(stamp);
+        apply(*entry->operation(), format, log_idx << VERSION_SHIFT,
+              results);
+        // entries without a time of their own, like a TOUCH, move it too
+        state_.advance_clock(hybrid_clock::millis(stamp));
+    } else {
+        log_line(logger_, raft_logger::WARNING, __FILE__, __LINE__,
+                 "Skipping invalid log entry " + std::to_string(log_idx));
+    }
+    last_committed_idx_ = log_idx;
 
-    // Return Raft log number as a return result.
-    nuraft::ptr<nuraft::buffer> ret = nuraft::buffer::alloc( sizeof(log_idx) );
+    // Return Raft log number, then the outcome of each operation.
+    nuraft::ptr<nuraft::buffer> ret = nuraft::buffer::alloc(
+        RESULT_HEADER + results.size() * RESULT_SIZE);
     nuraft::buffer_serializer bs(ret);
     bs.put_u64(log_idx);
+    bs.put_u32(results.size());
+    for (auto& result : results) {
+        bs.put_u8(result.code);
+        bs.put_u64(result.version);
+        bs.put_i64(result.value);
+    }
     return ret;
 }
 
+void cache_state_machine::apply(const schema::Operation& op,
+                                uint8_t format, uint64_t version,
+                                std::vector<op_result>& results)
+{
+    auto at = hybrid_clock::millis(entry_stamp(op, format));
+    op_result result;
+    bool done = true;
+    bool written = false;
+    switch (op.op_type()) {
+        case schema::Op_ReadOp:
+            done = state_.commit_read(op.op_as_ReadOp()->key()->str(), at);
+            break;
+        case schema::Op_WriteOp: {
+            auto write = op.op_as_WriteOp();
+            // the value is only copied by the cache, from the entry
+            done = state_.commit_write(write->key()->str(),
+                                       entry_item(*write, format, version),
+                                       at);
+            written = true;
+            break;
+        }
+        case schema::Op_PurgeOp:
+            state_.commit_purge_expired(at);
+            break;
+        case schema::Op_TouchOp:
+            if (auto hashes = op.op_as_TouchOp()->hashes()) {
+                state_.commit_touch(std::vector<uint64_t>(hashes->begin(),
+                                                          hashes->end()));
+            }
+            break;
+        case schema::Op_BatchOp:
+            commit_batch(*op.op_as_BatchOp(), format, version, results);
+            return;
+        case schema::Op_DeleteOp:
+            done = state_.commit_delete(op.op_as_DeleteOp()->key()->str(),
+                                        at);
+            break;
+        case schema::Op_ExpireOp: {
+            auto expire = op.op_as_ExpireOp();
+            done = state_.commit_expire(
+                    expire->key()->str(),
+                    entry_time(expire->expires_at(), format), at);
+            break;
+        }
+        case schema::Op_CasOp: {
+            auto cas = op.op_as_CasOp();
+            done = state_.commit_cas(cas->key()->str(),
+                                     entry_item(*cas, format, version),
+                                     cas->expected(), at);
+            written = true;
+            break;
+        }
+        case schema::Op_IncrOp: {
+            auto incr = op.op_as_IncrOp();
+            done = state_.commit_incr(incr->key()->str(), incr->delta(),
+                                      version, at, result.value);
+            written = true;
+            break;
+        }
+        default:
+            break;
+    }
+    if (!done) {
+        result.code = state_.get_commit_code();
+    } else if (written) {
+        result.version = version;
+    }
+    results.push_back(result);
+}
+
+void cache_state_machine::commit_batch(const schema::BatchOp& batch,
+                                       uint8_t format, uint64_t version,
+                                       std::vector<op_result>& results)
+{
+    std::vector<cache_state::batch_op> ops;
+    if (!batch.ops()) {
+        return;
+    }
+    // first operation of `ops` each one of the batch became, SIZE_MAX for
+    // a TOUCH without hashes
+    std::vector<size_t> firsts;
+    ops.reserve(batch.ops()->size());
+    firsts.reserve(batch.ops()->size());
+    for (auto op : *batch.ops()) {
+        cache_state::batch_op batch_op;
+        batch_op.at = hybrid_clock::millis(entry_stamp(*op, format));
+        batch_op.version = version + firsts.size();
+        firsts.push_back(ops.size());
+        switch (op->op_type()) {
+            case schema::Op_ReadOp:
+                batch_op.kind = cache_state::batch_op::READ;
+                batch_op.key = op->op_as_ReadOp()->key()->str();
+                break;
+            case schema::Op_WriteOp: {
+                auto write = op->op_as_WriteOp();
+                batch_op.kind = cache_state::batch_op::WRITE;
+                batch_op.key = write->key()->str();
+                if (auto value = write->value()) {
+                    batch_op.data = value->data();
+                    batch_op.data_len = value->size();
+                }
+                batch_op.expires_at = entry_time(write->expires_at(), format);
+                break;
+            }
+            case schema::Op_PurgeOp:
+                batch_op.kind = cache_state::batch_op::PURGE;
+                break;
+            case schema::Op_TouchOp:
+                batch_op.kind = cache_state::batch_op::TOUCH;
+                if (auto hashes = op->op_as_TouchOp()->hashes()) {
+                    for (auto hash : *hashes) {
+                        batch_op.hash = hash;
+                        ops.push_back(batch_op);
+                    }
+                }
+                if (ops.size() == firsts.back()) {
+                    firsts.back() = SIZE_MAX;
+                }
+                continue;
+            case schema::Op_DeleteOp:
+                batch_op.kind = cache_state::batch_op::DELETE;
+                batch_op.key = op->op_as_DeleteOp()->key()->str();
+                break;
+            case schema::Op_ExpireOp: {
+                auto expire = op->op_as_ExpireOp();
+                batch_op.kind = cache_state::batch_op::EXPIRE;
+                batch_op.key = expire->key()->str();
+                batch_op.expires_at = entry_time(expire->expires_at(),
+                                                 format);
+                break;
+            }
+            case schema::Op_CasOp: {
+                auto cas = op->op_as_CasOp();
+                batch_op.kind = cache_state::batch_op::CAS;
+                batch_op.key = cas->key()->str();
+                if (auto value = cas->value()) {
+                    batch_op.data = value->data();
+                    batch_op.data_len = value->size();
+                }
+                batch_op.expires_at = entry_time(cas->expires_at(), format);
+                batch_op.expected = cas->expected();
+                break;
+            }
+            case schema::Op_IncrOp: {
+                auto incr = op->op_as_IncrOp();
+                batch_op.kind = cache_state::batch_op::INCR;
+                batch_op.key = incr->key()->str();
+                batch_op.delta = incr->delta();
+                break;
+            }
+            default:
+                // batches are not nested
+                firsts.back() = SIZE_MAX;
+                continue;
+        }
+        ops.push_back(std::move(batch_op));
+    }
+    state_.commit_batch(ops);
+
+    for (size_t i = 0; i < firsts.size(); i++) {
+        op_result result;
+        if (firsts[i] != SIZE_MAX) {
+            auto& op = ops[firsts[i]];
+            result.code = op.code;
+            result.value = op.value;
+            bool written = op.kind == cache_state::batch_op::WRITE
+                    || op.kind == cache_state::batch_op::CAS
+                    || op.kind == cache_state::batch_op::INCR;
+            if (written && op.code == cache_storage::DONE_OK) {
+                result.version = op.version;
+            }
+        }
+        results.push_back(result);
+    }
+}
+
 void cache_state_machine::commit_config(
         const ulong log_idx,
         nuraft::ptr<nuraft::cluster_config>& new_conf)
@@ -39,4 +603,355 @@ void cache_state_machine::commit_config(
     last_config_idx_ = log_idx;
 }
 
-} // namespace lrucache
\ No newline at end of file
+void cache_state_machine::create_snapshot(
+        nuraft::snapshot& s,
+        nuraft::async_result<bool>::handler_type& when_done)
+{
+    {
+        std::lock_guard<std::mutex> lock(snapshot_lock_);
+        wait_persisted();
+        // the items stay frozen until persisted, the file serving the
+        // snapshot from then on. Without `snapshot_dir_`, until the next
+        // snapshot: whatever the `snapshot_distance` commits until then
+        // overwrite or remove is kept, each commit being up to a batch of
+        // items of `max_item_size`
+        state_.begin_snapshot();
+        nuraft::ptr<nuraft::buffer> snp_buf = s.serialize();
+        last_snapshot_ = nuraft::snapshot::deserialize(*snp_buf);
+        snapshot_time_ = state_.clock();
+        persist_snapshot();
+    }
+
+    bool ret = true;
+    nuraft::ptr<std::exception> except(nullptr);
+    when_done(ret, except);
+}
+
+int cache_state_machine::read_logical_snp_obj(
+        nuraft::snapshot& s,
+        void*& user_snp_ctx,
+        ulong obj_id,
+        nuraft::ptr<nuraft::buffer>& data_out,
+        bool& is_last_obj)
+{
+    std::lock_guard<std::mutex> lock(snapshot_lock_);
+    auto ctx = static_cast<snapshot_read_ctx*>(user_snp_ctx);
+    if (!last_snapshot_
+            || last_snapshot_->get_last_log_idx() != s.get_last_log_idx()
+            || (ctx && ctx->log_idx != s.get_last_log_idx())) {
+        // items frozen again since, the leader starts over with the new
+        // snapshot
+        return -1;
+    }
+
+    if (!ctx) {
+        ctx = new snapshot_read_ctx();
+        ctx->log_idx = s.get_last_log_idx();
+        user_snp_ctx = ctx;
+    }
+
+    std::lock_guard<std::mutex> source_lock(source_lock_);
+    if (obj_id == 0) {
+        // (re)start from the first item of each segment
+        ctx->source = snapshot_source_;
+        ctx->cursors.clear();
+        for (size_t i = 0; i < state_.shard_count(); i++) {
+            ctx->cursors.push_back(state_.open_snapshot_segment(i, true));
+        }
+        ctx->next_segment = 0;
+        ctx->obj_id = 0;
+        ctx->last_obj = nullptr;
+
+        data_out = nuraft::buffer::alloc(sizeof(uint64_t));
+        nuraft::buffer_serializer bs(data_out);
+        bs.put_u64(static_cast<uint64_t>(snapshot_time_));
+        is_last_obj = false;
+        return 0;
+    }
+
+    if (obj_id == ctx->obj_id && ctx->last_obj) {
+        // the follower did not get it, send it again
+        data_out = ctx->last_obj;
+        data_out->pos(0);
+        is_last_obj = ctx->done();
+        return 0;
+    }
+    if (obj_id != ctx->obj_id + 1) {
+        return -1;
+    }
+
+    if (ctx->source != snapshot_source_) {
+        // thawed once persisted, go on from the same items in the file
+        for (size_t i = 0; i < ctx->cursors.size(); i++) {
+            size_t position = ctx->cursors[i].position();
+            ctx->cursors[i] = state_.open_snapshot_segment(i, true);
+            ctx->cursors[i].seek(position);
+        }
+        ctx->source = snapshot_source_;
+    }
+
+    // a block of the next segments with items left, round robin so that
+    // consecutive objects keep every thread of the follower busy
+    std::vector<size_t> segments;
+    size_t count = ctx->cursors.size();
+    for (size_t n = 0; n < count && segments.size() < frames_per_obj_; n++) {
+        size_t i = (ctx->next_segment + n) % count;
+        if (!ctx->cursors[i].done()) {
+            segments.push_back(i);
+        }
+    }
+    if (!segments.empty()) {
+        ctx->next_segment = (segments.back() + 1) % count;
+    }
+
+    std::vector<std::vector<unsigned char>> frames(segments.size());
+    parallel_for(state_.snapshot_pool(), segments.size(), [&](size_t j) {
+        std::vector<iovec> iov;
+        ctx->cursors[segments[j]].next(frame_bytes_, iov);
+        codec_.encode(iov, frames[j]);
+    });
+
+    size_t size = sizeof(uint32_t);
+    for (auto& frame : frames) {
+        size += sizeof(uint32_t) + frame.size();
+    }
+    data_out = nuraft::buffer::alloc(size);
+    nuraft::buffer_serializer bs(data_out);
+    bs.put_u32(static_cast<uint32_t>(frames.size()));
+    for (auto& frame : frames) {
+        bs.put_u32(static_cast<uint32_t>(frame.size()));
+        bs.put_raw(frame.data(), frame.size());
+    }
+    data_out->pos(0);
+
+    ctx->obj_id = obj_id;
+    ctx->last_obj = data_out;
+    is_last_obj = ctx->done();
+    return 0;
+}
+
+void cache_state_machine::save_logical_snp_obj(nuraft::snapshot& s,
+                                               ulong& obj_id,
+                                               nuraft::buffer& data,
+                                               bool is_first_obj,
+                                               bool is_last_obj)
+{
+    if (obj_id == 0) {
+        nuraft::buffer_serializer bs(data);
+        restore_time_ = static_cast<std::time_t>(bs.get_u64());
+        state_.begin_restore(restore_time_);
+        obj_id++;
+        return;
+    }
+
+    // NuRaft applies the snapshot once it got the last object, whatever
+    // obj_id says, so a node that can't restore it stops instead
+    auto ask_again = [&](ulong from) {
+        if (is_last_obj) {
+            throw std::runtime_error("Snapshot object "
+                                     + std::to_string(obj_id)
+                                     + " could not be restored");
+        }
+        obj_id = from;
+    };
+
+    std::vector<std::pair<const unsigned char*, size_t>> frames;
+    try {
+        nuraft::buffer_serializer bs(data);
+        frames.resize(bs.get_u32());
+        for (auto& frame : frames) {
+            frame.second = bs.get_u32();
+            frame.first = static_cast<const unsigned char*>(
+                bs.get_raw(frame.second));
+        }
+    } catch (const std::overflow_error&) {
+        // truncated, ask for it again
+        ask_again(obj_id);
+        return;
+    }
+
+    // every frame is checked before anything is installed, the object is
+    // asked for again if any is corrupt
+    std::vector<std::vector<unsigned char>> chunks(frames.size());
+    std::atomic<bool> valid(true);
+    auto pool = state_.snapshot_pool();
+    parallel_for(pool, frames.size(), [&](size_t j) {
+        if (!snapshot_codec::decode(frames[j].first, frames[j].second,
+                                    chunks[j])) {
+            valid = false;
+        }
+    });
+    if (!valid) {
+        ask_again(obj_id);
+        return;
+    }
+
+    // the frames of an object come from different segments, restored in
+    // parallel into different shards
+    std::atomic<bool> restored(true);
+    parallel_for(pool, chunks.size(), [&](size_t j) {
+        if (!state_.restore_chunk(chunks[j].data(), chunks[j].size())) {
+            restored = false;
+        }
+    });
+    if (!restored) {
+        // some of its items may be restored already, or the restore was
+        // never begun: the transfer starts over from the first object
+        log_line(logger_, raft_logger::WARNING, __FILE__, __LINE__,
+                 "Restarting the snapshot transfer at object "
+                 + std::to_string(obj_id));
+        ask_again(0);
+        return;
+    }
+    obj_id++;
+}
+
+bool cache_state_machine::apply_snapshot(nuraft::snapshot& s)
+{
+    std::lock_guard<std::mutex> lock(snapshot_lock_);
+    wait_persisted();
+    // the objects received may not have begun a restore
+    if (!state_.end_restore()) {
+        return false;
+    }
+    state_.begin_snapshot();
+
+    nuraft::ptr<nuraft::buffer> snp_buf = s.serialize();
+    last_snapshot_ = nuraft::snapshot::deserialize(*snp_buf);
+    snapshot_time_ = restore_time_;
+    clock_.observe(hybrid_clock::from_millis(restore_time_));
+    last_committed_idx_ = s.get_last_log_idx();
+    persist_snapshot();
+    return true;
+}
+
+void cache_state_machine::free_user_snp_ctx(void*& user_snp_ctx)
+{
+    delete static_cast<snapshot_read_ctx*>(user_snp_ctx);
+    user_snp_ctx = nullptr;
+}
+
+nuraft::ptr<nuraft::snapshot> cache_state_machine::last_snapshot()
+{
+    std::lock_guard<std::mutex> lock(snapshot_lock_);
+    return last_snapshot_;
+}
+
+void cache_state_machine::persist_snapshot()
+{
+    if (snapshot_dir_.empty()) {
+        return;
+    }
+
+    nuraft::ptr<nuraft::buffer> snp_buf = last_snapshot_->serialize();
+    std::vector<unsigned char> meta(snp_buf->data_begin(),
+                                    snp_buf->data_begin() + snp_buf->size());
+    // zero padded so that the names sort like the log indexes
+    char name[64];
+    std::snprintf(name, sizeof(name), "snapshot-%020llu.lrcs",
+                  static_cast<unsigned long long>(
+                      last_snapshot_->get_last_log_idx()));
+    std::string path = snapshot_dir_ + "/" + name;
+    std::time_t taken_at = snapshot_time_;
+
+    persist_thread_ = std::thread([this, path, taken_at, meta]() {
+        namespace fs = std::filesystem;
+        std::error_code error;
+        fs::create_directories(snapshot_dir_, error);
+        if (!snapshot_file::write(state_, path, taken_at, meta)) {
+            log_line(logger_, raft_logger::ERROR, __FILE__, __LINE__,
+                     "Error writing snapshot " + path + ": "
+                     + std::strerror(errno));
+            return;
+        }
+        // along with the leftovers of writes cut short
+        for (auto& entry : fs::directory_iterator(snapshot_dir_, error)) {
+            auto name = entry.path().filename().string();
+            if (name.rfind("snapshot-", 0) == 0
+                    && entry.path().string() < path) {
+                fs::remove(entry.path(), error);
+            }
+        }
+
+        // no need to keep the items frozen any longer, nor to let the
+        // memory go over the cache size for them
+        std::shared_ptr<const snapshot_file> file = snapshot_file::open(path);
+        if (!file) {
+            log_line(logger_, raft_logger::ERROR, __FILE__, __LINE__,
+                     "Error reading snapshot " + path);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(source_lock_);
+        state_.serve_snapshot(std::move(file));
+        snapshot_source_++;
+    });
+}
+
+void cache_state_machine::wait_persisted()
+{
+    if (persist_thread_.joinable()) {
+        persist_thread_.join();
+    }
+}
+
+void cache_state_machine::load_local_snapshot()
+{
+    namespace fs = std::filesystem;
+    std::error_code error;
+    std::vector<std::string> paths;
+    for (auto& entry : fs::directory_iterator(snapshot_dir_, error)) {
+        if (entry.path().extension() == ".lrcs") {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.rbegin(), paths.rend());
+
+    // the most recent one may have been cut short by a crash
+    for (auto& path : paths) {
+        std::shared_ptr<const snapshot_file> file = snapshot_file::open(path);
+        if (!file) {
+            log_line(logger_, raft_logger::WARNING, __FILE__, __LINE__,
+                     "Ignoring invalid snapshot " + path);
+            continue;
+        }
+
+        // served from the mapping right away and folded in the background,
+        // or restored now if it was taken with another shard count. Either
+        // checks every segment first, an older snapshot being loaded if one
+        // is corrupt.
+        bool attached = state_.attach_snapshot(file);
+        if (!attached && !file->restore(state_)) {
+            log_line(logger_, raft_logger::WARNING, __FILE__, __LINE__,
+                     "Ignoring invalid snapshot " + path);
+            continue;
+        }
+
+        auto snp_buf = nuraft::buffer::alloc(file->meta_size());
+        std::memcpy(snp_buf->data_begin(), file->meta(), file->meta_size());
+        std::lock_guard<std::mutex> lock(snapshot_lock_);
+        last_snapshot_ = nuraft::snapshot::deserialize(*snp_buf);
+        snapshot_time_ = file->taken_at();
+        clock_.observe(hybrid_clock::from_millis(file->taken_at()));
+        last_committed_idx_ = last_snapshot_->get_last_log_idx();
+        if (attached) {
+            fold_thread_ = std::thread([this]() { state_.fold_snapshot(); });
+        } else {
+            // written again with this node's shard count, to be served
+            state_.begin_snapshot();
+            persist_snapshot();
+        }
+        return;
+    }
+}
+
+void cache_state_machine::run_purger(std::chrono::seconds interval)
+{
+    std::unique_lock<std::mutex> lock(purge_lock_);
+    while (!purge_cv_.wait_for(lock, interval, [this] { return stopping_; })) {
+        lock.unlock();
+        state_.purge_expired();
+        lock.lock();
+    }
+}
+
+} // namespace lrucache
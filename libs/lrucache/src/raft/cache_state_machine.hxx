@@ -1,81 +1,215 @@
 #ifndef LRUCACHE_CACHE_STATE_MACHINE_H_
 #define LRUCACHE_CACHE_STATE_MACHINE_H_
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
 #include "libnuraft/nuraft.hxx"
 #include "lrucache/cache_config.hxx"
 
 #include "cache/cache_state.hxx"
+#include "cache/snapshot_codec.hxx"
+#include "raft/hybrid_clock.hxx"
 
 namespace lrucache {
 
+namespace schema {
+struct LogEntry;
+struct Operation;
+struct BatchOp;
+} // namespace schema
+
 class cache_state_machine : public nuraft::state_machine {
 public:
-    cache_state_machine(cache_config config, bool async_snapshot = false)
+    /**
+     * @param config configuration of the cache
+     * @param async_snapshot whether snapshots are created in the background
+     * @param logger where the entries skipped, the snapshots ignored and
+     *               the transfers started over are reported, if any
+     */
+    cache_state_machine(cache_config config, bool async_snapshot = false,
+                        nuraft::ptr<nuraft::logger> logger = nullptr)
         : state_(config)
+        , last_committed_idx_(0)
+        , last_config_idx_(0)
+        , block_size_(config.snapshot_block_size)
+        , codec_(snapshot_codec::parse(config.snapshot_compression))
+        , snapshot_time_(0)
+        , restore_time_(0)
+        , snapshot_dir_(config.snapshot_dir)
+        , logger_(std::move(logger))
     {
+        // one frame per snapshot thread in each object, each big enough
+        // for the biggest item
+        auto pool = state_.snapshot_pool();
+        frames_per_obj_ = pool ? pool->size() + 1 : 1;
+        frame_bytes_ = std::max(block_size_ / frames_per_obj_,
+                                config.max_item_size + config.max_key_size
+                                + 4 * sizeof(uint64_t));
+
+        if (!snapshot_dir_.empty()) {
+            load_local_snapshot();
+        }
+        if (config.purge_interval > 0) {
+            purge_thread_ = std::thread(
+                    &cache_state_machine::run_purger, this,
+                    std::chrono::seconds(config.purge_interval));
+        }
     }
 
-    ~cache_state_machine() {}
+    ~cache_state_machine()
+    {
+        {
+            std::lock_guard<std::mutex> lock(purge_lock_);
+            stopping_ = true;
+        }
+        purge_cv_.notify_all();
+        if (purge_thread_.joinable()) {
+            purge_thread_.join();
+        }
+        if (fold_thread_.joinable()) {
+            fold_thread_.join();
+        }
+        wait_persisted();
+    }
 
-    // TODO: this entire code is garbage
     enum op_type : int {
         READ = 0x1,
         WRITE = 0x2,
-        PURGE = 0x3
+        // no longer proposed, each node removes the expired items on its
+        // own, see `cache_state::purge_expired()`. Still applied from the
+        // logs written before.
+        PURGE = 0x3,
+        TOUCH = 0x4,
+        BATCH = 0x5,
+        DELETE = 0x6,
+        // changes the expiry of an item, unlike TOUCH which only marks
+        // items as recently used
+        EXPIRE = 0x7,
+        CAS = 0x8,
+        INCR = 0x9
     };
 
     struct op_payload {
         op_type type;
+        // hybrid_clock value, stamped by the leader's log_batcher
         time_t timestamp;
         std::string key;
         size_t data_len;
         unsigned char* data;
+        // time in ms of the log clock, see `hybrid_clock::wall_millis()`
         time_t expires_at;
+        std::vector<uint64_t> hashes;
+        // operations of a BATCH, in order
+        std::vector<op_payload> ops;
+        // version a CAS expects the item to have
+        uint64_t expected = 0;
+        // amount added by an INCR, negative to decrement
+        int64_t delta = 0;
     };
 
-    static nuraft::ptr<nuraft::buffer> encode_log(const op_payload& payload)
-    {
-        size_t size = sizeof(payload.type) + sizeof(payload.timestamp);
-        if (payload.type != op_type::PURGE) {
-            size += sizeof(size_t) + payload.key.size();
-        }
-        if (payload.type == op_type::WRITE) {
-            size += sizeof(size_t) + payload.data_len + sizeof(time_t);
-        }
-        nuraft::ptr<nuraft::buffer> log = nuraft::buffer::alloc(size);
-        nuraft::buffer_serializer bs(log);
+    /**
+     * Outcome of an operation, see `commit()`.
+     */
+    struct op_result {
+        cache_storage::commit_result code = cache_storage::DONE_OK;
+        // version of the item written by a WRITE, a CAS or an INCR
+        uint64_t version = 0;
+        // value of the item once incremented by an INCR
+        int64_t value = 0;
+    };
 
-        bs.put_raw(&payload.type, sizeof(payload.type));
-        bs.put_raw(&payload.timestamp, sizeof(payload.timestamp));
-        if (payload.type != op_type::PURGE) {
-            bs.put_str(payload.key);
-        }
-        if (payload.type == op_type::WRITE) {
-            bs.put_bytes(payload.data, payload.data_len);
-            bs.put_raw(&payload.expires_at, sizeof(payload.expires_at));
-        }
+    // version of the schema::LogEntry written, a node stops at entries of
+    // later versions until it is upgraded. The times of the entries before
+    // version 3 are read as seconds of the wall clock, so that logs written
+    // before the upgrade still apply.
+    static constexpr uint8_t LOG_VERSION = 3;
 
-        return log;
-    }
+    // the version of an item written is its log index shifted by this
+    // much, plus the position of the operation in its entry
+    static constexpr int VERSION_SHIFT = 20;
 
-    static void decode_log(nuraft::buffer& log, op_payload& payload)
-    {
-        nuraft::buffer_serializer bs(log);
-        memcpy(&payload.type,
-               bs.get_raw(sizeof(payload.type)),
-               sizeof(payload.type));
-        memcpy(&payload.timestamp,
-               bs.get_raw(sizeof(payload.timestamp)),
-               sizeof(payload.timestamp));
-        if (payload.type != op_type::PURGE) {
-            payload.key = bs.get_str();
-        }
-        if (payload.type == op_type::WRITE) {
-            auto data = bs.get_bytes(payload.data_len);
-            memcpy(payload.data, data, payload.data_len);
-        }
-    }
-    // TODO: end of garbage code
+    /**
+     * Encode an operation as a schema::LogEntry, see `schema/LogEntry.fbs`.
+     */
+    static nuraft::ptr<nuraft::buffer> encode_log(const op_payload& payload);
+
+    /**
+     * Verify a log entry and access it in place, without decoding it.
+     *
+     * @param log log entry
+     * @return entry pointing into `log`, nullptr if it is corrupt. The
+     *         operation of an entry of a later version than `LOG_VERSION`,
+     *         or of a type this version does not know, must not be read.
+     */
+    static const schema::LogEntry* read_log(const nuraft::buffer& log);
+
+    /**
+     * Decode a log entry. The data of a WRITE points into `log`, and is
+     * only valid as long as it is. Times are given in ms whatever the
+     * version of the entry.
+     *
+     * @return false if the entry is corrupt or of a later version, or
+     *         holds an operation unknown to this one
+     */
+    static bool decode_log(nuraft::buffer& log, op_payload& payload);
+
+    /**
+     * Upper bound of the size of `payload` once encoded.
+     */
+    static size_t encoded_size(const op_payload& payload);
+
+    /**
+     * Read the outcome of an operation from the result of `commit()`.
+     *
+     * @param ret result of the commit
+     * @param position position of the operation in its entry, 0 unless
+     *                 it was part of a BATCH
+     * @param result[out] outcome of the operation
+     * @return false if `ret` holds no outcome at that position
+     */
+    static bool read_result(nuraft::buffer& ret, size_t position,
+                            op_result& result);
+
+    /**
+     * Read the log index of the entry committed from the result of
+     * `commit()`, or of `slice_result()`.
+     *
+     * @param ret result of the commit
+     * @param log_idx[out] log index of the entry
+     * @return false if `ret` holds no log index
+     */
+    static bool read_log_idx(nuraft::buffer& ret, ulong& log_idx);
+
+    /**
+     * Keep only the outcome at `position` of the result of `commit()`, so
+     * that each operation of a batch gets its own at position 0.
+     *
+     * @param ret result of the commit, given back as is if it holds no
+     *            outcome
+     * @param position position of the operation in its entry, SIZE_MAX
+     *                 for an operation dropped from it
+     * @return result holding the log index and that outcome, if any
+     */
+    static nuraft::ptr<nuraft::buffer> slice_result(
+            const nuraft::ptr<nuraft::buffer>& ret, size_t position);
+
+    cache_state& state() { return state_; }
+
+    /**
+     * Clock the entries proposed by this node are stamped with. It takes
+     * every entry committed into account, so that once leader this node
+     * goes on from the last one whatever its own clock says.
+     */
+    hybrid_clock& clock() { return clock_; }
 
     /**
      * Commit the given Raft log.
@@ -88,9 +222,15 @@ public:
      *   Here provide a default implementation for facilitating the
      *   situation when application does not care its implementation.
      *
+     * The cache clock, see `cache_state::clock()`, moves to the time the
+     * entry was stamped with.
+     *
      * @param log_idx Raft log number to commit.
      * @param data Payload of the Raft log.
-     * @return Raft log number wrapped in a nuraft::buffer
+     * @return Raft log number, then the number of operations and the
+     *         outcome of each, see `read_result()`
+     * @throw std::runtime_error if the entry was written by a later version,
+     *        which stops the node rather than let it diverge
      */
     nuraft::ptr<nuraft::buffer> commit(const ulong log_idx,
                                        nuraft::buffer& data);
@@ -104,10 +244,217 @@ public:
     void commit_config(const ulong log_idx,
                        nuraft::ptr<nuraft::cluster_config>& new_conf);
 
+    /**
+     * Freeze the items of the cache for a new snapshot, ending the previous
+     * one. Called by the commit thread, so the items frozen are exactly the
+     * ones at the log index of `s`.
+     *
+     * The snapshot is then written to `cache_config::snapshot_dir` in the
+     * background, if set. The next snapshot waits for it to be written.
+     *
+     * @param s snapshot to create
+     * @param when_done handler called once the snapshot is created
+     */
+    void create_snapshot(nuraft::snapshot& s,
+                         nuraft::async_result<bool>::handler_type& when_done);
+
+    /**
+     * Read an object of the last snapshot to send it to a follower.
+     *
+     * Object 0 holds the time of the last commit in the snapshot. Each of
+     * the next ones holds a frame count, then for each frame its size and
+     * a snapshot_codec frame compressed with
+     * `cache_config::snapshot_compression`.
+     *
+     * Each frame holds the next items of a different shard, laid out like
+     * the chunks of `cache_state::read_snapshot_chunk()`, least recently
+     * used first. Objects hold one frame per snapshot thread, encoded in
+     * parallel, and add up to about `cache_config::snapshot_block_size`
+     * bytes before compression. The position in each shard is kept in
+     * `user_snp_ctx`.
+     *
+     * @param s snapshot to read
+     * @param user_snp_ctx[in,out] read position, created on the first call
+     * @param obj_id object to read
+     * @param data_out[out] object read
+     * @param is_last_obj[out] true if no object is left after this one
+     * @return 0 on success, -1 if `s` is not the last snapshot anymore
+     */
+    int read_logical_snp_obj(nuraft::snapshot& s,
+                             void*& user_snp_ctx,
+                             ulong obj_id,
+                             nuraft::ptr<nuraft::buffer>& data_out,
+                             bool& is_last_obj);
+
+    /**
+     * Install an object of a snapshot received from the leader into the
+     * shadow cache restored beside the live one, its frames being decoded
+     * and restored in parallel. Objects with a corrupt frame are asked for
+     * again, and the transfer starts over from the first object if the
+     * items of one can't be restored.
+     *
+     * @param s snapshot being received
+     * @param obj_id[in,out] object received, then the next one to ask for
+     * @param data object received
+     * @param is_first_obj true for the first object of the snapshot
+     * @param is_last_obj true for the last object of the snapshot
+     * @throw std::runtime_error if the last object can't be restored,
+     *        which stops the node rather than apply a partial snapshot
+     */
+    void save_logical_snp_obj(nuraft::snapshot& s,
+                              ulong& obj_id,
+                              nuraft::buffer& data,
+                              bool is_first_obj,
+                              bool is_last_obj);
+
+    /**
+     * Replace the live cache by the snapshot received, and freeze it so
+     * that this node can send it in turn. It is written to
+     * `cache_config::snapshot_dir` in the background, if set.
+     *
+     * @param s snapshot received
+     * @return false if no restore was in progress, the live cache being
+     *         left as is
+     */
+    bool apply_snapshot(nuraft::snapshot& s);
+
+    /**
+     * Free the read position created by `read_logical_snp_obj()`.
+     */
+    void free_user_snp_ctx(void*& user_snp_ctx);
+
+    /**
+     * Last snapshot created or applied. After a restart, the one loaded
+     * from `cache_config::snapshot_dir`, whose logs do not have to be
+     * replicated again.
+     */
+    nuraft::ptr<nuraft::snapshot> last_snapshot();
+
+    ulong last_commit_index() { return last_committed_idx_; }
+
 private:
+    /**
+     * Apply an operation read in place from its log entry. The data of a
+     * WRITE or a CAS is copied straight from the entry into the cache.
+     *
+     * @param format version of the schema::LogEntry holding it
+     * @param version version of the items it writes
+     * @param results[out] outcome of the operation, or of each operation
+     *                     of a BATCH
+     */
+    void apply(const schema::Operation& op, uint8_t format,
+               uint64_t version, std::vector<op_result>& results);
+
+    /**
+     * Apply the operations of a BATCH log entry under a single lock
+     * acquisition per shard.
+     */
+    void commit_batch(const schema::BatchOp& batch, uint8_t format,
+                      uint64_t version, std::vector<op_result>& results);
+
+    /**
+     * Position of a follower in the snapshot sent to it.
+     */
+    struct snapshot_read_ctx {
+        bool done() const {
+            for (auto& cursor : cursors) {
+                if (!cursor.done()) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // log index of the snapshot read
+        ulong log_idx = 0;
+        // `snapshot_source_` when the cursors were opened
+        uint64_t source = 0;
+        // position in each shard
+        std::vector<snapshot_cursor> cursors;
+        // shard the next object starts with
+        size_t next_segment = 0;
+        // last object read, sent again if the follower did not get it
+        ulong obj_id = 0;
+        nuraft::ptr<nuraft::buffer> last_obj;
+    };
+
+    /**
+     * Write the last snapshot to `snapshot_dir_` on `persist_thread_`,
+     * then serve it from the file, see `cache_state::serve_snapshot()`, and
+     * remove the older ones. Called with `snapshot_lock_` held, once its
+     * items are frozen.
+     */
+    void persist_snapshot();
+
+    /**
+     * Wait until the snapshot being written is, before its items are
+     * thawed or replaced.
+     */
+    void wait_persisted();
+
+    /**
+     * Serve the most recent valid snapshot of `snapshot_dir_`, see
+     * `cache_state::attach_snapshot()`, and fold it into the cache on
+     * `fold_thread_`. It is the snapshot sent to the other nodes until the
+     * next one.
+     */
+    void load_local_snapshot();
+
+    /**
+     * Remove the items expired by the last commit every `interval`, see
+     * `cache_state::purge_expired()`, until stopped.
+     */
+    void run_purger(std::chrono::seconds interval);
+
     cache_state state_;
     std::atomic<uint64_t> last_committed_idx_;
     std::atomic<uint64_t> last_config_idx_;
+
+    // stamps the entries proposed, and follows the ones committed
+    hybrid_clock clock_;
+
+    // max size of the snapshot objects holding items, before compression
+    size_t block_size_;
+
+    // number of frames in those objects, and max size of each frame
+    size_t frames_per_obj_;
+    size_t frame_bytes_;
+
+    // frames the snapshot objects holding items
+    snapshot_codec codec_;
+
+    // last snapshot created or applied, whose items are frozen in `state_`,
+    // and the time of its last commit
+    nuraft::ptr<nuraft::snapshot> last_snapshot_;
+    std::time_t snapshot_time_;
+
+    // time of the last commit of the snapshot being received
+    std::time_t restore_time_;
+
+    // guards the last snapshot and its frozen items against the reads of
+    // snapshot objects
+    std::mutex snapshot_lock_;
+
+    // guards the items the snapshot objects are read from against the
+    // switch to the file once persisted, and counts those switches
+    std::mutex source_lock_;
+    uint64_t snapshot_source_ = 0;
+
+    // directory the snapshots are persisted to, empty if they are not, and
+    // thread writing the last one
+    std::string snapshot_dir_;
+    std::thread persist_thread_;
+
+    nuraft::ptr<nuraft::logger> logger_;
+
+    // thread folding the snapshot loaded at startup into the cache
+    std::thread fold_thread_;
+
+    // thread removing the expired items, woken up to stop
+    std::thread purge_thread_;
+    std::mutex purge_lock_;
+    std::condition_variable purge_cv_;
+    bool stopping_ = false;
 };
 
 } // namespace lrucache
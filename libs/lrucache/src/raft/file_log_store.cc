@@ -0,0 +1,676 @@
+#include "file_log_store.hxx"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#include "cache/crc32c.hxx"
+#include "raft_logger.hxx"
+
+namespace lrucache {
+
+using nuraft::buffer;
+using nuraft::cs_new;
+using nuraft::log_entry;
+using nuraft::ptr;
+using nuraft::ulong;
+
+constexpr size_t HEADER_SIZE = 40;
+
+// offsets of the entry header fields
+constexpr size_t SIZE_OFFSET = 4;
+constexpr size_t INDEX_OFFSET = 8;
+constexpr size_t TERM_OFFSET = 16;
+constexpr size_t TIMESTAMP_OFFSET = 24;
+constexpr size_t TYPE_OFFSET = 32;
+
+// how often the flusher looks for entries appended outside of a batch
+constexpr auto IDLE_FLUSH_INTERVAL = std::chrono::milliseconds(50);
+
+template <typename T>
+static void put(unsigned char* buffer, size_t offset, T value)
+{
+    std::memcpy(buffer + offset, &value, sizeof(value));
+}
+
+template <typename T>
+static T get(const unsigned char* buffer, size_t offset)
+{
+    T value;
+    std::memcpy(&value, buffer + offset, sizeof(value));
+    return value;
+}
+
+static std::string segment_name(ulong first)
+{
+    // zero padded so that the names sort like the indexes
+    char name[64];
+    std::snprintf(name, sizeof(name), "log-%020llu.seg",
+                  static_cast<unsigned long long>(first));
+    return name;
+}
+
+// comparison for the binary searches of the segment of an index
+static const auto before_segment = [](ulong index, const auto& segment) {
+    return index < segment->first;
+};
+
+static ptr<log_entry> dummy_entry()
+{
+    return cs_new<log_entry>(0, buffer::alloc(sizeof(ulong)));
+}
+
+static void fail(const std::string& what, const std::string& path)
+{
+    throw std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+/**
+ * Read `size` bytes at `offset`, retrying partial reads.
+ *
+ * @return bytes read, less than `size` if the file is shorter, or -1 on
+ *         error
+ */
+static ssize_t pread_all(int fd, unsigned char* data, size_t size,
+                         off_t offset)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t result = pread(fd, data + done, size - done, offset + done);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0) {
+            return -1;
+        }
+        if (result == 0) {
+            break;
+        }
+        done += result;
+    }
+    return done;
+}
+
+/**
+ * Write a header and a payload at `offset`, retrying partial writes.
+ */
+static bool pwrite_all(int fd, const unsigned char* header,
+                       const unsigned char* payload, size_t payload_size,
+                       off_t offset)
+{
+    iovec iov[2] = {
+        { const_cast<unsigned char*>(header), HEADER_SIZE },
+        { const_cast<unsigned char*>(payload), payload_size },
+    };
+    iovec* next = iov;
+    int count = payload_size ? 2 : 1;
+    while (count > 0) {
+        ssize_t written = pwritev(fd, next, count, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        offset += written;
+        while (count > 0 && static_cast<size_t>(written) >= next->iov_len) {
+            written -= next->iov_len;
+            next++;
+            count--;
+        }
+        if (count > 0) {
+            next->iov_base = static_cast<char*>(next->iov_base) + written;
+            next->iov_len -= written;
+        }
+    }
+    return true;
+}
+
+file_log_store::segment_file::~segment_file()
+{
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+file_log_store::file_log_store(const std::string& dir, size_t segment_size,
+                               int flush_window,
+                               nuraft::ptr<nuraft::logger> logger)
+    : dir_(dir)
+    , segment_size_(segment_size)
+    , flush_window_(flush_window)
+    , logger_(std::move(logger))
+    , start_(1)
+    , next_(1)
+    , durable_(0)
+{
+    std::error_code error;
+    std::filesystem::create_directories(dir_, error);
+    dir_fd_ = ::open(dir_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd_ < 0) {
+        fail("Error opening the log directory", dir_);
+    }
+    recover();
+    if (flush_window_ > 0) {
+        flusher_ = std::thread(&file_log_store::run_flusher, this);
+    }
+}
+
+file_log_store::~file_log_store()
+{
+    {
+        std::lock_guard<std::mutex> lock(flusher_lock_);
+        stopping_ = true;
+    }
+    flusher_cv_.notify_all();
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+    flush();
+    segments_.clear();
+    unsynced_.clear();
+    ::close(dir_fd_);
+}
+
+void file_log_store::set_flush_callback(std::function<void(bool)> callback)
+{
+    std::lock_guard<std::mutex> lock(flusher_lock_);
+    flush_callback_ = std::move(callback);
+}
+
+void file_log_store::recover()
+{
+    namespace fs = std::filesystem;
+    std::error_code error;
+    std::vector<std::pair<ulong, std::string>> files;
+    for (auto& entry : fs::directory_iterator(dir_, error)) {
+        auto name = entry.path().filename().string();
+        unsigned long long first;
+        char end;
+        if (std::sscanf(name.c_str(), "log-%llu.se%c", &first, &end) == 2
+                && name == segment_name(first)) {
+            files.emplace_back(first, entry.path().string());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    bool valid = true;
+    for (auto& file : files) {
+        // the segments after a torn entry or a gap are leftovers
+        if (!valid || (!segments_.empty() && file.first != next_)) {
+            valid = false;
+            log_line(logger_, raft_logger::WARNING, __FILE__, __LINE__,
+                     "Dropping log segment " + file.second);
+            unlink(file.second.c_str());
+            dir_changed_ = true;
+            continue;
+        }
+        auto segment = std::make_shared<segment_file>();
+        segment->first = file.first;
+        segment->path = file.second;
+        segment->fd = ::open(file.second.c_str(), O_RDWR | O_CLOEXEC);
+        if (segment->fd < 0) {
+            fail("Error opening log segment", file.second);
+        }
+        if (segments_.empty()) {
+            start_ = next_ = file.first;
+        }
+        valid = scan(*segment);
+        unsynced_.push_back(segment);
+        segments_.push_back(std::move(segment));
+    }
+
+    if (segments_.empty()) {
+        open_segment(start_);
+    }
+    // the entries kept are the durable ones from now on
+    if (!flush()) {
+        fail("Error syncing the log", dir_);
+    }
+}
+
+bool file_log_store::scan(segment_file& segment)
+{
+    struct stat st;
+    if (fstat(segment.fd, &st) < 0) {
+        fail("Error reading log segment", segment.path);
+    }
+    std::vector<unsigned char> data(st.st_size);
+    if (pread_all(segment.fd, data.data(), data.size(), 0)
+            != static_cast<ssize_t>(data.size())) {
+        fail("Error reading log segment", segment.path);
+    }
+
+    size_t offset = 0;
+    while (offset + HEADER_SIZE <= data.size()) {
+        const unsigned char* header = data.data() + offset;
+        size_t size = get<uint32_t>(header, SIZE_OFFSET);
+        if (size > data.size() - offset - HEADER_SIZE
+                || get<uint64_t>(header, INDEX_OFFSET) != next_
+                || get<uint32_t>(header, 0)
+                   != crc32c(header + SIZE_OFFSET,
+                             HEADER_SIZE - SIZE_OFFSET + size)) {
+            break;
+        }
+        positions_.push_back({ offset, get<uint64_t>(header, TERM_OFFSET),
+                               static_cast<uint32_t>(size) });
+        offset += HEADER_SIZE + size;
+        next_++;
+    }
+    segment.size = offset;
+    if (offset == data.size()) {
+        return true;
+    }
+
+    // an append cut short by a crash, or a corrupt entry
+    log_line(logger_, raft_logger::WARNING, __FILE__, __LINE__,
+             "Truncating log segment " + segment.path + " after entry "
+             + std::to_string(next_ - 1));
+    if (ftruncate(segment.fd, offset) < 0) {
+        fail("Error truncating log segment", segment.path);
+    }
+    return false;
+}
+
+void file_log_store::open_segment(ulong first)
+{
+    auto segment = std::make_shared<segment_file>();
+    segment->first = first;
+    segment->path = dir_ + "/" + segment_name(first);
+    segment->fd = ::open(segment->path.c_str(),
+                         O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (segment->fd < 0) {
+        fail("Error creating log segment", segment->path);
+    }
+    dir_changed_ = true;
+    unsynced_.push_back(segment);
+    segments_.push_back(std::move(segment));
+}
+
+void file_log_store::reset(ulong start)
+{
+    // the old segments go first, so that a crash never leaves a gap
+    for (auto& segment : segments_) {
+        unlink(segment->path.c_str());
+    }
+    segments_.clear();
+    positions_.clear();
+    start_ = next_ = start;
+    truncations_++;
+    // the entries before are covered by a snapshot
+    durable_ = start - 1;
+    open_segment(start);
+}
+
+void file_log_store::truncate(ulong index)
+{
+    if (index >= next_) {
+        return;
+    }
+    if (index < start_) {
+        reset(index);
+        return;
+    }
+    auto segment = segment_of(index);
+    uint64_t offset = positions_[index - start_].offset;
+    while (segments_.back() != segment) {
+        unlink(segments_.back()->path.c_str());
+        segments_.pop_back();
+        dir_changed_ = true;
+    }
+    if (ftruncate(segment->fd, offset) < 0) {
+        fail("Error truncating log segment", segment->path);
+    }
+    segment->size = offset;
+    unsynced_.push_back(segment);
+    positions_.resize(index - start_);
+    next_ = index;
+    truncations_++;
+    if (durable_ >= index) {
+        durable_ = index - 1;
+    }
+}
+
+void file_log_store::write_entry(log_entry& entry)
+{
+    if (segments_.back()->size >= segment_size_
+            && segments_.back()->first < next_) {
+        open_segment(next_);
+    }
+    auto& segment = segments_.back();
+
+    const unsigned char* payload = nullptr;
+    size_t size = 0;
+    if (!entry.is_buf_null()) {
+        payload = entry.get_buf().data_begin();
+        size = entry.get_buf().size();
+    }
+    unsigned char header[HEADER_SIZE] = {};
+    put<uint32_t>(header, SIZE_OFFSET, static_cast<uint32_t>(size));
+    put<uint64_t>(header, INDEX_OFFSET, next_);
+    put<uint64_t>(header, TERM_OFFSET, entry.get_term());
+    put<uint64_t>(header, TIMESTAMP_OFFSET, entry.get_timestamp());
+    header[TYPE_OFFSET] = static_cast<unsigned char>(entry.get_val_type());
+    uint32_t crc = crc32c(header + SIZE_OFFSET, HEADER_SIZE - SIZE_OFFSET);
+    put<uint32_t>(header, 0, crc32c(payload, size, crc));
+
+    if (!pwrite_all(segment->fd, header, payload, size, segment->size)) {
+        fail("Error writing log segment", segment->path);
+    }
+    positions_.push_back({ segment->size, entry.get_term(),
+                           static_cast<uint32_t>(size) });
+    segment->size += HEADER_SIZE + size;
+    if (unsynced_.empty() || unsynced_.back() != segment) {
+        unsynced_.push_back(segment);
+    }
+    next_++;
+}
+
+const std::shared_ptr<file_log_store::segment_file>&
+file_log_store::segment_of(ulong index) const
+{
+    auto it = std::upper_bound(segments_.begin(), segments_.end(), index,
+                               before_segment);
+    return *(it - 1);
+}
+
+ulong file_log_store::next_slot() const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return next_;
+}
+
+ulong file_log_store::start_index() const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return start_;
+}
+
+ptr<log_entry> file_log_store::last_entry() const
+{
+    ulong last = next_slot() - 1;
+    // reading does not change the store
+    auto entries = const_cast<file_log_store*>(this)->read(last, last + 1, 0);
+    return entries.empty() ? dummy_entry() : entries.front();
+}
+
+ulong file_log_store::append(ptr<log_entry>& entry)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    ulong index = next_;
+    write_entry(*entry);
+    return index;
+}
+
+void file_log_store::write_at(ulong index, ptr<log_entry>& entry)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    truncate(index);
+    write_entry(*entry);
+}
+
+void file_log_store::end_of_append_batch(ulong start, ulong cnt)
+{
+    if (flush_window_ <= 0) {
+        flush();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(flusher_lock_);
+        flush_requested_ = true;
+    }
+    flusher_cv_.notify_one();
+}
+
+std::vector<ptr<log_entry>> file_log_store::read(ulong start, ulong end,
+                                                 size_t max_bytes)
+{
+    std::vector<ptr<log_entry>> result;
+    std::vector<position> run;
+    std::vector<unsigned char> data;
+    size_t bytes = 0;
+    while (start < end) {
+        // the entries of the same segment are read at once
+        std::shared_ptr<segment_file> segment;
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            if (start < start_ || start >= next_) {
+                break;
+            }
+            auto it = std::upper_bound(segments_.begin(), segments_.end(),
+                                       start, before_segment);
+            segment = *(it - 1);
+            ulong last = std::min(end, next_);
+            if (it != segments_.end()) {
+                last = std::min(last, (*it)->first);
+            }
+            run.assign(positions_.begin() + (start - start_),
+                       positions_.begin() + (last - start_));
+        }
+
+        uint64_t offset = run.front().offset;
+        data.resize(run.back().offset + HEADER_SIZE + run.back().size
+                    - offset);
+        ssize_t size = pread_all(segment->fd, data.data(), data.size(),
+                                 offset);
+        if (size < 0) {
+            log_line(logger_, raft_logger::ERROR, __FILE__, __LINE__,
+                     "Error reading log segment " + segment->path + ": "
+                     + std::strerror(errno));
+            break;
+        }
+        // the entries may have been rewritten meanwhile, and are read
+        // again then
+        data.resize(size);
+        for (auto& entry : run) {
+            const unsigned char* header = data.data() + entry.offset - offset;
+            if (entry.offset - offset + HEADER_SIZE + entry.size > data.size()
+                    || get<uint64_t>(header, INDEX_OFFSET) != start
+                    || get<uint32_t>(header, SIZE_OFFSET) != entry.size) {
+                break;
+            }
+            ptr<buffer> payload = buffer::alloc(entry.size);
+            std::memcpy(payload->data_begin(), header + HEADER_SIZE,
+                        entry.size);
+            result.push_back(cs_new<log_entry>(
+                    get<uint64_t>(header, TERM_OFFSET), payload,
+                    static_cast<nuraft::log_val_type>(header[TYPE_OFFSET]),
+                    get<uint64_t>(header, TIMESTAMP_OFFSET)));
+            start++;
+            bytes += entry.size;
+            if (max_bytes && bytes >= max_bytes) {
+                return result;
+            }
+        }
+    }
+    return result;
+}
+
+ptr<std::vector<ptr<log_entry>>> file_log_store::log_entries(ulong start,
+                                                             ulong end)
+{
+    return cs_new<std::vector<ptr<log_entry>>>(read(start, end, 0));
+}
+
+ptr<std::vector<ptr<log_entry>>> file_log_store::log_entries_ext(
+        ulong start, ulong end, nuraft::int64 batch_size_hint_in_bytes)
+{
+    if (batch_size_hint_in_bytes < 0) {
+        return cs_new<std::vector<ptr<log_entry>>>();
+    }
+    return cs_new<std::vector<ptr<log_entry>>>(
+            read(start, end, batch_size_hint_in_bytes));
+}
+
+ptr<log_entry> file_log_store::entry_at(ulong index)
+{
+    auto entries = read(index, index + 1, 0);
+    return entries.empty() ? dummy_entry() : entries.front();
+}
+
+ulong file_log_store::term_at(ulong index)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    if (index < start_ || index >= next_) {
+        return 0;
+    }
+    return positions_[index - start_].term;
+}
+
+ptr<buffer> file_log_store::pack(ulong index, nuraft::int32 cnt)
+{
+    auto entries = read(index, index + cnt, 0);
+    std::vector<ptr<buffer>> logs;
+    size_t size_total = 0;
+    for (auto& entry : entries) {
+        logs.push_back(entry->serialize());
+        size_total += logs.back()->size();
+    }
+
+    ptr<buffer> buf_out = buffer::alloc(sizeof(nuraft::int32)
+                                        + logs.size() * sizeof(nuraft::int32)
+                                        + size_total);
+    buf_out->pos(0);
+    buf_out->put(static_cast<nuraft::int32>(logs.size()));
+    for (auto& buf : logs) {
+        buf_out->put(static_cast<nuraft::int32>(buf->size()));
+        buf_out->put(*buf);
+    }
+    return buf_out;
+}
+
+void file_log_store::apply_pack(ulong index, buffer& pack)
+{
+    pack.pos(0);
+    nuraft::int32 num_logs = pack.get_int();
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (index < start_ || index > next_) {
+            // nothing to keep
+            reset(index);
+        } else {
+            truncate(index);
+        }
+        for (nuraft::int32 i = 0; i < num_logs; i++) {
+            nuraft::int32 buf_size = pack.get_int();
+            ptr<buffer> buf_local = buffer::alloc(buf_size);
+            pack.get(buf_local);
+            ptr<log_entry> entry = log_entry::deserialize(*buf_local);
+            write_entry(*entry);
+        }
+    }
+    flush();
+}
+
+bool file_log_store::compact(ulong last_log_index)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    if (last_log_index < start_) {
+        return true;
+    }
+    if (last_log_index >= next_ - 1) {
+        reset(last_log_index + 1);
+        return true;
+    }
+
+    positions_.erase(positions_.begin(),
+                     positions_.begin() + (last_log_index + 1 - start_));
+    start_ = last_log_index + 1;
+    while (segments_.size() > 1 && segments_[1]->first <= start_) {
+        unlink(segments_.front()->path.c_str());
+        segments_.pop_front();
+        dir_changed_ = true;
+    }
+    return true;
+}
+
+bool file_log_store::flush()
+{
+    std::lock_guard<std::mutex> flush_lock(flush_lock_);
+    std::vector<std::shared_ptr<segment_file>> segments;
+    bool dir_changed;
+    ulong last;
+    uint64_t truncations;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        segments.swap(unsynced_);
+        dir_changed = dir_changed_;
+        dir_changed_ = false;
+        last = next_ - 1;
+        truncations = truncations_;
+    }
+
+    // concurrent appends go on meanwhile, and wait for the next fsync
+    bool ok = true;
+    for (auto& segment : segments) {
+        if (fdatasync(segment->fd) < 0) {
+            log_line(logger_, raft_logger::ERROR, __FILE__, __LINE__,
+                     "Error syncing log segment " + segment->path + ": "
+                     + std::strerror(errno));
+            ok = false;
+        }
+    }
+    if (dir_changed && fsync(dir_fd_) < 0) {
+        log_line(logger_, raft_logger::ERROR, __FILE__, __LINE__,
+                 "Error syncing log directory " + dir_ + ": "
+                 + std::strerror(errno));
+        ok = false;
+    }
+
+    std::lock_guard<std::mutex> lock(lock_);
+    if (!ok) {
+        unsynced_.insert(unsynced_.end(), segments.begin(), segments.end());
+        dir_changed_ = dir_changed_ || dir_changed;
+        return false;
+    }
+    if (truncations == truncations_ && last > durable_) {
+        durable_ = last;
+    }
+    return true;
+}
+
+ulong file_log_store::last_durable_index()
+{
+    return durable_;
+}
+
+void file_log_store::run_flusher()
+{
+    auto window = std::chrono::microseconds(flush_window_);
+    std::unique_lock<std::mutex> lock(flusher_lock_);
+    while (!stopping_) {
+        flusher_cv_.wait_for(lock, IDLE_FLUSH_INTERVAL, [this] {
+            return flush_requested_ || stopping_;
+        });
+        if (stopping_) {
+            break;
+        }
+        if (flush_requested_) {
+            // batches ending meanwhile share the fsync
+            flusher_cv_.wait_for(lock, window, [this] { return stopping_; });
+            flush_requested_ = false;
+        } else if (durable_ + 1 >= next_slot()) {
+            continue;
+        }
+        auto callback = flush_callback_;
+        lock.unlock();
+
+        ulong durable = durable_;
+        bool ok = flush();
+        if (callback && (!ok || durable_ > durable)) {
+            callback(ok);
+        }
+        lock.lock();
+    }
+}
+
+} // namespace lrucache
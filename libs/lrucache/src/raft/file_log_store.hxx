@@ -0,0 +1,210 @@
+#ifndef LRUCACHE_FILE_LOG_STORE_
+#define LRUCACHE_FILE_LOG_STORE_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "libnuraft/nuraft.hxx"
+
+namespace lrucache {
+
+/**
+ * Raft log store appending the entries to segment files, so that a node
+ * restarting finds its log again.
+ *
+ * Each entry is written to the last segment as soon as it is appended, and
+ * the segments written are fsync'ed together once a batch of appends ends.
+ * With a flush window, the fsync is left to a background thread waiting
+ * that long for more batches to share it with, and the raft server must
+ * run with parallel_log_appending_ set so that it commits only what
+ * last_durable_index() reports.
+ *
+ * Segment files are named after the index of their first entry, each entry
+ * being stored as a 40 bytes header followed by its payload:
+ *  - uint32_t CRC-32C of the rest of the header and the payload
+ *  - uint32_t payload size
+ *  - uint64_t index
+ *  - uint64_t term
+ *  - uint64_t timestamp
+ *  - uint8_t value type, and 7 bytes of padding
+ */
+class file_log_store : public nuraft::log_store {
+public:
+    /**
+     * Open the log stored in `dir`, keeping the entries written by the
+     * previous run up to the first torn or corrupt one.
+     *
+     * @param dir directory of the segment files, created if missing
+     * @param segment_size size in bytes from which the next entry starts a
+     *                     new segment
+     * @param flush_window time in µs a background fsync waits for more
+     *                     batches, 0 to fsync at the end of each batch
+     * @param logger where the segments dropped or truncated and the I/O
+     *               errors are reported, if any
+     * @throws std::runtime_error if the log can't be opened
+     */
+    file_log_store(const std::string& dir, size_t segment_size,
+                   int flush_window,
+                   nuraft::ptr<nuraft::logger> logger = nullptr);
+
+    ~file_log_store();
+
+    __nocopy__(file_log_store);
+
+public:
+    /**
+     * Set the function told about each background fsync, with true once
+     * more entries are durable or false if the fsync failed. Meant for
+     * raft_server::notify_log_append_completion.
+     */
+    void set_flush_callback(std::function<void(bool)> callback);
+
+    nuraft::ulong next_slot() const override;
+
+    nuraft::ulong start_index() const override;
+
+    nuraft::ptr<nuraft::log_entry> last_entry() const override;
+
+    nuraft::ulong append(nuraft::ptr<nuraft::log_entry>& entry) override;
+
+    void write_at(nuraft::ulong index,
+                  nuraft::ptr<nuraft::log_entry>& entry) override;
+
+    void end_of_append_batch(nuraft::ulong start, nuraft::ulong cnt) override;
+
+    nuraft::ptr<std::vector<nuraft::ptr<nuraft::log_entry>>> log_entries(
+            nuraft::ulong start, nuraft::ulong end) override;
+
+    nuraft::ptr<std::vector<nuraft::ptr<nuraft::log_entry>>> log_entries_ext(
+            nuraft::ulong start, nuraft::ulong end,
+            nuraft::int64 batch_size_hint_in_bytes = 0) override;
+
+    nuraft::ptr<nuraft::log_entry> entry_at(nuraft::ulong index) override;
+
+    nuraft::ulong term_at(nuraft::ulong index) override;
+
+    nuraft::ptr<nuraft::buffer> pack(nuraft::ulong index,
+                                     nuraft::int32 cnt) override;
+
+    void apply_pack(nuraft::ulong index, nuraft::buffer& pack) override;
+
+    bool compact(nuraft::ulong last_log_index) override;
+
+    /**
+     * fsync everything written so far.
+     */
+    bool flush() override;
+
+    nuraft::ulong last_durable_index() override;
+
+private:
+    struct segment_file {
+        ~segment_file();
+
+        // index of the first entry
+        nuraft::ulong first;
+        std::string path;
+        int fd = -1;
+        // bytes written so far
+        size_t size = 0;
+    };
+
+    // where each entry is, so that term_at() does not read it
+    struct position {
+        uint64_t offset;
+        uint64_t term;
+        uint32_t size;
+    };
+
+    void recover();
+
+    /**
+     * Read the entries of a segment into `positions_`, truncating it after
+     * the last valid one.
+     *
+     * @return false if it ends with an invalid entry, the later segments
+     *         being left over then
+     */
+    bool scan(segment_file& segment);
+
+    /**
+     * Start a new last segment whose first entry is `first`. The lock must
+     * be held.
+     */
+    void open_segment(nuraft::ulong first);
+
+    /**
+     * Remove the entries from `index` on. The lock must be held.
+     */
+    void truncate(nuraft::ulong index);
+
+    /**
+     * Drop every entry, the next one being `start`. The lock must be held.
+     */
+    void reset(nuraft::ulong start);
+
+    /**
+     * Write `entry` as the next one. The lock must be held.
+     */
+    void write_entry(nuraft::log_entry& entry);
+
+    /**
+     * Segment holding entry `index`. The lock must be held.
+     */
+    const std::shared_ptr<segment_file>& segment_of(nuraft::ulong index) const;
+
+    /**
+     * Read the entries from `start` to `end` excluded, stopping once
+     * `max_bytes` of payloads are read if not 0.
+     */
+    std::vector<nuraft::ptr<nuraft::log_entry>> read(nuraft::ulong start,
+                                                     nuraft::ulong end,
+                                                     size_t max_bytes);
+
+    void run_flusher();
+
+    std::string dir_;
+    int dir_fd_ = -1;
+    size_t segment_size_;
+    int flush_window_;
+    nuraft::ptr<nuraft::logger> logger_;
+
+    // guards everything below up to the flusher
+    mutable std::mutex lock_;
+    std::deque<std::shared_ptr<segment_file>> segments_;
+    // of the entries from start_ to next_ excluded
+    std::deque<position> positions_;
+    nuraft::ulong start_;
+    nuraft::ulong next_;
+    // segments written to since the last fsync
+    std::vector<std::shared_ptr<segment_file>> unsynced_;
+    // files created or removed since the last fsync
+    bool dir_changed_ = false;
+    // bumped by each truncation, so that an fsync started before does not
+    // make the entries written since durable
+    uint64_t truncations_ = 0;
+
+    std::atomic<nuraft::ulong> durable_;
+    // one fsync at a time
+    std::mutex flush_lock_;
+
+    std::function<void(bool)> flush_callback_;
+    std::thread flusher_;
+    std::mutex flusher_lock_;
+    std::condition_variable flusher_cv_;
+    bool flush_requested_ = false;
+    bool stopping_ = false;
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_FILE_LOG_STORE_
@@ -0,0 +1,141 @@
+#include "file_state_mgr.hxx"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#include "raft_logger.hxx"
+
+namespace lrucache {
+
+/**
+ * Content of the file at `path`, or nullptr if there is none.
+ */
+static nuraft::ptr<nuraft::buffer> load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return nullptr;
+    }
+    std::vector<char> content((std::istreambuf_iterator<char>(file)),
+                              std::istreambuf_iterator<char>());
+    if (content.empty()) {
+        return nullptr;
+    }
+    auto buf = nuraft::buffer::alloc(content.size());
+    std::memcpy(buf->data_begin(), content.data(), content.size());
+    return buf;
+}
+
+/**
+ * Replace the file at `path` with `buf` durably, so that a crash leaves
+ * either the old or the new content.
+ */
+static void store(const std::string& path, nuraft::buffer& buf)
+{
+    std::string temp_path = path + ".tmp";
+    int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                    0644);
+    bool ok = fd >= 0;
+    size_t written = 0;
+    while (ok && written < buf.size()) {
+        ssize_t result = ::write(fd, buf.data_begin() + written,
+                                 buf.size() - written);
+        if (result < 0 && errno != EINTR) {
+            ok = false;
+        } else if (result > 0) {
+            written += result;
+        }
+    }
+    ok = ok && fsync(fd) == 0;
+    if (fd >= 0) {
+        close(fd);
+    }
+    ok = ok && rename(temp_path.c_str(), path.c_str()) == 0;
+    if (!ok) {
+        throw std::runtime_error("Error writing " + path + ": "
+                                 + std::strerror(errno));
+    }
+
+    auto slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+    int dir_fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+}
+
+file_state_mgr::file_state_mgr(int srv_id, const std::string& endpoint,
+                               const std::string& dir, size_t segment_size,
+                               int flush_window,
+                               nuraft::ptr<nuraft::logger> logger)
+    : my_id_(srv_id)
+    , config_path_(dir + "/config")
+    , state_path_(dir + "/state")
+    , log_store_(nuraft::cs_new<file_log_store>(dir, segment_size,
+                                                flush_window, logger))
+    , logger_(logger)
+{
+    auto config = load(config_path_);
+    if (config) {
+        saved_config_ = nuraft::cluster_config::deserialize(*config);
+    } else {
+        // the first start: a cluster of this server only
+        saved_config_ = nuraft::cs_new<nuraft::cluster_config>();
+        saved_config_->get_servers().push_back(
+                nuraft::cs_new<nuraft::srv_config>(srv_id, endpoint));
+    }
+    auto state = load(state_path_);
+    if (state) {
+        saved_state_ = nuraft::srv_state::deserialize(*state);
+    }
+}
+
+nuraft::ptr<nuraft::cluster_config> file_state_mgr::load_config()
+{
+    return saved_config_;
+}
+
+void file_state_mgr::save_config(const nuraft::cluster_config& config)
+{
+    nuraft::ptr<nuraft::buffer> buf = config.serialize();
+    store(config_path_, *buf);
+    saved_config_ = nuraft::cluster_config::deserialize(*buf);
+}
+
+void file_state_mgr::save_state(const nuraft::srv_state& state)
+{
+    nuraft::ptr<nuraft::buffer> buf = state.serialize();
+    store(state_path_, *buf);
+    saved_state_ = nuraft::srv_state::deserialize(*buf);
+}
+
+nuraft::ptr<nuraft::srv_state> file_state_mgr::read_state()
+{
+    return saved_state_;
+}
+
+nuraft::ptr<nuraft::log_store> file_state_mgr::load_log_store()
+{
+    return log_store_;
+}
+
+void file_state_mgr::system_exit(const int exit_code)
+{
+    // asked for when the log can't be made durable anymore, or when an
+    // entry can't be committed
+    log_line(logger_, raft_logger::FATAL, __FILE__, __LINE__,
+             "Stopping after a raft failure, code "
+             + std::to_string(exit_code));
+    std::_Exit(exit_code);
+}
+
+} // namespace lrucache
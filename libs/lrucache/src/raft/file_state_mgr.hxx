@@ -0,0 +1,60 @@
+#ifndef LRUCACHE_FILE_STATE_MGR_
+#define LRUCACHE_FILE_STATE_MGR_
+
+#include <string>
+
+#include "file_log_store.hxx"
+#include "libnuraft/nuraft.hxx"
+
+namespace lrucache {
+
+/**
+ * Raft state manager keeping the server state and the cluster config in
+ * files next to a file_log_store, so that a restarting node neither votes
+ * twice in a term nor forgets the members of the cluster.
+ */
+class file_state_mgr : public nuraft::state_mgr {
+public:
+    /**
+     * @param srv_id id of this server
+     * @param endpoint raft address of this server
+     * @param dir directory of the log, the state and the config
+     * @param segment_size see file_log_store
+     * @param flush_window see file_log_store
+     * @param logger see file_log_store, also told why the node stops
+     * @throws std::runtime_error if the log can't be opened
+     */
+    file_state_mgr(int srv_id, const std::string& endpoint,
+                   const std::string& dir, size_t segment_size,
+                   int flush_window,
+                   nuraft::ptr<nuraft::logger> logger = nullptr);
+
+    nuraft::ptr<nuraft::cluster_config> load_config() override;
+
+    void save_config(const nuraft::cluster_config& config) override;
+
+    void save_state(const nuraft::srv_state& state) override;
+
+    nuraft::ptr<nuraft::srv_state> read_state() override;
+
+    nuraft::ptr<nuraft::log_store> load_log_store() override;
+
+    nuraft::int32 server_id() override { return my_id_; }
+
+    void system_exit(const int exit_code) override;
+
+    const nuraft::ptr<file_log_store>& log_store() const { return log_store_; }
+
+private:
+    int my_id_;
+    std::string config_path_;
+    std::string state_path_;
+    nuraft::ptr<file_log_store> log_store_;
+    nuraft::ptr<nuraft::cluster_config> saved_config_;
+    nuraft::ptr<nuraft::srv_state> saved_state_;
+    nuraft::ptr<nuraft::logger> logger_;
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_FILE_STATE_MGR_
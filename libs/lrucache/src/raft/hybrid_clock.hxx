@@ -0,0 +1,89 @@
+#ifndef LRUCACHE_HYBRID_CLOCK_H_
+#define LRUCACHE_HYBRID_CLOCK_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+
+namespace lrucache {
+
+/**
+ * Hybrid logical clock the leader stamps its log entries with, so that
+ * every node applies an entry at the same time whatever its own clock
+ * says.
+ *
+ * A value holds a time in ms in its upper bits, and a counter in its lower
+ * `LOGICAL_BITS` bits telling apart the values given within the same ms.
+ * Values only grow: they follow the wall clock while it is ahead of the
+ * last value given or observed, and count on from that value otherwise,
+ * when the wall clock steps back or when a new leader's clock lags behind
+ * the entries already committed.
+ */
+class hybrid_clock {
+public:
+    static constexpr int LOGICAL_BITS = 16;
+
+    /**
+     * Value later than every one given or observed so far, following the
+     * wall clock.
+     */
+    uint64_t now() {
+        uint64_t wall = from_millis(wall_millis());
+        uint64_t last = last_.load(std::memory_order_relaxed);
+        uint64_t next;
+        do {
+            next = std::max(wall, last + 1);
+        } while (!last_.compare_exchange_weak(last, next,
+                                              std::memory_order_relaxed));
+        return next;
+    }
+
+    /**
+     * Take a value stamped by another node into account, so that the
+     * values given next come after it.
+     */
+    void observe(uint64_t value) {
+        uint64_t last = last_.load(std::memory_order_relaxed);
+        while (last < value
+               && !last_.compare_exchange_weak(last, value,
+                                               std::memory_order_relaxed)) {
+        }
+    }
+
+    /**
+     * Last value given or observed, 0 if none.
+     */
+    uint64_t last() const { return last_.load(std::memory_order_relaxed); }
+
+    /**
+     * Time in ms of a value.
+     */
+    static std::time_t millis(uint64_t value) {
+        return static_cast<std::time_t>(value >> LOGICAL_BITS);
+    }
+
+    /**
+     * First value of a time in ms.
+     */
+    static uint64_t from_millis(std::time_t ms) {
+        return static_cast<uint64_t>(ms) << LOGICAL_BITS;
+    }
+
+    /**
+     * Time of the wall clock, in ms since the epoch. Expiries are given
+     * relative to it.
+     */
+    static std::time_t wall_millis() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    std::atomic<uint64_t> last_{0};
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_HYBRID_CLOCK_H_
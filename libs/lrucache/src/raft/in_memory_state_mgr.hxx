@@ -17,7 +17,7 @@ limitations under the License.
 
 #pragma once
 
-#include "in_memory_log_store.hxx"
+#include "ring_log_store.hxx"
 
 #include "libnuraft/nuraft.hxx"
 
@@ -29,7 +29,7 @@ public:
                     const std::string& endpoint)
         : my_id_(srv_id)
         , my_endpoint_(endpoint)
-        , cur_log_store_( cs_new<inmem_log_store>() )
+        , cur_log_store_( cs_new<lrucache::ring_log_store>() )
     {
         my_srv_config_ = cs_new<srv_config>( srv_id, endpoint );
 
@@ -82,7 +82,7 @@ public:
 private:
     int my_id_;
     std::string my_endpoint_;
-    ptr<inmem_log_store> cur_log_store_;
+    ptr<lrucache::ring_log_store> cur_log_store_;
     ptr<srv_config> my_srv_config_;
     ptr<cluster_config> saved_config_;
     ptr<srv_state> saved_state_;
@@ -0,0 +1,194 @@
+#include "log_batcher.hxx"
+
+#include <algorithm>
+#include <utility>
+
+namespace lrucache {
+
+using op_payload = cache_state_machine::op_payload;
+using op_type = cache_state_machine::op_type;
+
+log_batcher::log_batcher(int window, size_t max_bytes, append_fn append,
+                         hybrid_clock* clock)
+    : window_(window)
+    , max_bytes_(max_bytes)
+    , append_(std::move(append))
+    , clock_(clock)
+{
+    if (window_.count() > 0) {
+        flusher_ = std::thread(&log_batcher::run_flusher, this);
+    }
+}
+
+log_batcher::~log_batcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+    flush();
+}
+
+nuraft::ptr<log_batcher::result> log_batcher::propose(const op_payload& op)
+{
+    if (window_.count() <= 0) {
+        std::lock_guard<std::mutex> order(append_lock_);
+        if (!clock_) {
+            return append_(cache_state_machine::encode_log(op));
+        }
+        op_payload stamped = op;
+        stamp(stamped);
+        return append_(cache_state_machine::encode_log(stamped));
+    }
+
+    auto ret = nuraft::cs_new<result>();
+    bool full;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        queued_op queued;
+        queued.op = op;
+        if (op.type == op_type::READ) {
+            auto read = reads_.emplace(op.key, ops_.size());
+            if (!read.second) {
+                // only the last read of the key counts
+                auto& previous = ops_[read.first->second];
+                previous.dropped = true;
+                previous.replaced_by = ops_.size();
+                bytes_ -= cache_state_machine::encoded_size(previous.op);
+                read.first->second = ops_.size();
+            }
+        } else if (op.type == op_type::TOUCH) {
+            queued.op.hashes.clear();
+            for (auto hash : op.hashes) {
+                if (touched_.insert(hash).second) {
+                    queued.op.hashes.push_back(hash);
+                }
+            }
+            // one without hashes to begin with only moves the clock
+            queued.dropped = !op.hashes.empty() && queued.op.hashes.empty();
+        } else if (op.type == op_type::WRITE || op.type == op_type::CAS) {
+            queued.data.assign(op.data, op.data + op.data_len);
+            queued.op.data = queued.data.data();
+        }
+
+        if (waiting_.empty()) {
+            opened_ = clock::now();
+            cv_.notify_all();
+        }
+        waiting_.emplace_back(ret, queued.dropped ? SIZE_MAX : ops_.size());
+        if (!queued.dropped) {
+            bytes_ += cache_state_machine::encoded_size(queued.op);
+            ops_.push_back(std::move(queued));
+        }
+        full = bytes_ >= max_bytes_;
+    }
+    if (full) {
+        flush();
+    }
+    return ret;
+}
+
+void log_batcher::flush()
+{
+    std::lock_guard<std::mutex> order(append_lock_);
+    std::vector<queued_op> ops;
+    std::vector<std::pair<nuraft::ptr<result>, size_t>> waiting;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (waiting_.empty()) {
+            return;
+        }
+        ops.swap(ops_);
+        waiting.swap(waiting_);
+        bytes_ = 0;
+        reads_.clear();
+        touched_.clear();
+    }
+
+    op_payload batch;
+    batch.type = op_type::BATCH;
+    batch.timestamp = 0;
+    stamp(batch);
+    // place of each queued operation in the batch, a dropped read taking
+    // the place of the read replacing it
+    std::vector<size_t> positions(ops.size(), SIZE_MAX);
+    for (size_t i = 0; i < ops.size(); i++) {
+        auto& queued = ops[i];
+        if (!queued.dropped) {
+            positions[i] = batch.ops.size();
+            if (clock_) {
+                queued.op.timestamp = batch.timestamp;
+            }
+            batch.timestamp = std::max(batch.timestamp, queued.op.timestamp);
+            batch.ops.push_back(std::move(queued.op));
+        }
+    }
+    for (size_t i = ops.size(); i-- > 0;) {
+        if (ops[i].replaced_by != SIZE_MAX) {
+            positions[i] = positions[ops[i].replaced_by];
+        }
+    }
+    for (auto& each : waiting) {
+        if (each.second != SIZE_MAX) {
+            each.second = positions[each.second];
+        }
+    }
+    nuraft::ptr<result> ret;
+    if (batch.ops.empty()) {
+        // nothing new to replicate
+        ret = nuraft::cs_new<result>();
+        ret->accept();
+        nuraft::ptr<nuraft::buffer> none;
+        nuraft::ptr<std::exception> err;
+        ret->set_result(none, err);
+    } else {
+        ret = append_(batch.ops.size() == 1
+                      ? cache_state_machine::encode_log(batch.ops.front())
+                      : cache_state_machine::encode_log(batch));
+    }
+
+    result::handler_type2 forward = [waiting](
+            result& r, nuraft::ptr<std::exception>& err) {
+        for (auto& each : waiting) {
+            if (r.get_accepted()) {
+                each.first->accept();
+            }
+            auto own = cache_state_machine::slice_result(r.get(),
+                                                         each.second);
+            each.first->set_result(own, err, r.get_result_code());
+        }
+    };
+    ret->when_ready(forward);
+}
+
+void log_batcher::stamp(op_payload& op)
+{
+    if (clock_) {
+        op.timestamp = static_cast<time_t>(clock_->now());
+    }
+}
+
+void log_batcher::run_flusher()
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    while (!stopping_) {
+        if (waiting_.empty()) {
+            cv_.wait(lock);
+            continue;
+        }
+        auto due = opened_ + window_;
+        if (clock::now() < due) {
+            cv_.wait_until(lock, due);
+            continue;
+        }
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
+
+} // namespace lrucache
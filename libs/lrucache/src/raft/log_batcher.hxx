@@ -0,0 +1,142 @@
+#ifndef LRUCACHE_LOG_BATCHER_
+#define LRUCACHE_LOG_BATCHER_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "cache_state_machine.hxx"
+#include "hybrid_clock.hxx"
+#include "libnuraft/nuraft.hxx"
+
+namespace lrucache {
+
+/**
+ * Leader side batcher coalescing the operations proposed within a window
+ * of time, or up to a byte budget, into a single BATCH log entry, so that
+ * the cost of replicating an entry is shared by all of them.
+ *
+ * The first operation of a batch opens its window; the batch is appended
+ * once the window is over, or right away once its operations add up to
+ * the byte budget. Repeated reads of a key and repeated touches of a key
+ * hash within a batch are only replicated once, at their last and first
+ * place respectively. Batches are appended in the order they were filled,
+ * and the results of their operations set together, each holding the
+ * outcome of its own operation, see `cache_state_machine::slice_result()`.
+ * A dropped read gets the outcome of the read of the key replicated.
+ *
+ * Given a clock, each entry is stamped as it is appended, all of its
+ * operations with the same value, so that the entries of the log are
+ * stamped in order.
+ */
+class log_batcher {
+public:
+    using result = nuraft::cmd_result<nuraft::ptr<nuraft::buffer>>;
+
+    /**
+     * Appends a log entry to the Raft log, returning its result.
+     */
+    using append_fn =
+            std::function<nuraft::ptr<result>(nuraft::ptr<nuraft::buffer>)>;
+
+    /**
+     * @param window time in µs a batch waits for more operations after
+     *               its first one. 0 to append every operation on its own
+     *               right away.
+     * @param max_bytes size of the encoded operations from which a batch
+     *                  is appended without waiting for its window.
+     * @param append called to append each batch.
+     * @param clock stamps each entry appended, nullptr to keep the
+     *              timestamps of the operations proposed.
+     */
+    log_batcher(int window, size_t max_bytes, append_fn append,
+                hybrid_clock* clock = nullptr);
+
+    /**
+     * Append the batch left, if any.
+     */
+    ~log_batcher();
+
+    log_batcher(const log_batcher&) = delete;
+    log_batcher& operator=(const log_batcher&) = delete;
+
+    /**
+     * Add an operation to the batch being filled.
+     *
+     * @param op operation to replicate. The data of a WRITE or a CAS is
+     *           copied. A TOUCH without hashes is kept, to move the clock
+     *           of the nodes forward.
+     * @return result of the operation, set along with the others of its
+     *         batch once the batch is committed or rejected
+     */
+    nuraft::ptr<result> propose(const cache_state_machine::op_payload& op);
+
+    /**
+     * Append the batch being filled right away.
+     */
+    void flush();
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * Operation queued, dropped when repeated later in the batch.
+     */
+    struct queued_op {
+        cache_state_machine::op_payload op;
+        // owns the data of a WRITE or a CAS
+        std::vector<unsigned char> data;
+        bool dropped = false;
+        // later read of the same key replacing a dropped read
+        size_t replaced_by = SIZE_MAX;
+    };
+
+    /**
+     * Append the batches whose window is over, until stopped.
+     */
+    void run_flusher();
+
+    /**
+     * Stamp an operation with the next value of `clock_`, if any. Called
+     * with `append_lock_` held.
+     */
+    void stamp(cache_state_machine::op_payload& op);
+
+    std::chrono::microseconds window_;
+    size_t max_bytes_;
+    append_fn append_;
+    hybrid_clock* clock_;
+
+    // serializes the appends, so that batches keep their order
+    std::mutex append_lock_;
+
+    // guards everything below
+    std::mutex lock_;
+    std::condition_variable cv_;
+    std::vector<queued_op> ops_;
+    // results of the operations of the batch, set along, and the place
+    // of each operation in `ops_`, SIZE_MAX if dropped right away
+    std::vector<std::pair<nuraft::ptr<result>, size_t>> waiting_;
+    // time the batch was opened at, and size of its operations
+    clock::time_point opened_;
+    size_t bytes_ = 0;
+    // places of the reads, and key hashes touched, in the batch
+    std::unordered_map<std::string, size_t> reads_;
+    std::unordered_set<uint64_t> touched_;
+    bool stopping_ = false;
+
+    std::thread flusher_;
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_LOG_BATCHER_
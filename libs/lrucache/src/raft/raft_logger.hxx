@@ -0,0 +1,68 @@
+#ifndef LRUCACHE_RAFT_LOGGER_H_
+#define LRUCACHE_RAFT_LOGGER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+#include "libnuraft/nuraft.hxx"
+
+namespace lrucache {
+
+/**
+ * NuRaft logger writing the lines up to its level to stderr. The one of a
+ * node is given to NuRaft and to its state machine and log store, which
+ * report through it what they recover from.
+ */
+class raft_logger : public nuraft::logger {
+public:
+    // levels of NuRaft, see `nuraft::logger::put_details()`
+    static constexpr int FATAL = 1;
+    static constexpr int ERROR = 2;
+    static constexpr int WARNING = 3;
+    static constexpr int INFO = 4;
+
+    explicit raft_logger(int level) : level_(level) {}
+
+    void put_details(int level, const char* source_file,
+                     const char* func_name, size_t line_number,
+                     const std::string& log_line) override {
+        if (level > level_) {
+            return;
+        }
+        static const char* const names[] = {
+            "", "FATAL", "ERROR", "WARN", "INFO", "DEBUG", "TRACE" };
+        const char* file = std::strrchr(source_file, '/');
+        std::lock_guard<std::mutex> lock(lock_);
+        std::cerr << "[" << names[level < 1 || level > 6 ? 0 : level] << "] "
+                  << (file ? file + 1 : source_file) << ":" << line_number
+                  << " " << log_line << std::endl;
+    }
+
+    void set_level(int level) override { level_ = level; }
+
+    int get_level() override { return level_; }
+
+private:
+    std::atomic<int> level_;
+    std::mutex lock_;
+};
+
+/**
+ * Put a line in `logger`, if there is one.
+ */
+inline void log_line(const nuraft::ptr<nuraft::logger>& logger, int level,
+                     const char* source_file, size_t line_number,
+                     const std::string& line)
+{
+    if (logger && level <= logger->get_level()) {
+        logger->put_details(level, source_file, "", line_number, line);
+    }
+}
+
+} // namespace lrucache
+
+#endif // LRUCACHE_RAFT_LOGGER_H_
@@ -1,8 +1,12 @@
 #include "raft_manager.hxx"
 
 #include "in_memory_state_mgr.hxx"
+#include "file_state_mgr.hxx"
 #include "cache_state_machine.hxx"
+#include "raft_logger.hxx"
 
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
 
 namespace lrucache {
@@ -15,9 +19,32 @@ raft_manager::raft_manager(cache_config config, int server_id)
     , server_id_(server_id)
 {
     std::string endpoint = config.raft_endpoint();
-    state_mgr_ = nuraft::cs_new<nuraft::inmem_state_mgr>(server_id_, endpoint);
+    logger_ = nuraft::cs_new<raft_logger>(config.log_level);
+    nuraft::ptr<file_log_store> log_store;
+    if (config.log_dir.empty()) {
+        state_mgr_ = nuraft::cs_new<nuraft::inmem_state_mgr>(server_id_,
+                                                             endpoint);
+    } else {
+        auto state_mgr = nuraft::cs_new<file_state_mgr>(
+                server_id_, endpoint, config.log_dir, config.log_segment_size,
+                config.log_flush_window, logger_);
+        log_store = state_mgr->log_store();
+        state_mgr_ = state_mgr;
+    }
     state_machine_ = nuraft::cs_new<cache_state_machine>(
-            config, ASYNC_SNAPSHOT_CREATION);
+            config, ASYNC_SNAPSHOT_CREATION, logger_);
+
+    // resume from the snapshot persisted before a restart: the logs it
+    // covers are not asked for again, only the ones committed since
+    auto snapshot = state_machine_->last_snapshot();
+    if (snapshot) {
+        state_mgr_->load_log_store()->compact(snapshot->get_last_log_idx());
+        // unless the log kept a more recent one
+        auto config = snapshot->get_last_config();
+        if (config->get_log_idx() > state_mgr_->load_config()->get_log_idx()) {
+            state_mgr_->save_config(*config);
+        }
+    }
 
     // ASIO options
     nuraft::asio_service::options asio_opt;
@@ -32,14 +59,241 @@ raft_manager::raft_manager(cache_config config, int server_id)
     params.snapshot_distance_ = config.snapshot_distance;
     params.client_req_timeout_ = config.client_req_timeout;
     params.return_method_ = nuraft::raft_params::async_handler;
-    
+    // the log is fsync'ed in the background: commit only what it reports
+    // as durable
+    params.parallel_log_appending_ = log_store && config.log_flush_window > 0;
+    // followers serve reads too, and hand their touches over to the leader
+    params.auto_forwarding_ = true;
+
+    nuraft::raft_server::init_options opt;
+    opt.raft_callback_ = [this](nuraft::cb_func::Type type,
+                                nuraft::cb_func::Param* param) {
+        return on_raft_event(type, param);
+    };
+
     // launch raft server
-    m_instance_ = launcher_.init(state_machine_, state_mgr_, nullptr,
-            config.raft_port, asio_opt, params);
+    m_instance_ = launcher_.init(state_machine_, state_mgr_, logger_,
+            config.raft_port, asio_opt, params, opt);
 
     if (!m_instance_) {
         throw std::runtime_error("Failed to initialize raft server");
     }
+
+    if (params.parallel_log_appending_) {
+        std::weak_ptr<nuraft::raft_server> server = m_instance_;
+        log_store->set_flush_callback([server](bool ok) {
+            if (auto instance = server.lock()) {
+                instance->notify_log_append_completion(ok);
+            }
+        });
+    }
+
+    auto machine = std::static_pointer_cast<cache_state_machine>(
+            state_machine_);
+    batcher_ = std::make_unique<log_batcher>(
+            config.batch_window, config.batch_max_bytes,
+            [this](nuraft::ptr<nuraft::buffer> entry) {
+                return m_instance_->append_entries({ entry });
+            },
+            &machine->clock());
+
+    touch_timer_ = std::thread(&raft_manager::run_touch_timer, this);
+}
+
+raft_manager::~raft_manager()
+{
+    {
+        std::lock_guard<std::mutex> lock(touch_lock_);
+        stopping_ = true;
+    }
+    touch_cv_.notify_all();
+    if (touch_timer_.joinable()) {
+        touch_timer_.join();
+    }
+    batcher_.reset();
+    // no callback may run once this is gone
+    launcher_.shutdown();
+}
+
+bool raft_manager::read(const std::string& key,
+                        std::function<void(unsigned char*, size_t)> then)
+{
+    auto deadline = clock::now()
+                    + std::chrono::milliseconds(config_.client_req_timeout);
+    nuraft::ulong index;
+    if (!read_index(deadline, index) || !wait_applied(index, deadline)) {
+        return false;
+    }
+    auto machine = std::static_pointer_cast<cache_state_machine>(
+            state_machine_);
+    machine->state().read_then(key, then, true);
+    return true;
+}
+
+bool raft_manager::read_index(clock::time_point deadline,
+                              nuraft::ulong& index)
+{
+    auto start = clock::now();
+    auto poll = std::chrono::milliseconds(
+            std::max(1, config_.heart_beat_interval / 10));
+    auto log_store = state_mgr_->load_log_store();
+
+    while (clock::now() < deadline) {
+        if (!m_instance_->is_leader()) {
+            return leader_index(deadline, index);
+        }
+
+        // the entries of the previous terms are only known to be committed
+        // once one of this term is
+        index = m_instance_->get_committed_log_idx();
+        if (log_store->term_at(index) == m_instance_->get_term()) {
+            // while a quorum answered less than the lease ago, none of them
+            // voted for another leader: they turn down votes until their
+            // election timeout. Otherwise, wait for a quorum to answer again.
+            auto since_start = std::chrono::duration_cast<
+                    std::chrono::microseconds>(clock::now() - start).count();
+            nuraft::ulong within = std::max<nuraft::ulong>(
+                    config_.read_lease * 1000, since_start);
+            size_t answered, quorum;
+            count_answers(within, answered, quorum);
+            if (answered >= quorum) {
+                return true;
+            }
+        }
+        std::this_thread::sleep_for(poll);
+    }
+    return false;
+}
+
+bool raft_manager::leader_index(clock::time_point deadline,
+                                nuraft::ulong& index)
+{
+    // an entry the leader commits once the read started comes after every
+    // write committed before, its own quorum confirming that it still
+    // leads. An empty TOUCH only moves the clock, and shares the entry of
+    // the operations proposed along.
+    cache_state_machine::op_payload payload;
+    payload.type = cache_state_machine::op_type::TOUCH;
+    // stamped by the batcher
+    payload.timestamp = 0;
+    auto ret = propose(payload);
+
+    struct outcome {
+        std::mutex lock;
+        std::condition_variable cv;
+        bool ready = false;
+        bool committed = false;
+        nuraft::ulong index = 0;
+    };
+    auto done = std::make_shared<outcome>();
+    ret->when_ready([done](log_batcher::result& result,
+                           nuraft::ptr<std::exception>& err) {
+        std::lock_guard<std::mutex> lock(done->lock);
+        done->committed = !err && result.get_accepted()
+                && result.get_result_code() == nuraft::cmd_result_code::OK
+                && result.get()
+                && cache_state_machine::read_log_idx(*result.get(),
+                                                     done->index);
+        done->ready = true;
+        done->cv.notify_all();
+    });
+
+    std::unique_lock<std::mutex> lock(done->lock);
+    if (!done->cv.wait_until(lock, deadline, [&] { return done->ready; })
+            || !done->committed) {
+        return false;
+    }
+    index = done->index;
+    return true;
+}
+
+void raft_manager::count_answers(nuraft::ulong within_us, size_t& answered,
+                                 size_t& quorum)
+{
+    std::vector<nuraft::ptr<nuraft::srv_config>> configs;
+    m_instance_->get_srv_config_all(configs);
+    size_t voters = 0;
+    for (auto& config : configs) {
+        if (!config->is_learner()) {
+            voters++;
+        }
+    }
+    quorum = voters / 2 + 1;
+
+    answered = 1;
+    for (auto& peer : m_instance_->get_peer_info_all()) {
+        auto config = m_instance_->get_srv_config(peer.id_);
+        if (config && !config->is_learner()
+                && peer.last_succ_resp_us_ < within_us) {
+            answered++;
+        }
+    }
+}
+
+bool raft_manager::wait_applied(nuraft::ulong index,
+                                clock::time_point deadline)
+{
+    auto machine = std::static_pointer_cast<cache_state_machine>(
+            state_machine_);
+    // snapshots installed do not notify
+    auto poll = std::chrono::milliseconds(config_.heart_beat_interval);
+    std::unique_lock<std::mutex> lock(read_lock_);
+    apply_waiters_++;
+    while (machine->last_commit_index() < index) {
+        if (clock::now() >= deadline) {
+            apply_waiters_--;
+            return false;
+        }
+        read_cv_.wait_until(lock, std::min(deadline, clock::now() + poll));
+    }
+    apply_waiters_--;
+    return true;
+}
+
+nuraft::cb_func::ReturnCode raft_manager::on_raft_event(
+        nuraft::cb_func::Type type, nuraft::cb_func::Param* param)
+{
+    if (type == nuraft::cb_func::StateMachineExecution
+            && apply_waiters_ > 0) {
+        std::lock_guard<std::mutex> lock(read_lock_);
+        read_cv_.notify_all();
+    }
+    return nuraft::cb_func::Ok;
+}
+
+void raft_manager::propose_touches()
+{
+    auto machine = std::static_pointer_cast<cache_state_machine>(
+            state_machine_);
+    cache_state_machine::op_payload payload;
+    payload.type = cache_state_machine::op_type::TOUCH;
+    // stamped by the batcher
+    payload.timestamp = 0;
+    payload.hashes = machine->state().collect_touches();
+    if (payload.hashes.empty()) {
+        auto lag = hybrid_clock::wall_millis() - machine->state().clock();
+        if (lag < config_.touch_interval || !m_instance_->is_leader()) {
+            return;
+        }
+    }
+    propose(payload);
+}
+
+nuraft::ptr<log_batcher::result> raft_manager::propose(
+        const cache_state_machine::op_payload& op)
+{
+    return batcher_->propose(op);
+}
+
+void raft_manager::run_touch_timer()
+{
+    auto interval = std::chrono::milliseconds(config_.touch_interval);
+    std::unique_lock<std::mutex> lock(touch_lock_);
+    while (!touch_cv_.wait_for(lock, interval, [this] { return stopping_; })) {
+        lock.unlock();
+        propose_touches();
+        lock.lock();
+    }
 }
 
 } // namespace lrucache
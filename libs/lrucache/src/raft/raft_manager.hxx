@@ -1,8 +1,19 @@
 #ifndef LRUCACHE_RAFT_MANAGER_H_
 #define LRUCACHE_RAFT_MANAGER_H_
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
 #include "lrucache/cache_config.hxx"
 #include "libnuraft/nuraft.hxx"
+#include "log_batcher.hxx"
 
 namespace lrucache {
 
@@ -10,17 +21,116 @@ class raft_manager {
 public:
     raft_manager(cache_config config, int server_id);
 
+    ~raft_manager();
+
     nuraft::ptr<nuraft::raft_server> instance() { return m_instance_; }
 
+    /**
+     * Read the value of `key` from the local cache state, with the same
+     * guarantees as a READ going through the log: every write committed
+     * before the call is seen.
+     *
+     * The leader answers right away while it holds its lease, that is while
+     * a quorum of voters answered it less than `config.read_lease` ms ago.
+     * Otherwise the read waits for a quorum to answer again. Followers ask
+     * the leader for the index to read at through an entry of the log,
+     * shared with the operations proposed along. The read then waits for
+     * the state machine to apply that index. The item read is put back in
+     * front of the eviction queue through the next batch of touches.
+     *
+     * @param key key of the data to read.
+     * @param then callback taking the data read and its length, or nullptr
+     *             if there is none. The data is only valid during the call.
+     * @return false, without calling `then`, if the read index could not
+     *         be confirmed within `config.client_req_timeout` ms, when there
+     *         is no leader for instance
+     */
+    bool read(const std::string& key,
+              std::function<void(unsigned char*, size_t)> then);
+
+    /**
+     * Replicate an operation through the log, in the same entry as the
+     * ones proposed within `config.batch_window` µs.
+     *
+     * @param op operation to replicate
+     * @return result of the operation, set once the log entry holding it
+     *         is committed or rejected
+     */
+    nuraft::ptr<log_batcher::result> propose(
+            const cache_state_machine::op_payload& op);
+
+    /**
+     * Replicate the reads recorded since the last call as a single TOUCH
+     * log entry, so that every node updates its recency order the same
+     * way. Called every `config.touch_interval` ms.
+     *
+     * With nothing read, the leader still proposes an empty TOUCH once the
+     * clock of the last commit lags that long behind its own, so that the
+     * items of an idle cache expire on time.
+     */
+    void propose_touches();
+
 private:
+    using clock = std::chrono::steady_clock;
+
+    void run_touch_timer();
+
+    /**
+     * Commit index a read starting now must see, once confirmed that no
+     * other leader could have committed past it.
+     *
+     * @return false if it could not be confirmed before `deadline`
+     */
+    bool read_index(clock::time_point deadline, nuraft::ulong& index);
+
+    /**
+     * Read index of a follower: the index of an entry proposed through
+     * the leader, and committed by it once the read started.
+     *
+     * @return false if the entry was not committed before `deadline`
+     */
+    bool leader_index(clock::time_point deadline, nuraft::ulong& index);
+
+    /**
+     * Number of voters, this leader included, that answered it less than
+     * `within_us` µs ago, along with the quorum needed.
+     */
+    void count_answers(nuraft::ulong within_us, size_t& answered,
+                       size_t& quorum);
+
+    /**
+     * Wait for the state machine to apply the log up to `index`.
+     *
+     * @return false if it did not before `deadline`
+     */
+    bool wait_applied(nuraft::ulong index, clock::time_point deadline);
+
+    nuraft::cb_func::ReturnCode on_raft_event(nuraft::cb_func::Type type,
+                                              nuraft::cb_func::Param* param);
+
     cache_config config_;
 
     int server_id_;
 
+    // shared by NuRaft, the state machine and the log
+    nuraft::ptr<nuraft::logger> logger_;
     nuraft::ptr<nuraft::state_mgr> state_mgr_;
     nuraft::ptr<nuraft::state_machine> state_machine_;
     nuraft::raft_launcher launcher_;
     nuraft::ptr<nuraft::raft_server> m_instance_;
+    std::unique_ptr<log_batcher> batcher_;
+
+    // periodically calls `propose_touches()`
+    std::thread touch_timer_;
+    std::mutex touch_lock_;
+    std::condition_variable touch_cv_;
+    bool stopping_ = false;
+
+    // guards the progress reads wait for
+    std::mutex read_lock_;
+    std::condition_variable read_cv_;
+    // reads waiting for the state machine, for commits to wake them up
+    std::atomic<size_t> apply_waiters_{0};
 };
 
 }
@@ -0,0 +1,316 @@
+#include "ring_log_store.hxx"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace lrucache {
+
+using nuraft::buffer;
+using nuraft::cs_new;
+using nuraft::log_entry;
+using nuraft::ptr;
+using nuraft::ulong;
+
+// empty slabs kept for the next appends, the others being freed
+constexpr size_t MAX_FREE_SLABS = 4;
+
+static ptr<log_entry> dummy_entry()
+{
+    return cs_new<log_entry>(0, buffer::alloc(sizeof(ulong)));
+}
+
+ring_log_store::ring_log_store()
+    : ring_(new std::atomic<slab*>[RING_SIZE])
+    , start_(1)
+    , next_(1)
+{
+    for (size_t i = 0; i < RING_SIZE; i++) {
+        ring_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+ring_log_store::~ring_log_store()
+{
+    for (size_t i = 0; i < RING_SIZE; i++) {
+        delete ring_[i].load(std::memory_order_relaxed);
+    }
+    for (auto& retired : retired_) {
+        delete retired.second;
+    }
+    for (auto free : free_) {
+        delete free;
+    }
+}
+
+ulong ring_log_store::next_slot() const
+{
+    return next_.load(std::memory_order_acquire);
+}
+
+ulong ring_log_store::start_index() const
+{
+    return start_.load(std::memory_order_acquire);
+}
+
+const ptr<log_entry>* ring_log_store::find(ulong index) const
+{
+    if (index < start_.load(std::memory_order_acquire)
+            || index >= next_.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    slab* s = ring_slot(index).load(std::memory_order_acquire);
+    // the slab may have been compacted away and its slot of the ring
+    // reused meanwhile
+    if (!s || s->first != index - index % SLAB_SIZE) {
+        return nullptr;
+    }
+    auto& entry = s->entries[index % SLAB_SIZE];
+    return entry ? &entry : nullptr;
+}
+
+ptr<log_entry> ring_log_store::hand_out(const ptr<log_entry>& entry)
+{
+    if (entry->get_val_type() == nuraft::log_val_type::app_log) {
+        return entry;
+    }
+    return cs_new<log_entry>(entry->get_term(),
+                             buffer::clone(entry->get_buf()),
+                             entry->get_val_type(),
+                             entry->get_timestamp(),
+                             entry->has_crc32(),
+                             entry->get_crc32(),
+                             false);
+}
+
+ptr<log_entry> ring_log_store::last_entry() const
+{
+    auto guard = epoch_.pin();
+    auto entry = find(next_.load(std::memory_order_acquire) - 1);
+    return entry ? hand_out(*entry) : dummy_entry();
+}
+
+ulong ring_log_store::append(ptr<log_entry>& entry)
+{
+    std::lock_guard<std::mutex> lock(write_lock_);
+    ulong index = next_.load(std::memory_order_relaxed);
+    push(entry);
+    return index;
+}
+
+void ring_log_store::write_at(ulong index, ptr<log_entry>& entry)
+{
+    std::lock_guard<std::mutex> lock(write_lock_);
+    truncate(index);
+    push(entry);
+}
+
+void ring_log_store::push(const ptr<log_entry>& entry)
+{
+    ulong index = next_.load(std::memory_order_relaxed);
+    ulong start = start_.load(std::memory_order_relaxed);
+    if (index / SLAB_SIZE - start / SLAB_SIZE >= RING_SIZE) {
+        throw std::length_error("Raft log too long to be kept in memory");
+    }
+    auto& slot = ring_slot(index);
+    slab* s = slot.load(std::memory_order_relaxed);
+    if (s && s->first != index - index % SLAB_SIZE) {
+        // left over by a truncation before the log was reset
+        retire(index);
+        s = nullptr;
+    }
+    if (!s) {
+        s = allocate();
+        s->first = index - index % SLAB_SIZE;
+        slot.store(s, std::memory_order_release);
+    }
+    s->entries[index % SLAB_SIZE] = entry;
+    next_.store(index + 1, std::memory_order_release);
+}
+
+void ring_log_store::truncate(ulong index)
+{
+    ulong next = next_.load(std::memory_order_relaxed);
+    if (index >= next) {
+        return;
+    }
+    if (index < start_.load(std::memory_order_relaxed)) {
+        reset(index);
+        return;
+    }
+    // the entries are overwritten in place, once no reader can be using
+    // them. Only followers whose log diverged from the leader's get here.
+    next_.store(index, std::memory_order_release);
+    epoch_.synchronize();
+    for (ulong i = index; i < next; i++) {
+        slab* s = ring_slot(i).load(std::memory_order_relaxed);
+        if (s) {
+            s->entries[i % SLAB_SIZE].reset();
+        }
+    }
+}
+
+void ring_log_store::reset(ulong start)
+{
+    ulong first = start_.load(std::memory_order_relaxed);
+    ulong next = next_.load(std::memory_order_relaxed);
+    next_.store(first, std::memory_order_release);
+    for (ulong i = first - first % SLAB_SIZE; i < next; i += SLAB_SIZE) {
+        retire(i);
+    }
+    start_.store(start, std::memory_order_release);
+    next_.store(start, std::memory_order_release);
+}
+
+bool ring_log_store::compact(ulong last_log_index)
+{
+    std::lock_guard<std::mutex> lock(write_lock_);
+    ulong start = start_.load(std::memory_order_relaxed);
+    if (last_log_index < start) {
+        return true;
+    }
+    if (last_log_index >= next_.load(std::memory_order_relaxed) - 1) {
+        reset(last_log_index + 1);
+        return true;
+    }
+
+    start_.store(last_log_index + 1, std::memory_order_release);
+    // the slabs whose every entry is compacted
+    for (ulong i = start - start % SLAB_SIZE;
+         i + SLAB_SIZE <= last_log_index + 1; i += SLAB_SIZE) {
+        retire(i);
+    }
+    return true;
+}
+
+void ring_log_store::retire(ulong index)
+{
+    slab* s = ring_slot(index).exchange(nullptr, std::memory_order_acq_rel);
+    if (s) {
+        retired_.emplace_back(epoch_.retire_epoch(), s);
+    }
+}
+
+ring_log_store::slab* ring_log_store::allocate()
+{
+    if (!retired_.empty()) {
+        uint64_t safe = epoch_.safe_epoch();
+        auto it = std::stable_partition(
+                retired_.begin(), retired_.end(),
+                [safe](const std::pair<uint64_t, slab*>& retired) {
+                    return retired.first >= safe;
+                });
+        for (auto reclaimed = it; reclaimed != retired_.end(); ++reclaimed) {
+            if (free_.size() < MAX_FREE_SLABS) {
+                for (auto& entry : reclaimed->second->entries) {
+                    entry.reset();
+                }
+                free_.push_back(reclaimed->second);
+            } else {
+                delete reclaimed->second;
+            }
+        }
+        retired_.erase(it, retired_.end());
+    }
+    if (free_.empty()) {
+        return new slab();
+    }
+    slab* s = free_.back();
+    free_.pop_back();
+    return s;
+}
+
+ptr<std::vector<ptr<log_entry>>> ring_log_store::log_entries(ulong start,
+                                                             ulong end)
+{
+    return log_entries_ext(start, end, 0);
+}
+
+ptr<std::vector<ptr<log_entry>>> ring_log_store::log_entries_ext(
+        ulong start, ulong end, nuraft::int64 batch_size_hint_in_bytes)
+{
+    auto result = cs_new<std::vector<ptr<log_entry>>>();
+    if (batch_size_hint_in_bytes < 0) {
+        return result;
+    }
+    result->reserve(end > start ? end - start : 0);
+
+    auto guard = epoch_.pin();
+    size_t bytes = 0;
+    for (ulong i = start; i < end; i++) {
+        auto entry = find(i);
+        if (!entry) {
+            break;
+        }
+        result->push_back(hand_out(*entry));
+        bytes += (*entry)->get_buf().size();
+        if (batch_size_hint_in_bytes
+                && bytes >= static_cast<size_t>(batch_size_hint_in_bytes)) {
+            break;
+        }
+    }
+    return result;
+}
+
+ptr<log_entry> ring_log_store::entry_at(ulong index)
+{
+    auto guard = epoch_.pin();
+    auto entry = find(index);
+    return entry ? hand_out(*entry) : dummy_entry();
+}
+
+ulong ring_log_store::term_at(ulong index)
+{
+    auto guard = epoch_.pin();
+    auto entry = find(index);
+    return entry ? (*entry)->get_term() : 0;
+}
+
+ptr<buffer> ring_log_store::pack(ulong index, nuraft::int32 cnt)
+{
+    std::vector<ptr<buffer>> logs;
+    size_t size_total = 0;
+    {
+        auto guard = epoch_.pin();
+        for (ulong i = index; i < index + cnt; i++) {
+            auto entry = find(i);
+            if (!entry) {
+                break;
+            }
+            logs.push_back(hand_out(*entry)->serialize());
+            size_total += logs.back()->size();
+        }
+    }
+
+    ptr<buffer> buf_out = buffer::alloc(sizeof(nuraft::int32)
+                                        + logs.size() * sizeof(nuraft::int32)
+                                        + size_total);
+    buf_out->pos(0);
+    buf_out->put(static_cast<nuraft::int32>(logs.size()));
+    for (auto& buf : logs) {
+        buf_out->put(static_cast<nuraft::int32>(buf->size()));
+        buf_out->put(*buf);
+    }
+    return buf_out;
+}
+
+void ring_log_store::apply_pack(ulong index, buffer& pack)
+{
+    pack.pos(0);
+    nuraft::int32 num_logs = pack.get_int();
+
+    std::lock_guard<std::mutex> lock(write_lock_);
+    if (index < start_.load(std::memory_order_relaxed)
+            || index > next_.load(std::memory_order_relaxed)) {
+        reset(index);
+    } else {
+        truncate(index);
+    }
+    for (nuraft::int32 i = 0; i < num_logs; i++) {
+        nuraft::int32 buf_size = pack.get_int();
+        ptr<buffer> buf_local = buffer::alloc(buf_size);
+        pack.get(buf_local);
+        push(log_entry::deserialize(*buf_local));
+    }
+}
+
+} // namespace lrucache
@@ -0,0 +1,149 @@
+#ifndef LRUCACHE_RING_LOG_STORE_
+#define LRUCACHE_RING_LOG_STORE_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "cache/epoch_manager.hxx"
+#include "libnuraft/nuraft.hxx"
+
+namespace lrucache {
+
+/**
+ * In memory Raft log store keeping the entries in a ring of slabs indexed
+ * by log index, without copying them.
+ *
+ * Entry `i` is in slot `i % SLAB_SIZE` of the slab at `i / SLAB_SIZE` in the
+ * ring. Writers are serialized, while reads take no lock: readers pin an
+ * epoch, and the slabs compacted away are only reused once no reader can
+ * see them anymore. Compaction thus only advances the head of the ring and
+ * retires the slabs left behind.
+ *
+ * Application entries are stored and handed out as they are appended,
+ * their payloads being shared by every reader. Those are only read through
+ * serializers by the state machine and by the replication, which leave the
+ * buffers untouched but for rewinding them. The other entries, such as
+ * configs, are parsed in place by NuRaft, and are handed out as copies.
+ */
+class ring_log_store : public nuraft::log_store {
+public:
+    // entries per slab
+    static constexpr size_t SLAB_SIZE = 4096;
+    // slabs in the ring, bounding the number of entries not compacted
+    static constexpr size_t RING_SIZE = 65536;
+
+    ring_log_store();
+
+    ~ring_log_store();
+
+    __nocopy__(ring_log_store);
+
+public:
+    nuraft::ulong next_slot() const override;
+
+    nuraft::ulong start_index() const override;
+
+    nuraft::ptr<nuraft::log_entry> last_entry() const override;
+
+    /**
+     * @throws std::length_error if the entries not compacted would not fit
+     *         in the ring
+     */
+    nuraft::ulong append(nuraft::ptr<nuraft::log_entry>& entry) override;
+
+    void write_at(nuraft::ulong index,
+                  nuraft::ptr<nuraft::log_entry>& entry) override;
+
+    nuraft::ptr<std::vector<nuraft::ptr<nuraft::log_entry>>> log_entries(
+            nuraft::ulong start, nuraft::ulong end) override;
+
+    nuraft::ptr<std::vector<nuraft::ptr<nuraft::log_entry>>> log_entries_ext(
+            nuraft::ulong start, nuraft::ulong end,
+            nuraft::int64 batch_size_hint_in_bytes = 0) override;
+
+    nuraft::ptr<nuraft::log_entry> entry_at(nuraft::ulong index) override;
+
+    nuraft::ulong term_at(nuraft::ulong index) override;
+
+    nuraft::ptr<nuraft::buffer> pack(nuraft::ulong index,
+                                     nuraft::int32 cnt) override;
+
+    void apply_pack(nuraft::ulong index, nuraft::buffer& pack) override;
+
+    bool compact(nuraft::ulong last_log_index) override;
+
+    bool flush() override { return true; }
+
+private:
+    struct slab {
+        // index of the entry in the first slot
+        nuraft::ulong first;
+        nuraft::ptr<nuraft::log_entry> entries[SLAB_SIZE];
+    };
+
+    std::atomic<slab*>& ring_slot(nuraft::ulong index) const {
+        return ring_[(index / SLAB_SIZE) % RING_SIZE];
+    }
+
+    /**
+     * Entry `index`, or nullptr if there is none. The epoch must be pinned
+     * for as long as the result is used.
+     */
+    const nuraft::ptr<nuraft::log_entry>* find(nuraft::ulong index) const;
+
+    /**
+     * `entry` itself if it is an application entry, a copy otherwise.
+     */
+    static nuraft::ptr<nuraft::log_entry> hand_out(
+            const nuraft::ptr<nuraft::log_entry>& entry);
+
+    /**
+     * Store `entry` at `next_` and publish it. The write lock must be held.
+     */
+    void push(const nuraft::ptr<nuraft::log_entry>& entry);
+
+    /**
+     * Remove the entries from `index` on. The write lock must be held.
+     */
+    void truncate(nuraft::ulong index);
+
+    /**
+     * Drop every entry, the next one being `start`. The write lock must be
+     * held.
+     */
+    void reset(nuraft::ulong start);
+
+    /**
+     * Unlink the slab of `index` from the ring, to be reused once no reader
+     * can see it. The write lock must be held.
+     */
+    void retire(nuraft::ulong index);
+
+    /**
+     * An empty slab, reusing a retired one if possible. The write lock must
+     * be held.
+     */
+    slab* allocate();
+
+    std::unique_ptr<std::atomic<slab*>[]> ring_;
+    // entries from start_ to next_ excluded can be read
+    std::atomic<nuraft::ulong> start_;
+    std::atomic<nuraft::ulong> next_;
+
+    mutable epoch_manager epoch_;
+
+    // guards everything below
+    std::mutex write_lock_;
+    // slabs unlinked, with the epoch they were retired at
+    std::vector<std::pair<uint64_t, slab*>> retired_;
+    std::vector<slab*> free_;
+};
+
+} // namespace lrucache
+
+#endif // LRUCACHE_RING_LOG_STORE_
@@ -0,0 +1,965 @@
+// written after the output of the FlatBuffers compiler for LogEntry.fbs,
+// the schema_check target checks that flatc generates the same code
+
+
+#ifndef FLATBUFFERS_GENERATED_LOGENTRY_LRUCACHE_SCHEMA_H_
+#define FLATBUFFERS_GENERATED_LOGENTRY_LRUCACHE_SCHEMA_H_
+
+#include "flatbuffers/flatbuffers.h"
+
+// Ensure the included flatbuffers.h is the same version as when this file was
+// generated, otherwise it may not be compatible.
+static_assert(FLATBUFFERS_VERSION_MAJOR == 23 &&
+              FLATBUFFERS_VERSION_MINOR == 5 &&
+              FLATBUFFERS_VERSION_REVISION == 26,
+             "Non-compatible flatbuffers version included");
+
+namespace lrucache {
+namespace schema {
+
+struct ReadOp;
+struct ReadOpBuilder;
+
+struct WriteOp;
+struct WriteOpBuilder;
+
+struct PurgeOp;
+struct PurgeOpBuilder;
+
+struct TouchOp;
+struct TouchOpBuilder;
+
+struct DeleteOp;
+struct DeleteOpBuilder;
+
+struct ExpireOp;
+struct ExpireOpBuilder;
+
+struct CasOp;
+struct CasOpBuilder;
+
+struct IncrOp;
+struct IncrOpBuilder;
+
+struct Operation;
+struct OperationBuilder;
+
+struct BatchOp;
+struct BatchOpBuilder;
+
+struct LogEntry;
+struct LogEntryBuilder;
+
+enum Op : uint8_t {
+  Op_NONE = 0,
+  Op_ReadOp = 1,
+  Op_WriteOp = 2,
+  Op_PurgeOp = 3,
+  Op_TouchOp = 4,
+  Op_BatchOp = 5,
+  Op_DeleteOp = 6,
+  Op_ExpireOp = 7,
+  Op_CasOp = 8,
+  Op_IncrOp = 9,
+  Op_MIN = Op_NONE,
+  Op_MAX = Op_IncrOp
+};
+
+inline const Op (&EnumValuesOp())[10] {
+  static const Op values[] = {
+    Op_NONE,
+    Op_ReadOp,
+    Op_WriteOp,
+    Op_PurgeOp,
+    Op_TouchOp,
+    Op_BatchOp,
+    Op_DeleteOp,
+    Op_ExpireOp,
+    Op_CasOp,
+    Op_IncrOp
+  };
+  return values;
+}
+
+inline const char * const *EnumNamesOp() {
+  static const char * const names[11] = {
+    "NONE",
+    "ReadOp",
+    "WriteOp",
+    "PurgeOp",
+    "TouchOp",
+    "BatchOp",
+    "DeleteOp",
+    "ExpireOp",
+    "CasOp",
+    "IncrOp",
+    nullptr
+  };
+  return names;
+}
+
+inline const char *EnumNameOp(Op e) {
+  if (::flatbuffers::IsOutRange(e, Op_NONE, Op_IncrOp)) return "";
+  const size_t index = static_cast<size_t>(e);
+  return EnumNamesOp()[index];
+}
+
+template<typename T> struct OpTraits {
+  static const Op enum_value = Op_NONE;
+};
+
+template<> struct OpTraits<lrucache::schema::ReadOp> {
+  static const Op enum_value = Op_ReadOp;
+};
+
+template<> struct OpTraits<lrucache::schema::WriteOp> {
+  static const Op enum_value = Op_WriteOp;
+};
+
+template<> struct OpTraits<lrucache::schema::PurgeOp> {
+  static const Op enum_value = Op_PurgeOp;
+};
+
+template<> struct OpTraits<lrucache::schema::TouchOp> {
+  static const Op enum_value = Op_TouchOp;
+};
+
+template<> struct OpTraits<lrucache::schema::BatchOp> {
+  static const Op enum_value = Op_BatchOp;
+};
+
+template<> struct OpTraits<lrucache::schema::DeleteOp> {
+  static const Op enum_value = Op_DeleteOp;
+};
+
+template<> struct OpTraits<lrucache::schema::ExpireOp> {
+  static const Op enum_value = Op_ExpireOp;
+};
+
+template<> struct OpTraits<lrucache::schema::CasOp> {
+  static const Op enum_value = Op_CasOp;
+};
+
+template<> struct OpTraits<lrucache::schema::IncrOp> {
+  static const Op enum_value = Op_IncrOp;
+};
+
+bool VerifyOp(::flatbuffers::Verifier &verifier, const void *obj, Op type);
+bool VerifyOpVector(::flatbuffers::Verifier &verifier, const ::flatbuffers::Vector<::flatbuffers::Offset<void>> *values, const ::flatbuffers::Vector<uint8_t> *types);
+
+struct ReadOp FLATBUFFERS_FINAL_CLASS : private ::flatbuffers::Table {
+  typedef ReadOpBuilder Builder;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_KEY = 4
+  };
+  const ::flatbuffers::String *key() const {
+    return GetPointer<const ::flatbuffers::String *>(VT_KEY);
+  }
+  bool Verify(::flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyOffsetRequired(verifier, VT_KEY) &&
+           verifier.VerifyString(key()) &&
+           verifier.EndTable();
+  }
+};
+
+struct ReadOpBuilder {
+  typedef ReadOp Table;
+  ::flatbuffers::FlatBufferBuilder &fbb_;
+  ::flatbuffers::uoffset_t start_;
+  void add_key(::flatbuffers::Offset<::flatbuffers::String> key) {
+    fbb_.AddOffset(ReadOp::VT_KEY, key);
+  }
+  explicit ReadOpBuilder(::flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  ::flatbuffers::Offset<ReadOp> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = ::flatbuffers::Offset<ReadOp>(end);
+    fbb_.Required(o, ReadOp::VT_KEY);
+    return o;
+  }
+};
+
+inline ::flatbuffers::Offset<ReadOp> CreateReadOp(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    ::flatbuffers::Offset<::flatbuffers::String> key = 0) {
+  ReadOpBuilder builder_(_fbb);
+  builder_.add_key(key);
+  return builder_.Finish();
+}
+
+inline ::flatbuffers::Offset<ReadOp> CreateReadOpDirect(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    const char *key = nullptr) {
+  auto key__ = key ? _fbb.CreateString(key) : 0;
+  return lrucache::schema::CreateReadOp(
+      _fbb,
+      key__);
+}
+
+struct WriteOp FLATBUFFERS_FINAL_CLASS : private ::flatbuffers::Table {
+  typedef WriteOpBuilder Builder;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_KEY = 4,
+    VT_VALUE = 6,
+    VT_EXPIRES_AT = 8
+  };
+  const ::flatbuffers::String *key() const {
+    return GetPointer<const ::flatbuffers::String *>(VT_KEY);
+  }
+  const ::flatbuffers::Vector<uint8_t> *value() const {
+    return GetPointer<const ::flatbuffers::Vector<uint8_t> *>(VT_VALUE);
+  }
+  int64_t expires_at() const {
+    return GetField<int64_t>(VT_EXPIRES_AT, 0);
+  }
+  bool Verify(::flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyOffsetRequired(verifier, VT_KEY) &&
+           verifier.VerifyString(key()) &&
+           VerifyOffset(verifier, VT_VALUE) &&
+           verifier.VerifyVector(value()) &&
+           VerifyField<int64_t>(verifier, VT_EXPIRES_AT, 8) &&
+           verifier.EndTable();
+  }
+};
+
+struct WriteOpBuilder {
+  typedef WriteOp Table;
+  ::flatbuffers::FlatBufferBuilder &fbb_;
+  ::flatbuffers::uoffset_t start_;
+  void add_key(::flatbuffers::Offset<::flatbuffers::String> key) {
+    fbb_.AddOffset(WriteOp::VT_KEY, key);
+  }
+  void add_value(::flatbuffers::Offset<::flatbuffers::Vector<uint8_t>> value) {
+    fbb_.AddOffset(WriteOp::VT_VALUE, value);
+  }
+  void add_expires_at(int64_t expires_at) {
+    fbb_.AddElement<int64_t>(WriteOp::VT_EXPIRES_AT, expires_at, 0);
+  }
+  explicit WriteOpBuilder(::flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  ::flatbuffers::Offset<WriteOp> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = ::flatbuffers::Offset<WriteOp>(end);
+    fbb_.Required(o, WriteOp::VT_KEY);
+    return o;
+  }
+};
+
+inline ::flatbuffers::Offset<WriteOp> CreateWriteOp(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    ::flatbuffers::Offset<::flatbuffers::String> key = 0,
+    ::flatbuffers::Offset<::flatbuffers::Vector<uint8_t>> value = 0,
+    int64_t expires_at = 0) {
+  WriteOpBuilder builder_(_fbb);
+  builder_.add_expires_at(expires_at);
+  builder_.add_value(value);
+  builder_.add_key(key);
+  return builder_.Finish();
+}
+
+inline ::flatbuffers::Offset<WriteOp> CreateWriteOpDirect(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    const char *key = nullptr,
+    const std::vector<uint8_t> *value = nullptr,
+    int64_t expires_at = 0) {
+  auto key__ = key ? _fbb.CreateString(key) : 0;
+  auto value__ = value ? _fbb.CreateVector<uint8_t>(*value) : 0;
+  return lrucache::schema::CreateWriteOp(
+      _fbb,
+      key__,
+      value__,
+      expires_at);
+}
+
+struct PurgeOp FLATBUFFERS_FINAL_CLASS : private ::flatbuffers::Table {
+  typedef PurgeOpBuilder Builder;
+  bool Verify(::flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           verifier.EndTable();
+  }
+};
+
+struct PurgeOpBuilder {
+  typedef PurgeOp Table;
+  ::flatbuffers::FlatBufferBuilder &fbb_;
+  ::flatbuffers::uoffset_t start_;
+  explicit PurgeOpBuilder(::flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  ::flatbuffers::Offset<PurgeOp> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = ::flatbuffers::Offset<PurgeOp>(end);
+    return o;
+  }
+};
+
+inline ::flatbuffers::Offset<PurgeOp> CreatePurgeOp(
+    ::flatbuffers::FlatBufferBuilder &_fbb) {
+  PurgeOpBuilder builder_(_fbb);
+  return builder_.Finish();
+}
+
+struct TouchOp FLATBUFFERS_FINAL_CLASS : private ::flatbuffers::Table {
+  typedef TouchOpBuilder Builder;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_HASHES = 4
+  };
+  const ::flatbuffers::Vector<uint64_t> *hashes() const {
+    return GetPointer<const ::flatbuffers::Vector<uint64_t> *>(VT_HASHES);
+  }
+  bool Verify(::flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyOffset(verifier, VT_HASHES) &&
+           verifier.VerifyVector(hashes()) &&
+           verifier.EndTable();
+  }
+};
+
+struct TouchOpBuilder {
+  typedef TouchOp Table;
+  ::flatbuffers::FlatBufferBuilder &fbb_;
+  ::flatbuffers::uoffset_t start_;
+  void add_hashes(::flatbuffers::Offset<::flatbuffers::Vector<uint64_t>> hashes) {
+    fbb_.AddOffset(TouchOp::VT_HASHES, hashes);
+  }
+  explicit TouchOpBuilder(::flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  ::flatbuffers::Offset<TouchOp> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = ::flatbuffers::Offset<TouchOp>(end);
+    return o;
+  }
+};
+
+inline ::flatbuffers::Offset<TouchOp> CreateTouchOp(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    ::flatbuffers::Offset<::flatbuffers::Vector<uint64_t>> hashes = 0) {
+  TouchOpBuilder builder_(_fbb);
+  builder_.add_hashes(hashes);
+  return builder_.Finish();
+}
+
+inline ::flatbuffers::Offset<TouchOp> CreateTouchOpDirect(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    const std::vector<uint64_t> *hashes = nullptr) {
+  auto hashes__ = hashes ? _fbb.CreateVector<uint64_t>(*hashes) : 0;
+  return lrucache::schema::CreateTouchOp(
+      _fbb,
+      hashes__);
+}
+
+struct DeleteOp FLATBUFFERS_FINAL_CLASS : private ::flatbuffers::Table {
+  typedef DeleteOpBuilder Builder;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_KEY = 4
+  };
+  const ::flatbuffers::String *key() const {
+    return GetPointer<const ::flatbuffers::String *>(VT_KEY);
+  }
+  bool Verify(::flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyOffsetRequired(verifier, VT_KEY) &&
+           verifier.VerifyString(key()) &&
+           verifier.EndTable();
+  }
+};
+
+struct DeleteOpBuilder {
+  typedef DeleteOp Table;
+  ::flatbuffers::FlatBufferBuilder &fbb_;
+  ::flatbuffers::uoffset_t start_;
+  void add_key(::flatbuffers::Offset<::flatbuffers::String> key) {
+    fbb_.AddOffset(DeleteOp::VT_KEY, key);
+  }
+  explicit DeleteOpBuilder(::flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  ::flatbuffers::Offset<DeleteOp> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = ::flatbuffers::Offset<DeleteOp>(end);
+    fbb_.Required(o, DeleteOp::VT_KEY);
+    return o;
+  }
+};
+
+inline ::flatbuffers::Offset<DeleteOp> CreateDeleteOp(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    ::flatbuffers::Offset<::flatbuffers::String> key = 0) {
+  DeleteOpBuilder builder_(_fbb);
+  builder_.add_key(key);
+  return builder_.Finish();
+}
+
+inline ::flatbuffers::Offset<DeleteOp> CreateDeleteOpDirect(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    const char *key = nullptr) {
+  auto key__ = key ? _fbb.CreateString(key) : 0;
+  return lrucache::schema::CreateDeleteOp(
+      _fbb,
+      key__);
+}
+
+struct ExpireOp FLATBUFFERS_FINAL_CLASS : private ::flatbuffers::Table {
+  typedef ExpireOpBuilder Builder;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_KEY = 4,
+    VT_EXPIRES_AT = 6
+  };
+  const ::flatbuffers::String *key() const {
+    return GetPointer<const ::flatbuffers::String *>(VT_KEY);
+  }
+  int64_t expires_at() const {
+    return GetField<int64_t>(VT_EXPIRES_AT, 0);
+  }
+  bool Verify(::flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyOffsetRequired(verifier, VT_KEY) &&
+           verifier.VerifyString(key()) &&
+           VerifyField<int64_t>(verifier, VT_EXPIRES_AT, 8) &&
+           verifier.EndTable();
+  }
+};
+
+struct ExpireOpBuilder {
+  typedef ExpireOp Table;
+  ::flatbuffers::FlatBufferBuilder &fbb_;
+  ::flatbuffers::uoffset_t start_;
+  void add_key(::flatbuffers::Offset<::flatbuffers::String> key) {
+    fbb_.AddOffset(ExpireOp::VT_KEY, key);
+  }
+  void add_expires_at(int64_t expires_at) {
+    fbb_.AddElement<int64_t>(ExpireOp::VT_EXPIRES_AT, expires_at, 0);
+  }
+  explicit ExpireOpBuilder(::flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  ::flatbuffers::Offset<ExpireOp> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = ::flatbuffers::Offset<ExpireOp>(end);
+    fbb_.Required(o, ExpireOp::VT_KEY);
+    return o;
+  }
+};
+
+inline ::flatbuffers::Offset<ExpireOp> CreateExpireOp(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    ::flatbuffers::Offset<::flatbuffers::String> key = 0,
+    int64_t expires_at = 0) {
+  ExpireOpBuilder builder_(_fbb);
+  builder_.add_expires_at(expires_at);
+  builder_.add_key(key);
+  return builder_.Finish();
+}
+
+inline ::flatbuffers::Offset<ExpireOp> CreateExpireOpDirect(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    const char *key = nullptr,
+    int64_t expires_at = 0) {
+  auto key__ = key ? _fbb.CreateString(key) : 0;
+  return lrucache::schema::CreateExpireOp(
+      _fbb,
+      key__,
+      expires_at);
+}
+
+struct CasOp FLATBUFFERS_FINAL_CLASS : private ::flatbuffers::Table {
+  typedef CasOpBuilder Builder;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_KEY = 4,
+    VT_VALUE = 6,
+    VT_EXPIRES_AT = 8,
+    VT_EXPECTED = 10
+  };
+  const ::flatbuffers::String *key() const {
+    return GetPointer<const ::flatbuffers::String *>(VT_KEY);
+  }
+  const ::flatbuffers::Vector<uint8_t> *value() const {
+    return GetPointer<const ::flatbuffers::Vector<uint8_t> *>(VT_VALUE);
+  }
+  int64_t expires_at() const {
+    return GetField<int64_t>(VT_EXPIRES_AT, 0);
+  }
+  uint64_t expected() const {
+    return GetField<uint64_t>(VT_EXPECTED, 0);
+  }
+  bool Verify(::flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyOffsetRequired(verifier, VT_KEY) &&
+           verifier.VerifyString(key()) &&
+           VerifyOffset(verifier, VT_VALUE) &&
+           verifier.VerifyVector(value()) &&
+           VerifyField<int64_t>(verifier, VT_EXPIRES_AT, 8) &&
+           VerifyField<uint64_t>(verifier, VT_EXPECTED, 8) &&
+           verifier.EndTable();
+  }
+};
+
+struct CasOpBuilder {
+  typedef CasOp Table;
+  ::flatbuffers::FlatBufferBuilder &fbb_;
+  ::flatbuffers::uoffset_t start_;
+  void add_key(::flatbuffers::Offset<::flatbuffers::String> key) {
+    fbb_.AddOffset(CasOp::VT_KEY, key);
+  }
+  void add_value(::flatbuffers::Offset<::flatbuffers::Vector<uint8_t>> value) {
+    fbb_.AddOffset(CasOp::VT_VALUE, value);
+  }
+  void add_expires_at(int64_t expires_at) {
+    fbb_.AddElement<int64_t>(CasOp::VT_EXPIRES_AT, expires_at, 0);
+  }
+  void add_expected(uint64_t expected) {
+    fbb_.AddElement<uint64_t>(CasOp::VT_EXPECTED, expected, 0);
+  }
+  explicit CasOpBuilder(::flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  ::flatbuffers::Offset<CasOp> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = ::flatbuffers::Offset<CasOp>(end);
+    fbb_.Required(o, CasOp::VT_KEY);
+    return o;
+  }
+};
+
+inline ::flatbuffers::Offset<CasOp> CreateCasOp(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    ::flatbuffers::Offset<::flatbuffers::String> key = 0,
+    ::flatbuffers::Offset<::flatbuffers::Vector<uint8_t>> value = 0,
+    int64_t expires_at = 0,
+    uint64_t expected = 0) {
+  CasOpBuilder builder_(_fbb);
+  builder_.add_expected(expected);
+  builder_.add_expires_at(expires_at);
+  builder_.add_value(value);
+  builder_.add_key(key);
+  return builder_.Finish();
+}
+
+inline ::flatbuffers::Offset<CasOp> CreateCasOpDirect(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    const char *key = nullptr,
+    const std::vector<uint8_t> *value = nullptr,
+    int64_t expires_at = 0,
+    uint64_t expected = 0) {
+  auto key__ = key ? _fbb.CreateString(key) : 0;
+  auto value__ = value ? _fbb.CreateVector<uint8_t>(*value) : 0;
+  return lrucache::schema::CreateCasOp(
+      _fbb,
+      key__,
+      value__,
+      expires_at,
+      expected);
+}
+
+struct IncrOp FLATBUFFERS_FINAL_CLASS : private ::flatbuffers::Table {
+  typedef IncrOpBuilder Builder;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_KEY = 4,
+    VT_DELTA = 6
+  };
+  const ::flatbuffers::String *key() const {
+    return GetPointer<const ::flatbuffers::String *>(VT_KEY);
+  }
+  int64_t delta() const {
+    return GetField<int64_t>(VT_DELTA, 0);
+  }
+  bool Verify(::flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyOffsetRequired(verifier, VT_KEY) &&
+           verifier.VerifyString(key()) &&
+           VerifyField<int64_t>(verifier, VT_DELTA, 8) &&
+           verifier.EndTable();
+  }
+};
+
+struct IncrOpBuilder {
+  typedef IncrOp Table;
+  ::flatbuffers::FlatBufferBuilder &fbb_;
+  ::flatbuffers::uoffset_t start_;
+  void add_key(::flatbuffers::Offset<::flatbuffers::String> key) {
+    fbb_.AddOffset(IncrOp::VT_KEY, key);
+  }
+  void add_delta(int64_t delta) {
+    fbb_.AddElement<int64_t>(IncrOp::VT_DELTA, delta, 0);
+  }
+  explicit IncrOpBuilder(::flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  ::flatbuffers::Offset<IncrOp> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = ::flatbuffers::Offset<IncrOp>(end);
+    fbb_.Required(o, IncrOp::VT_KEY);
+    return o;
+  }
+};
+
+inline ::flatbuffers::Offset<IncrOp> CreateIncrOp(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    ::flatbuffers::Offset<::flatbuffers::String> key = 0,
+    int64_t delta = 0) {
+  IncrOpBuilder builder_(_fbb);
+  builder_.add_delta(delta);
+  builder_.add_key(key);
+  return builder_.Finish();
+}
+
+inline ::flatbuffers::Offset<IncrOp> CreateIncrOpDirect(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    const char *key = nullptr,
+    int64_t delta = 0) {
+  auto key__ = key ? _fbb.CreateString(key) : 0;
+  return lrucache::schema::CreateIncrOp(
+      _fbb,
+      key__,
+      delta);
+}
+
+struct Operation FLATBUFFERS_FINAL_CLASS : private ::flatbuffers::Table {
+  typedef OperationBuilder Builder;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_TIMESTAMP = 4,
+    VT_OP_TYPE = 6,
+    VT_OP = 8
+  };
+  int64_t timestamp() const {
+    return GetField<int64_t>(VT_TIMESTAMP, 0);
+  }
+  lrucache::schema::Op op_type() const {
+    return static_cast<lrucache::schema::Op>(GetField<uint8_t>(VT_OP_TYPE, 0));
+  }
+  const void *op() const {
+    return GetPointer<const void *>(VT_OP);
+  }
+  template<typename T> const T *op_as() const;
+  const lrucache::schema::ReadOp *op_as_ReadOp() const {
+    return op_type() == lrucache::schema::Op_ReadOp ? static_cast<const lrucache::schema::ReadOp *>(op()) : nullptr;
+  }
+  const lrucache::schema::WriteOp *op_as_WriteOp() const {
+    return op_type() == lrucache::schema::Op_WriteOp ? static_cast<const lrucache::schema::WriteOp *>(op()) : nullptr;
+  }
+  const lrucache::schema::PurgeOp *op_as_PurgeOp() const {
+    return op_type() == lrucache::schema::Op_PurgeOp ? static_cast<const lrucache::schema::PurgeOp *>(op()) : nullptr;
+  }
+  const lrucache::schema::TouchOp *op_as_TouchOp() const {
+    return op_type() == lrucache::schema::Op_TouchOp ? static_cast<const lrucache::schema::TouchOp *>(op()) : nullptr;
+  }
+  const lrucache::schema::BatchOp *op_as_BatchOp() const {
+    return op_type() == lrucache::schema::Op_BatchOp ? static_cast<const lrucache::schema::BatchOp *>(op()) : nullptr;
+  }
+  const lrucache::schema::DeleteOp *op_as_DeleteOp() const {
+    return op_type() == lrucache::schema::Op_DeleteOp ? static_cast<const lrucache::schema::DeleteOp *>(op()) : nullptr;
+  }
+  const lrucache::schema::ExpireOp *op_as_ExpireOp() const {
+    return op_type() == lrucache::schema::Op_ExpireOp ? static_cast<const lrucache::schema::ExpireOp *>(op()) : nullptr;
+  }
+  const lrucache::schema::CasOp *op_as_CasOp() const {
+    return op_type() == lrucache::schema::Op_CasOp ? static_cast<const lrucache::schema::CasOp *>(op()) : nullptr;
+  }
+  const lrucache::schema::IncrOp *op_as_IncrOp() const {
+    return op_type() == lrucache::schema::Op_IncrOp ? static_cast<const lrucache::schema::IncrOp *>(op()) : nullptr;
+  }
+  bool Verify(::flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<int64_t>(verifier, VT_TIMESTAMP, 8) &&
+           VerifyField<uint8_t>(verifier, VT_OP_TYPE, 1) &&
+           VerifyOffset(verifier, VT_OP) &&
+           VerifyOp(verifier, op(), op_type()) &&
+           verifier.EndTable();
+  }
+};
+
+template<> inline const lrucache::schema::ReadOp *Operation::op_as<lrucache::schema::ReadOp>() const {
+  return op_as_ReadOp();
+}
+
+template<> inline const lrucache::schema::WriteOp *Operation::op_as<lrucache::schema::WriteOp>() const {
+  return op_as_WriteOp();
+}
+
+template<> inline const lrucache::schema::PurgeOp *Operation::op_as<lrucache::schema::PurgeOp>() const {
+  return op_as_PurgeOp();
+}
+
+template<> inline const lrucache::schema::TouchOp *Operation::op_as<lrucache::schema::TouchOp>() const {
+  return op_as_TouchOp();
+}
+
+template<> inline const lrucache::schema::BatchOp *Operation::op_as<lrucache::schema::BatchOp>() const {
+  return op_as_BatchOp();
+}
+
+template<> inline const lrucache::schema::DeleteOp *Operation::op_as<lrucache::schema::DeleteOp>() const {
+  return op_as_DeleteOp();
+}
+
+template<> inline const lrucache::schema::ExpireOp *Operation::op_as<lrucache::schema::ExpireOp>() const {
+  return op_as_ExpireOp();
+}
+
+template<> inline const lrucache::schema::CasOp *Operation::op_as<lrucache::schema::CasOp>() const {
+  return op_as_CasOp();
+}
+
+template<> inline const lrucache::schema::IncrOp *Operation::op_as<lrucache::schema::IncrOp>() const {
+  return op_as_IncrOp();
+}
+
+struct OperationBuilder {
+  typedef Operation Table;
+  ::flatbuffers::FlatBufferBuilder &fbb_;
+  ::flatbuffers::uoffset_t start_;
+  void add_timestamp(int64_t timestamp) {
+    fbb_.AddElement<int64_t>(Operation::VT_TIMESTAMP, timestamp, 0);
+  }
+  void add_op_type(lrucache::schema::Op op_type) {
+    fbb_.AddElement<uint8_t>(Operation::VT_OP_TYPE, static_cast<uint8_t>(op_type), 0);
+  }
+  void add_op(::flatbuffers::Offset<void> op) {
+    fbb_.AddOffset(Operation::VT_OP, op);
+  }
+  explicit OperationBuilder(::flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  ::flatbuffers::Offset<Operation> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = ::flatbuffers::Offset<Operation>(end);
+    return o;
+  }
+};
+
+inline ::flatbuffers::Offset<Operation> CreateOperation(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    int64_t timestamp = 0,
+    lrucache::schema::Op op_type = lrucache::schema::Op_NONE,
+    ::flatbuffers::Offset<void> op = 0) {
+  OperationBuilder builder_(_fbb);
+  builder_.add_timestamp(timestamp);
+  builder_.add_op(op);
+  builder_.add_op_type(op_type);
+  return builder_.Finish();
+}
+
+struct BatchOp FLATBUFFERS_FINAL_CLASS : private ::flatbuffers::Table {
+  typedef BatchOpBuilder Builder;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_OPS = 4
+  };
+  const ::flatbuffers::Vector<::flatbuffers::Offset<lrucache::schema::Operation>> *ops() const {
+    return GetPointer<const ::flatbuffers::Vector<::flatbuffers::Offset<lrucache::schema::Operation>> *>(VT_OPS);
+  }
+  bool Verify(::flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyOffset(verifier, VT_OPS) &&
+           verifier.VerifyVector(ops()) &&
+           verifier.VerifyVectorOfTables(ops()) &&
+           verifier.EndTable();
+  }
+};
+
+struct BatchOpBuilder {
+  typedef BatchOp Table;
+  ::flatbuffers::FlatBufferBuilder &fbb_;
+  ::flatbuffers::uoffset_t start_;
+  void add_ops(::flatbuffers::Offset<::flatbuffers::Vector<::flatbuffers::Offset<lrucache::schema::Operation>>> ops) {
+    fbb_.AddOffset(BatchOp::VT_OPS, ops);
+  }
+  explicit BatchOpBuilder(::flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  ::flatbuffers::Offset<BatchOp> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = ::flatbuffers::Offset<BatchOp>(end);
+    return o;
+  }
+};
+
+inline ::flatbuffers::Offset<BatchOp> CreateBatchOp(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    ::flatbuffers::Offset<::flatbuffers::Vector<::flatbuffers::Offset<lrucache::schema::Operation>>> ops = 0) {
+  BatchOpBuilder builder_(_fbb);
+  builder_.add_ops(ops);
+  return builder_.Finish();
+}
+
+inline ::flatbuffers::Offset<BatchOp> CreateBatchOpDirect(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    const std::vector<::flatbuffers::Offset<lrucache::schema::Operation>> *ops = nullptr) {
+  auto ops__ = ops ? _fbb.CreateVector<::flatbuffers::Offset<lrucache::schema::Operation>>(*ops) : 0;
+  return lrucache::schema::CreateBatchOp(
+      _fbb,
+      ops__);
+}
+
+struct LogEntry FLATBUFFERS_FINAL_CLASS : private ::flatbuffers::Table {
+  typedef LogEntryBuilder Builder;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_VERSION = 4,
+    VT_OPERATION = 6
+  };
+  uint8_t version() const {
+    return GetField<uint8_t>(VT_VERSION, 1);
+  }
+  const lrucache::schema::Operation *operation() const {
+    return GetPointer<const lrucache::schema::Operation *>(VT_OPERATION);
+  }
+  bool Verify(::flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<uint8_t>(verifier, VT_VERSION, 1) &&
+           VerifyOffsetRequired(verifier, VT_OPERATION) &&
+           verifier.VerifyTable(operation()) &&
+           verifier.EndTable();
+  }
+};
+
+struct LogEntryBuilder {
+  typedef LogEntry Table;
+  ::flatbuffers::FlatBufferBuilder &fbb_;
+  ::flatbuffers::uoffset_t start_;
+  void add_version(uint8_t version) {
+    fbb_.AddElement<uint8_t>(LogEntry::VT_VERSION, version, 1);
+  }
+  void add_operation(::flatbuffers::Offset<lrucache::schema::Operation> operation) {
+    fbb_.AddOffset(LogEntry::VT_OPERATION, operation);
+  }
+  explicit LogEntryBuilder(::flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  ::flatbuffers::Offset<LogEntry> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = ::flatbuffers::Offset<LogEntry>(end);
+    fbb_.Required(o, LogEntry::VT_OPERATION);
+    return o;
+  }
+};
+
+inline ::flatbuffers::Offset<LogEntry> CreateLogEntry(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    uint8_t version = 1,
+    ::flatbuffers::Offset<lrucache::schema::Operation> operation = 0) {
+  LogEntryBuilder builder_(_fbb);
+  builder_.add_operation(operation);
+  builder_.add_version(version);
+  return builder_.Finish();
+}
+
+inline bool VerifyOp(::flatbuffers::Verifier &verifier, const void *obj, Op type) {
+  switch (type) {
+    case Op_NONE: {
+      return true;
+    }
+    case Op_ReadOp: {
+      auto ptr = reinterpret_cast<const lrucache::schema::ReadOp *>(obj);
+      return verifier.VerifyTable(ptr);
+    }
+    case Op_WriteOp: {
+      auto ptr = reinterpret_cast<const lrucache::schema::WriteOp *>(obj);
+      return verifier.VerifyTable(ptr);
+    }
+    case Op_PurgeOp: {
+      auto ptr = reinterpret_cast<const lrucache::schema::PurgeOp *>(obj);
+      return verifier.VerifyTable(ptr);
+    }
+    case Op_TouchOp: {
+      auto ptr = reinterpret_cast<const lrucache::schema::TouchOp *>(obj);
+      return verifier.VerifyTable(ptr);
+    }
+    case Op_BatchOp: {
+      auto ptr = reinterpret_cast<const lrucache::schema::BatchOp *>(obj);
+      return verifier.VerifyTable(ptr);
+    }
+    case Op_DeleteOp: {
+      auto ptr = reinterpret_cast<const lrucache::schema::DeleteOp *>(obj);
+      return verifier.VerifyTable(ptr);
+    }
+    case Op_ExpireOp: {
+      auto ptr = reinterpret_cast<const lrucache::schema::ExpireOp *>(obj);
+      return verifier.VerifyTable(ptr);
+    }
+    case Op_CasOp: {
+      auto ptr = reinterpret_cast<const lrucache::schema::CasOp *>(obj);
+      return verifier.VerifyTable(ptr);
+    }
+    case Op_IncrOp: {
+      auto ptr = reinterpret_cast<const lrucache::schema::IncrOp *>(obj);
+      return verifier.VerifyTable(ptr);
+    }
+    default: return true;
+  }
+}
+
+inline bool VerifyOpVector(::flatbuffers::Verifier &verifier, const ::flatbuffers::Vector<::flatbuffers::Offset<void>> *values, const ::flatbuffers::Vector<uint8_t> *types) {
+  if (!values || !types) return !values && !types;
+  if (values->size() != types->size()) return false;
+  for (::flatbuffers::uoffset_t i = 0; i < values->size(); ++i) {
+    if (!VerifyOp(
+        verifier,  values->Get(i), types->GetEnum<Op>(i))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+inline const lrucache::schema::LogEntry *GetLogEntry(const void *buf) {
+  return ::flatbuffers::GetRoot<lrucache::schema::LogEntry>(buf);
+}
+
+inline const lrucache::schema::LogEntry *GetSizePrefixedLogEntry(const void *buf) {
+  return ::flatbuffers::GetSizePrefixedRoot<lrucache::schema::LogEntry>(buf);
+}
+
+inline const char *LogEntryIdentifier() {
+  return "LRUL";
+}
+
+inline bool LogEntryBufferHasIdentifier(const void *buf) {
+  return ::flatbuffers::BufferHasIdentifier(
+      buf, LogEntryIdentifier());
+}
+
+inline bool SizePrefixedLogEntryBufferHasIdentifier(const void *buf) {
+  return ::flatbuffers::BufferHasIdentifier(
+      buf, LogEntryIdentifier(), true);
+}
+
+inline bool VerifyLogEntryBuffer(
+    ::flatbuffers::Verifier &verifier) {
+  return verifier.VerifyBuffer<lrucache::schema::LogEntry>(LogEntryIdentifier());
+}
+
+inline bool VerifySizePrefixedLogEntryBuffer(
+    ::flatbuffers::Verifier &verifier) {
+  return verifier.VerifySizePrefixedBuffer<lrucache::schema::LogEntry>(LogEntryIdentifier());
+}
+
+inline void FinishLogEntryBuffer(
+    ::flatbuffers::FlatBufferBuilder &fbb,
+    ::flatbuffers::Offset<lrucache::schema::LogEntry> root) {
+  fbb.Finish(root, LogEntryIdentifier());
+}
+
+inline void FinishSizePrefixedLogEntryBuffer(
+    ::flatbuffers::FlatBufferBuilder &fbb,
+    ::flatbuffers::Offset<lrucache::schema::LogEntry> root) {
+  fbb.FinishSizePrefixed(root, LogEntryIdentifier());
+}
+
+}  // namespace schema
+}  // namespace lrucache
+
+#endif  // FLATBUFFERS_GENERATED_LOGENTRY_LRUCACHE_SCHEMA_H_
@@ -1,10 +1,13 @@
 #include "utilities.hxx"
 
+#include "cache/cache_storage.hxx"
+
 lrucache::cache_config build_default_cache_config()
 {
     lrucache::cache_config config;
-    config.cache_size = 150;
-    config.max_item_size = 90;
+    config.cache_size = 2 * item_size(20) + 6; // two 20 bytes items
+    // items of any size fit, tests of the limit set their own
+    config.max_item_size = 64 * 1024;
     config.max_key_size = 20;
     config.purge_interval = 30;
     return config;
@@ -16,6 +19,20 @@ lrucache::cache_item create_item(size_t size, std::time_t expires_at)
     return lrucache::cache_item(data, size, expires_at);
 }
 
+size_t item_size(size_t data_size)
+{
+    return lrucache::cache_storage::get_item_size("key1", data_size);
+}
+
+size_t data_size_for(size_t bytes)
+{
+    size_t data_size = 0;
+    while (item_size(data_size) < bytes) {
+        data_size++;
+    }
+    return data_size;
+}
+
 std::vector<lrucache::cache_item> read_snapshot_data(unsigned char data[],
                                                      size_t size)
 {
@@ -23,6 +40,7 @@ std::vector<lrucache::cache_item> read_snapshot_data(unsigned char data[],
     size_t key_size;
     size_t data_size;
     std::time_t expires_at;
+    uint64_t version;
     unsigned char* data_ptr;
     size_t read = 0;
 
@@ -36,8 +54,10 @@ std::vector<lrucache::cache_item> read_snapshot_data(unsigned char data[],
         data += data_size;
         memcpy(&expires_at, data, sizeof(expires_at));
         data += sizeof(expires_at);
+        memcpy(&version, data, sizeof(version));
+        data += sizeof(version);
 
-        lrucache::cache_item item(data_ptr, data_size, expires_at);
+        lrucache::cache_item item(data_ptr, data_size, expires_at, version);
         read += item.size() + key_size;
         result.push_back(std::move(item));
     }
@@ -10,6 +10,17 @@ lrucache::cache_config build_default_cache_config();
 
 lrucache::cache_item create_item(size_t size, std::time_t expires_at);
 
+/**
+ * Memory taken in cache by an item of `data_size` bytes stored under a 4
+ * characters key such as "key1".
+ */
+size_t item_size(size_t data_size);
+
+/**
+ * Smallest data size for which `item_size()` is at least `bytes`.
+ */
+size_t data_size_for(size_t bytes);
+
 std::vector<lrucache::cache_item> read_snapshot_data(unsigned char data[],
                                                      size_t size);
 
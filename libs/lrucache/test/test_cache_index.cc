@@ -0,0 +1,77 @@
+#include <catch.hpp>
+
+#include <deque>
+#include <memory>
+#include <unordered_map>
+
+#include "cache/cache_index.hxx"
+#include "cache/entry_pool.hxx"
+#include "cache/key_hash.hxx"
+
+// entries only point at their key, `keys` keeps it alive
+static lrucache::cache_entry* make_entry(lrucache::entry_pool& pool,
+                                         std::deque<std::string>& keys,
+                                         const std::string& key)
+{
+    auto entry = pool.allocate();
+    entry->item.key = keys.emplace_back(key);
+    entry->hash = lrucache::key_hash(key);
+    return entry;
+}
+
+TEST_CASE("Cache index lookups", "[cache_index]") {
+    lrucache::entry_pool pool(64);
+    lrucache::cache_index index;
+    std::deque<std::string> keys;
+
+    SECTION ( "find inserted keys" ) {
+        auto entry1 = make_entry(pool, keys, "key1");
+        auto entry2 = make_entry(pool, keys, "key2");
+        index.insert(entry1);
+        index.insert(entry2);
+        REQUIRE(index.size() == 2);
+        REQUIRE(index.find("key1", entry1->hash) == entry1);
+        REQUIRE(index.find("key2", entry2->hash) == entry2);
+        REQUIRE(index.find("key3", lrucache::key_hash("key3")) == nullptr);
+    }
+
+    SECTION ( "colliding hashes are told apart by key" ) {
+        auto entry1 = make_entry(pool, keys, "key1");
+        auto entry2 = make_entry(pool, keys, "key2");
+        entry2->hash = entry1->hash;
+        index.insert(entry1);
+        index.insert(entry2);
+        REQUIRE(index.find("key2", entry1->hash) == entry2);
+        index.erase(entry1);
+        REQUIRE(index.find("key1", entry1->hash) == nullptr);
+        REQUIRE(index.find("key2", entry1->hash) == entry2);
+    }
+
+    SECTION ( "stays consistent through growth and removals" ) {
+        std::unordered_map<std::string, lrucache::cache_entry*> expected;
+        for (int i = 0; i < 5000; i++) {
+            auto key = "key" + std::to_string(i);
+            auto entry = make_entry(pool, keys, key);
+            index.insert(entry);
+            expected[key] = entry;
+        }
+        for (int i = 0; i < 5000; i += 3) {
+            auto key = "key" + std::to_string(i);
+            index.erase(expected[key]);
+            pool.release(expected[key]);
+            expected.erase(key);
+        }
+
+        REQUIRE(index.size() == expected.size());
+        for (int i = 0; i < 5000; i++) {
+            auto key = "key" + std::to_string(i);
+            auto found = index.find(key, lrucache::key_hash(key));
+            auto iter = expected.find(key);
+            if (iter == expected.end()) {
+                REQUIRE(found == nullptr);
+            } else {
+                REQUIRE(found == iter->second);
+            }
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#include <catch.hpp>
+
+#include "cache/cache_item.hxx"
+#include "helpers/utilities.hxx"
+
+TEST_CASE("Cache item data layout", "[cache_item]") {
+    std::time_t future = std::time(nullptr) + 100;
+
+    SECTION ( "small data is stored inline and copied" ) {
+        auto item = create_item(8, future);
+        memcpy(item.bytes(), "abcdefgh", 8);
+        REQUIRE(item.is_inline());
+
+        lrucache::cache_item copy(item);
+        memcpy(item.bytes(), "zzzzzzzz", 8);
+        REQUIRE(memcmp(copy.bytes(), "abcdefgh", 8) == 0);
+        REQUIRE(lrucache::cache_item::external_size(8) == 0);
+    }
+
+    SECTION ( "large data lives on the heap and is shared by copies" ) {
+        size_t size = lrucache::cache_item::INLINE_SIZE + 1;
+        auto item = create_item(size, future);
+        REQUIRE_FALSE(item.is_inline());
+
+        lrucache::cache_item copy = item;
+        REQUIRE(copy.bytes() == item.bytes());
+        REQUIRE(lrucache::cache_item::external_size(size) > size);
+    }
+
+    SECTION ( "assignment switches between layouts" ) {
+        auto item = create_item(lrucache::cache_item::INLINE_SIZE * 2, future);
+        auto small = create_item(4, future);
+        memcpy(small.bytes(), "Test", 4);
+
+        item = small;
+        REQUIRE(item.is_inline());
+        REQUIRE(item.data_size == 4);
+        REQUIRE(memcmp(item.bytes(), "Test", 4) == 0);
+
+        item = create_item(lrucache::cache_item::INLINE_SIZE * 2, future);
+        REQUIRE_FALSE(item.is_inline());
+        REQUIRE(item.data_size == lrucache::cache_item::INLINE_SIZE * 2);
+    }
+}
@@ -1,12 +1,16 @@
 #include <catch.hpp>
 
+#include <algorithm>
+#include <thread>
+
 #include "cache/cache_state.hxx"
 #include "helpers/utilities.hxx"
 
 
 TEST_CASE("Cache state snapshot commits", "[cache_state][snapshot][commits]") {
     lrucache::cache_config config = build_default_cache_config();
-    config.cache_size = 350;
+    // key5 only fits once key3 is evicted
+    config.cache_size = item_size(125) + item_size(20) + 2 * item_size(10) - 1;
     lrucache::cache_state state(config);
     std::time_t now = std::time(nullptr);
     std::time_t future = now+99999;
@@ -44,48 +48,44 @@ TEST_CASE("Cache state snapshot commits", "[cache_state][snapshot][commits]") {
         REQUIRE(len == 40);
     }
 
-    SECTION ( "purge commits are ignored during snapshot" ) {
+    SECTION ( "purge commits are applied during snapshot" ) {
         state.commit_purge_expired(future+99999);
 
         auto result = state.read("key1", len);
-        REQUIRE(result != nullptr);
-        REQUIRE(len == 20);
+        REQUIRE(result == nullptr);
     }
 
-    SECTION ( "commits are applied after snapshot" ) {
+    SECTION ( "commits are applied during snapshot" ) {
         auto new_item = create_item(1, now+10); // will be expired
         state.commit_write("key2", new_item, now+4);
         state.commit_read("key1", now+5);
         state.commit_purge_expired(now+50); // purge key2 -> 3 - 4 - 1
         auto new_item2 = create_item(125, future); // will evict key3
         state.commit_write("key5", new_item2, now+51);
-    
-        auto result1 = state.read("key1", len);
-        auto result2 = state.read("key2", len);
-        auto result3 = state.read("key3", len);
-        auto result4 = state.read("key4", len);
-        auto result5 = state.read("key5", len);
-
-        REQUIRE(result1 != nullptr);
-        REQUIRE(result2 != nullptr);
-        REQUIRE(result3 != nullptr);
-        REQUIRE(result4 != nullptr);
-        REQUIRE(result5 != nullptr);
+
+        auto check_final_state = [&]() {
+            // final cache state contains key 5 -> 1 -> 4
+            REQUIRE(state.read("key1", len) != nullptr);
+            REQUIRE(state.read("key2", len) == nullptr);
+            REQUIRE(state.read("key3", len) == nullptr);
+            REQUIRE(state.read("key4", len) != nullptr);
+            REQUIRE(state.read("key5", len) != nullptr);
+        };
+        check_final_state();
+
+        // the snapshot still sees the items as they were frozen
+        int item_index = 0;
+        size_t read = 0;
+        auto data = state.read_snapshot_chunk(9999, item_index, read);
+        auto items = read_snapshot_data(data.get(), read);
+        REQUIRE(item_index == -1);
+        REQUIRE(items.size() == 4);
+        REQUIRE(items[2].data_size == 10); // key2 before its update
+        REQUIRE(items[2].expires_at == future);
+        REQUIRE(items[3].data_size == 20); // key1
 
         state.end_snapshot();
-    
-        auto result6 = state.read("key1", len);
-        auto result7 = state.read("key2", len);
-        auto result8 = state.read("key3", len);
-        auto result9 = state.read("key4", len);
-        auto result10 = state.read("key5", len);
-
-        // final cache state contains key 5 -> 1 -> 4
-        REQUIRE(result6 != nullptr);
-        REQUIRE(result7 == nullptr);
-        REQUIRE(result8 == nullptr);
-        REQUIRE(result9 != nullptr);
-        REQUIRE(result10 != nullptr);
+        check_final_state();
     }
 }
 
@@ -100,16 +100,16 @@ TEST_CASE("Cache state snapshot reads", "[cache_state][snapshot][read]") {
 
     // setup snapshot data
     auto item1 = create_item(6, future);
-    memcpy(item1.data.get()->data(), "value1", 6);
+    memcpy(item1.bytes(), "value1", 6);
     state.commit_write("key1", item1, now);
     auto item2 = create_item(6, future);
-    memcpy(item2.data.get()->data(), "value2", 6);
+    memcpy(item2.bytes(), "value2", 6);
     state.commit_write("key2", item2, now+1);
     auto item3 = create_item(6, future);
-    memcpy(item3.data.get()->data(), "value3", 6);
+    memcpy(item3.bytes(), "value3", 6);
     state.commit_write("key3", item3, now+2);
     auto item4 = create_item(6, future);
-    memcpy(item4.data.get()->data(), "value4", 6);
+    memcpy(item4.bytes(), "value4", 6);
     state.commit_write("key4", item4, now+3);
     state.begin_snapshot();
 
@@ -117,22 +117,22 @@ TEST_CASE("Cache state snapshot reads", "[cache_state][snapshot][read]") {
         auto data = state.read_snapshot_chunk(9999, item_index, read);
         auto items = read_snapshot_data(data.get(), read);
         REQUIRE(item_index == -1);
-        REQUIRE(memcmp(items[0].data.get()->data(), "value4", 6) == 0);
-        REQUIRE(memcmp(items[1].data.get()->data(), "value3", 6) == 0);
-        REQUIRE(memcmp(items[2].data.get()->data(), "value2", 6) == 0);
-        REQUIRE(memcmp(items[3].data.get()->data(), "value1", 6) == 0);
+        REQUIRE(memcmp(items[0].bytes(), "value4", 6) == 0);
+        REQUIRE(memcmp(items[1].bytes(), "value3", 6) == 0);
+        REQUIRE(memcmp(items[2].bytes(), "value2", 6) == 0);
+        REQUIRE(memcmp(items[3].bytes(), "value1", 6) == 0);
     }
 
     SECTION ( "return partial snapshot if too much data" ) {
-        auto data = state.read_snapshot_chunk(80, item_index, read);
+        auto data = state.read_snapshot_chunk(90, item_index, read);
         auto items = read_snapshot_data(data.get(), read);
         REQUIRE(item_index == 2);
         REQUIRE(items.size() == 2);
-        auto data2 = state.read_snapshot_chunk(80, item_index, read);
+        auto data2 = state.read_snapshot_chunk(90, item_index, read);
         auto items2 = read_snapshot_data(data2.get(), read);
         REQUIRE(item_index == -1);
         REQUIRE(items2.size() == 2);
-        REQUIRE(memcmp(items2[1].data.get()->data(), "value1", 6) == 0);
+        REQUIRE(memcmp(items2[1].bytes(), "value1", 6) == 0);
     }
 
     SECTION ( "commits don't change frozen snapshot data" ) {
@@ -142,7 +142,284 @@ TEST_CASE("Cache state snapshot reads", "[cache_state][snapshot][read]") {
         auto items = read_snapshot_data(data.get(), read);
         REQUIRE(item_index == -1);
         REQUIRE(items.size() == 4);
-        REQUIRE(memcmp(items[0].data.get()->data(), "value4", 6) == 0);
+        REQUIRE(memcmp(items[0].bytes(), "value4", 6) == 0);
+    }
+
+}
+
+TEST_CASE("Cache state snapshot during commits", "[cache_state][snapshot]") {
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 200 * item_size(100);
+    config.shard_count = 4;
+    lrucache::cache_state state(config);
+    std::time_t now = std::time(nullptr);
+
+    auto write = [&](int i, unsigned char value, std::time_t at) {
+        auto item = create_item(100, now + 1000);
+        memset(item.bytes(), value, 100);
+        state.commit_write("key" + std::to_string(i), item, at);
+    };
+    for (int i = 0; i < 100; i++) {
+        write(i, 'a', now);
+    }
+    state.begin_snapshot();
+
+    SECTION ( "frozen items are not changed by updates, evictions or purges" ) {
+        std::thread writer([&]() {
+            for (int i = 0; i < 2000; i++) {
+                write(i % 400, 'b', now + 1);
+            }
+            state.commit_purge_expired(now + 500);
+        });
+
+        size_t count = 0;
+        int item_index = 0;
+        size_t read = 0;
+        while (item_index >= 0) {
+            auto data = state.read_snapshot_chunk(1000, item_index, read);
+            for (auto& item : read_snapshot_data(data.get(), read)) {
+                REQUIRE(item.data_size == 100);
+                for (size_t i = 0; i < item.data_size; i++) {
+                    REQUIRE(item.bytes()[i] == 'a');
+                }
+                count++;
+            }
+        }
+        writer.join();
+        REQUIRE(count == 100);
+
+        state.end_snapshot();
+        size_t len = 0;
+        auto result = state.read("key399", len);
+        REQUIRE(result != nullptr);
+        REQUIRE(result[0] == 'b');
     }
+}
+
+TEST_CASE("Cache state snapshot cursor", "[cache_state][snapshot][read]") {
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 100 * item_size(200);
+    config.max_item_size = 200 + config.max_key_size;
+    config.shard_count = 3;
+    lrucache::cache_state state(config);
+    std::time_t now = std::time(nullptr);
+
+    for (int i = 0; i < 30; i++) {
+        auto item = create_item(i % 2 ? 200 : 10, now + 1000);
+        memset(item.bytes(), 'a' + i, item.data_size);
+        state.commit_write("key" + std::to_string(i), item, now);
+    }
+    state.begin_snapshot();
 
-}
\ No newline at end of file
+    auto gather = [](const std::vector<iovec>& iov) {
+        std::vector<unsigned char> result;
+        for (auto& buffer : iov) {
+            auto base = static_cast<unsigned char*>(buffer.iov_base);
+            result.insert(result.end(), base, base + buffer.iov_len);
+        }
+        return result;
+    };
+
+    SECTION ( "buffers describe the same bytes as read_snapshot_chunk" ) {
+        int item_index = 0;
+        size_t read = 0;
+        auto cursor = state.open_snapshot();
+        std::vector<iovec> iov;
+        while (item_index >= 0) {
+            auto data = state.read_snapshot_chunk(1000, item_index, read);
+            size_t bytes = cursor.next(1000, iov);
+            REQUIRE(bytes == read);
+            REQUIRE(gather(iov) == std::vector<unsigned char>(data.get(),
+                                                              data.get() + read));
+            REQUIRE(cursor.done() == (item_index < 0));
+        }
+        REQUIRE(cursor.position() == 30);
+    }
+
+    SECTION ( "values are pointed at, not copied" ) {
+        auto cursor = state.open_snapshot();
+        auto other = state.open_snapshot();
+        std::vector<iovec> iov;
+        std::vector<iovec> other_iov;
+        size_t count = 0;
+        while (!cursor.done()) {
+            cursor.next(300, iov);
+            other.next(300, other_iov);
+            REQUIRE(iov.size() == other_iov.size());
+            for (size_t i = 0; i < iov.size(); i++) {
+                if (iov[i].iov_len == 200) {
+                    // both cursors point at the chunk of the item
+                    REQUIRE(iov[i].iov_base == other_iov[i].iov_base);
+                    auto value = static_cast<unsigned char*>(iov[i].iov_base);
+                    auto key = "key" + std::to_string(value[0] - 'a');
+                    state.read_then(key, [&](unsigned char* data, size_t n) {
+                        REQUIRE(n == 200);
+                        REQUIRE(std::equal(data, data + n, value));
+                    });
+                    count++;
+                }
+            }
+        }
+        REQUIRE(count == 15);
+    }
+
+    SECTION ( "seek resumes from any item" ) {
+        auto cursor = state.open_snapshot();
+        std::vector<iovec> iov;
+        cursor.next(1000, iov);
+        size_t position = cursor.position();
+        auto expected = gather((cursor.next(1000, iov), iov));
+
+        auto other = state.open_snapshot();
+        other.seek(position);
+        other.next(1000, iov);
+        REQUIRE(gather(iov) == expected);
+    }
+
+    state.end_snapshot();
+}
+
+TEST_CASE("Cache state snapshot restore", "[cache_state][snapshot][restore]") {
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 100 * item_size(200);
+    config.max_item_size = 200 + config.max_key_size;
+    config.shard_count = 3;
+    lrucache::cache_state source(config);
+    lrucache::cache_state target(config);
+    std::time_t now = std::time(nullptr);
+    size_t len = 0;
+
+    for (int i = 0; i < 30; i++) {
+        auto item = create_item(i % 2 ? 200 : 10, now + 1000 + i);
+        memset(item.bytes(), 'a' + i, item.data_size);
+        source.commit_write("key" + std::to_string(i), item, now);
+    }
+    source.commit_read("key3", now + 1);
+    source.commit_read("key20", now + 1);
+    target.commit_write("other", create_item(10, now + 1000), now);
+    source.begin_snapshot();
+
+    auto restore = [&](std::time_t taken_at, size_t chunk_size) {
+        auto cursor = source.open_snapshot(true);
+        std::vector<iovec> iov;
+        target.begin_restore(taken_at);
+        while (!cursor.done()) {
+            std::vector<unsigned char> chunk;
+            cursor.next(chunk_size, iov);
+            for (auto& buffer : iov) {
+                auto base = static_cast<unsigned char*>(buffer.iov_base);
+                chunk.insert(chunk.end(), base, base + buffer.iov_len);
+            }
+            REQUIRE(target.restore_chunk(chunk.data(), chunk.size()));
+        }
+    };
+
+    SECTION ( "restored items are only visible once the restore ends" ) {
+        restore(now + 1, 1000);
+        REQUIRE(target.read("other", len) != nullptr);
+        REQUIRE(target.read("key0", len) == nullptr);
+
+        REQUIRE(target.end_restore());
+        REQUIRE_FALSE(target.end_restore());
+        REQUIRE(target.read("other", len) == nullptr);
+        for (int i = 0; i < 30; i++) {
+            auto result = target.read("key" + std::to_string(i), len);
+            REQUIRE(result != nullptr);
+            REQUIRE(len == (i % 2 ? 200 : 10));
+            REQUIRE(result[0] == 'a' + i);
+        }
+    }
+
+    SECTION ( "restored items keep the LRU order of the snapshot" ) {
+        restore(now + 1, 300);
+        target.end_restore();
+        target.begin_snapshot();
+
+        int source_index = 0;
+        int target_index = 0;
+        size_t source_read = 0;
+        size_t target_read = 0;
+        while (source_index >= 0) {
+            auto expected = source.read_snapshot_chunk(1000, source_index,
+                                                       source_read);
+            auto result = target.read_snapshot_chunk(1000, target_index,
+                                                     target_read);
+            REQUIRE(target_read == source_read);
+            REQUIRE(memcmp(result.get(), expected.get(), source_read) == 0);
+            REQUIRE(target_index == source_index);
+        }
+        target.end_snapshot();
+    }
+
+    SECTION ( "segments are restored in parallel" ) {
+        target.begin_restore(now + 1);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < source.shard_count(); i++) {
+            threads.emplace_back([&, i]() {
+                auto cursor = source.open_snapshot_segment(i, true);
+                std::vector<iovec> iov;
+                while (!cursor.done()) {
+                    std::vector<unsigned char> chunk;
+                    cursor.next(300, iov);
+                    for (auto& buffer : iov) {
+                        auto base = static_cast<unsigned char*>(buffer.iov_base);
+                        chunk.insert(chunk.end(), base, base + buffer.iov_len);
+                    }
+                    target.restore_chunk(chunk.data(), chunk.size());
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        target.end_restore();
+        target.begin_snapshot();
+
+        int source_index = 0;
+        int target_index = 0;
+        size_t source_read = 0;
+        size_t target_read = 0;
+        while (source_index >= 0) {
+            auto expected = source.read_snapshot_chunk(100000, source_index,
+                                                       source_read);
+            auto result = target.read_snapshot_chunk(100000, target_index,
+                                                     target_read);
+            REQUIRE(target_read == source_read);
+            REQUIRE(memcmp(result.get(), expected.get(), source_read) == 0);
+        }
+        target.end_snapshot();
+    }
+
+    SECTION ( "items expired by the time of the snapshot are not read" ) {
+        restore(now + 1010, 1000);
+        target.end_restore();
+        REQUIRE(target.clock() == now + 1010);
+        REQUIRE(target.read("key10", len) == nullptr);
+        REQUIRE(target.read("key11", len) != nullptr);
+
+        target.commit_purge_expired(now + 1010);
+        REQUIRE(target.read("key10", len) == nullptr);
+        REQUIRE(target.read("key11", len) != nullptr);
+    }
+
+    SECTION ( "truncated chunks are rejected" ) {
+        auto item = create_item(10, now + 1000);
+        unsigned char chunk[8 + 3 + 8 + 10 + 8 + 8];
+        size_t key_size = 3;
+        memcpy(chunk, &key_size, 8);
+        memcpy(chunk + 8, "abc", 3);
+        memcpy(chunk + 11, &item.data_size, 8);
+        memcpy(chunk + 19, item.bytes(), 10);
+        memcpy(chunk + 29, &item.expires_at, 8);
+        memcpy(chunk + 37, &item.version, 8);
+
+        REQUIRE_FALSE(target.restore_chunk(chunk, sizeof(chunk)));
+        target.begin_restore(now);
+        REQUIRE_FALSE(target.restore_chunk(chunk, sizeof(chunk) - 1));
+        REQUIRE(target.restore_chunk(chunk, sizeof(chunk)));
+        target.end_restore();
+        REQUIRE(target.read("abc", len) != nullptr);
+    }
+
+    source.end_snapshot();
+}
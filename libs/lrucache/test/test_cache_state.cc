@@ -1,5 +1,10 @@
 #include <catch.hpp>
 
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "cache/cache_state.hxx"
 #include "helpers/utilities.hxx"
 
@@ -99,3 +104,320 @@ TEST_CASE("Cache state basic write", "[cache_state][write]") {
         REQUIRE(result3 != nullptr);
     }
 }
+
+TEST_CASE("Cache state with multiple shards", "[cache_state][shards]") {
+    lrucache::cache_config config = build_default_cache_config();
+    config.shard_count = 8;
+    config.cache_size = config.shard_count * 32 * item_size(16);
+    lrucache::cache_state state(config);
+    std::time_t now = std::time(nullptr);
+    std::time_t future = now+1000;
+    size_t len = 0;
+
+    for (int i = 0; i < 32; i++) {
+        auto item = create_item(10, future);
+        state.commit_write("key" + std::to_string(i), item, now);
+    }
+
+    SECTION ( "every key is readable from its shard" ) {
+        REQUIRE(state.shard_count() == 8);
+        for (int i = 0; i < 32; i++) {
+            auto result = state.read("key" + std::to_string(i), len);
+            REQUIRE(result != nullptr);
+            REQUIRE(len == 10);
+        }
+    }
+
+    SECTION ( "purge is applied to every shard" ) {
+        state.commit_purge_expired(future+99999);
+        for (int i = 0; i < 32; i++) {
+            auto result = state.read("key" + std::to_string(i), len);
+            REQUIRE(result == nullptr);
+        }
+    }
+
+    SECTION ( "local purges follow the clock committed" ) {
+        REQUIRE(state.purge_expired() == 0);
+        state.advance_clock(future);
+        // expired items are no longer read, purged or not
+        REQUIRE(state.read("key0", len) == nullptr);
+        REQUIRE(state.purge_expired() == 32);
+        REQUIRE(state.purge_debt() == 0);
+    }
+
+    SECTION ( "snapshot chunks span every shard" ) {
+        int item_index = 0;
+        size_t read = 0;
+        size_t count = 0;
+        state.begin_snapshot();
+        while (item_index >= 0) {
+            auto data = state.read_snapshot_chunk(100, item_index, read);
+            count += read_snapshot_data(data.get(), read).size();
+        }
+        state.end_snapshot();
+        REQUIRE(count == 32);
+    }
+}
+
+TEST_CASE("Cache state lock-free reads", "[cache_state][read]") {
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 64 * item_size(200);
+    config.max_item_size = 1000;
+    lrucache::cache_state state(config);
+    std::time_t now = std::time(nullptr);
+    std::time_t future = now + 100;
+    size_t len = 0;
+
+    // every byte of a value is its size, so torn reads are detected
+    auto write = [&](const std::string& key, size_t size) {
+        std::vector<unsigned char> data(size, static_cast<unsigned char>(size));
+        lrucache::cache_item item(data.data(), size, future);
+        state.commit_write(key, item, now);
+    };
+    auto consistent = [](unsigned char* data, size_t len) {
+        for (size_t i = 0; i < len; i++) {
+            if (data[i] != static_cast<unsigned char>(len))
+                return false;
+        }
+        return true;
+    };
+
+    SECTION ( "a reader inside its callback does not block commits" ) {
+        write("key1", 150);
+        std::atomic<bool> reading(false);
+        std::atomic<bool> committed(false);
+        bool intact = false;
+        std::thread reader([&]() {
+            state.read_then("key1", [&](unsigned char* data, size_t len) {
+                reading = true;
+                while (!committed) {
+                    std::this_thread::yield();
+                }
+                intact = len == 150 && consistent(data, len);
+            });
+        });
+        while (!reading) {
+            std::this_thread::yield();
+        }
+
+        // overwrite then evict the entry the reader is using
+        write("key1", 180);
+        for (int i = 0; i < 1000; i++) {
+            write("other" + std::to_string(i), 200);
+        }
+        committed = true;
+        reader.join();
+        REQUIRE(intact);
+        REQUIRE(state.read("key1", len) == nullptr);
+    }
+
+    SECTION ( "readers never see torn data" ) {
+        std::atomic<bool> done(false);
+        std::atomic<int> errors(0);
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 4; t++) {
+            readers.emplace_back([&, t]() {
+                int i = t;
+                while (!done) {
+                    auto key = "key" + std::to_string(i++ % 32);
+                    state.read_then(key, [&](unsigned char* data, size_t len) {
+                        if (data && !consistent(data, len))
+                            errors++;
+                    });
+                }
+            });
+        }
+        for (int i = 0; i < 20000; i++) {
+            write("key" + std::to_string(i % 48), 1 + (i * 7) % 250);
+        }
+        done = true;
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        REQUIRE(errors == 0);
+    }
+
+    SECTION ( "readers never see a half changed expire or incr" ) {
+        write("key1", 150);
+        // the version of the counter is its value
+        lrucache::cache_item counter((unsigned char*) "0", 1, future, 0);
+        state.commit_write("count", counter, now);
+        std::atomic<bool> done(false);
+        std::atomic<int> errors(0);
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 4; t++) {
+            readers.emplace_back([&]() {
+                while (!done) {
+                    state.read_then("key1", [&](unsigned char* data,
+                                                size_t len) {
+                        if (!data || !consistent(data, len))
+                            errors++;
+                    });
+                    state.read_versioned("count", [&](unsigned char* data,
+                                                      size_t len,
+                                                      uint64_t version) {
+                        if (!data || std::string((char*) data, len)
+                                     != std::to_string(version))
+                            errors++;
+                    });
+                }
+            });
+        }
+        int64_t value = 0;
+        for (int i = 1; i <= 20000; i++) {
+            state.commit_expire("key1", future + i % 2, now);
+            state.commit_incr("count", 1, i, now, value);
+        }
+        done = true;
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        REQUIRE(errors == 0);
+        REQUIRE(value == 20000);
+    }
+}
+
+TEST_CASE("Cache state approximate recency", "[cache_state][touch]") {
+    lrucache::cache_config config = build_default_cache_config();
+    config.approximate_recency = true;
+    lrucache::cache_state state(config);
+    size_t len = 0;
+    auto expiry = std::time(nullptr)+1000;
+
+    state.commit_write("key1", create_item(20, expiry), std::time(nullptr));
+    state.commit_write("key2", create_item(20, expiry), std::time(nullptr));
+
+    SECTION ( "reads are only recorded until their touch is committed" ) {
+        REQUIRE(state.read("key1", len) != nullptr);
+        REQUIRE(state.read("key1", len) != nullptr);
+        REQUIRE(state.read("unknown", len) == nullptr);
+
+        state.commit_write("key3", create_item(20, expiry), std::time(nullptr));
+        REQUIRE(state.read("key1", len) == nullptr);
+        REQUIRE(state.read("key2", len) != nullptr);
+    }
+
+    SECTION ( "committed touches spare the items read from the sweep" ) {
+        REQUIRE(state.read("key1", len) != nullptr);
+        auto touches = state.collect_touches();
+        REQUIRE(touches.size() == 1);
+        REQUIRE(state.collect_touches().empty());
+
+        state.commit_touch(touches);
+        state.commit_write("key3", create_item(20, expiry), std::time(nullptr));
+        REQUIRE(state.read("key1", len) != nullptr);
+        REQUIRE(state.read("key2", len) == nullptr);
+    }
+
+    SECTION ( "touches committed during a snapshot are applied after it" ) {
+        REQUIRE(state.read("key1", len) != nullptr);
+        auto touches = state.collect_touches();
+
+        state.begin_snapshot();
+        state.commit_touch(touches);
+        state.end_snapshot();
+        state.commit_write("key3", create_item(20, expiry), std::time(nullptr));
+        REQUIRE(state.read("key1", len) != nullptr);
+        REQUIRE(state.read("key2", len) == nullptr);
+    }
+
+    SECTION ( "replicas applying the same touches evict the same items" ) {
+        lrucache::cache_state replica(config);
+        replica.commit_write("key1", create_item(20, expiry), std::time(nullptr));
+        replica.commit_write("key2", create_item(20, expiry), std::time(nullptr));
+
+        // only the leader served the read
+        REQUIRE(state.read("key2", len) != nullptr);
+        auto touches = state.collect_touches();
+        REQUIRE(replica.collect_touches().empty());
+
+        for (auto s : { &state, &replica }) {
+            s->commit_touch(touches);
+            s->commit_write("key3", create_item(20, expiry), std::time(nullptr));
+            REQUIRE(s->read("key1", len) == nullptr);
+            REQUIRE(s->read("key2", len) != nullptr);
+        }
+    }
+}
+
+TEST_CASE("Cache state touches of local reads", "[cache_state][touch]") {
+    lrucache::cache_config config = build_default_cache_config();
+    lrucache::cache_state state(config);
+    size_t len = 0;
+    auto expiry = std::time(nullptr)+1000;
+
+    state.commit_write("key1", create_item(20, expiry), std::time(nullptr));
+    state.commit_write("key2", create_item(20, expiry), std::time(nullptr));
+
+    SECTION ( "reads are only recorded when asked to" ) {
+        REQUIRE(state.read("key1", len) != nullptr);
+        REQUIRE(state.collect_touches().empty());
+
+        state.read_then("key1", [](unsigned char*, size_t) {}, true);
+        state.read_then("unknown", [](unsigned char*, size_t) {}, true);
+        REQUIRE(state.collect_touches().size() == 1);
+    }
+
+    SECTION ( "committed touches move the items read to the front" ) {
+        state.read_then("key1", [](unsigned char*, size_t) {}, true);
+        state.commit_touch(state.collect_touches());
+        state.commit_write("key3", create_item(20, expiry), std::time(nullptr));
+        REQUIRE(state.read("key1", len) != nullptr);
+        REQUIRE(state.read("key2", len) == nullptr);
+    }
+}
+
+TEST_CASE("Cache state batch commit", "[cache_state][batch]") {
+    lrucache::cache_config config = build_default_cache_config();
+    config.shard_count = 4;
+    size_t len = 0;
+    auto expiry = std::time(nullptr)+1000;
+    unsigned char data[4] = { 'T', 'e', 's', 't' };
+
+    std::vector<lrucache::cache_state::batch_op> ops;
+    for (int i = 0; i < 8; i++) {
+        lrucache::cache_state::batch_op op;
+        op.kind = lrucache::cache_state::batch_op::WRITE;
+        op.at = std::time(nullptr);
+        op.key = "key" + std::to_string(i);
+        op.data = data;
+        op.data_len = 4;
+        op.expires_at = i == 3 ? 0 : expiry;
+        ops.push_back(op);
+    }
+
+    SECTION ( "operations are applied in order" ) {
+        config.cache_size = 64 * item_size(4);
+        lrucache::cache_state state(config);
+        lrucache::cache_state::batch_op purge;
+        purge.kind = lrucache::cache_state::batch_op::PURGE;
+        purge.at = std::time(nullptr);
+        ops.push_back(purge);
+        state.commit_batch(ops);
+
+        for (int i = 0; i < 8; i++) {
+            auto result = state.read("key" + std::to_string(i), len);
+            REQUIRE((result != nullptr) == (i != 3));
+        }
+        REQUIRE(state.purge_debt() == 0);
+    }
+
+    SECTION ( "a batch evicts the same items as single commits" ) {
+        config.cache_size = 8 * item_size(4);
+        lrucache::cache_state state(config);
+        lrucache::cache_state single(config);
+        for (auto& op : ops) {
+            single.commit_write(
+                op.key,
+                { const_cast<unsigned char*>(op.data), op.data_len,
+                  op.expires_at },
+                op.at);
+        }
+        state.commit_batch(ops);
+        for (int i = 0; i < 8; i++) {
+            std::string key = "key" + std::to_string(i);
+            REQUIRE((state.read(key, len) != nullptr)
+                    == (single.read(key, len) != nullptr));
+        }
+    }
+}
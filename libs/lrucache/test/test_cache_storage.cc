@@ -1,6 +1,12 @@
 #include <catch.hpp>
 
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
 #include "cache/cache_storage.hxx"
+#include "cache/epoch_manager.hxx"
 #include "helpers/utilities.hxx"
 
 TEST_CASE("Cache storage read", "[cache_storage][read]") {
@@ -60,24 +66,213 @@ TEST_CASE("Cache storage evict data", "[cache_storage][evict]") {
         REQUIRE(result1 == nullptr);
         REQUIRE(result2 != nullptr);
     }
+
+    SECTION ( "never evicts the item being written" ) {
+        storage.commit_read("key1", now);
+        storage.evict_lru_data("key2", 99999);
+        auto result1 = storage.get_item("key1", now);
+        auto result2 = storage.get_item("key2", now);
+        REQUIRE(result1 == nullptr);
+        REQUIRE(result2 != nullptr);
+    }
+}
+
+TEST_CASE("Cache storage eviction headroom", "[cache_storage][evict]") {
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 4 * item_size(20);
+    config.eviction_headroom = 2 * item_size(20);
+    lrucache::cache_storage storage(config);
+    std::time_t now = std::time(nullptr);
+    std::time_t future = now+100;
+    for (int i = 1; i <= 4; i++) {
+        storage.commit_write("key" + std::to_string(i),
+                             create_item(20, future), now);
+    }
+    REQUIRE(storage.item_count() == 4);
+
+    SECTION ( "evicts down to the headroom once full" ) {
+        storage.commit_write("key5", create_item(20, future), now);
+        REQUIRE(storage.item_count() == 2);
+        REQUIRE(storage.available_memory() == 2 * item_size(20));
+
+        // the next writes fit without evicting
+        storage.commit_write("key6", create_item(20, future), now);
+        REQUIRE(storage.item_count() == 3);
+        REQUIRE(storage.get_item("key4", now) != nullptr);
+    }
+
+    SECTION ( "purges restore the headroom" ) {
+        storage.commit_purge(now);
+        REQUIRE(storage.item_count() == 2);
+        REQUIRE(storage.get_item("key3", now) != nullptr);
+        REQUIRE(storage.get_item("key4", now) != nullptr);
+    }
+
+    SECTION ( "local purges never evict live items" ) {
+        REQUIRE(storage.purge_expired(now, SIZE_MAX) == 0);
+        REQUIRE(storage.item_count() == 4);
+    }
+}
+
+TEST_CASE("Cache storage evictions whatever was purged locally",
+          "[cache_storage][evict]") {
+    auto name = GENERATE(as<std::string>{},
+                         "lru", "slru", "arc", "clock", "wtinylfu");
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 4 * 1024 * 1024;
+    config.eviction_headroom = 64 * 1024;
+    config.purge_batch_size = 8;
+    config.eviction_policy = name;
+    // one node purges often, the other never does
+    lrucache::cache_storage purging(config);
+    lrucache::cache_storage lagging(config);
+    std::mt19937 random(42);
+    std::time_t now = std::time(nullptr);
+
+    for (int i = 0; i < 5000; i++) {
+        auto key = "key" + std::to_string(random() % 2000);
+        // mostly short lived, over several slab classes
+        std::time_t ttl = random() % 4 ? 1 + random() % 20 : 1000;
+        auto item = create_item(100 + random() % 30000, now + ttl);
+        now += random() % 3;
+        for (auto storage : { &purging, &lagging }) {
+            storage->commit_write(key, item, now);
+            if (i % 7 == 0) {
+                storage->commit_read(key, now);
+            }
+            if (i % 500 == 0) {
+                storage->commit_purge(now);
+            }
+        }
+        if (i % 3 == 0) {
+            purging.purge_expired(now, random() % 50);
+        }
+    }
+
+    for (int i = 0; i < 2000; i++) {
+        auto key = "key" + std::to_string(i);
+        REQUIRE((purging.get_item(key, now) == nullptr)
+                == (lagging.get_item(key, now) == nullptr));
+    }
+}
+
+TEST_CASE("Cache storage evictions whatever the readers",
+          "[cache_storage][evict]") {
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 4 * 1024 * 1024;
+    config.eviction_headroom = 64 * 1024;
+    // one node has a reader holding its epoch all along, the other none
+    lrucache::epoch_manager epoch;
+    lrucache::cache_storage pinned(config, &epoch);
+    lrucache::cache_storage single(config);
+    auto guard = epoch.pin();
+    std::mt19937 random(42);
+    std::time_t now = std::time(nullptr);
+    std::vector<unsigned char> data(3000);
+
+    for (int i = 0; i < 5000; i++) {
+        auto key = "key" + std::to_string(random() % 3000);
+        // all in the same slab classes, which fill up and evict
+        size_t size = 2000 + random() % 1000;
+        std::fill(data.begin(), data.begin() + size, (unsigned char) i);
+        lrucache::cache_item item(data.data(), size, now + 1000);
+        for (auto storage : { &pinned, &single }) {
+            REQUIRE_NOTHROW(storage->commit_write(key, item, now));
+        }
+        REQUIRE(pinned.item_count() == single.item_count());
+    }
+
+    std::vector<unsigned char> buffer;
+    for (int i = 0; i < 3000; i++) {
+        auto key = "key" + std::to_string(i);
+        size_t len = 0;
+        auto result = pinned.read(key, now, len, buffer);
+        auto expected = single.get_item(key, now);
+        REQUIRE((result == nullptr) == (expected == nullptr));
+        if (result != nullptr) {
+            REQUIRE(len == expected->data_size);
+            REQUIRE(std::equal(result, result + len, expected->bytes()));
+        }
+    }
+}
+
+TEST_CASE("Cache storage bigger than 2GB", "[cache_storage][evict]") {
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 3ull * 1024 * 1024 * 1024;
+    lrucache::cache_storage storage(config);
+    std::time_t now = std::time(nullptr);
+    std::time_t future = now+100;
+
+    storage.commit_write("key1", create_item(20, future), now);
+    storage.commit_write("key2", create_item(20, future), now);
+    REQUIRE(storage.get_item("key1", now) != nullptr);
+    REQUIRE(storage.get_item("key2", now) != nullptr);
+}
+
+TEST_CASE("Cache storage item size limit", "[cache_storage]") {
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 10 * item_size(80);
+    // 80 bytes under a 4 characters key
+    config.max_item_size = 84;
+    lrucache::cache_storage storage(config);
+    std::time_t now = std::time(nullptr);
+    REQUIRE(storage.commit_write("key1", create_item(80, now + 100), now));
+
+    SECTION ( "writes bigger than the limit are rejected" ) {
+        REQUIRE_FALSE(storage.commit_write("key1", create_item(81, now + 100),
+                                           now));
+        REQUIRE(storage.get_commit_code()
+                == lrucache::cache_storage::DATA_TOO_BIG);
+        REQUIRE(storage.get_item("key1", now)->data_size == 80);
+        // the key counts too
+        REQUIRE_FALSE(storage.commit_write("key10", create_item(80, now + 100),
+                                           now));
+        REQUIRE(storage.get_commit_code()
+                == lrucache::cache_storage::DATA_TOO_BIG);
+        REQUIRE(storage.get_item("key10", now) == nullptr);
+    }
+
+    SECTION ( "cas bigger than the limit is rejected" ) {
+        auto version = storage.get_item("key1", now)->version;
+        REQUIRE_FALSE(storage.commit_cas("key1", create_item(81, now + 100),
+                                         version, now));
+        REQUIRE(storage.get_commit_code()
+                == lrucache::cache_storage::DATA_TOO_BIG);
+        REQUIRE(storage.get_item("key1", now)->data_size == 80);
+    }
+
+    SECTION ( "incr past the limit is rejected" ) {
+        config.max_item_size = 2;
+        lrucache::cache_storage small(config);
+        lrucache::cache_item nine((unsigned char*) "9", 1, now + 100);
+        REQUIRE(small.commit_write("n", nine, now));
+        int64_t value = 0;
+        REQUIRE_FALSE(small.commit_incr("n", 1, 2, now, value));
+        REQUIRE(small.get_commit_code()
+                == lrucache::cache_storage::DATA_TOO_BIG);
+        REQUIRE(small.commit_incr("n", -1, 2, now, value));
+        REQUIRE(value == 8);
+    }
 }
 
 TEST_CASE("Cache storage update", "[cache_storage][update]") {
+    // big enough for the data to live outside of the item
+    const size_t size = lrucache::cache_item::INLINE_SIZE + 40;
     lrucache::cache_config config = build_default_cache_config();
-    config.cache_size = 300;
+    config.cache_size = 3 * item_size(size) + 24;
     lrucache::cache_storage storage(config);
     std::time_t now = std::time(nullptr);
     std::time_t future = now+100;
-    auto item1 = create_item(40, future);
-    auto item2 = create_item(40, future);
+    auto item1 = create_item(size, future);
+    auto item2 = create_item(size, future);
     storage.commit_write("key1", item1, now);
-    memcpy(item1.data.get()->data(), "otherdata", 10);
+    memcpy(item1.bytes(), "otherdata", 10);
     storage.commit_write("key2", item2, now);
-    memcpy(item1.data.get()->data(), "olddata", 8);
+    memcpy(item1.bytes(), "olddata", 8);
 
     SECTION ( "updates item with new data" ) {
-        auto new_item = create_item(40, future);
-        memcpy(new_item.data.get()->data(), "success", 8);
+        auto new_item = create_item(size, future);
+        memcpy(new_item.bytes(), "success", 8);
         storage.commit_write("key1", new_item, now);
 
         auto result1 = storage.get_item("key1", now);
@@ -86,10 +281,10 @@ TEST_CASE("Cache storage update", "[cache_storage][update]") {
     }
 
     SECTION ( "move item to most recently used position" ) {
-        auto new_item2 = create_item(40, future);
+        auto new_item2 = create_item(size, future);
         storage.commit_write("key3", new_item2, now);
 
-        auto new_item = create_item(40, future);
+        auto new_item = create_item(size, future);
         storage.commit_write("key1", new_item, now);
         storage.evict_lru_data("nokey", 40);
 
@@ -102,7 +297,7 @@ TEST_CASE("Cache storage update", "[cache_storage][update]") {
     }
 
     SECTION ( "frees up memory if new item is smaller" ) { 
-        auto new_item = create_item(40, future);
+        auto new_item = create_item(size, future);
         storage.commit_write("key3", new_item, now);
      
         auto update_item = create_item(1, future);
@@ -119,7 +314,9 @@ TEST_CASE("Cache storage update", "[cache_storage][update]") {
     }
 
     SECTION ( "evicts item if new item is bigger" ) {
-        auto update_item = create_item(150, future);
+        // fits, but leaves less than 50 bytes available
+        auto update_item = create_item(data_size_for(2 * item_size(size)),
+                                       future);
         storage.commit_write("key1", update_item, now);
         storage.evict_lru_data("nokey", 50);
 
@@ -167,4 +364,171 @@ TEST_CASE("Cache storage purge expired data", "[cache_storage][purge]") {
         REQUIRE(result1 != nullptr); // was not expired
         REQUIRE(result2 == nullptr);
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Cache storage incremental purge", "[cache_storage][purge]") {
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 100 * item_size(20);
+    config.purge_batch_size = 4;
+    lrucache::cache_storage storage(config);
+    std::time_t now = std::time(nullptr);
+
+    for (int i = 0; i < 10; i++) {
+        storage.commit_write("key" + std::to_string(i),
+                             create_item(20, now + 10 + i % 2), now);
+    }
+
+    SECTION ( "each purge removes at most purge_batch_size items" ) {
+        storage.commit_purge(now + 11);
+        REQUIRE(storage.item_count() == 6);
+        REQUIRE(storage.purge_debt() == 6);
+        storage.commit_purge(now + 11);
+        storage.commit_purge(now + 12);
+        REQUIRE(storage.item_count() == 0);
+        REQUIRE(storage.purge_debt() == 0);
+    }
+
+    SECTION ( "purge debt only counts items expired at the last purge" ) {
+        storage.commit_purge(now + 5);
+        REQUIRE(storage.purge_debt() == 0);
+        storage.commit_purge(now + 10);
+        REQUIRE(storage.item_count() == 6);
+        REQUIRE(storage.purge_debt() == 1);
+    }
+
+    SECTION ( "expired items are removed when read" ) {
+        REQUIRE_FALSE(storage.commit_read("key0", now + 10));
+        REQUIRE(storage.item_count() == 9);
+        REQUIRE(storage.commit_read("key1", now + 10));
+    }
+
+    SECTION ( "local purges remove the expired items in batches" ) {
+        REQUIRE(storage.purge_expired(now + 10, 3) == 3);
+        REQUIRE(storage.purge_debt() == 2);
+        REQUIRE(storage.purge_expired(now + 10, 3) == 2);
+        REQUIRE(storage.item_count() == 5);
+        REQUIRE(storage.get_item("key1", now + 10) != nullptr);
+    }
+
+    SECTION ( "expired items are reclaimed before evicting live ones" ) {
+        for (int i = 10; i < 100; i++) {
+            storage.commit_write("key" + std::to_string(i),
+                                 create_item(20, now + 1000), now + 10);
+        }
+        storage.commit_write("key100", create_item(20, now + 1000), now + 10);
+        // all of the expired items go, whatever memory was missing
+        REQUIRE(storage.item_count() == 96);
+        for (int i = 10; i <= 100; i++) {
+            REQUIRE(storage.get_item("key" + std::to_string(i), now + 10));
+        }
+    }
+}
+
+TEST_CASE("Cache storage delete, expire, cas and incr", "[cache_storage]") {
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 10 * item_size(20);
+    lrucache::epoch_manager epoch;
+    lrucache::cache_storage storage(config, &epoch);
+    std::time_t now = std::time(nullptr);
+    // not inlined, so that its data stays in the chunk
+    auto item = create_item(80, now + 100);
+    item.version = 7;
+    storage.commit_write("key1", item, now);
+    lrucache::cache_item counter((unsigned char*) "41", 2, now + 100, 8);
+    storage.commit_write("count", counter, now);
+    int64_t value = 0;
+
+    SECTION ( "delete removes live items only" ) {
+        REQUIRE(storage.commit_delete("key1", now + 1));
+        REQUIRE(storage.get_item("key1", now + 1) == nullptr);
+        REQUIRE_FALSE(storage.commit_delete("key1", now + 1));
+        REQUIRE(storage.get_commit_code()
+                == lrucache::cache_storage::NOT_FOUND);
+        REQUIRE_FALSE(storage.commit_delete("count", now + 100));
+        REQUIRE(storage.item_count() == 0);
+    }
+
+    SECTION ( "expire changes the expiry and nothing else" ) {
+        auto data = storage.get_item("key1", now)->bytes();
+        REQUIRE(storage.commit_expire("key1", now + 200, now + 1));
+        auto result = storage.get_item("key1", now + 150);
+        REQUIRE(result != nullptr);
+        REQUIRE(result->bytes() == data);
+        REQUIRE(result->version == 7);
+        storage.commit_purge(now + 150);
+        REQUIRE(storage.item_count() == 1);
+        storage.commit_purge(now + 200);
+        REQUIRE(storage.item_count() == 0);
+
+        REQUIRE_FALSE(storage.commit_expire("count", now, now + 1));
+        REQUIRE(storage.get_commit_code()
+                == lrucache::cache_storage::WRONG_EXPIRY);
+        REQUIRE_FALSE(storage.commit_expire("key2", now + 200, now + 1));
+        REQUIRE(storage.get_commit_code()
+                == lrucache::cache_storage::NOT_FOUND);
+    }
+
+    SECTION ( "cas writes over the version expected only" ) {
+        auto update = create_item(10, now + 100);
+        update.version = 9;
+        REQUIRE_FALSE(storage.commit_cas("key1", update, 6, now + 1));
+        REQUIRE(storage.get_commit_code()
+                == lrucache::cache_storage::WRONG_VERSION);
+        REQUIRE(storage.get_item("key1", now + 1)->data_size == 80);
+        REQUIRE(storage.commit_cas("key1", update, 7, now + 1));
+        REQUIRE(storage.get_item("key1", now + 1)->data_size == 10);
+        REQUIRE(storage.get_item("key1", now + 1)->version == 9);
+        REQUIRE_FALSE(storage.commit_cas("key2", update, 0, now + 1));
+        REQUIRE(storage.get_commit_code()
+                == lrucache::cache_storage::NOT_FOUND);
+    }
+
+    SECTION ( "incr adds to decimal integers" ) {
+        REQUIRE(storage.commit_incr("count", 1, 10, now + 1, value));
+        REQUIRE(value == 42);
+        REQUIRE(storage.commit_incr("count", -50, 11, now + 1, value));
+        REQUIRE(value == -8);
+        auto result = storage.get_item("count", now + 1);
+        REQUIRE(std::string((char*) result->bytes(), result->data_size)
+                == "-8");
+        REQUIRE(result->version == 11);
+        REQUIRE(result->expires_at == now + 100);
+    }
+
+    SECTION ( "incr rejects other data and overflows" ) {
+        REQUIRE_FALSE(storage.commit_incr("key1", 1, 10, now + 1, value));
+        REQUIRE(storage.get_commit_code()
+                == lrucache::cache_storage::NOT_A_NUMBER);
+        lrucache::cache_item max((unsigned char*) "9223372036854775807", 19,
+                                 now + 100);
+        storage.commit_write("max", max, now);
+        REQUIRE_FALSE(storage.commit_incr("max", 1, 10, now + 1, value));
+        REQUIRE(storage.get_commit_code()
+                == lrucache::cache_storage::NOT_A_NUMBER);
+        REQUIRE(storage.commit_incr("max", -1, 10, now + 1, value));
+        REQUIRE_FALSE(storage.commit_incr("nope", 1, 10, now + 1, value));
+        REQUIRE(storage.get_commit_code()
+                == lrucache::cache_storage::NOT_FOUND);
+    }
+
+    SECTION ( "frozen items are not changed in place" ) {
+        storage.freeze();
+        REQUIRE(storage.commit_expire("key1", now + 200, now + 1));
+        REQUIRE(storage.commit_incr("count", 1, 10, now + 1, value));
+        for (auto entry : storage.frozen_entries()) {
+            if (entry->key() == "key1") {
+                REQUIRE(entry->item.expires_at == now + 100);
+            } else {
+                REQUIRE(std::string((char*) entry->item.bytes(),
+                                    entry->item.data_size) == "41");
+            }
+        }
+        storage.thaw();
+        REQUIRE(storage.get_item("key1", now + 150) != nullptr);
+        auto result = storage.get_item("count", now + 1);
+        REQUIRE(std::string((char*) result->bytes(), result->data_size)
+                == "42");
+        REQUIRE(storage.commit_delete("key1", now + 2));
+        REQUIRE(storage.commit_delete("count", now + 2));
+    }
+}
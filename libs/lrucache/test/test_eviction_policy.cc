@@ -0,0 +1,212 @@
+#include <catch.hpp>
+
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "cache/arc_policy.hxx"
+#include "cache/cache_storage.hxx"
+#include "cache/entry_pool.hxx"
+#include "cache/eviction_policy.hxx"
+#include "cache/key_hash.hxx"
+#include "helpers/utilities.hxx"
+
+struct policy_fixture {
+    policy_fixture(const std::string& name)
+        : policy(lrucache::eviction_policy::create(name)) {}
+
+    lrucache::cache_entry* insert(const std::string& key) {
+        auto entry = pool.allocate();
+        entry->item.key = keys.emplace_back(key);
+        entry->hash = lrucache::key_hash(key);
+        policy->inserted(entry);
+        return entry;
+    }
+
+    lrucache::cache_entry* evict(const lrucache::cache_entry* pinned = nullptr) {
+        auto entry = policy->victim(pinned);
+        if (entry) {
+            policy->removed(entry, true);
+        }
+        return entry;
+    }
+
+    std::unique_ptr<lrucache::eviction_policy> policy;
+    lrucache::entry_pool pool;
+    std::deque<std::string> keys;
+};
+
+TEST_CASE("Every eviction policy", "[eviction_policy]") {
+    auto name = GENERATE(as<std::string>{},
+                         "lru", "slru", "arc", "clock", "wtinylfu");
+    policy_fixture fixture(name);
+    std::vector<lrucache::cache_entry*> entries;
+    for (int i = 0; i < 10; i++) {
+        entries.push_back(fixture.insert("key" + std::to_string(i)));
+        if (i % 3 == 0) {
+            fixture.policy->accessed(entries.back());
+        }
+    }
+
+    SECTION ( "evicts every entry but the pinned one " + name ) {
+        auto pinned = entries[0];
+        size_t evicted = 0;
+        while (auto entry = fixture.evict(pinned)) {
+            REQUIRE(entry != pinned);
+            evicted++;
+        }
+        REQUIRE(evicted == entries.size() - 1);
+    }
+
+    SECTION ( "evicts nothing once cleared " + name ) {
+        fixture.policy->clear();
+        REQUIRE(fixture.policy->victim(nullptr) == nullptr);
+    }
+}
+
+TEST_CASE("Eviction policy names", "[eviction_policy]") {
+    REQUIRE_THROWS_AS(lrucache::eviction_policy::create("mru"),
+                      std::invalid_argument);
+}
+
+TEST_CASE("LRU eviction policy", "[eviction_policy]") {
+    policy_fixture fixture("lru");
+    auto entry1 = fixture.insert("key1");
+    auto entry2 = fixture.insert("key2");
+    fixture.policy->accessed(entry1);
+    REQUIRE(fixture.evict() == entry2);
+    REQUIRE(fixture.evict() == entry1);
+}
+
+TEST_CASE("SLRU eviction policy", "[eviction_policy]") {
+    policy_fixture fixture("slru");
+    std::vector<lrucache::cache_entry*> hot;
+    for (int i = 0; i < 4; i++) {
+        hot.push_back(fixture.insert("hot" + std::to_string(i)));
+        fixture.policy->accessed(hot.back());
+    }
+
+    SECTION ( "a scan does not flush entries accessed twice" ) {
+        for (int i = 0; i < 20; i++) {
+            fixture.insert("scan" + std::to_string(i));
+        }
+        for (int i = 0; i < 20; i++) {
+            auto entry = fixture.evict();
+            REQUIRE(entry->key().substr(0, 4) == "scan");
+        }
+    }
+}
+
+TEST_CASE("CLOCK eviction policy", "[eviction_policy]") {
+    policy_fixture fixture("clock");
+    auto entry1 = fixture.insert("key1");
+    auto entry2 = fixture.insert("key2");
+    auto entry3 = fixture.insert("key3");
+
+    SECTION ( "referenced entries get a second chance" ) {
+        fixture.policy->accessed(entry1);
+        REQUIRE(fixture.evict() == entry2);
+        REQUIRE(fixture.evict() == entry3);
+        REQUIRE(fixture.evict() == entry1);
+    }
+
+    SECTION ( "entries are evicted in insertion order otherwise" ) {
+        REQUIRE(fixture.evict() == entry1);
+        auto entry4 = fixture.insert("key4");
+        REQUIRE(fixture.evict() == entry2);
+        REQUIRE(fixture.evict() == entry3);
+        REQUIRE(fixture.evict() == entry4);
+    }
+}
+
+TEST_CASE("ARC eviction policy", "[eviction_policy]") {
+    policy_fixture fixture("arc");
+    auto arc = static_cast<lrucache::arc_policy*>(fixture.policy.get());
+    for (int i = 0; i < 4; i++) {
+        fixture.insert("key" + std::to_string(i));
+    }
+
+    SECTION ( "a key evicted recently comes back as frequent" ) {
+        auto evicted = fixture.evict();
+        REQUIRE(evicted->key() == "key0");
+        fixture.pool.release(evicted);
+        REQUIRE(arc->target() == 0);
+
+        auto entry = fixture.insert("key0");
+        REQUIRE(entry->policy_segment == lrucache::arc_policy::T2);
+        REQUIRE(arc->target() == 1);
+    }
+
+    SECTION ( "entries seen once are evicted first" ) {
+        auto frequent = fixture.insert("frequent");
+        fixture.policy->accessed(frequent);
+        for (int i = 0; i < 4; i++) {
+            REQUIRE(fixture.evict() != frequent);
+        }
+        REQUIRE(fixture.evict() == frequent);
+    }
+}
+
+TEST_CASE("W-TinyLFU eviction policy", "[eviction_policy]") {
+    policy_fixture fixture("wtinylfu");
+    std::vector<lrucache::cache_entry*> hot;
+    for (int i = 0; i < 10; i++) {
+        hot.push_back(fixture.insert("hot" + std::to_string(i)));
+        for (int j = 0; j < 5; j++) {
+            fixture.policy->accessed(hot.back());
+        }
+    }
+    // move the hot entries out of the window
+    fixture.insert("filler");
+    while (fixture.evict()->key() != "filler") {}
+
+    SECTION ( "one time keys are not admitted over frequent ones" ) {
+        for (int i = 0; i < 100; i++) {
+            fixture.insert("scan" + std::to_string(i));
+            auto entry = fixture.evict();
+            REQUIRE(entry->key().substr(0, 4) == "scan");
+        }
+    }
+}
+
+TEST_CASE("Cache storage eviction policy", "[eviction_policy]") {
+    auto config = build_default_cache_config();
+    config.cache_size = 20 * item_size(20);
+    std::time_t now = std::time(nullptr);
+    std::time_t future = now + 100;
+
+    auto hot_keys_left = [&](const std::string& name) {
+        config.eviction_policy = name;
+        lrucache::cache_storage storage(config);
+        for (int i = 0; i < 10; i++) {
+            auto key = "hot" + std::to_string(i);
+            storage.commit_write(key, create_item(20, future), now);
+            for (int j = 0; j < 5; j++) {
+                storage.commit_read(key, now);
+            }
+        }
+        for (int i = 0; i < 100; i++) {
+            auto key = "k" + std::to_string(100 + i);
+            storage.commit_write(key, create_item(20, future), now);
+        }
+        int left = 0;
+        for (int i = 0; i < 10; i++) {
+            if (storage.get_item("hot" + std::to_string(i), now)) {
+                left++;
+            }
+        }
+        return left;
+    };
+
+    SECTION ( "a scan flushes LRU" ) {
+        REQUIRE(hot_keys_left("lru") == 0);
+    }
+
+    SECTION ( "a scan does not flush the scan resistant policies" ) {
+        REQUIRE(hot_keys_left("slru") == 10);
+        REQUIRE(hot_keys_left("arc") == 10);
+        REQUIRE(hot_keys_left("wtinylfu") == 10);
+    }
+}
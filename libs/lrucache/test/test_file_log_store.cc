@@ -0,0 +1,190 @@
+#include <catch.hpp>
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "raft/file_log_store.hxx"
+
+using lrucache::file_log_store;
+using nuraft::ptr;
+
+/**
+ * Log entry of `term` whose payload is `size` bytes of `byte`.
+ */
+static ptr<nuraft::log_entry> create_entry(nuraft::ulong term, size_t size,
+                                           unsigned char byte)
+{
+    auto buf = nuraft::buffer::alloc(size);
+    std::memset(buf->data_begin(), byte, size);
+    return nuraft::cs_new<nuraft::log_entry>(term, buf);
+}
+
+/**
+ * Check that entry `index` is the one appended by the test cases below.
+ */
+static void check_entry(const ptr<nuraft::log_entry>& entry,
+                        nuraft::ulong index, nuraft::ulong term)
+{
+    REQUIRE(entry->get_term() == term);
+    REQUIRE(entry->get_buf().size() == 10 + index % 50);
+    REQUIRE(entry->get_buf().data_begin()[0]
+            == static_cast<unsigned char>(index));
+}
+
+static size_t segment_count(const std::string& dir)
+{
+    size_t count = 0;
+    for (auto& entry : std::filesystem::directory_iterator(dir)) {
+        count += entry.path().extension() == ".seg";
+    }
+    return count;
+}
+
+TEST_CASE("File log store", "[raft][log_store]") {
+    std::string dir = "test_file_log_store_" + std::to_string(getpid());
+    std::filesystem::remove_all(dir);
+    auto store = std::make_unique<file_log_store>(dir, 1000, 0);
+
+    REQUIRE(store->start_index() == 1);
+    REQUIRE(store->next_slot() == 1);
+    REQUIRE(store->last_entry()->get_term() == 0);
+    for (nuraft::ulong i = 1; i <= 100; i++) {
+        auto entry = create_entry(i / 10, 10 + i % 50, i);
+        REQUIRE(store->append(entry) == i);
+    }
+    store->end_of_append_batch(1, 100);
+    REQUIRE(store->last_durable_index() == 100);
+    REQUIRE(segment_count(dir) > 1);
+
+    SECTION ( "entries are read back" ) {
+        auto entries = store->log_entries(1, 101);
+        REQUIRE(entries->size() == 100);
+        for (nuraft::ulong i = 1; i <= 100; i++) {
+            check_entry((*entries)[i - 1], i, i / 10);
+            REQUIRE(store->term_at(i) == i / 10);
+        }
+        check_entry(store->last_entry(), 100, 10);
+        REQUIRE(store->log_entries_ext(1, 101, 100)->size() < 10);
+    }
+
+    SECTION ( "entries are found again after a restart" ) {
+        store.reset();
+        store = std::make_unique<file_log_store>(dir, 1000, 0);
+        REQUIRE(store->start_index() == 1);
+        REQUIRE(store->next_slot() == 101);
+        REQUIRE(store->last_durable_index() == 100);
+        for (nuraft::ulong i = 1; i <= 100; i++) {
+            check_entry(store->entry_at(i), i, i / 10);
+        }
+    }
+
+    SECTION ( "a torn entry is dropped at restart" ) {
+        store.reset();
+        std::string last;
+        for (auto& entry : std::filesystem::directory_iterator(dir)) {
+            if (entry.path().extension() == ".seg"
+                    && entry.path().string() > last) {
+                last = entry.path().string();
+            }
+        }
+        REQUIRE(truncate(last.c_str(),
+                         std::filesystem::file_size(last) - 5) == 0);
+
+        store = std::make_unique<file_log_store>(dir, 1000, 0);
+        REQUIRE(store->next_slot() == 100);
+        check_entry(store->last_entry(), 99, 9);
+        auto entry = create_entry(11, 10 + 100 % 50, 100);
+        REQUIRE(store->append(entry) == 100);
+        check_entry(store->entry_at(100), 100, 11);
+    }
+
+    SECTION ( "write_at drops the following entries" ) {
+        auto entry = create_entry(20, 10 + 30 % 50, 30);
+        store->write_at(30, entry);
+        REQUIRE(store->next_slot() == 31);
+        REQUIRE(store->last_durable_index() == 29);
+        store->end_of_append_batch(30, 1);
+
+        store.reset();
+        store = std::make_unique<file_log_store>(dir, 1000, 0);
+        REQUIRE(store->next_slot() == 31);
+        check_entry(store->entry_at(29), 29, 2);
+        check_entry(store->entry_at(30), 30, 20);
+    }
+
+    SECTION ( "compaction removes whole segments" ) {
+        size_t segments = segment_count(dir);
+        REQUIRE(store->compact(50));
+        REQUIRE(store->start_index() == 51);
+        REQUIRE(segment_count(dir) < segments);
+        check_entry(store->entry_at(51), 51, 5);
+
+        store.reset();
+        store = std::make_unique<file_log_store>(dir, 1000, 0);
+        REQUIRE(store->start_index() <= 51);
+        REQUIRE(store->next_slot() == 101);
+    }
+
+    SECTION ( "compaction past the last entry starts over" ) {
+        REQUIRE(store->compact(200));
+        REQUIRE(store->start_index() == 201);
+        REQUIRE(store->next_slot() == 201);
+        REQUIRE(store->last_durable_index() == 200);
+        REQUIRE(segment_count(dir) == 1);
+
+        store.reset();
+        store = std::make_unique<file_log_store>(dir, 1000, 0);
+        REQUIRE(store->start_index() == 201);
+        REQUIRE(store->next_slot() == 201);
+    }
+
+    SECTION ( "packs are applied" ) {
+        auto pack = store->pack(41, 20);
+        std::string other_dir = dir + "_other";
+        std::filesystem::remove_all(other_dir);
+        {
+            file_log_store other(other_dir, 1000, 0);
+            other.apply_pack(41, *pack);
+            REQUIRE(other.start_index() == 41);
+            REQUIRE(other.next_slot() == 61);
+            REQUIRE(other.last_durable_index() == 60);
+            for (nuraft::ulong i = 41; i <= 60; i++) {
+                check_entry(other.entry_at(i), i, i / 10);
+            }
+        }
+        std::filesystem::remove_all(other_dir);
+    }
+
+    SECTION ( "batches are flushed together in the background" ) {
+        store.reset();
+        store = std::make_unique<file_log_store>(dir, 1000, 20000);
+        std::atomic<int> flushes(0);
+        std::atomic<int> failures(0);
+        store->set_flush_callback([&](bool ok) {
+            (ok ? flushes : failures)++;
+        });
+        for (nuraft::ulong i = 101; i <= 110; i++) {
+            auto entry = create_entry(11, 10 + i % 50, i);
+            store->append(entry);
+            store->end_of_append_batch(i, 1);
+        }
+        REQUIRE(store->last_durable_index() == 100);
+        for (int i = 0; i < 1000 && store->last_durable_index() < 110; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        REQUIRE(store->last_durable_index() == 110);
+        REQUIRE(failures == 0);
+        REQUIRE(flushes >= 1);
+        REQUIRE(flushes < 10);
+    }
+
+    store.reset();
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,547 @@
+#include <catch.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "cache/snapshot_codec.hxx"
+#include "helpers/utilities.hxx"
+#include "raft/log_batcher.hxx"
+#include "schema/LogEntry_generated.h"
+
+using lrucache::cache_state_machine;
+using lrucache::hybrid_clock;
+using lrucache::log_batcher;
+using nuraft::ptr;
+
+static cache_state_machine::op_payload create_op(
+        cache_state_machine::op_type type, const std::string& key,
+        time_t timestamp = 1)
+{
+    cache_state_machine::op_payload op;
+    op.type = type;
+    op.timestamp = timestamp;
+    op.key = key;
+    op.data_len = 0;
+    op.data = nullptr;
+    op.expires_at = 0;
+    return op;
+}
+
+TEST_CASE("Batch log entries", "[raft][batch]") {
+    unsigned char data[4] = { 'T', 'e', 's', 't' };
+    auto write = create_op(cache_state_machine::WRITE, "key1", 2);
+    write.data = data;
+    write.data_len = 4;
+    write.expires_at = 1000;
+    auto touch = create_op(cache_state_machine::TOUCH, "", 3);
+    touch.hashes = { 7, 8 };
+
+    cache_state_machine::op_payload batch;
+    batch.type = cache_state_machine::BATCH;
+    batch.timestamp = 3;
+    batch.ops = { create_op(cache_state_machine::READ, "key2"), write,
+                  create_op(cache_state_machine::PURGE, "", 2), touch };
+
+    auto log = cache_state_machine::encode_log(batch);
+    cache_state_machine::op_payload decoded;
+    cache_state_machine::decode_log(*log, decoded);
+    REQUIRE(decoded.type == cache_state_machine::BATCH);
+    REQUIRE(decoded.timestamp == 3);
+    REQUIRE(decoded.ops.size() == 4);
+    REQUIRE(decoded.ops[0].type == cache_state_machine::READ);
+    REQUIRE(decoded.ops[0].key == "key2");
+    REQUIRE(decoded.ops[1].key == "key1");
+    REQUIRE(decoded.ops[1].data_len == 4);
+    REQUIRE(std::memcmp(decoded.ops[1].data, "Test", 4) == 0);
+    REQUIRE(decoded.ops[1].expires_at == 1000);
+    REQUIRE(decoded.ops[2].type == cache_state_machine::PURGE);
+    REQUIRE(decoded.ops[3].hashes == std::vector<uint64_t>{ 7, 8 });
+
+    auto cas = create_op(cache_state_machine::CAS, "key3", 4);
+    cas.data = data;
+    cas.data_len = 4;
+    cas.expires_at = 1000;
+    cas.expected = 42;
+    auto incr = create_op(cache_state_machine::INCR, "key4", 4);
+    incr.delta = -3;
+    auto expire = create_op(cache_state_machine::EXPIRE, "key5", 4);
+    expire.expires_at = 2000;
+    batch.ops = { cas, incr, expire,
+                  create_op(cache_state_machine::DELETE, "key6", 4) };
+    log = cache_state_machine::encode_log(batch);
+    REQUIRE(log->size() <= cache_state_machine::encoded_size(batch));
+    REQUIRE(cache_state_machine::decode_log(*log, decoded));
+    REQUIRE(decoded.ops.size() == 4);
+    REQUIRE(decoded.ops[0].type == cache_state_machine::CAS);
+    REQUIRE(decoded.ops[0].expected == 42);
+    REQUIRE(std::memcmp(decoded.ops[0].data, "Test", 4) == 0);
+    REQUIRE(decoded.ops[1].type == cache_state_machine::INCR);
+    REQUIRE(decoded.ops[1].delta == -3);
+    REQUIRE(decoded.ops[2].type == cache_state_machine::EXPIRE);
+    REQUIRE(decoded.ops[2].expires_at == 2000);
+    REQUIRE(decoded.ops[3].type == cache_state_machine::DELETE);
+    REQUIRE(decoded.ops[3].key == "key6");
+}
+
+TEST_CASE("Commit log entries", "[raft][batch]") {
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 64 * 1024;
+    config.max_item_size = 1024;
+    cache_state_machine machine(config);
+
+    std::vector<unsigned char> value(500, 'v');
+    auto write = create_op(cache_state_machine::WRITE, "key1", 2);
+    write.data = value.data();
+    write.data_len = value.size();
+    write.expires_at = std::time(nullptr) + 3600;
+
+    SECTION ( "values are read from the entry" ) {
+        auto log = cache_state_machine::encode_log(write);
+        REQUIRE(cache_state_machine::read_log(*log) != nullptr);
+        machine.commit(1, *log);
+        // the entry is gone, the cache kept its own copy
+        log.reset();
+
+        size_t len = 0;
+        auto data = machine.state().read("key1", len);
+        REQUIRE(data != nullptr);
+        REQUIRE(len == value.size());
+        REQUIRE(std::memcmp(data.get(), value.data(), len) == 0);
+        REQUIRE(machine.last_commit_index() == 1);
+    }
+
+    SECTION ( "batched values are read from the entry" ) {
+        cache_state_machine::op_payload batch;
+        batch.type = cache_state_machine::BATCH;
+        batch.timestamp = 2;
+        batch.ops = { create_op(cache_state_machine::READ, "key2"), write };
+        machine.commit(1, *cache_state_machine::encode_log(batch));
+
+        size_t len = 0;
+        REQUIRE(machine.state().read("key1", len) != nullptr);
+        REQUIRE(len == value.size());
+    }
+
+    SECTION ( "invalid entries are skipped" ) {
+        auto log = cache_state_machine::encode_log(write);
+        log->data_begin()[4] = 'X';
+        REQUIRE(cache_state_machine::read_log(*log) == nullptr);
+        cache_state_machine::op_payload decoded;
+        REQUIRE(!cache_state_machine::decode_log(*log, decoded));
+
+        auto truncated = nuraft::buffer::alloc(log->size() / 2);
+        std::memcpy(truncated->data_begin(), log->data_begin(),
+                    truncated->size());
+        REQUIRE(cache_state_machine::read_log(*truncated) == nullptr);
+
+        machine.commit(1, *log);
+        size_t len = 0;
+        REQUIRE(machine.state().read("key1", len) == nullptr);
+        REQUIRE(machine.last_commit_index() == 1);
+    }
+
+    SECTION ( "entries of a later version stop the commits" ) {
+        namespace schema = lrucache::schema;
+        flatbuffers::FlatBufferBuilder builder;
+        auto read = schema::CreateReadOpDirect(builder, "key1");
+        auto operation = schema::CreateOperation(
+            builder, 2, schema::Op_ReadOp, read.Union());
+        schema::FinishLogEntryBuffer(
+            builder, schema::CreateLogEntry(
+                builder, cache_state_machine::LOG_VERSION + 1, operation));
+        auto log = nuraft::buffer::alloc(builder.GetSize());
+        std::memcpy(log->data_begin(), builder.GetBufferPointer(),
+                    builder.GetSize());
+        REQUIRE(cache_state_machine::read_log(*log) != nullptr);
+        cache_state_machine::op_payload decoded;
+        REQUIRE(!cache_state_machine::decode_log(*log, decoded));
+
+        REQUIRE_THROWS_AS(machine.commit(1, *log), std::runtime_error);
+        REQUIRE(machine.last_commit_index() == 0);
+    }
+
+    SECTION ( "operations unknown to this version stop the commits" ) {
+        namespace schema = lrucache::schema;
+        // as added by a later version, alone or in a batch
+        auto unknown = static_cast<schema::Op>(schema::Op_MAX + 1);
+        for (bool batched : { false, true }) {
+            flatbuffers::FlatBufferBuilder builder;
+            auto read = schema::CreateReadOpDirect(builder, "key1");
+            auto operation = schema::CreateOperation(builder, 2, unknown,
+                                                     read.Union());
+            if (batched) {
+                std::vector<flatbuffers::Offset<schema::Operation>> ops = {
+                    operation };
+                operation = schema::CreateOperation(
+                    builder, 2, schema::Op_BatchOp,
+                    schema::CreateBatchOpDirect(builder, &ops).Union());
+            }
+            schema::FinishLogEntryBuffer(
+                builder, schema::CreateLogEntry(
+                    builder, cache_state_machine::LOG_VERSION, operation));
+            auto log = nuraft::buffer::alloc(builder.GetSize());
+            std::memcpy(log->data_begin(), builder.GetBufferPointer(),
+                        builder.GetSize());
+            REQUIRE(cache_state_machine::read_log(*log) != nullptr);
+            cache_state_machine::op_payload decoded;
+            REQUIRE(!cache_state_machine::decode_log(*log, decoded));
+
+            REQUIRE_THROWS_AS(machine.commit(1, *log), std::runtime_error);
+            REQUIRE(machine.last_commit_index() == 0);
+        }
+    }
+
+    SECTION ( "expiries are checked against the clock committed" ) {
+        write.timestamp = hybrid_clock::from_millis(1000);
+        write.expires_at = 1500;
+        machine.commit(1, *cache_state_machine::encode_log(write));
+        size_t len = 0;
+        REQUIRE(machine.state().clock() == 1000);
+        REQUIRE(machine.state().read("key1", len) != nullptr);
+
+        // an empty TOUCH only moves the clock
+        auto tick = create_op(cache_state_machine::TOUCH, "",
+                              hybrid_clock::from_millis(1500) + 1);
+        machine.commit(2, *cache_state_machine::encode_log(tick));
+        REQUIRE(machine.state().clock() == 1500);
+        REQUIRE(machine.state().read("key1", len) == nullptr);
+        REQUIRE(machine.clock().last() == hybrid_clock::from_millis(1500) + 1);
+        REQUIRE(machine.clock().now() > hybrid_clock::from_millis(1500) + 1);
+    }
+
+    SECTION ( "entries of version 2 count seconds" ) {
+        namespace schema = lrucache::schema;
+        flatbuffers::FlatBufferBuilder builder;
+        auto op = schema::CreateWriteOp(
+                builder, builder.CreateString("key1"),
+                builder.CreateVector(value.data(), 10), 5).Union();
+        schema::FinishLogEntryBuffer(
+                builder, schema::CreateLogEntry(
+                        builder, 2, schema::CreateOperation(
+                                builder, 4, schema::Op_WriteOp, op)));
+        auto log = nuraft::buffer::alloc(builder.GetSize());
+        std::memcpy(log->data_begin(), builder.GetBufferPointer(),
+                    builder.GetSize());
+
+        cache_state_machine::op_payload decoded;
+        REQUIRE(cache_state_machine::decode_log(*log, decoded));
+        REQUIRE(decoded.timestamp == hybrid_clock::from_millis(4000));
+        REQUIRE(decoded.expires_at == 5000);
+
+        machine.commit(1, *log);
+        size_t len = 0;
+        REQUIRE(machine.state().clock() == 4000);
+        REQUIRE(machine.state().read("key1", len) != nullptr);
+    }
+
+    SECTION ( "each operation reports its outcome" ) {
+        using lrucache::cache_storage;
+        cache_state_machine::op_result result;
+        auto ret = machine.commit(1, *cache_state_machine::encode_log(write));
+        REQUIRE(cache_state_machine::read_result(*ret, 0, result));
+        REQUIRE(result.code == cache_storage::DONE_OK);
+        uint64_t version = 1 << cache_state_machine::VERSION_SHIFT;
+        REQUIRE(result.version == version);
+
+        unsigned char ten[2] = { '1', '0' };
+        auto cas = create_op(cache_state_machine::CAS, "key1", 3);
+        cas.data = ten;
+        cas.data_len = 2;
+        cas.expires_at = write.expires_at;
+        cas.expected = version + 1;
+        auto incr = create_op(cache_state_machine::INCR, "key1", 3);
+        incr.delta = 5;
+        cache_state_machine::op_payload batch;
+        batch.type = cache_state_machine::BATCH;
+        batch.timestamp = 3;
+        batch.ops = { cas, cas, incr,
+                      create_op(cache_state_machine::DELETE, "key2", 3) };
+        batch.ops[1].expected = version;
+        ret = machine.commit(2, *cache_state_machine::encode_log(batch));
+
+        uint64_t batch_version = 2 << cache_state_machine::VERSION_SHIFT;
+        REQUIRE(cache_state_machine::read_result(*ret, 0, result));
+        REQUIRE(result.code == cache_storage::WRONG_VERSION);
+        REQUIRE(cache_state_machine::read_result(*ret, 1, result));
+        REQUIRE(result.code == cache_storage::DONE_OK);
+        REQUIRE(result.version == batch_version + 1);
+        REQUIRE(cache_state_machine::read_result(*ret, 2, result));
+        REQUIRE(result.value == 15);
+        REQUIRE(result.version == batch_version + 2);
+        REQUIRE(cache_state_machine::read_result(*ret, 3, result));
+        REQUIRE(result.code == cache_storage::NOT_FOUND);
+        REQUIRE(!cache_state_machine::read_result(*ret, 4, result));
+
+        machine.state().read_versioned("key1",
+                [&](unsigned char* data, size_t len, uint64_t version) {
+            REQUIRE(std::string((char*) data, len) == "15");
+            REQUIRE(version == batch_version + 2);
+        });
+    }
+
+    SECTION ( "batched operations get their own outcome" ) {
+        nuraft::ulong index = 0;
+        log_batcher batcher(1000 * 1000, 1024 * 1024,
+                            [&](ptr<nuraft::buffer> entry) {
+            auto ret = nuraft::cs_new<log_batcher::result>();
+            ret->accept();
+            auto committed = machine.commit(++index, *entry);
+            ptr<std::exception> err;
+            ret->set_result(committed, err);
+            return ret;
+        });
+        auto read = batcher.propose(
+                create_op(cache_state_machine::READ, "key1"));
+        auto written = batcher.propose(write);
+        auto incr = create_op(cache_state_machine::INCR, "key1", 3);
+        incr.delta = 1;
+        auto incremented = batcher.propose(incr);
+        auto reread = batcher.propose(
+                create_op(cache_state_machine::READ, "key1", 3));
+        batcher.flush();
+
+        cache_state_machine::op_result result;
+        REQUIRE(cache_state_machine::read_result(*written->get(), 0,
+                                                 result));
+        REQUIRE(result.code == lrucache::cache_storage::DONE_OK);
+        REQUIRE(cache_state_machine::read_result(*incremented->get(), 0,
+                                                 result));
+        REQUIRE(result.code == lrucache::cache_storage::NOT_A_NUMBER);
+        // the first read was dropped for the last one
+        for (auto& each : { read, reread }) {
+            REQUIRE(cache_state_machine::read_result(*each->get(), 0,
+                                                     result));
+            REQUIRE(result.code == lrucache::cache_storage::DONE_OK);
+            REQUIRE(!cache_state_machine::read_result(*each->get(), 1,
+                                                      result));
+        }
+    }
+
+    SECTION ( "empty touches get the log index of their entry" ) {
+        nuraft::ulong index = 6;
+        log_batcher batcher(1000 * 1000, 1024 * 1024,
+                            [&](ptr<nuraft::buffer> entry) {
+            auto ret = nuraft::cs_new<log_batcher::result>();
+            ret->accept();
+            auto committed = machine.commit(++index, *entry);
+            ptr<std::exception> err;
+            ret->set_result(committed, err);
+            return ret;
+        });
+        auto written = batcher.propose(write);
+        auto touched = batcher.propose(
+                create_op(cache_state_machine::TOUCH, "", 3));
+        batcher.flush();
+
+        nuraft::ulong log_idx = 0;
+        REQUIRE(cache_state_machine::read_log_idx(*touched->get(), log_idx));
+        REQUIRE(log_idx == 7);
+        REQUIRE(cache_state_machine::read_log_idx(*written->get(), log_idx));
+        REQUIRE(log_idx == 7);
+        REQUIRE(!cache_state_machine::read_log_idx(*nuraft::buffer::alloc(4),
+                                                   log_idx));
+    }
+}
+
+TEST_CASE("Save snapshot objects", "[raft][snapshot]") {
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 64 * 1024;
+    config.max_item_size = 1024;
+    cache_state_machine machine(config);
+    nuraft::snapshot s(1, 1, nuraft::cs_new<nuraft::cluster_config>());
+    std::time_t now = hybrid_clock::wall_millis();
+
+    // an object of a single frame holding `chunk`
+    lrucache::snapshot_codec codec;
+    auto object = [&codec](const std::vector<unsigned char>& chunk) {
+        std::vector<unsigned char> frame;
+        codec.encode(chunk.data(), chunk.size(), frame);
+        auto data = nuraft::buffer::alloc(2 * sizeof(uint32_t)
+                                          + frame.size());
+        nuraft::buffer_serializer bs(data);
+        bs.put_u32(1);
+        bs.put_u32(static_cast<uint32_t>(frame.size()));
+        bs.put_raw(frame.data(), frame.size());
+        data->pos(0);
+        return data;
+    };
+
+    auto item = create_item(10, now + 1000 * 1000);
+    std::vector<unsigned char> chunk(8 + 3 + 8 + 10 + 8 + 8);
+    size_t key_size = 3;
+    std::memcpy(&chunk[0], &key_size, 8);
+    std::memcpy(&chunk[8], "abc", 3);
+    std::memcpy(&chunk[11], &item.data_size, 8);
+    std::memcpy(&chunk[19], item.bytes(), 10);
+    std::memcpy(&chunk[29], &item.expires_at, 8);
+    std::memcpy(&chunk[37], &item.version, 8);
+    std::vector<unsigned char> truncated(chunk.begin(), chunk.end() - 1);
+
+    auto meta = nuraft::buffer::alloc(sizeof(uint64_t));
+    nuraft::buffer_serializer(meta).put_u64(static_cast<uint64_t>(now));
+    meta->pos(0);
+    ulong obj_id = 0;
+    machine.save_logical_snp_obj(s, obj_id, *meta, true, false);
+    REQUIRE(obj_id == 1);
+
+    SECTION ( "restored objects move on to the next one" ) {
+        machine.save_logical_snp_obj(s, obj_id, *object(chunk), false, false);
+        REQUIRE(obj_id == 2);
+    }
+
+    SECTION ( "objects not restored start the transfer over" ) {
+        machine.save_logical_snp_obj(s, obj_id, *object(truncated), false,
+                                     false);
+        REQUIRE(obj_id == 0);
+    }
+
+    SECTION ( "snapshots restored are applied" ) {
+        machine.save_logical_snp_obj(s, obj_id, *object(chunk), false, true);
+        REQUIRE(machine.apply_snapshot(s));
+        size_t len = 0;
+        REQUIRE(machine.state().read("abc", len) != nullptr);
+        REQUIRE(machine.last_commit_index() == 1);
+    }
+
+    SECTION ( "snapshots never restored are not applied" ) {
+        cache_state_machine other(config);
+        REQUIRE_FALSE(other.apply_snapshot(s));
+        REQUIRE(other.last_commit_index() == 0);
+    }
+
+    SECTION ( "a last object not restored stops the node" ) {
+        REQUIRE_THROWS_AS(machine.save_logical_snp_obj(
+                              s, obj_id, *object(truncated), false, true),
+                          std::runtime_error);
+    }
+}
+
+TEST_CASE("Log batcher", "[raft][batch]") {
+    std::mutex lock;
+    std::vector<ptr<nuraft::buffer>> appended;
+    auto append = [&](ptr<nuraft::buffer> entry) {
+        std::lock_guard<std::mutex> guard(lock);
+        appended.push_back(entry);
+        auto ret = nuraft::cs_new<log_batcher::result>();
+        ret->accept();
+        auto index = nuraft::buffer::alloc(sizeof(uint64_t));
+        index->put(static_cast<nuraft::ulong>(appended.size()));
+        index->pos(0);
+        ptr<std::exception> err;
+        ret->set_result(index, err);
+        return ret;
+    };
+    auto decode = [&](size_t i) {
+        cache_state_machine::op_payload payload;
+        cache_state_machine::decode_log(*appended[i], payload);
+        return payload;
+    };
+
+    SECTION ( "operations within the window share an entry" ) {
+        log_batcher batcher(1000 * 1000, 1024 * 1024, append);
+        auto first = batcher.propose(
+                create_op(cache_state_machine::READ, "key1"));
+        auto second = batcher.propose(
+                create_op(cache_state_machine::READ, "key2"));
+        REQUIRE(appended.empty());
+        REQUIRE(!first->has_result());
+
+        batcher.flush();
+        REQUIRE(appended.size() == 1);
+        for (auto& result : { first, second }) {
+            REQUIRE(result->has_result());
+            REQUIRE(result->get_accepted());
+            REQUIRE(result->get_result_code()
+                    == nuraft::cmd_result_code::OK);
+            auto index = result->get();
+            index->pos(0);
+            REQUIRE(index->get_ulong() == 1);
+        }
+        auto batch = decode(0);
+        REQUIRE(batch.type == cache_state_machine::BATCH);
+        REQUIRE(batch.ops.size() == 2);
+    }
+
+    SECTION ( "repeated reads and touches are replicated once" ) {
+        log_batcher batcher(1000 * 1000, 1024 * 1024, append);
+        auto touch = create_op(cache_state_machine::TOUCH, "");
+        touch.hashes = { 1, 2 };
+        batcher.propose(touch);
+        batcher.propose(create_op(cache_state_machine::READ, "key1", 1));
+        batcher.propose(create_op(cache_state_machine::WRITE, "key2", 2));
+        batcher.propose(create_op(cache_state_machine::READ, "key1", 3));
+        touch.hashes = { 2, 3 };
+        batcher.propose(touch);
+        touch.hashes = { 1 };
+        auto repeated = batcher.propose(touch);
+        batcher.flush();
+        REQUIRE(repeated->has_result());
+
+        auto batch = decode(0);
+        REQUIRE(batch.timestamp == 3);
+        REQUIRE(batch.ops.size() == 4);
+        REQUIRE(batch.ops[0].hashes == std::vector<uint64_t>{ 1, 2 });
+        REQUIRE(batch.ops[1].type == cache_state_machine::WRITE);
+        REQUIRE(batch.ops[2].type == cache_state_machine::READ);
+        REQUIRE(batch.ops[2].timestamp == 3);
+        REQUIRE(batch.ops[3].hashes == std::vector<uint64_t>{ 3 });
+    }
+
+    SECTION ( "a full batch is appended right away" ) {
+        log_batcher batcher(1000 * 1000, 200, append);
+        batcher.propose(create_op(cache_state_machine::READ, "key1"));
+        REQUIRE(appended.empty());
+        batcher.propose(create_op(cache_state_machine::READ,
+                                  std::string(64, 'k')));
+        REQUIRE(appended.size() == 1);
+    }
+
+    SECTION ( "a batch is appended at the end of its window" ) {
+        log_batcher batcher(1000, 1024 * 1024, append);
+        auto result = batcher.propose(
+                create_op(cache_state_machine::READ, "key1"));
+        for (int i = 0; i < 1000 && !result->has_result(); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        REQUIRE(result->has_result());
+        std::lock_guard<std::mutex> guard(lock);
+        REQUIRE(appended.size() == 1);
+        REQUIRE(decode(0).type == cache_state_machine::READ);
+    }
+
+    SECTION ( "entries are stamped in order by the clock" ) {
+        hybrid_clock clock;
+        clock.observe(hybrid_clock::from_millis(hybrid_clock::wall_millis()
+                                                + 60 * 1000));
+        uint64_t ahead = clock.last();
+        log_batcher batcher(1000 * 1000, 1024 * 1024, append, &clock);
+        batcher.propose(create_op(cache_state_machine::READ, "key1", 7));
+        batcher.propose(create_op(cache_state_machine::WRITE, "key2", 9));
+        batcher.flush();
+        // an empty TOUCH is kept, to move the clock of the nodes
+        batcher.propose(create_op(cache_state_machine::TOUCH, ""));
+        batcher.flush();
+
+        REQUIRE(appended.size() == 2);
+        auto batch = decode(0);
+        REQUIRE(batch.timestamp == ahead + 1);
+        REQUIRE(batch.ops[0].timestamp == ahead + 1);
+        REQUIRE(batch.ops[1].timestamp == ahead + 1);
+        auto tick = decode(1);
+        REQUIRE(tick.type == cache_state_machine::TOUCH);
+        REQUIRE(tick.timestamp == ahead + 2);
+    }
+
+    SECTION ( "without a window every operation is appended alone" ) {
+        log_batcher batcher(0, 1024 * 1024, append);
+        batcher.propose(create_op(cache_state_machine::READ, "key1"));
+        batcher.propose(create_op(cache_state_machine::READ, "key1"));
+        REQUIRE(appended.size() == 2);
+        REQUIRE(decode(1).type == cache_state_machine::READ);
+    }
+}
@@ -0,0 +1,144 @@
+#include <catch.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "raft/ring_log_store.hxx"
+
+using lrucache::ring_log_store;
+using nuraft::ptr;
+
+static ptr<nuraft::log_entry> create_entry(
+        nuraft::ulong term, unsigned char byte,
+        nuraft::log_val_type type = nuraft::log_val_type::app_log)
+{
+    auto buf = nuraft::buffer::alloc(16);
+    std::memset(buf->data_begin(), byte, 16);
+    return nuraft::cs_new<nuraft::log_entry>(term, buf, type);
+}
+
+static unsigned char byte_of(const ptr<nuraft::log_entry>& entry)
+{
+    return entry->get_buf().data_begin()[0];
+}
+
+TEST_CASE("Ring log store", "[raft][log_store]") {
+    ring_log_store store;
+    const nuraft::ulong count = 3 * ring_log_store::SLAB_SIZE + 10;
+
+    REQUIRE(store.start_index() == 1);
+    REQUIRE(store.next_slot() == 1);
+    REQUIRE(store.last_entry()->get_term() == 0);
+    std::vector<ptr<nuraft::log_entry>> appended;
+    for (nuraft::ulong i = 1; i <= count; i++) {
+        appended.push_back(create_entry(i / 100, i));
+        REQUIRE(store.append(appended.back()) == i);
+    }
+    REQUIRE(store.next_slot() == count + 1);
+
+    SECTION ( "application entries are read without copies" ) {
+        auto entries = store.log_entries(1, count + 1);
+        REQUIRE(entries->size() == count);
+        for (nuraft::ulong i = 1; i <= count; i++) {
+            REQUIRE((*entries)[i - 1] == appended[i - 1]);
+            REQUIRE(store.term_at(i) == i / 100);
+        }
+        REQUIRE(store.entry_at(5) == appended[4]);
+        REQUIRE(store.last_entry() == appended.back());
+        REQUIRE(store.log_entries_ext(1, count + 1, 100)->size() == 7);
+    }
+
+    SECTION ( "other entries are copied" ) {
+        auto config = create_entry(100, 'c', nuraft::log_val_type::conf);
+        store.append(config);
+        auto entry = store.entry_at(count + 1);
+        REQUIRE(entry != config);
+        REQUIRE(entry->get_val_type() == nuraft::log_val_type::conf);
+        REQUIRE(byte_of(entry) == 'c');
+    }
+
+    SECTION ( "write_at drops the following entries" ) {
+        auto entry = create_entry(50, 'x');
+        store.write_at(100, entry);
+        REQUIRE(store.next_slot() == 101);
+        REQUIRE(store.entry_at(100) == entry);
+        REQUIRE(store.term_at(101) == 0);
+        REQUIRE(store.log_entries(99, 200)->size() == 2);
+
+        auto next = create_entry(50, 'y');
+        REQUIRE(store.append(next) == 101);
+        REQUIRE(store.entry_at(101) == next);
+    }
+
+    SECTION ( "compaction advances the head" ) {
+        REQUIRE(store.compact(2 * ring_log_store::SLAB_SIZE + 5));
+        REQUIRE(store.start_index() == 2 * ring_log_store::SLAB_SIZE + 6);
+        REQUIRE(store.term_at(10) == 0);
+        REQUIRE(store.entry_at(2 * ring_log_store::SLAB_SIZE + 6)
+                == appended[2 * ring_log_store::SLAB_SIZE + 5]);
+
+        // the slabs compacted away are reused
+        nuraft::ulong last = count + 2 * ring_log_store::SLAB_SIZE;
+        for (nuraft::ulong i = count + 1; i <= last; i++) {
+            auto entry = create_entry(1000, i);
+            REQUIRE(store.append(entry) == i);
+        }
+        REQUIRE(byte_of(store.last_entry())
+                == static_cast<unsigned char>(last));
+    }
+
+    SECTION ( "compaction past the last entry starts over" ) {
+        REQUIRE(store.compact(count + 100));
+        REQUIRE(store.start_index() == count + 101);
+        REQUIRE(store.next_slot() == count + 101);
+        auto entry = create_entry(1000, 'z');
+        REQUIRE(store.append(entry) == count + 101);
+        REQUIRE(store.entry_at(count + 101) == entry);
+    }
+
+    SECTION ( "packs are applied" ) {
+        auto pack = store.pack(41, 20);
+        ring_log_store other;
+        other.apply_pack(41, *pack);
+        REQUIRE(other.start_index() == 41);
+        REQUIRE(other.next_slot() == 61);
+        for (nuraft::ulong i = 41; i <= 60; i++) {
+            REQUIRE(byte_of(other.entry_at(i))
+                    == static_cast<unsigned char>(i));
+        }
+    }
+
+    SECTION ( "reads go on while appending and compacting" ) {
+        std::atomic<bool> stop(false);
+        std::atomic<size_t> errors(0);
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 4; t++) {
+            readers.emplace_back([&]() {
+                while (!stop) {
+                    nuraft::ulong start = store.start_index();
+                    auto entries = store.log_entries(start, start + 100);
+                    for (size_t i = 0; i < entries->size(); i++) {
+                        if (byte_of((*entries)[i])
+                                != static_cast<unsigned char>(start + i)) {
+                            errors++;
+                        }
+                    }
+                }
+            });
+        }
+        for (nuraft::ulong i = count + 1; i <= count + 50000; i++) {
+            auto entry = create_entry(1000, i);
+            store.append(entry);
+            if (i % 1000 == 0) {
+                store.compact(i - 500);
+            }
+        }
+        stop = true;
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        REQUIRE(errors == 0);
+    }
+}
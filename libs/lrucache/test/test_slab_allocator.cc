@@ -0,0 +1,92 @@
+#include <catch.hpp>
+
+#include <string>
+
+#include "cache/cache_storage.hxx"
+#include "cache/slab_allocator.hxx"
+#include "helpers/utilities.hxx"
+
+using lrucache::slab_allocator;
+
+TEST_CASE("Slab allocator classes", "[slab_allocator]") {
+    SECTION ( "class sizes grow by at most the growth factor" ) {
+        size_t previous = slab_allocator::chunk_size(1);
+        REQUIRE(previous == slab_allocator::MIN_CHUNK_SIZE);
+        for (size_t i = 1; i < slab_allocator::class_count() - 1; i++) {
+            size_t size = slab_allocator::chunk_size(previous + 1);
+            REQUIRE(size > previous);
+            REQUIRE(size <= previous * slab_allocator::GROWTH_FACTOR + 8);
+            previous = size;
+        }
+    }
+
+    SECTION ( "sizes bigger than a page use the huge class" ) {
+        size_t size = slab_allocator::PAGE_SIZE + 1;
+        REQUIRE(slab_allocator::class_for(size) == slab_allocator::HUGE_CLASS);
+        REQUIRE(slab_allocator::chunk_size(size) == size);
+    }
+}
+
+TEST_CASE("Slab allocator chunks", "[slab_allocator]") {
+    slab_allocator slab(slab_allocator::PAGE_SIZE);
+
+    SECTION ( "released chunks are reused" ) {
+        auto chunk1 = slab.allocate(100);
+        auto chunk2 = slab.allocate(100);
+        REQUIRE(chunk1 != chunk2);
+        slab.release(chunk1, 100);
+        REQUIRE(slab.allocate(100) == chunk1);
+        REQUIRE(slab.reserved_memory() == slab_allocator::PAGE_SIZE);
+    }
+
+    SECTION ( "a class gets its first page even over the limit" ) {
+        REQUIRE(slab.allocate(100) != nullptr);
+        REQUIRE(slab.allocate(1000) != nullptr);
+        REQUIRE(slab.reserved_memory() == 2 * slab_allocator::PAGE_SIZE);
+    }
+
+    SECTION ( "an exhausted class returns nullptr" ) {
+        size_t size = slab_allocator::PAGE_SIZE / 4;
+        size_t chunks = slab_allocator::PAGE_SIZE
+                      / slab_allocator::chunk_size(size);
+        for (size_t i = 0; i < chunks; i++) {
+            REQUIRE(slab.allocate(size) != nullptr);
+        }
+        auto chunk = slab.allocate(size);
+        REQUIRE(chunk == nullptr);
+    }
+
+    SECTION ( "huge chunks are accounted for" ) {
+        size_t size = 2 * slab_allocator::PAGE_SIZE;
+        auto chunk = slab.allocate(size);
+        REQUIRE(slab.reserved_memory() == size);
+        slab.release(chunk, size);
+        REQUIRE(slab.reserved_memory() == 0);
+    }
+}
+
+TEST_CASE("Cache storage evicts within a slab class", "[slab_allocator]") {
+    auto config = build_default_cache_config();
+    config.cache_size = 2 * slab_allocator::PAGE_SIZE;
+    config.max_item_size = slab_allocator::PAGE_SIZE;
+    lrucache::cache_storage storage(config);
+    std::time_t now = std::time(nullptr);
+    std::time_t future = now + 100;
+
+    // a small item in another class, least recently used of all
+    REQUIRE(storage.commit_write("small", create_item(100, future), now));
+
+    // fill the only page of the class of big items, then write one more
+    size_t size = slab_allocator::PAGE_SIZE / 4;
+    size_t chunks = slab_allocator::PAGE_SIZE
+                  / slab_allocator::chunk_size(size + 4);
+    for (size_t i = 0; i <= chunks; i++) {
+        auto key = "k" + std::to_string(100 + i);
+        REQUIRE(storage.commit_write(key, create_item(size, future), now));
+    }
+
+    REQUIRE(storage.get_item("small", now) != nullptr);
+    REQUIRE(storage.get_item("k100", now) == nullptr);
+    REQUIRE(storage.get_item("k101", now) != nullptr);
+    REQUIRE(storage.item_count() == chunks + 1);
+}
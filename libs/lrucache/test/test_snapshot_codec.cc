@@ -0,0 +1,122 @@
+#include <catch.hpp>
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "cache/crc32c.hxx"
+#include "cache/snapshot_codec.hxx"
+
+using lrucache::snapshot_codec;
+using lrucache::snapshot_compression;
+
+TEST_CASE("CRC-32C checksum", "[snapshot_codec]") {
+    SECTION ( "matches the check value of the standard" ) {
+        REQUIRE(lrucache::crc32c("123456789", 9) == 0xE3069283);
+        REQUIRE(lrucache::crc32c("", 0) == 0);
+    }
+
+    SECTION ( "can be computed one buffer after the other" ) {
+        std::string data = "snapshot chunks are checksummed before install";
+        uint32_t crc = lrucache::crc32c(data.data(), 13);
+        crc = lrucache::crc32c(data.data() + 13, data.size() - 13, crc);
+        REQUIRE(crc == lrucache::crc32c(data.data(), data.size()));
+    }
+}
+
+TEST_CASE("Snapshot codec frames", "[snapshot_codec]") {
+    std::vector<unsigned char> chunk;
+    for (int i = 0; i < 1000; i++) {
+        std::string record = "{\"id\":" + std::to_string(i)
+                             + ",\"name\":\"item\",\"tags\":[\"a\",\"b\"]}";
+        chunk.insert(chunk.end(), record.begin(), record.end());
+    }
+    std::vector<iovec> iov = {
+        { chunk.data(), 100 },
+        { chunk.data() + 100, chunk.size() - 100 }
+    };
+    std::vector<unsigned char> frame;
+    std::vector<unsigned char> decoded;
+
+    std::vector<snapshot_compression> compressions;
+    for (auto compression : { snapshot_compression::NONE,
+                              snapshot_compression::LZ4,
+                              snapshot_compression::ZSTD }) {
+        if (snapshot_codec::is_available(compression)) {
+            compressions.push_back(compression);
+        }
+    }
+
+    SECTION ( "frames decode back to their chunk" ) {
+        for (auto compression : compressions) {
+            snapshot_codec codec(compression);
+            codec.encode(iov, frame);
+            REQUIRE(snapshot_codec::decode(frame.data(), frame.size(),
+                                           decoded));
+            REQUIRE(decoded == chunk);
+            if (compression != snapshot_compression::NONE) {
+                REQUIRE(frame.size() < chunk.size());
+            }
+        }
+    }
+
+    SECTION ( "empty chunks are framed too" ) {
+        snapshot_codec codec;
+        codec.encode({}, frame);
+        REQUIRE(frame.size() == snapshot_codec::HEADER_SIZE);
+        REQUIRE(snapshot_codec::decode(frame.data(), frame.size(), decoded));
+        REQUIRE(decoded.empty());
+    }
+
+    SECTION ( "incompressible chunks are stored as is" ) {
+        std::vector<unsigned char> noise(4096);
+        uint32_t state = 1;
+        for (auto& byte : noise) {
+            state = state * 1103515245 + 12345;
+            byte = static_cast<unsigned char>(state >> 24);
+        }
+        for (auto compression : compressions) {
+            snapshot_codec(compression).encode(noise.data(), noise.size(),
+                                               frame);
+            REQUIRE(frame.size() == snapshot_codec::HEADER_SIZE + noise.size());
+            REQUIRE(snapshot_codec::decode(frame.data(), frame.size(),
+                                           decoded));
+            REQUIRE(decoded == noise);
+        }
+    }
+
+    SECTION ( "corrupt frames are rejected" ) {
+        for (auto compression : compressions) {
+            snapshot_codec codec(compression);
+            codec.encode(iov, frame);
+            for (size_t i : { size_t(0), size_t(4), size_t(9), size_t(17),
+                              snapshot_codec::HEADER_SIZE,
+                              frame.size() - 1 }) {
+                auto corrupt = frame;
+                corrupt[i] ^= 0x20;
+                REQUIRE_FALSE(snapshot_codec::decode(corrupt.data(),
+                                                     corrupt.size(), decoded));
+            }
+            REQUIRE_FALSE(snapshot_codec::decode(frame.data(),
+                                                 frame.size() - 1, decoded));
+            REQUIRE_FALSE(snapshot_codec::decode(frame.data(), 10, decoded));
+        }
+    }
+
+    SECTION ( "compressions are parsed from their name" ) {
+        REQUIRE(snapshot_codec::parse("none") == snapshot_compression::NONE);
+        REQUIRE_THROWS_AS(snapshot_codec::parse("gzip"),
+                          std::invalid_argument);
+        for (auto name : { "lz4", "zstd" }) {
+            auto compression = std::string(name) == "lz4"
+                ? snapshot_compression::LZ4 : snapshot_compression::ZSTD;
+            if (snapshot_codec::is_available(compression)) {
+                REQUIRE(snapshot_codec::parse(name) == compression);
+            } else {
+                REQUIRE_THROWS_AS(snapshot_codec::parse(name),
+                                  std::invalid_argument);
+            }
+        }
+    }
+}
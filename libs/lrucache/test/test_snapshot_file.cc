@@ -0,0 +1,271 @@
+#include <catch.hpp>
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "cache/cache_state.hxx"
+#include "cache/snapshot_file.hxx"
+#include "helpers/utilities.hxx"
+
+using lrucache::snapshot_file;
+
+/**
+ * Flip a byte of a file.
+ */
+static void corrupt(const std::string& path, size_t offset)
+{
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekg(offset);
+    char byte = static_cast<char>(file.get());
+    file.seekp(offset);
+    file.put(static_cast<char>(~byte));
+}
+
+/**
+ * Offset of the first occurrence of `text` in a file.
+ */
+static size_t find(const std::string& path, const std::string& text)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(file)),
+                        std::istreambuf_iterator<char>());
+    return content.find(text);
+}
+
+/**
+ * Items of the snapshot in progress of `state`, in LRU order.
+ */
+static std::vector<unsigned char> snapshot_of(lrucache::cache_state& state)
+{
+    std::vector<unsigned char> result;
+    auto cursor = state.open_snapshot(true);
+    std::vector<iovec> iov;
+    while (!cursor.done()) {
+        cursor.next(1000, iov);
+        for (auto& buffer : iov) {
+            auto base = static_cast<unsigned char*>(buffer.iov_base);
+            result.insert(result.end(), base, base + buffer.iov_len);
+        }
+    }
+    return result;
+}
+
+TEST_CASE("Snapshot files", "[snapshot][snapshot_file]") {
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 100 * item_size(200);
+    config.max_item_size = 200 + config.max_key_size;
+    config.shard_count = 3;
+    config.snapshot_threads = 2;
+    lrucache::cache_state source(config);
+    lrucache::cache_state target(config);
+    std::time_t now = std::time(nullptr);
+    size_t len = 0;
+
+    for (int i = 0; i < 30; i++) {
+        auto item = create_item(i % 2 ? 200 : 10, now + 1000 + i);
+        memset(item.bytes(), 'a' + i, item.data_size);
+        source.commit_write("key" + std::to_string(i), item, now);
+    }
+    source.commit_read("key3", now + 1);
+    target.commit_write("other", create_item(10, now + 1000), now);
+    source.begin_snapshot();
+
+    std::string path = "test_snapshot_file_" + std::to_string(getpid())
+                       + ".lrcs";
+    std::vector<unsigned char> meta = { 1, 2, 3, 4, 5 };
+    REQUIRE(snapshot_file::write(source, path, now + 1, meta));
+
+    SECTION ( "items and meta are read back" ) {
+        auto file = snapshot_file::open(path);
+        REQUIRE(file != nullptr);
+        REQUIRE(file->taken_at() == now + 1);
+        REQUIRE(file->item_count() == 30);
+        REQUIRE(file->meta_size() == meta.size());
+        REQUIRE(memcmp(file->meta(), meta.data(), meta.size()) == 0);
+
+        REQUIRE(file->restore(target));
+        REQUIRE(target.read("other", len) == nullptr);
+        for (int i = 0; i < 30; i++) {
+            auto result = target.read("key" + std::to_string(i), len);
+            REQUIRE(result != nullptr);
+            REQUIRE(len == (i % 2 ? 200 : 10));
+            REQUIRE(result[0] == 'a' + i);
+        }
+    }
+
+    SECTION ( "restored items keep the LRU order of the snapshot" ) {
+        auto file = snapshot_file::open(path);
+        REQUIRE(file != nullptr);
+        REQUIRE(file->restore(target));
+        target.begin_snapshot();
+
+        int source_index = 0;
+        int target_index = 0;
+        size_t source_read = 0;
+        size_t target_read = 0;
+        while (source_index >= 0) {
+            auto expected = source.read_snapshot_chunk(1000, source_index,
+                                                       source_read);
+            auto result = target.read_snapshot_chunk(1000, target_index,
+                                                     target_read);
+            REQUIRE(target_read == source_read);
+            REQUIRE(memcmp(result.get(), expected.get(), source_read) == 0);
+        }
+        target.end_snapshot();
+    }
+
+    SECTION ( "corrupt headers are rejected" ) {
+        corrupt(path, 20);
+        REQUIRE(snapshot_file::open(path) == nullptr);
+    }
+
+    SECTION ( "corrupt segments are not restored" ) {
+        corrupt(path, find(path, "key7"));
+
+        auto file = snapshot_file::open(path);
+        REQUIRE(file != nullptr);
+        REQUIRE_FALSE(file->restore(target));
+        REQUIRE(target.read("other", len) != nullptr);
+        REQUIRE(target.read("key0", len) == nullptr);
+    }
+
+    SECTION ( "truncated files are rejected" ) {
+        REQUIRE(truncate(path.c_str(), 100) == 0);
+        REQUIRE(snapshot_file::open(path) == nullptr);
+    }
+
+    SECTION ( "the file written serves the snapshot in progress" ) {
+        auto expected = snapshot_of(source);
+        auto cursor = source.open_snapshot_segment(1, true);
+        std::vector<iovec> iov;
+        cursor.next(300, iov);
+        size_t position = cursor.position();
+        cursor.next(1000, iov);
+        std::vector<unsigned char> rest;
+        for (auto& buffer : iov) {
+            auto base = static_cast<unsigned char*>(buffer.iov_base);
+            rest.insert(rest.end(), base, base + buffer.iov_len);
+        }
+
+        source.serve_snapshot(snapshot_file::open(path));
+        source.commit_write("key3", create_item(10, now + 1000), now + 2);
+        REQUIRE(snapshot_of(source) == expected);
+
+        // cursors resume from the file where they were
+        cursor = source.open_snapshot_segment(1, true);
+        cursor.seek(position);
+        cursor.next(1000, iov);
+        std::vector<unsigned char> resumed;
+        for (auto& buffer : iov) {
+            auto base = static_cast<unsigned char*>(buffer.iov_base);
+            resumed.insert(resumed.end(), base, base + buffer.iov_len);
+        }
+        REQUIRE(resumed == rest);
+    }
+
+    source.end_snapshot();
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Snapshot files attached", "[snapshot][snapshot_file]") {
+    lrucache::cache_config config = build_default_cache_config();
+    config.cache_size = 100 * item_size(200);
+    config.max_item_size = 200 + config.max_key_size;
+    config.shard_count = 3;
+    config.snapshot_threads = 2;
+    lrucache::cache_state source(config);
+    lrucache::cache_state target(config);
+    std::time_t now = std::time(nullptr);
+    size_t len = 0;
+
+    for (int i = 0; i < 30; i++) {
+        auto item = create_item(i % 2 ? 200 : 10, now + 1000 + i);
+        memset(item.bytes(), 'a' + i, item.data_size);
+        source.commit_write("key" + std::to_string(i), item, now);
+    }
+    target.commit_write("other", create_item(10, now + 1000), now);
+    source.begin_snapshot();
+    auto expected = snapshot_of(source);
+
+    std::string path = "test_snapshot_attached_" + std::to_string(getpid())
+                       + ".lrcs";
+    REQUIRE(snapshot_file::write(source, path, now + 1, {}));
+    std::shared_ptr<const snapshot_file> file = snapshot_file::open(path);
+    REQUIRE(file != nullptr);
+    std::remove(path.c_str());
+    REQUIRE(target.attach_snapshot(file));
+
+    SECTION ( "items are read from the file right away" ) {
+        REQUIRE(target.read("other", len) == nullptr);
+        for (int i = 0; i < 30; i++) {
+            auto result = target.read("key" + std::to_string(i), len);
+            REQUIRE(result != nullptr);
+            REQUIRE(len == (i % 2 ? 200 : 10));
+            REQUIRE(result[0] == 'a' + i);
+        }
+    }
+
+    SECTION ( "the file is the snapshot in progress" ) {
+        REQUIRE(snapshot_of(target) == expected);
+        target.fold_snapshot();
+        REQUIRE(snapshot_of(target) == expected);
+    }
+
+    SECTION ( "folded items end up like on the node that took it" ) {
+        // commits before and after the fold must give the same items in
+        // the same order as on the source
+        for (auto state : { &source, &target }) {
+            state->commit_read("key4", now + 2);
+            auto item = create_item(10, now + 1000);
+            memset(item.bytes(), 'z', item.data_size);
+            state->commit_write("key7", item, now + 2);
+            state->commit_write("new", item, now + 2);
+        }
+        auto result = target.read("key7", len);
+        REQUIRE(result != nullptr);
+        REQUIRE(result[0] == 'z');
+
+        target.fold_snapshot();
+        for (auto state : { &source, &target }) {
+            state->commit_read("key9", now + 3);
+        }
+        source.begin_snapshot();
+        target.begin_snapshot();
+        REQUIRE(snapshot_of(target) == snapshot_of(source));
+        REQUIRE(target.read("other", len) == nullptr);
+        target.end_snapshot();
+    }
+
+    SECTION ( "files with a corrupt segment are not attached" ) {
+        std::string corrupt_path = "test_snapshot_corrupt_"
+                                   + std::to_string(getpid()) + ".lrcs";
+        REQUIRE(snapshot_file::write(source, corrupt_path, now + 1, {}));
+        corrupt(corrupt_path, find(corrupt_path, "key7"));
+        std::shared_ptr<const snapshot_file> corrupt_file =
+                snapshot_file::open(corrupt_path);
+        std::remove(corrupt_path.c_str());
+        REQUIRE(corrupt_file != nullptr);
+
+        lrucache::cache_state other(config);
+        other.commit_write("other", create_item(10, now + 1000), now);
+        REQUIRE_FALSE(other.attach_snapshot(corrupt_file));
+        REQUIRE(other.read("other", len) != nullptr);
+        REQUIRE(other.read("key0", len) == nullptr);
+    }
+
+    SECTION ( "files with another shard count are not attached" ) {
+        config.shard_count = 2;
+        lrucache::cache_state other(config);
+        REQUIRE_FALSE(other.attach_snapshot(file));
+        REQUIRE(file->restore(other));
+        REQUIRE(other.read("key3", len) != nullptr);
+    }
+
+    source.end_snapshot();
+}
@@ -0,0 +1,129 @@
+#include <catch.hpp>
+
+#include <deque>
+#include <vector>
+
+#include "cache/timing_wheel.hxx"
+
+using lrucache::cache_entry;
+using lrucache::timing_wheel;
+
+static cache_entry* make_entry(std::deque<cache_entry>& entries,
+                               std::time_t expires_at)
+{
+    entries.emplace_back();
+    entries.back().item.expires_at = expires_at;
+    return &entries.back();
+}
+
+TEST_CASE("Timing wheel expiry", "[timing_wheel]") {
+    std::deque<cache_entry> entries;
+    std::vector<cache_entry*> expired;
+    timing_wheel wheel;
+    std::time_t now = 1700000000;
+    wheel.reset(now);
+
+    auto expire = [&](cache_entry* entry) {
+        wheel.cancel(entry);
+        expired.push_back(entry);
+    };
+
+    SECTION ( "entries expire at their tick, in expiry order" ) {
+        auto entry1 = make_entry(entries, now + 100);
+        auto entry2 = make_entry(entries, now + 5);
+        auto entry3 = make_entry(entries, now + 5000);
+        for (auto entry : { entry1, entry2, entry3 }) {
+            wheel.schedule(entry);
+        }
+
+        REQUIRE(wheel.advance(now + 4, SIZE_MAX, expire) == 0);
+        REQUIRE(wheel.advance(now + 5, SIZE_MAX, expire) == 1);
+        REQUIRE(wheel.advance(now + 4999, SIZE_MAX, expire) == 1);
+        REQUIRE(wheel.advance(now + 5000, SIZE_MAX, expire) == 1);
+        REQUIRE(expired == std::vector<cache_entry*>{ entry2, entry1, entry3 });
+        REQUIRE(wheel.empty());
+    }
+
+    SECTION ( "cancelled entries never expire" ) {
+        auto entry1 = make_entry(entries, now + 10);
+        auto entry2 = make_entry(entries, now + 10);
+        wheel.schedule(entry1);
+        wheel.schedule(entry2);
+        wheel.cancel(entry1);
+
+        wheel.advance(now + 10, SIZE_MAX, expire);
+        REQUIRE(expired == std::vector<cache_entry*>{ entry2 });
+    }
+
+    SECTION ( "rescheduled entries expire at their new tick" ) {
+        auto entry = make_entry(entries, now + 10);
+        wheel.schedule(entry);
+        entry->item.expires_at = now + 300000;
+        wheel.cancel(entry);
+        wheel.schedule(entry);
+
+        REQUIRE(wheel.advance(now + 299999, SIZE_MAX, expire) == 0);
+        REQUIRE(wheel.advance(now + 300000, SIZE_MAX, expire) == 1);
+    }
+
+    SECTION ( "entries beyond the top level wait in the overflow slot" ) {
+        std::time_t later = now + (std::time_t(1) << 25);
+        auto entry = make_entry(entries, later);
+        wheel.schedule(entry);
+
+        wheel.advance(later - 1, SIZE_MAX, expire);
+        REQUIRE(expired.empty());
+        wheel.advance(later, SIZE_MAX, expire);
+        REQUIRE(expired.size() == 1);
+    }
+
+    SECTION ( "empty levels are skipped over" ) {
+        // one tick at a time, this would take a billion iterations
+        std::time_t later = now + (std::time_t(1) << 30);
+        auto entry = make_entry(entries, later);
+        wheel.schedule(entry);
+        wheel.schedule(make_entry(entries, now + 3));
+
+        REQUIRE(wheel.advance(later - 1, SIZE_MAX, expire) == 1);
+        REQUIRE(wheel.now() == later);
+        REQUIRE(wheel.advance(later, SIZE_MAX, expire) == 1);
+        REQUIRE(expired.back() == entry);
+    }
+
+    SECTION ( "entries already due expire on the next tick" ) {
+        wheel.advance(now + 100, SIZE_MAX, expire);
+        wheel.schedule(make_entry(entries, now + 50));
+        wheel.schedule(make_entry(entries, now + 200));
+
+        REQUIRE(wheel.advance(now + 101, SIZE_MAX, expire) == 1);
+    }
+
+    SECTION ( "due entries are counted on every level" ) {
+        for (long ttl : { 1L, 2L, 70L, 70L, 5000L, 1L << 25 }) {
+            wheel.schedule(make_entry(entries, now + ttl));
+        }
+
+        REQUIRE(wheel.due(now) == 0);
+        REQUIRE(wheel.due(now + 1) == 1);
+        REQUIRE(wheel.due(now + 70) == 4);
+        REQUIRE(wheel.due(now + 4999) == 4);
+        REQUIRE(wheel.due(now + (std::time_t(1) << 26)) == 6);
+        wheel.advance(now + 1, SIZE_MAX, expire);
+        REQUIRE(wheel.due(now + 5000) == 4);
+    }
+
+    SECTION ( "expiry resumes where the limit stopped it" ) {
+        for (int i = 0; i < 10; i++) {
+            wheel.schedule(make_entry(entries, now + 1 + i % 2));
+        }
+
+        REQUIRE(wheel.advance(now + 2, 4, expire) == 4);
+        REQUIRE(wheel.advance(now + 2, 4, expire) == 4);
+        REQUIRE(wheel.advance(now + 2, 4, expire) == 2);
+        REQUIRE(wheel.empty());
+        for (size_t i = 1; i < expired.size(); i++) {
+            REQUIRE(expired[i - 1]->item.expires_at
+                    <= expired[i]->item.expires_at);
+        }
+    }
+}